@@ -3,10 +3,109 @@
 //***************************************************************************************
 
 #include "GeometryGenerator.h"
+#include "MeshTangents.h"
+#include "TaskScheduler.h"
 #include <algorithm>
 
 using namespace DirectX;
 
+namespace
+{
+	// Meshes with fewer vertices than this are generated serially; below it the
+	// dispatch costs more than it saves.
+	const std::uint64_t ParallelVertexThreshold = 16384;
+
+	// Least vertices (or quads) that one parallel chunk of rows works on.
+	const std::uint32_t ParallelGrainVertices = 2048;
+}
+
+template <typename Func>
+void GeometryGenerator::ForEachRow(uint32 rowCount, uint32 rowSize, const Func& body)
+{
+	if (std::uint64_t(rowCount) * rowSize < ParallelVertexThreshold)
+	{
+		for (uint32 i = 0; i < rowCount; ++i)
+			body(i);
+		return;
+	}
+
+	// Every row writes its own, precomputed part of the output, so the result is
+	// the same however the rows are spread over threads.
+	TaskScheduler& scheduler = mScheduler != nullptr ? *mScheduler : TaskScheduler::Default();
+	int grainSize = static_cast<int>(std::max<uint32>(1, ParallelGrainVertices / std::max<uint32>(rowSize, 1)));
+	scheduler.ParallelFor(0, static_cast<int>(rowCount), grainSize, [&body](int i)
+	{
+		body(static_cast<uint32>(i));
+	});
+}
+
+std::vector<GeometryGenerator::MeshData::Chunk16> GeometryGenerator::MeshData::SplitIndices16(std::vector<uint16>& indices16)
+{
+	const uint32 maxSpan = 0xffff;
+
+	std::vector<Chunk16> chunks;
+	indices16.clear();
+	indices16.reserve(Indices32.size());
+
+	// The chunk being built: its first index and the range of vertices it uses.
+	size_t chunkStart = 0;
+	uint32 lo = UINT32_MAX;
+	uint32 hi = 0;
+
+	auto closeChunk = [&](size_t chunkEnd)
+	{
+		Chunk16 chunk;
+		chunk.StartIndexLocation = static_cast<uint32>(chunkStart);
+		chunk.IndexCount = static_cast<uint32>(chunkEnd - chunkStart);
+		chunk.BaseVertexLocation = static_cast<int>(lo);
+		chunks.push_back(chunk);
+
+		for (size_t i = chunkStart; i < chunkEnd; ++i)
+			indices16.push_back(static_cast<uint16>(Indices32[i] - lo));
+	};
+
+	for (size_t i = 0; i + 2 < Indices32.size(); i += 3)
+	{
+		uint32 triLo = std::min(Indices32[i], std::min(Indices32[i + 1], Indices32[i + 2]));
+		uint32 triHi = std::max(Indices32[i], std::max(Indices32[i + 1], Indices32[i + 2]));
+
+		if (triHi - triLo > maxSpan)
+		{
+			uint32 base = static_cast<uint32>(Vertices.size());
+			for (int k = 0; k < 3; ++k)
+			{
+				Vertex copy = Vertices[Indices32[i + k]];
+				Vertices.push_back(copy);
+				Indices32[i + k] = base + k;
+			}
+			triLo = base;
+			triHi = base + 2;
+		}
+
+		uint32 newLo = std::min(lo, triLo);
+		uint32 newHi = std::max(hi, triHi);
+		if (i > chunkStart && newHi - newLo > maxSpan)
+		{
+			closeChunk(i);
+			chunkStart = i;
+			newLo = triLo;
+			newHi = triHi;
+		}
+
+		lo = newLo;
+		hi = newHi;
+	}
+
+	size_t triangleEnd = Indices32.size() - Indices32.size() % 3;
+	if (triangleEnd > chunkStart)
+		closeChunk(triangleEnd);
+
+	// Indices32 may have been changed under the cached 16-bit indices.
+	mIndices16.clear();
+
+	return chunks;
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
 {
 	MeshData meshData;
@@ -118,8 +217,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
 	// Put a cap on the number of subdivisions.
 	numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
 
-	for (uint32 i = 0; i < numSubdivisions; ++i)
-		Subdivide(meshData);
+	Subdivide(meshData, numSubdivisions);
 
 	return meshData;
 }
@@ -138,15 +236,26 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
 	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 
-	meshData.Vertices.push_back(topVertex);
+	// Add one because we duplicate the first and last vertex per ring
+	// since the texture coordinates are different.
+	uint32 ringVertexCount = sliceCount + 1;
+	uint32 innerRingCount = stackCount - 1;
+
+	meshData.Vertices.resize(innerRingCount * ringVertexCount + 2);
+	meshData.Indices32.resize(sliceCount * 6 * (stackCount - 1));
+
+	meshData.Vertices.front() = topVertex;
+	meshData.Vertices.back() = bottomVertex;
 
 	float phiStep = XM_PI / stackCount;
 	float thetaStep = 2.0f * XM_PI / sliceCount;
 
 	// Compute vertices for each stack ring (do not count the poles as rings).
-	for (uint32 i = 1; i <= stackCount - 1; ++i)
+	ForEachRow(innerRingCount, ringVertexCount, [&](uint32 ring)
 	{
+		uint32 i = ring + 1;
 		float phi = i * phiStep;
+		Vertex* ringVertices = &meshData.Vertices[1 + ring * ringVertexCount];
 
 		// Vertices of ring.
 		for (uint32 j = 0; j <= sliceCount; ++j)
@@ -174,22 +283,21 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 			v.TexC.x = theta / XM_2PI;
 			v.TexC.y = phi / XM_PI;
 
-			meshData.Vertices.push_back(v);
+			ringVertices[j] = v;
 		}
-	}
-
-	meshData.Vertices.push_back(bottomVertex);
+	});
 
 	//
 	// Compute indices for top stack.  The top stack was written first to the vertex buffer
 	// and connects the top pole to the first ring.
 	//
 
+	uint32* topIndices = meshData.Indices32.data();
 	for (uint32 i = 1; i <= sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(0);
-		meshData.Indices32.push_back(i + 1);
-		meshData.Indices32.push_back(i);
+		*topIndices++ = 0;
+		*topIndices++ = i + 1;
+		*topIndices++ = i;
 	}
 
 	//
@@ -199,20 +307,20 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	// Offset the indices to the index of the first vertex in the first ring.
 	// This is just skipping the top pole vertex.
 	uint32 baseIndex = 1;
-	uint32 ringVertexCount = sliceCount + 1;
-	for (uint32 i = 0; i < stackCount - 2; ++i)
+	ForEachRow(stackCount - 2, sliceCount, [&](uint32 i)
 	{
+		uint32* indices = &meshData.Indices32[(sliceCount + i * sliceCount * 2) * 3];
 		for (uint32 j = 0; j < sliceCount; ++j)
 		{
-			meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j + 1);
-			meshData.Indices32.push_back(baseIndex + (i + 1) * ringVertexCount + j);
+			*indices++ = baseIndex + i * ringVertexCount + j;
+			*indices++ = baseIndex + i * ringVertexCount + j + 1;
+			*indices++ = baseIndex + (i + 1) * ringVertexCount + j;
 
-			meshData.Indices32.push_back(baseIndex + (i + 1) * ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j + 1);
-			meshData.Indices32.push_back(baseIndex + (i + 1) * ringVertexCount + j + 1);
+			*indices++ = baseIndex + (i + 1) * ringVertexCount + j;
+			*indices++ = baseIndex + i * ringVertexCount + j + 1;
+			*indices++ = baseIndex + (i + 1) * ringVertexCount + j + 1;
 		}
-	}
+	});
 
 	//
 	// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
@@ -225,24 +333,76 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	// Offset the indices to the index of the first vertex in the last ring.
 	baseIndex = southPoleIndex - ringVertexCount;
 
+	uint32* bottomIndices = &meshData.Indices32[meshData.Indices32.size() - sliceCount * 3];
 	for (uint32 i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(southPoleIndex);
-		meshData.Indices32.push_back(baseIndex + i);
-		meshData.Indices32.push_back(baseIndex + i + 1);
+		*bottomIndices++ = southPoleIndex;
+		*bottomIndices++ = baseIndex + i;
+		*bottomIndices++ = baseIndex + i + 1;
 	}
 
 	return meshData;
 }
 
-void GeometryGenerator::Subdivide(MeshData& meshData)
+void GeometryGenerator::Subdivide(MeshData& meshData, uint32 numSubdivisions)
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
+	// Each level reads the indices of the one before from 'input' and writes its
+	// own into meshData.Indices32; swapping them keeps both allocations (and the
+	// edge table's) for the next level instead of copying the whole mesh.
+	std::vector<uint32> input;
+	std::vector<std::uint64_t> edges;
 
+	for (uint32 i = 0; i < numSubdivisions; ++i)
+	{
+		input.swap(meshData.Indices32);
+		SubdivideOnce(meshData, input, edges);
+	}
+}
 
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
+namespace
+{
+	std::uint64_t EdgeKey(std::uint32_t a, std::uint32_t b)
+	{
+		if (a > b)
+			std::swap(a, b);
+
+		return (std::uint64_t(a) << 32) | b;
+	}
+
+	std::uint32_t EdgeIndex(const std::vector<std::uint64_t>& edges, std::uint32_t a, std::uint32_t b)
+	{
+		return static_cast<std::uint32_t>(std::lower_bound(edges.begin(), edges.end(), EdgeKey(a, b)) - edges.begin());
+	}
+}
+
+void GeometryGenerator::SubdivideOnce(MeshData& meshData, const std::vector<uint32>& input, std::vector<std::uint64_t>& edges)
+{
+	uint32 numVerts = static_cast<uint32>(meshData.Vertices.size());
+	uint32 numTris = static_cast<uint32>(input.size()) / 3;
+
+	//
+	// One midpoint per distinct edge: sort the edges of all the triangles and
+	// drop the duplicates.  The midpoint of edges[e] becomes vertex numVerts + e.
+	//
+
+	edges.resize(numTris * 3);
+	for (uint32 i = 0; i < numTris; ++i)
+	{
+		edges[i * 3 + 0] = EdgeKey(input[i * 3 + 0], input[i * 3 + 1]);
+		edges[i * 3 + 1] = EdgeKey(input[i * 3 + 1], input[i * 3 + 2]);
+		edges[i * 3 + 2] = EdgeKey(input[i * 3 + 0], input[i * 3 + 2]);
+	}
+
+	std::sort(edges.begin(), edges.end());
+	edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+	meshData.Vertices.resize(numVerts + edges.size());
+	for (size_t e = 0; e < edges.size(); ++e)
+	{
+		uint32 a = static_cast<uint32>(edges[e] >> 32);
+		uint32 b = static_cast<uint32>(edges[e]);
+		meshData.Vertices[numVerts + e] = MidPoint(meshData.Vertices[a], meshData.Vertices[b]);
+	}
 
 	//       v1
 	//       *
@@ -254,47 +414,34 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 	// *-----*-----*
 	// v0    m2     v2
 
-	uint32 numTris = static_cast<uint32>(inputCopy.Indices32.size()) / 3;
+	meshData.Indices32.resize(numTris * 12);
 	for (uint32 i = 0; i < numTris; ++i)
 	{
-		Vertex v0 = inputCopy.Vertices[inputCopy.Indices32[i * 3 + 0]];
-		Vertex v1 = inputCopy.Vertices[inputCopy.Indices32[i * 3 + 1]];
-		Vertex v2 = inputCopy.Vertices[inputCopy.Indices32[i * 3 + 2]];
-
-		//
-		// Generate the midpoints.
-		//
-
-		Vertex m0 = MidPoint(v0, v1);
-		Vertex m1 = MidPoint(v1, v2);
-		Vertex m2 = MidPoint(v0, v2);
-
-		//
-		// Add new geometry.
-		//
-
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
-
-		meshData.Indices32.push_back(i * 6 + 0);
-		meshData.Indices32.push_back(i * 6 + 3);
-		meshData.Indices32.push_back(i * 6 + 5);
-
-		meshData.Indices32.push_back(i * 6 + 3);
-		meshData.Indices32.push_back(i * 6 + 4);
-		meshData.Indices32.push_back(i * 6 + 5);
-
-		meshData.Indices32.push_back(i * 6 + 5);
-		meshData.Indices32.push_back(i * 6 + 4);
-		meshData.Indices32.push_back(i * 6 + 2);
-
-		meshData.Indices32.push_back(i * 6 + 3);
-		meshData.Indices32.push_back(i * 6 + 1);
-		meshData.Indices32.push_back(i * 6 + 4);
+		uint32 v0 = input[i * 3 + 0];
+		uint32 v1 = input[i * 3 + 1];
+		uint32 v2 = input[i * 3 + 2];
+
+		uint32 m0 = numVerts + EdgeIndex(edges, v0, v1);
+		uint32 m1 = numVerts + EdgeIndex(edges, v1, v2);
+		uint32 m2 = numVerts + EdgeIndex(edges, v0, v2);
+
+		uint32* out = &meshData.Indices32[i * 12];
+
+		out[0] = v0;
+		out[1] = m0;
+		out[2] = m2;
+
+		out[3] = m0;
+		out[4] = m1;
+		out[5] = m2;
+
+		out[6] = m2;
+		out[7] = m1;
+		out[8] = v2;
+
+		out[9] = m0;
+		out[10] = v1;
+		out[11] = m1;
 	}
 }
 
@@ -364,8 +511,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 	for (uint32 i = 0; i < 12; ++i)
 		meshData.Vertices[i].Position = pos[i];
 
-	for (uint32 i = 0; i < numSubdivisions; ++i)
-		Subdivide(meshData);
+	Subdivide(meshData, numSubdivisions);
 
 	// Project vertices onto sphere and scale.
 	for (uint32 i = 0; i < meshData.Vertices.size(); ++i)
@@ -391,13 +537,84 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 		meshData.Vertices[i].TexC.x = theta / XM_2PI;
 		meshData.Vertices[i].TexC.y = phi / XM_PI;
 
-		// Partial derivative of P with respect to theta
-		meshData.Vertices[i].TangentU.x = -radius * sinf(phi) * sinf(theta);
+		// Direction of the partial derivative of P with respect to theta.  Its
+		// length, radius*sin(phi), is left out so the poles get a tangent too.
+		meshData.Vertices[i].TangentU.x = -sinf(theta);
 		meshData.Vertices[i].TangentU.y = 0.0f;
-		meshData.Vertices[i].TangentU.z = +radius * sinf(phi) * cosf(theta);
+		meshData.Vertices[i].TangentU.z = +cosf(theta);
+	}
+
+	// Triangles across the u = 0/1 seam would run u backwards over nearly the
+	// whole texture; their corners on the low side get copies at u + 1.  The
+	// poles have no u of their own and are dealt with after.
+	const uint32 NoCopy = ~0u;
+	auto isPole = [&meshData, radius](uint32 index)
+	{
+		const XMFLOAT3& p = meshData.Vertices[index].Position;
+		return p.x*p.x + p.z*p.z < 1e-12f*radius*radius;
+	};
 
-		XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
-		XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
+	std::vector<uint32> seamCopy(meshData.Vertices.size(), NoCopy);
+	for (size_t t = 0; t + 2 < meshData.Indices32.size(); t += 3)
+	{
+		uint32* tri = &meshData.Indices32[t];
+
+		float minU = 1.0f;
+		float maxU = 0.0f;
+		for (int k = 0; k < 3; ++k)
+		{
+			if (!isPole(tri[k]))
+			{
+				minU = std::min(minU, meshData.Vertices[tri[k]].TexC.x);
+				maxU = std::max(maxU, meshData.Vertices[tri[k]].TexC.x);
+			}
+		}
+		if (maxU - minU < 0.5f)
+			continue;
+
+		for (int k = 0; k < 3; ++k)
+		{
+			if (isPole(tri[k]) || meshData.Vertices[tri[k]].TexC.x >= 0.5f)
+				continue;
+
+			if (seamCopy[tri[k]] == NoCopy)
+			{
+				Vertex copy = meshData.Vertices[tri[k]];
+				copy.TexC.x += 1.0f;
+				seamCopy[tri[k]] = static_cast<uint32>(meshData.Vertices.size());
+				meshData.Vertices.push_back(copy);
+			}
+			tri[k] = seamCopy[tri[k]];
+		}
+	}
+
+	// Every triangle at a pole gets its own pole vertex, with u halfway between
+	// its other two corners and the tangent for that u.
+	std::vector<bool> poleUsed(meshData.Vertices.size(), false);
+	for (size_t t = 0; t + 2 < meshData.Indices32.size(); t += 3)
+	{
+		uint32* tri = &meshData.Indices32[t];
+		for (int k = 0; k < 3; ++k)
+		{
+			if (!isPole(tri[k]))
+				continue;
+
+			float u = 0.5f * (meshData.Vertices[tri[(k + 1) % 3]].TexC.x + meshData.Vertices[tri[(k + 2) % 3]].TexC.x);
+			Vertex pole = meshData.Vertices[tri[k]];
+			pole.TexC.x = u;
+			pole.TangentU = XMFLOAT3(-sinf(u * XM_2PI), 0.0f, cosf(u * XM_2PI));
+
+			if (!poleUsed[tri[k]])
+			{
+				poleUsed[tri[k]] = true;
+				meshData.Vertices[tri[k]] = pole;
+			}
+			else
+			{
+				tri[k] = static_cast<uint32>(meshData.Vertices.size());
+				meshData.Vertices.push_back(pole);
+			}
+		}
 	}
 
 	return meshData;
@@ -419,8 +636,19 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 
 	uint32 ringCount = stackCount + 1;
 
+	// Add one because we duplicate the first and last vertex per ring
+	// since the texture coordinates are different.
+	uint32 ringVertexCount = sliceCount + 1;
+
+	// The stacks, then the two caps (a ring plus a center vertex each).
+	meshData.Vertices.reserve(ringCount * ringVertexCount + 2 * (ringVertexCount + 1));
+	meshData.Indices32.reserve(stackCount * sliceCount * 6 + 2 * sliceCount * 3);
+
+	meshData.Vertices.resize(ringCount * ringVertexCount);
+	meshData.Indices32.resize(stackCount * sliceCount * 6);
+
 	// Compute vertices for each stack ring starting at the bottom and moving up.
-	for (uint32 i = 0; i < ringCount; ++i)
+	ForEachRow(ringCount, ringVertexCount, [&](uint32 i)
 	{
 		float y = -0.5f * height + i * stackHeight;
 		float r = bottomRadius + i * radiusStep;
@@ -469,28 +697,25 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 			XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
 			XMStoreFloat3(&vertex.Normal, N);
 
-			meshData.Vertices.push_back(vertex);
+			meshData.Vertices[i * ringVertexCount + j] = vertex;
 		}
-	}
-
-	// Add one because we duplicate the first and last vertex per ring
-	// since the texture coordinates are different.
-	uint32 ringVertexCount = sliceCount + 1;
+	});
 
 	// Compute indices for each stack.
-	for (uint32 i = 0; i < stackCount; ++i)
+	ForEachRow(stackCount, sliceCount, [&](uint32 i)
 	{
+		uint32* indices = &meshData.Indices32[i * sliceCount * 6];
 		for (uint32 j = 0; j < sliceCount; ++j)
 		{
-			meshData.Indices32.push_back(i * ringVertexCount + j);
-			meshData.Indices32.push_back((i + 1) * ringVertexCount + j);
-			meshData.Indices32.push_back((i + 1) * ringVertexCount + j + 1);
+			*indices++ = i * ringVertexCount + j;
+			*indices++ = (i + 1) * ringVertexCount + j;
+			*indices++ = (i + 1) * ringVertexCount + j + 1;
 
-			meshData.Indices32.push_back(i * ringVertexCount + j);
-			meshData.Indices32.push_back((i + 1) * ringVertexCount + j + 1);
-			meshData.Indices32.push_back(i * ringVertexCount + j + 1);
+			*indices++ = i * ringVertexCount + j;
+			*indices++ = (i + 1) * ringVertexCount + j + 1;
+			*indices++ = i * ringVertexCount + j + 1;
 		}
-	}
+	});
 
 	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
 	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
@@ -573,6 +798,16 @@ void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadi
 	}
 }
 
+void GeometryGenerator::BuildNormalsAndTangents(MeshData& meshData)
+{
+	// The hand-written corner normals of these shapes do not match their faces, so
+	// all of them are rebuilt.
+	MeshTangents::TangentOptions options;
+	options.ComputeNormals = true;
+	options.Scheduler = mScheduler;
+	MeshTangents::Generate(meshData, options);
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n)
 {
 	MeshData meshData;
@@ -594,7 +829,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 	float dv = 1.0f / (m - 1);
 
 	meshData.Vertices.resize(vertexCount);
-	for (uint32 i = 0; i < m; ++i)
+	ForEachRow(m, n, [&](uint32 i)
 	{
 		float z = halfDepth - i * dz;
 		for (uint32 j = 0; j < n; ++j)
@@ -609,7 +844,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 			meshData.Vertices[i * n + j].TexC.x = j * du;
 			meshData.Vertices[i * n + j].TexC.y = i * dv;
 		}
-	}
+	});
 
 	//
 	// Create the indices.
@@ -618,9 +853,9 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 	meshData.Indices32.resize(faceCount * 3); // 3 indices per face
 
 	// Iterate over each quad and compute indices.
-	uint32 k = 0;
-	for (uint32 i = 0; i < m - 1; ++i)
+	ForEachRow(m - 1, n - 1, [&](uint32 i)
 	{
+		uint32 k = i * (n - 1) * 6;
 		for (uint32 j = 0; j < n - 1; ++j)
 		{
 			meshData.Indices32[k] = i * n + j;
@@ -633,7 +868,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 
 			k += 6; // next quad
 		}
-	}
+	});
 
 	return meshData;
 }
@@ -729,8 +964,8 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSquarePyramid(float height,
 
 	numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
 
-	for (uint32 i = 0; i < numSubdivisions; ++i)
-		Subdivide(meshdata);
+	Subdivide(meshdata, numSubdivisions);
+	BuildNormalsAndTangents(meshdata);
 
 	return meshdata;
 }
@@ -774,8 +1009,8 @@ GeometryGenerator::MeshData GeometryGenerator::CreateTriangularPyramid(float hei
 
 	numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
 
-	for (uint32 i = 0; i < numSubdivisions; ++i)
-		Subdivide(meshdata);
+	Subdivide(meshdata, numSubdivisions);
+	BuildNormalsAndTangents(meshdata);
 
 	return meshdata;
 }
@@ -838,8 +1073,8 @@ GeometryGenerator::MeshData GeometryGenerator::CreateTriangularPrism(float width
 	meshdata.Indices32.assign(&i[0], &i[24]);
 	numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
 
-	for (uint32 i = 0; i < numSubdivisions; ++i)
-		Subdivide(meshdata);
+	Subdivide(meshdata, numSubdivisions);
+	BuildNormalsAndTangents(meshdata);
 
 	return meshdata;
 }
@@ -928,11 +1163,18 @@ GeometryGenerator::MeshData GeometryGenerator::CreateTorus(float radius, float t
 	float thetaStep = XM_2PI / sliceCount;
 	float phiStep = XM_2PI / stackCount;
 
-	for (int i = 0; i <= stackCount; ++i)
+	// The first vertex of every ring and the first ring are repeated at the end,
+	// since the texture coordinates are different there.
+	uint32 ringVertexCount = sliceCount + 1;
+
+	meshData.Vertices.resize((stackCount + 1) * ringVertexCount);
+	meshData.Indices32.resize(stackCount * sliceCount * 6);
+
+	ForEachRow(stackCount + 1, ringVertexCount, [&](uint32 i)
 	{
 		float phi = i * phiStep;
 
-		for (int j = 0; j < sliceCount; ++j)
+		for (uint32 j = 0; j <= sliceCount; ++j)
 		{
 			float theta = j * thetaStep;
 
@@ -940,32 +1182,35 @@ GeometryGenerator::MeshData GeometryGenerator::CreateTorus(float radius, float t
 
 			vertex.Position = XMFLOAT3((radius + thickness * cosf(phi)) * cosf(theta),
 			                           (radius + thickness * cosf(phi)) * sinf(theta),
-			                           thickness * sin(phi));
+			                           thickness * sinf(phi));
 
-			XMVECTOR normal = XMVector3Normalize(
-				XMVectorSubtract(XMLoadFloat3(&vertex.Position), XMVectorSet(radius, 0.0f, 0.0f, 0.0f)));
-			XMStoreFloat3(&vertex.Normal, normal);
+			// Away from the point of the center circle nearest the vertex.
+			vertex.Normal = XMFLOAT3(cosf(phi) * cosf(theta), cosf(phi) * sinf(theta), sinf(phi));
 
-			vertex.TexC.x = static_cast<float>(j) / stackCount - 1;
-			vertex.TexC.y = 1.0f - static_cast<float>(i) / stackCount;
+			// Partial derivative of P with respect to theta, which grows with u.
+			vertex.TangentU = XMFLOAT3(-sinf(theta), cosf(theta), 0.0f);
 
-			meshData.Vertices.push_back(vertex);
+			vertex.TexC.x = static_cast<float>(j) / sliceCount;
+			vertex.TexC.y = static_cast<float>(i) / stackCount;
+
+			meshData.Vertices[i * ringVertexCount + j] = vertex;
 		}
-	}
+	});
 
-	for (int i = 0; i < stackCount; ++i)
+	ForEachRow(stackCount, sliceCount, [&](uint32 i)
 	{
-		for (int j = 0; j < sliceCount; ++j)
+		uint32* indices = &meshData.Indices32[i * sliceCount * 6];
+		for (uint32 j = 0; j < sliceCount; ++j)
 		{
-			meshData.Indices32.push_back((i * sliceCount + j) % (sliceCount * stackCount));
-			meshData.Indices32.push_back((i * sliceCount + (j + 1) % sliceCount) % (sliceCount * stackCount));
-			meshData.Indices32.push_back(((i + 1) * sliceCount + j) % (sliceCount * stackCount));
+			*indices++ = i * ringVertexCount + j;
+			*indices++ = i * ringVertexCount + j + 1;
+			*indices++ = (i + 1) * ringVertexCount + j;
 
-			meshData.Indices32.push_back(((i + 1) * sliceCount + j) % (sliceCount * stackCount));
-			meshData.Indices32.push_back((i * sliceCount + (j + 1) % sliceCount) % (sliceCount * stackCount));
-			meshData.Indices32.push_back(((i + 1) * sliceCount + (j + 1) % sliceCount) % (sliceCount * stackCount));
+			*indices++ = (i + 1) * ringVertexCount + j;
+			*indices++ = i * ringVertexCount + j + 1;
+			*indices++ = (i + 1) * ringVertexCount + j + 1;
 		}
-	}
+	});
 
 	return meshData;
 }
@@ -1027,8 +1272,8 @@ GeometryGenerator::MeshData GeometryGenerator::CreateDiamond(float width, float
 	meshdata.Indices32.assign(&i[0], &i[24]);
 	numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
 
-	for (uint32 i = 0; i < numSubdivisions; ++i)
-		Subdivide(meshdata);
+	Subdivide(meshdata, numSubdivisions);
+	BuildNormalsAndTangents(meshdata);
 
 	return meshdata;
 }
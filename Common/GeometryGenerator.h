@@ -14,10 +14,13 @@
 
 #pragma once
 
+#include <cassert>
 #include <cstdint>
 #include <DirectXMath.h>
 #include <vector>
 
+class TaskScheduler;
+
 class GeometryGenerator
 {
 public:
@@ -62,25 +65,80 @@ public:
 
 	struct MeshData
 	{
+		// A range of the indices drawable with 16-bit indices: they are stored
+		// relative to BaseVertexLocation.
+		struct Chunk16
+		{
+			uint32 StartIndexLocation = 0;
+			uint32 IndexCount = 0;
+			int BaseVertexLocation = 0;
+		};
+
 		std::vector<Vertex> Vertices;
 		std::vector<uint32> Indices32;
 
+		///<summary>
+		/// True if every index fits in 16 bits, i.e. GetIndices16 loses nothing.
+		///</summary>
+		bool FitsIndices16() const
+		{
+			for (uint32 index : Indices32)
+			{
+				if (index > 0xffff)
+					return false;
+			}
+			return true;
+		}
+
+		///<summary>
+		/// Bytes per index needed to draw the mesh in one piece: 2 or 4.
+		///</summary>
+		uint32 IndexSize() const
+		{
+			return FitsIndices16() ? 2 : 4;
+		}
+
+		///<summary>
+		/// The indices as 16-bit values.  Only for meshes that FitsIndices16; use
+		/// SplitIndices16 or Indices32 for larger ones.
+		///</summary>
 		std::vector<uint16>& GetIndices16()
 		{
+			// Checked while converting rather than with FitsIndices16, so debug
+			// builds do not scan the indices again on every call.
 			if (mIndices16.empty())
 			{
 				mIndices16.resize(Indices32.size());
 				for (size_t i = 0; i < Indices32.size(); ++i)
+				{
+					assert(Indices32[i] <= 0xffff);
 					mIndices16[i] = static_cast<uint16>(Indices32[i]);
+				}
 			}
 
 			return mIndices16;
 		}
 
+		///<summary>
+		/// Cuts the triangles, in order, into chunks whose vertices each lie within
+		/// 65536 of one another and writes their 16-bit indices to indices16, so any
+		/// mesh can be drawn with 16-bit indices, one draw per chunk.  Meshes that
+		/// fit come back as a single chunk.  Grids and other meshes whose triangles
+		/// use nearby vertices split without new vertices; a triangle spanning more
+		/// than 65536 vertices gets copies of its vertices appended to Vertices.
+		///</summary>
+		std::vector<Chunk16> SplitIndices16(std::vector<uint16>& indices16);
+
 	private:
 		std::vector<uint16> mIndices16;
 	};
 
+	///<summary>
+	/// Sets the scheduler that large grids, spheres, cylinders and tori are generated
+	/// on (the process-wide default if null).  The output does not depend on it.
+	///</summary>
+	void SetScheduler(TaskScheduler* scheduler) { mScheduler = scheduler; }
+
 	///<summary>
 	/// Creates a box centered at the origin with the given dimensions, where each
 	/// face has m rows and n columns of vertices.
@@ -131,12 +189,28 @@ public:
 
 	MeshData CreateDiamond(float width, float height, float depth, uint32 numSubdivisions);
 
-	void Subdivide(MeshData& meshData);
+	///<summary>
+	/// Splits every triangle into four, numSubdivisions times over.  Triangles that
+	/// share an edge (by vertex indices) share its midpoint, and the existing
+	/// vertices keep their indices.
+	///</summary>
+	void Subdivide(MeshData& meshData, uint32 numSubdivisions = 1);
 
 private:
+	void SubdivideOnce(MeshData& meshData, const std::vector<uint32>& input, std::vector<std::uint64_t>& edges);
 	Vertex MidPoint(const Vertex& v0, const Vertex& v1);
 	void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount,
 	                         MeshData& meshData);
 	void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount,
 	                            MeshData& meshData);
+
+	// For the shapes whose faces share vertices: normals and TangentU from the
+	// triangles, with MeshTangents.
+	void BuildNormalsAndTangents(MeshData& meshData);
+
+	// Calls body(row) for every row in [0, rowCount); in parallel if the mesh is large.
+	template <typename Func>
+	void ForEachRow(uint32 rowCount, uint32 rowSize, const Func& body);
+
+	TaskScheduler* mScheduler = nullptr;
 };
@@ -0,0 +1,411 @@
+//***************************************************************************************
+// MeshCache.cpp
+//***************************************************************************************
+
+#include "MeshCache.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// File layout: a FileHeader, EntryCount entries, then the vertex and index arrays of
+// each entry, every array starting on a DataAlignment boundary.
+struct MeshCache::Entry
+{
+	uint64 Name;
+	uint64 Parameters;
+	uint64 VertexOffset;
+	uint64 IndexOffset;
+	uint32 VertexCount;
+	uint32 IndexCount;
+	float Error;
+	uint32 Padding;
+};
+
+namespace
+{
+	struct FileHeader
+	{
+		char Magic[4];
+		std::uint32_t Version;
+		std::uint32_t EntryCount;
+
+		// sizeof(GeometryGenerator::Vertex) when written.
+		std::uint32_t VertexSize;
+	};
+
+	const char FileMagic[4] = { 'M', 'S', 'H', 'C' };
+	const std::uint64_t DataAlignment = 16;
+
+	std::uint64_t AlignUp(std::uint64_t offset)
+	{
+		return (offset + DataAlignment - 1) & ~(DataAlignment - 1);
+	}
+
+#if !defined(_WIN32)
+	// File names are UTF-8 outside Windows.
+	std::string NarrowFileName(const std::wstring& name)
+	{
+		std::string narrow;
+		for (wchar_t wc : name)
+		{
+			std::uint32_t c = static_cast<std::uint32_t>(wc);
+			if (c < 0x80)
+				narrow += static_cast<char>(c);
+			else if (c < 0x800)
+			{
+				narrow += static_cast<char>(0xc0 | (c >> 6));
+				narrow += static_cast<char>(0x80 | (c & 0x3f));
+			}
+			else if (c < 0x10000)
+			{
+				narrow += static_cast<char>(0xe0 | (c >> 12));
+				narrow += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+				narrow += static_cast<char>(0x80 | (c & 0x3f));
+			}
+			else
+			{
+				narrow += static_cast<char>(0xf0 | (c >> 18));
+				narrow += static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+				narrow += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+				narrow += static_cast<char>(0x80 | (c & 0x3f));
+			}
+		}
+		return narrow;
+	}
+#endif
+
+	// Writes the whole file, or removes what was written and returns false.
+	bool WriteWholeFile(const std::wstring& name, const std::vector<std::uint8_t>& data)
+	{
+#if defined(_WIN32)
+		HANDLE file = CreateFileW(name.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		DWORD written = 0;
+		BOOL ok = WriteFile(file, data.data(), static_cast<DWORD>(data.size()), &written, nullptr);
+		CloseHandle(file);
+		if (!ok || written != data.size())
+		{
+			DeleteFileW(name.c_str());
+			return false;
+		}
+		return true;
+#else
+		std::string narrow = NarrowFileName(name);
+		int file = open(narrow.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (file < 0)
+			return false;
+
+		size_t done = 0;
+		while (done < data.size())
+		{
+			ssize_t written = write(file, data.data() + done, data.size() - done);
+			if (written <= 0)
+				break;
+			done += static_cast<size_t>(written);
+		}
+		bool ok = close(file) == 0 && done == data.size();
+		if (!ok)
+			unlink(narrow.c_str());
+		return ok;
+#endif
+	}
+
+	// Replaces to with from; on failure from is removed and to is left alone.
+	bool ReplaceWholeFile(const std::wstring& from, const std::wstring& to)
+	{
+#if defined(_WIN32)
+		if (MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING))
+			return true;
+		DeleteFileW(from.c_str());
+		return false;
+#else
+		std::string narrowFrom = NarrowFileName(from);
+		if (rename(narrowFrom.c_str(), NarrowFileName(to).c_str()) == 0)
+			return true;
+		unlink(narrowFrom.c_str());
+		return false;
+#endif
+	}
+
+	MeshCache::MeshView MeshDataView(const GeometryGenerator::MeshData& meshData, float error)
+	{
+		MeshCache::MeshView view;
+		view.Vertices = meshData.Vertices.data();
+		view.VertexCount = static_cast<std::uint32_t>(meshData.Vertices.size());
+		view.Indices = meshData.Indices32.data();
+		view.IndexCount = static_cast<std::uint32_t>(meshData.Indices32.size());
+		view.Error = error;
+		return view;
+	}
+}
+
+GeometryGenerator::MeshData MeshCache::MeshView::ToMeshData() const
+{
+	GeometryGenerator::MeshData meshData;
+	meshData.Vertices.assign(Vertices, Vertices + VertexCount);
+	meshData.Indices32.assign(Indices, Indices + IndexCount);
+	return meshData;
+}
+
+MeshCache::MeshCache(const std::wstring& fileName)
+	: mFileName(fileName)
+{
+	Map();
+}
+
+MeshCache::~MeshCache()
+{
+	Unmap();
+}
+
+MeshCache::uint64 MeshCache::Hash(const void* data, size_t byteSize, uint64 hash)
+{
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+	for (size_t i = 0; i < byteSize; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool MeshCache::Find(const Key& key, MeshView& view) const
+{
+	for (uint32 i = 0; i < mEntryCount; ++i)
+	{
+		if (mEntries[i].Name == key.Name && mEntries[i].Parameters == key.Parameters)
+		{
+			view = EntryView(mEntries[i]);
+			++mHitCount;
+			return true;
+		}
+	}
+
+	for (const auto& stored : mStored)
+	{
+		if (stored->MeshKey.Name == key.Name && stored->MeshKey.Parameters == key.Parameters)
+		{
+			view = MeshDataView(stored->Mesh, stored->Error);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+MeshCache::MeshView MeshCache::Store(const Key& key, const GeometryGenerator::MeshData& meshData, float error)
+{
+	auto stored = std::make_unique<StoredMesh>();
+	stored->MeshKey = key;
+	stored->Mesh.Vertices = meshData.Vertices;
+	stored->Mesh.Indices32 = meshData.Indices32;
+	stored->Error = error;
+
+	MeshView view = MeshDataView(stored->Mesh, error);
+	mStored.push_back(std::move(stored));
+	return view;
+}
+
+bool MeshCache::Save()
+{
+	if (mStored.empty())
+		return true;
+
+	//
+	// Lay out the meshes already in the file followed by the new ones.
+	//
+
+	struct Source
+	{
+		Key MeshKey;
+		MeshView View;
+	};
+
+	std::vector<Source> sources;
+	for (uint32 i = 0; i < mEntryCount; ++i)
+		sources.push_back({ { mEntries[i].Name, mEntries[i].Parameters }, EntryView(mEntries[i]) });
+	for (const auto& stored : mStored)
+		sources.push_back({ stored->MeshKey, MeshDataView(stored->Mesh, stored->Error) });
+
+	std::vector<Entry> entries(sources.size());
+	uint64 offset = AlignUp(sizeof(FileHeader) + sizeof(Entry) * entries.size());
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		entries[i].Name = sources[i].MeshKey.Name;
+		entries[i].Parameters = sources[i].MeshKey.Parameters;
+		entries[i].VertexCount = sources[i].View.VertexCount;
+		entries[i].IndexCount = sources[i].View.IndexCount;
+		entries[i].Error = sources[i].View.Error;
+		entries[i].Padding = 0;
+
+		entries[i].VertexOffset = offset;
+		offset = AlignUp(offset + sizeof(GeometryGenerator::Vertex) * uint64(entries[i].VertexCount));
+		entries[i].IndexOffset = offset;
+		offset = AlignUp(offset + sizeof(uint32) * uint64(entries[i].IndexCount));
+	}
+
+	std::vector<std::uint8_t> file(static_cast<size_t>(offset), 0);
+
+	FileHeader header;
+	memcpy(header.Magic, FileMagic, sizeof(FileMagic));
+	header.Version = Version;
+	header.EntryCount = static_cast<uint32>(entries.size());
+	header.VertexSize = sizeof(GeometryGenerator::Vertex);
+	memcpy(file.data(), &header, sizeof(header));
+	if (!entries.empty())
+		memcpy(file.data() + sizeof(header), entries.data(), sizeof(Entry) * entries.size());
+
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		const MeshView& view = sources[i].View;
+		if (view.VertexCount > 0)
+			memcpy(file.data() + entries[i].VertexOffset, view.Vertices, sizeof(GeometryGenerator::Vertex) * view.VertexCount);
+		if (view.IndexCount > 0)
+			memcpy(file.data() + entries[i].IndexOffset, view.Indices, sizeof(uint32) * view.IndexCount);
+	}
+
+	//
+	// Write it next to the old file and swap it in, so a failed write leaves the
+	// old file alone.
+	//
+
+	std::wstring tempName = mFileName + L".tmp";
+	if (!WriteWholeFile(tempName, file))
+		return false;
+
+	// Windows cannot replace a file that is mapped.  The meshes stay in mStored
+	// until the new file is in place, so a failed rename loses nothing.
+	Unmap();
+	bool replaced = ReplaceWholeFile(tempName, mFileName);
+	Map();
+
+	if (replaced)
+		mStored.clear();
+	return replaced;
+}
+
+void MeshCache::Map()
+{
+#if defined(_WIN32)
+	HANDLE file = CreateFileW(mFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+	mFile = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || uint64(size.QuadPart) < sizeof(FileHeader))
+	{
+		Unmap();
+		return;
+	}
+
+	mMapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mMapping == nullptr)
+	{
+		Unmap();
+		return;
+	}
+
+	mData = static_cast<const std::uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+	mDataSize = uint64(size.QuadPart);
+	if (mData == nullptr)
+	{
+		Unmap();
+		return;
+	}
+#else
+	// The mapping keeps the file open by itself.
+	int file = open(NarrowFileName(mFileName).c_str(), O_RDONLY);
+	if (file < 0)
+		return;
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || uint64(info.st_size) < sizeof(FileHeader))
+	{
+		close(file);
+		return;
+	}
+
+	void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (data == MAP_FAILED)
+		return;
+
+	mData = static_cast<const std::uint8_t*>(data);
+	mDataSize = uint64(info.st_size);
+#endif
+
+	//
+	// Anything that does not look like a whole file of this version is treated as
+	// no file; it is overwritten by the next Save.
+	//
+
+	FileHeader header;
+	memcpy(&header, mData, sizeof(header));
+	if (memcmp(header.Magic, FileMagic, sizeof(FileMagic)) != 0 || header.Version != Version ||
+		header.VertexSize != sizeof(GeometryGenerator::Vertex) ||
+		sizeof(FileHeader) + sizeof(Entry) * uint64(header.EntryCount) > mDataSize)
+	{
+		Unmap();
+		return;
+	}
+
+	const Entry* entries = reinterpret_cast<const Entry*>(mData + sizeof(FileHeader));
+	for (uint32 i = 0; i < header.EntryCount; ++i)
+	{
+		const Entry& entry = entries[i];
+		uint64 vertexBytes = sizeof(GeometryGenerator::Vertex) * uint64(entry.VertexCount);
+		uint64 indexBytes = sizeof(uint32) * uint64(entry.IndexCount);
+		if (entry.VertexOffset % DataAlignment != 0 || entry.IndexOffset % DataAlignment != 0 ||
+			entry.VertexOffset > mDataSize || vertexBytes > mDataSize - entry.VertexOffset ||
+			entry.IndexOffset > mDataSize || indexBytes > mDataSize - entry.IndexOffset)
+		{
+			Unmap();
+			return;
+		}
+	}
+
+	mEntries = entries;
+	mEntryCount = header.EntryCount;
+}
+
+void MeshCache::Unmap()
+{
+#if defined(_WIN32)
+	if (mData != nullptr)
+		UnmapViewOfFile(mData);
+	if (mMapping != nullptr)
+		CloseHandle(mMapping);
+	if (mFile != nullptr)
+		CloseHandle(mFile);
+#else
+	if (mData != nullptr)
+		munmap(const_cast<std::uint8_t*>(mData), static_cast<size_t>(mDataSize));
+#endif
+
+	mData = nullptr;
+	mDataSize = 0;
+	mMapping = nullptr;
+	mFile = nullptr;
+	mEntries = nullptr;
+	mEntryCount = 0;
+}
+
+MeshCache::MeshView MeshCache::EntryView(const Entry& entry) const
+{
+	MeshView view;
+	view.Vertices = reinterpret_cast<const GeometryGenerator::Vertex*>(mData + entry.VertexOffset);
+	view.VertexCount = entry.VertexCount;
+	view.Indices = reinterpret_cast<const uint32*>(mData + entry.IndexOffset);
+	view.IndexCount = entry.IndexCount;
+	view.Error = entry.Error;
+	return view;
+}
@@ -0,0 +1,142 @@
+//***************************************************************************************
+// MeshCache.h
+//
+// Keeps generated meshes in a binary file between runs.  Each mesh is stored under the
+// name of the generator that made it and a hash of the parameters it was called with,
+// along with the simplification error of meshes that are LOD levels.
+// The file is memory-mapped on load, so a cached mesh is read straight out of the
+// mapping: its vertex and index pointers can go to the upload path as they are.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+class MeshCache
+{
+public:
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	// Bump when the file layout or the output of any generator changes (or of the
+	// welder, simplifier or optimizer, for meshes stored after them), so that files
+	// written before are ignored.
+	static const uint32 Version = 3;
+
+	struct Key
+	{
+		uint64 Name = 0;
+		uint64 Parameters = 0;
+	};
+
+	// A mesh in the mapped file (or, until Save, in memory).  Valid until the next
+	// Save or until the cache is destroyed.
+	struct MeshView
+	{
+		const GeometryGenerator::Vertex* Vertices = nullptr;
+		uint32 VertexCount = 0;
+		const uint32* Indices = nullptr;
+		uint32 IndexCount = 0;
+
+		// What Store was given, e.g. MeshSimplifier::Lod::Error; 0 otherwise.
+		float Error = 0.0f;
+
+		// A copy to modify.
+		GeometryGenerator::MeshData ToMeshData() const;
+	};
+
+	explicit MeshCache(const std::wstring& fileName);
+	~MeshCache();
+
+	MeshCache(const MeshCache& rhs) = delete;
+	MeshCache& operator=(const MeshCache& rhs) = delete;
+
+	// FNV-1a.
+	static uint64 Hash(const void* data, size_t byteSize, uint64 hash = 14695981039346656037ull);
+
+	template <typename... Params>
+	static Key MakeKey(const char* generator, const Params&... params)
+	{
+		Key key;
+		key.Name = Hash(generator, strlen(generator));
+		key.Parameters = Hash(nullptr, 0);
+
+		int expand[] = { 0, (key.Parameters = Hash(&params, sizeof(params), key.Parameters), 0)... };
+		(void)expand;
+		return key;
+	}
+
+	///<summary>
+	/// Looks the mesh up in the file and then in the meshes stored since it was
+	/// loaded.
+	///</summary>
+	bool Find(const Key& key, MeshView& view) const;
+
+	///<summary>
+	/// Keeps a copy of the mesh, and the error of an LOD level, to be written by
+	/// Save.
+	///</summary>
+	MeshView Store(const Key& key, const GeometryGenerator::MeshData& meshData, float error = 0.0f);
+
+	///<summary>
+	/// Returns the cached mesh that (gen.*create)(args...) made, calling it and
+	/// storing the result if it is not cached, e.g.
+	///   cache.Generate("CreateTorus", geoGen, &GeometryGenerator::CreateTorus, 1.5f, 0.3f, 8, 6);
+	/// The arguments are converted to the parameter types before being hashed.
+	///</summary>
+	template <typename... Params, typename... Args>
+	MeshView Generate(const char* generator, GeometryGenerator& gen,
+		GeometryGenerator::MeshData (GeometryGenerator::*create)(Params...), Args... args)
+	{
+		Key key = MakeKey(generator, Params(args)...);
+
+		MeshView view;
+		if (Find(key, view))
+			return view;
+
+		return Store(key, (gen.*create)(Params(args)...));
+	}
+
+	///<summary>
+	/// Rewrites the file with the meshes it held and the ones stored since, if any
+	/// were.  Returns false if the file could not be written; the stored meshes are
+	/// then kept, so a later Save can try again.
+	///</summary>
+	bool Save();
+
+	uint32 HitCount() const { return mHitCount; }
+	uint32 MissCount() const { return static_cast<uint32>(mStored.size()); }
+
+private:
+	struct Entry;
+	struct StoredMesh
+	{
+		Key MeshKey;
+		GeometryGenerator::MeshData Mesh;
+		float Error = 0.0f;
+	};
+
+	void Map();
+	void Unmap();
+	MeshView EntryView(const Entry& entry) const;
+
+	std::wstring mFileName;
+
+	// Win32 file and mapping handles (unused elsewhere, where the mapping keeps the
+	// file open), and the mapped view.
+	void* mFile = nullptr;
+	void* mMapping = nullptr;
+	const std::uint8_t* mData = nullptr;
+	uint64 mDataSize = 0;
+
+	const Entry* mEntries = nullptr;
+	uint32 mEntryCount = 0;
+
+	std::vector<std::unique_ptr<StoredMesh>> mStored;
+	mutable uint32 mHitCount = 0;
+};
@@ -0,0 +1,611 @@
+//***************************************************************************************
+// MeshCodec.cpp
+//***************************************************************************************
+
+#include "MeshCodec.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(_XM_SSE_INTRINSICS_)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const std::uint8_t IndexCodecVersion = 1;
+	const std::uint8_t VertexCodecVersion = 1;
+
+	//
+	// Index codec.  Every triangle has one code byte; vertices that cannot be named
+	// in it go to a second stream of varints after the code bytes.
+	//
+	//   0xF0         no edge match: three vertex values follow, each 0 for the next
+	//                new vertex, 1-15 for vertex FIFO entry 0-14, or 16 + the
+	//                zigzagged difference from the last vertex.
+	//   (e << 4) | v  the triangle continues FIFO edge e (0-14) and its third vertex
+	//                is the next new vertex (v = 0), vertex FIFO entry v - 1
+	//                (v = 1-14), or given by zigzagged difference (v = 15).
+	//
+
+	const int FifoSize = 16;
+	const std::uint8_t NoEdgeCode = 0xF0;
+
+	struct IndexCoder
+	{
+		std::uint32_t EdgeA[FifoSize];
+		std::uint32_t EdgeB[FifoSize];
+		std::uint32_t Vertex[FifoSize];
+		int EdgeCount = 0;
+		int VertexCount = 0;
+
+		std::uint32_t Next = 0;
+		std::uint32_t Last = 0;
+
+		// Entry i counts back from the most recent one.
+		int FindEdge(std::uint32_t a, std::uint32_t b) const
+		{
+			for (int i = 0; i < std::min(EdgeCount, FifoSize - 1); ++i)
+			{
+				int slot = (EdgeCount - 1 - i) & (FifoSize - 1);
+				if (EdgeA[slot] == a && EdgeB[slot] == b)
+					return i;
+			}
+			return -1;
+		}
+
+		int FindVertex(std::uint32_t v, int limit) const
+		{
+			for (int i = 0; i < std::min(VertexCount, limit); ++i)
+			{
+				if (Vertex[(VertexCount - 1 - i) & (FifoSize - 1)] == v)
+					return i;
+			}
+			return -1;
+		}
+
+		std::uint32_t EdgeFirst(int i) const { return EdgeA[(EdgeCount - 1 - i) & (FifoSize - 1)]; }
+		std::uint32_t EdgeSecond(int i) const { return EdgeB[(EdgeCount - 1 - i) & (FifoSize - 1)]; }
+		std::uint32_t VertexAt(int i) const { return Vertex[(VertexCount - 1 - i) & (FifoSize - 1)]; }
+
+		void PushEdge(std::uint32_t a, std::uint32_t b)
+		{
+			EdgeA[EdgeCount & (FifoSize - 1)] = a;
+			EdgeB[EdgeCount & (FifoSize - 1)] = b;
+			++EdgeCount;
+		}
+
+		void PushVertex(std::uint32_t v)
+		{
+			Vertex[VertexCount & (FifoSize - 1)] = v;
+			++VertexCount;
+		}
+	};
+
+	std::uint32_t ZigZag(std::uint32_t from, std::uint32_t to)
+	{
+		std::int32_t d = static_cast<std::int32_t>(to - from);
+		return (static_cast<std::uint32_t>(d) << 1) ^ static_cast<std::uint32_t>(d >> 31);
+	}
+
+	std::uint32_t UnZigZag(std::uint32_t from, std::uint32_t z)
+	{
+		return from + ((z >> 1) ^ (0u - (z & 1)));
+	}
+
+	void WriteVarint(std::vector<std::uint8_t>& out, std::uint32_t v)
+	{
+		while (v >= 0x80)
+		{
+			out.push_back(static_cast<std::uint8_t>(v | 0x80));
+			v >>= 7;
+		}
+		out.push_back(static_cast<std::uint8_t>(v));
+	}
+
+	bool ReadVarint(const std::uint8_t*& p, const std::uint8_t* end, std::uint32_t& v)
+	{
+		v = 0;
+		for (int shift = 0; shift < 35; shift += 7)
+		{
+			if (p == end)
+				return false;
+
+			std::uint8_t byte = *p++;
+			v |= std::uint32_t(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	//
+	// Vertex codec.  Vertices go in blocks; each byte column of a block is stored
+	// as groups of 16 zigzagged byte deltas, with a 2-bit mode per group (packed four
+	// to a byte ahead of the groups) giving how many bits each delta takes.
+	//
+
+	const size_t BlockVertices = 256;
+	const size_t GroupSize = 16;
+	const size_t MaxVertexSize = 256;
+
+	const size_t ModeBytes[4] = { 0, 4, 8, 16 };
+
+	// The fewest bytes vertexCount vertices encode to: the version byte and the
+	// mode bytes of every column of every block, with all groups in mode 0.
+	size_t MinVertexBytes(size_t vertexCount, size_t vertexSize)
+	{
+		size_t fullBlocks = vertexCount / BlockVertices;
+		size_t lastGroups = (vertexCount % BlockVertices + GroupSize - 1) / GroupSize;
+		return 1 + vertexSize * (fullBlocks * (BlockVertices / GroupSize / 4) + (lastGroups + 3) / 4);
+	}
+
+	std::uint8_t ZigZag8(std::uint8_t d)
+	{
+		return static_cast<std::uint8_t>((d << 1) ^ static_cast<std::uint8_t>(static_cast<std::int8_t>(d) >> 7));
+	}
+
+	// Turns 16 packed deltas into values following carry; returns false if data
+	// runs out.
+	bool DecodeGroup(int mode, const std::uint8_t*& p, const std::uint8_t* end, std::uint8_t& carry, std::uint8_t out[GroupSize])
+	{
+		if (size_t(end - p) < ModeBytes[mode])
+			return false;
+
+#if defined(_XM_SSE_INTRINSICS_)
+		__m128i z;
+		switch (mode)
+		{
+		case 0:
+			memset(out, carry, GroupSize);
+			return true;
+
+		case 1:
+		{
+			// Four 2-bit values per byte, highest bits first.
+			std::int32_t packed;
+			memcpy(&packed, p, sizeof(packed));
+			__m128i v = _mm_cvtsi32_si128(packed);
+			__m128i mask = _mm_set1_epi8(3);
+			__m128i a = _mm_and_si128(_mm_srli_epi16(v, 6), mask);
+			__m128i b = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+			__m128i c = _mm_and_si128(_mm_srli_epi16(v, 2), mask);
+			__m128i d = _mm_and_si128(v, mask);
+			z = _mm_unpacklo_epi16(_mm_unpacklo_epi8(a, b), _mm_unpacklo_epi8(c, d));
+			break;
+		}
+
+		case 2:
+		{
+			// Two 4-bit values per byte, high nibble first.
+			__m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+			__m128i mask = _mm_set1_epi8(15);
+			z = _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(v, 4), mask), _mm_and_si128(v, mask));
+			break;
+		}
+
+		default:
+			z = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			break;
+		}
+		p += ModeBytes[mode];
+
+		// Undo the zigzag, then a running sum over the 16 lanes from the carry.
+		__m128i one = _mm_set1_epi8(1);
+		__m128i d = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(z, 1), _mm_set1_epi8(0x7f)),
+			_mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(z, one)));
+		d = _mm_add_epi8(d, _mm_slli_si128(d, 1));
+		d = _mm_add_epi8(d, _mm_slli_si128(d, 2));
+		d = _mm_add_epi8(d, _mm_slli_si128(d, 4));
+		d = _mm_add_epi8(d, _mm_slli_si128(d, 8));
+		d = _mm_add_epi8(d, _mm_set1_epi8(static_cast<char>(carry)));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), d);
+		carry = out[GroupSize - 1];
+		return true;
+#else
+		std::uint8_t z[GroupSize];
+		switch (mode)
+		{
+		case 0:
+			memset(out, carry, GroupSize);
+			return true;
+
+		case 1:
+			for (size_t i = 0; i < GroupSize; ++i)
+				z[i] = (p[i / 4] >> (6 - 2 * (i % 4))) & 3;
+			break;
+
+		case 2:
+			for (size_t i = 0; i < GroupSize; ++i)
+				z[i] = (p[i / 2] >> (4 - 4 * (i % 2))) & 15;
+			break;
+
+		default:
+			memcpy(z, p, GroupSize);
+			break;
+		}
+		p += ModeBytes[mode];
+
+		for (size_t i = 0; i < GroupSize; ++i)
+		{
+			carry = static_cast<std::uint8_t>(carry + ((z[i] >> 1) ^ (0u - (z[i] & 1))));
+			out[i] = carry;
+		}
+		return true;
+#endif
+	}
+}
+
+std::vector<std::uint8_t> MeshCodec::EncodeIndices(const uint32* indices, size_t indexCount)
+{
+	size_t triangleCount = indexCount / 3;
+
+	std::vector<std::uint8_t> codes;
+	std::vector<std::uint8_t> extra;
+	codes.reserve(triangleCount + 1);
+	codes.push_back(IndexCodecVersion);
+
+	IndexCoder coder;
+
+	// Vertex value of a missed triangle; pushed as it is coded so the next one can
+	// refer to it.
+	auto codeVertex = [&](uint32 v)
+	{
+		if (v == coder.Next)
+		{
+			WriteVarint(extra, 0);
+			++coder.Next;
+		}
+		else
+		{
+			int fifo = coder.FindVertex(v, FifoSize - 1);
+			if (fifo >= 0)
+			{
+				WriteVarint(extra, fifo + 1);
+				return;
+			}
+			WriteVarint(extra, 16 + ZigZag(coder.Last, v));
+		}
+		coder.Last = v;
+		coder.PushVertex(v);
+	};
+
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		const uint32* tri = indices + t * 3;
+
+		// A corner whose leading edge an earlier triangle had the other way round.
+		int edge = -1;
+		int rotation = 0;
+		for (int r = 0; r < 3 && edge < 0; ++r)
+		{
+			edge = coder.FindEdge(tri[(r + 1) % 3], tri[r]);
+			rotation = r;
+		}
+
+		if (edge < 0)
+		{
+			codes.push_back(NoEdgeCode);
+			for (int k = 0; k < 3; ++k)
+				codeVertex(tri[k]);
+
+			coder.PushEdge(tri[0], tri[1]);
+			coder.PushEdge(tri[1], tri[2]);
+			coder.PushEdge(tri[2], tri[0]);
+			continue;
+		}
+
+		uint32 a = tri[rotation];
+		uint32 b = tri[(rotation + 1) % 3];
+		uint32 c = tri[(rotation + 2) % 3];
+
+		int vertexCode;
+		if (c == coder.Next)
+		{
+			vertexCode = 0;
+			++coder.Next;
+		}
+		else
+		{
+			int fifo = coder.FindVertex(c, 14);
+			vertexCode = fifo >= 0 ? fifo + 1 : 15;
+			if (vertexCode == 15)
+				WriteVarint(extra, ZigZag(coder.Last, c));
+		}
+
+		if (vertexCode == 0 || vertexCode == 15)
+		{
+			coder.Last = c;
+			coder.PushVertex(c);
+		}
+
+		codes.push_back(static_cast<std::uint8_t>((edge << 4) | vertexCode));
+		coder.PushEdge(b, c);
+		coder.PushEdge(c, a);
+	}
+
+	codes.insert(codes.end(), extra.begin(), extra.end());
+	return codes;
+}
+
+bool MeshCodec::DecodeIndices(uint32* indices, size_t indexCount, const std::uint8_t* data, size_t byteSize)
+{
+	size_t triangleCount = indexCount / 3;
+	if (byteSize < 1 + triangleCount || data[0] != IndexCodecVersion || indexCount % 3 != 0)
+		return false;
+
+	const std::uint8_t* codes = data + 1;
+	const std::uint8_t* extra = codes + triangleCount;
+	const std::uint8_t* end = data + byteSize;
+
+	IndexCoder coder;
+
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		uint32* tri = indices + t * 3;
+		std::uint8_t code = codes[t];
+
+		if (code == NoEdgeCode)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				uint32 value;
+				if (!ReadVarint(extra, end, value))
+					return false;
+
+				if (value >= 1 && value < 16)
+				{
+					if (int(value) > std::min(coder.VertexCount, FifoSize - 1))
+						return false;
+					tri[k] = coder.VertexAt(value - 1);
+					continue;
+				}
+
+				tri[k] = value == 0 ? coder.Next++ : UnZigZag(coder.Last, value - 16);
+				coder.Last = tri[k];
+				coder.PushVertex(tri[k]);
+			}
+
+			coder.PushEdge(tri[0], tri[1]);
+			coder.PushEdge(tri[1], tri[2]);
+			coder.PushEdge(tri[2], tri[0]);
+			continue;
+		}
+
+		int edge = code >> 4;
+		int vertexCode = code & 15;
+		if (edge >= std::min(coder.EdgeCount, FifoSize - 1) || edge == 15)
+			return false;
+
+		uint32 a = coder.EdgeSecond(edge);
+		uint32 b = coder.EdgeFirst(edge);
+		uint32 c;
+
+		if (vertexCode == 0)
+		{
+			c = coder.Next++;
+		}
+		else if (vertexCode < 15)
+		{
+			if (vertexCode > std::min(coder.VertexCount, 14))
+				return false;
+			c = coder.VertexAt(vertexCode - 1);
+		}
+		else
+		{
+			uint32 value;
+			if (!ReadVarint(extra, end, value))
+				return false;
+			c = UnZigZag(coder.Last, value);
+		}
+
+		if (vertexCode == 0 || vertexCode == 15)
+		{
+			coder.Last = c;
+			coder.PushVertex(c);
+		}
+
+		tri[0] = a;
+		tri[1] = b;
+		tri[2] = c;
+		coder.PushEdge(b, c);
+		coder.PushEdge(c, a);
+	}
+
+	return extra == end;
+}
+
+std::vector<std::uint8_t> MeshCodec::EncodeVertices(const void* vertices, size_t vertexCount, size_t vertexSize)
+{
+	std::vector<std::uint8_t> out;
+	out.push_back(VertexCodecVersion);
+	if (vertexSize == 0 || vertexSize > MaxVertexSize)
+		return out;
+
+	const std::uint8_t* src = static_cast<const std::uint8_t*>(vertices);
+	std::vector<std::uint8_t> last(vertexSize, 0);
+	std::uint8_t deltas[BlockVertices];
+
+	for (size_t blockStart = 0; blockStart < vertexCount; blockStart += BlockVertices)
+	{
+		size_t blockCount = std::min(BlockVertices, vertexCount - blockStart);
+		size_t groupCount = (blockCount + GroupSize - 1) / GroupSize;
+
+		for (size_t k = 0; k < vertexSize; ++k)
+		{
+			memset(deltas, 0, sizeof(deltas));
+			for (size_t i = 0; i < blockCount; ++i)
+			{
+				std::uint8_t byte = src[(blockStart + i) * vertexSize + k];
+				deltas[i] = ZigZag8(static_cast<std::uint8_t>(byte - last[k]));
+				last[k] = byte;
+			}
+
+			// Modes first, then the groups.
+			size_t modeStart = out.size();
+			out.resize(out.size() + (groupCount + 3) / 4, 0);
+
+			for (size_t g = 0; g < groupCount; ++g)
+			{
+				const std::uint8_t* group = deltas + g * GroupSize;
+				std::uint8_t largest = *std::max_element(group, group + GroupSize);
+				int mode = largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+				out[modeStart + g / 4] |= static_cast<std::uint8_t>(mode << (6 - 2 * (g % 4)));
+
+				switch (mode)
+				{
+				case 1:
+					for (size_t i = 0; i < GroupSize; i += 4)
+						out.push_back(static_cast<std::uint8_t>((group[i] << 6) | (group[i + 1] << 4) | (group[i + 2] << 2) | group[i + 3]));
+					break;
+
+				case 2:
+					for (size_t i = 0; i < GroupSize; i += 2)
+						out.push_back(static_cast<std::uint8_t>((group[i] << 4) | group[i + 1]));
+					break;
+
+				case 3:
+					out.insert(out.end(), group, group + GroupSize);
+					break;
+				}
+			}
+		}
+	}
+
+	return out;
+}
+
+bool MeshCodec::DecodeVertices(void* vertices, size_t vertexCount, size_t vertexSize, const std::uint8_t* data, size_t byteSize)
+{
+	if (byteSize < 1 || data[0] != VertexCodecVersion || vertexSize == 0 || vertexSize > MaxVertexSize)
+		return false;
+
+	const std::uint8_t* p = data + 1;
+	const std::uint8_t* end = data + byteSize;
+	std::uint8_t* dst = static_cast<std::uint8_t*>(vertices);
+
+	std::vector<std::uint8_t> last(vertexSize, 0);
+
+	// One block, a byte column at a time.
+	std::vector<std::uint8_t> columns(vertexSize * BlockVertices);
+
+	for (size_t blockStart = 0; blockStart < vertexCount; blockStart += BlockVertices)
+	{
+		size_t blockCount = std::min(BlockVertices, vertexCount - blockStart);
+		size_t groupCount = (blockCount + GroupSize - 1) / GroupSize;
+		size_t modeBytes = (groupCount + 3) / 4;
+
+		for (size_t k = 0; k < vertexSize; ++k)
+		{
+			if (size_t(end - p) < modeBytes)
+				return false;
+
+			const std::uint8_t* modes = p;
+			p += modeBytes;
+
+			std::uint8_t* column = &columns[k * BlockVertices];
+			for (size_t g = 0; g < groupCount; ++g)
+			{
+				int mode = (modes[g / 4] >> (6 - 2 * (g % 4))) & 3;
+				if (!DecodeGroup(mode, p, end, last[k], column + g * GroupSize))
+					return false;
+			}
+
+			// The padding of a partial last group must not move the carry.
+			last[k] = column[blockCount - 1];
+		}
+
+		for (size_t i = 0; i < blockCount; ++i)
+		{
+			std::uint8_t* vertex = dst + (blockStart + i) * vertexSize;
+			for (size_t k = 0; k < vertexSize; ++k)
+				vertex[k] = columns[k * BlockVertices + i];
+		}
+	}
+
+	return p == end;
+}
+
+std::vector<std::uint8_t> MeshCodec::Encode(const GeometryGenerator::MeshData& meshData)
+{
+	std::vector<std::uint8_t> vertices = EncodeVertices(meshData.Vertices.data(), meshData.Vertices.size(), sizeof(GeometryGenerator::Vertex));
+	std::vector<std::uint8_t> indices = EncodeIndices(meshData.Indices32.data(), meshData.Indices32.size());
+
+	// Vertex count, index count and vertex stream size, then the two streams.
+	std::vector<std::uint8_t> out;
+	WriteVarint(out, static_cast<uint32>(meshData.Vertices.size()));
+	WriteVarint(out, static_cast<uint32>(meshData.Indices32.size()));
+	WriteVarint(out, static_cast<uint32>(vertices.size()));
+	out.insert(out.end(), vertices.begin(), vertices.end());
+	out.insert(out.end(), indices.begin(), indices.end());
+	return out;
+}
+
+bool MeshCodec::Decode(const std::uint8_t* data, size_t byteSize, GeometryGenerator::MeshData& meshData)
+{
+	const std::uint8_t* p = data;
+	const std::uint8_t* end = data + byteSize;
+
+	uint32 vertexCount, indexCount, vertexBytes;
+	if (!ReadVarint(p, end, vertexCount) || !ReadVarint(p, end, indexCount) || !ReadVarint(p, end, vertexBytes) ||
+		vertexBytes > size_t(end - p))
+		return false;
+
+	// The counts come from the data, so check them against the bytes there are
+	// before allocating: every triangle takes a code byte, and every vertex block
+	// its mode bytes.
+	size_t indexBytes = size_t(end - p) - vertexBytes;
+	if (indexCount % 3 != 0 || indexCount / 3 + 1 > indexBytes ||
+		MinVertexBytes(vertexCount, sizeof(GeometryGenerator::Vertex)) > vertexBytes)
+		return false;
+
+	meshData.Vertices.resize(vertexCount);
+	meshData.Indices32.resize(indexCount);
+
+	if (!DecodeVertices(meshData.Vertices.data(), vertexCount, sizeof(GeometryGenerator::Vertex), p, vertexBytes) ||
+		!DecodeIndices(meshData.Indices32.data(), indexCount, p + vertexBytes, indexBytes))
+		return false;
+
+	// Damaged data can still decode; never hand out indices past the vertices.
+	for (uint32 index : meshData.Indices32)
+	{
+		if (index >= vertexCount)
+			return false;
+	}
+	return true;
+}
+
+MeshCodec::CodecReport MeshCodec::Measure(const GeometryGenerator::MeshData& meshData)
+{
+	CodecReport report;
+	report.IndexBytes = meshData.Indices32.size() * sizeof(uint32);
+	report.VertexBytes = meshData.Vertices.size() * sizeof(GeometryGenerator::Vertex);
+	report.EncodedIndexBytes = EncodeIndices(meshData.Indices32.data(), meshData.Indices32.size()).size();
+	report.EncodedVertexBytes = EncodeVertices(meshData.Vertices.data(), meshData.Vertices.size(), sizeof(GeometryGenerator::Vertex)).size();
+
+	std::vector<std::uint8_t> encoded = Encode(meshData);
+	GeometryGenerator::MeshData decoded;
+	if (!Decode(encoded.data(), encoded.size(), decoded) ||
+		decoded.Vertices.size() != meshData.Vertices.size() || decoded.Indices32.size() != meshData.Indices32.size())
+		return report;
+
+	if (!meshData.Vertices.empty() &&
+		memcmp(decoded.Vertices.data(), meshData.Vertices.data(), report.VertexBytes) != 0)
+		return report;
+
+	// Same triangles in the same order, allowing each to start at another corner.
+	for (size_t i = 0; i + 2 < meshData.Indices32.size(); i += 3)
+	{
+		const uint32* a = &meshData.Indices32[i];
+		const uint32* b = &decoded.Indices32[i];
+
+		bool same = false;
+		for (int r = 0; r < 3 && !same; ++r)
+			same = a[0] == b[r] && a[1] == b[(r + 1) % 3] && a[2] == b[(r + 2) % 3];
+		if (!same)
+			return report;
+	}
+
+	report.RoundTrips = true;
+	return report;
+}
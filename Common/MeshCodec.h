@@ -0,0 +1,61 @@
+//***************************************************************************************
+// MeshCodec.h
+//
+// Lossless compression of index and vertex buffers for storing meshes on disk, after
+// meshoptimizer's codecs (Kapoulkine).  Indices are coded a triangle at a time against
+// a FIFO of recently seen edges and vertices, which takes one or two bytes per
+// triangle for meshes in vertex cache order (see MeshOptimizer).  Vertices are coded a
+// byte column at a time as zigzagged deltas from the previous vertex, packed into 0, 2,
+// 4 or 8 bits per byte in groups of 16, which SSE2 decodes 16 bytes at a time.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <cstdint>
+#include <vector>
+
+class MeshCodec
+{
+public:
+	using uint32 = std::uint32_t;
+
+	// Sizes and round-trip check of an encoded mesh.
+	struct CodecReport
+	{
+		size_t IndexBytes = 0;
+		size_t EncodedIndexBytes = 0;
+		size_t VertexBytes = 0;
+		size_t EncodedVertexBytes = 0;
+		bool RoundTrips = false;
+
+		float IndexRatio() const { return EncodedIndexBytes > 0 ? float(IndexBytes) / EncodedIndexBytes : 0.0f; }
+		float VertexRatio() const { return EncodedVertexBytes > 0 ? float(VertexBytes) / EncodedVertexBytes : 0.0f; }
+	};
+
+	///<summary>
+	/// Encodes a triangle list.  Decoding gives back the same triangles in the
+	/// same order, but a triangle may start at a different corner (same winding).
+	///</summary>
+	static std::vector<std::uint8_t> EncodeIndices(const uint32* indices, size_t indexCount);
+	static bool DecodeIndices(uint32* indices, size_t indexCount, const std::uint8_t* data, size_t byteSize);
+
+	///<summary>
+	/// Encodes vertexCount vertices of vertexSize bytes each (at most 256), exactly.
+	///</summary>
+	static std::vector<std::uint8_t> EncodeVertices(const void* vertices, size_t vertexCount, size_t vertexSize);
+	static bool DecodeVertices(void* vertices, size_t vertexCount, size_t vertexSize, const std::uint8_t* data, size_t byteSize);
+
+	///<summary>
+	/// The vertices and indices of the mesh, with their counts, in one buffer.  Decode
+	/// fails on data that is cut short or gives indices past the vertices.
+	///</summary>
+	static std::vector<std::uint8_t> Encode(const GeometryGenerator::MeshData& meshData);
+	static bool Decode(const std::uint8_t* data, size_t byteSize, GeometryGenerator::MeshData& meshData);
+
+	///<summary>
+	/// Encodes and decodes the mesh and reports how much smaller it got and whether
+	/// it came back the same.
+	///</summary>
+	static CodecReport Measure(const GeometryGenerator::MeshData& meshData);
+};
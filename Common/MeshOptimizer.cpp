@@ -0,0 +1,388 @@
+//***************************************************************************************
+// MeshOptimizer.cpp
+//***************************************************************************************
+
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	// Tuning of Forsyth's vertex scores: the size of the modelled LRU cache, how
+	// fast the score of a cached vertex decays with its position, the fixed score
+	// of the last triangle's vertices (slightly lower, so a strip does not simply
+	// turn back), and how strongly vertices with few triangles left are preferred.
+	const int ForsythCacheSize = 32;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+
+	// Soft overdraw clusters are never split below this many triangles.
+	const uint32 MinClusterSize = 8;
+
+	float VertexScore(int cachePosition, uint32 remainingValence)
+	{
+		// No triangles left to draw with it.
+		if(remainingValence == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if(cachePosition >= 0)
+		{
+			if(cachePosition < 3)
+				score = LastTriScore;
+			else
+				score = powf(1.0f - float(cachePosition - 3) / (ForsythCacheSize - 3), CacheDecayPower);
+		}
+
+		return score + ValenceBoostScale*powf(float(remainingValence), -ValenceBoostPower);
+	}
+
+	// FIFO cache simulation: a vertex is cached while fewer than cacheSize misses
+	// have happened since it was loaded.  Reset empties the cache.
+	class FifoCache
+	{
+	public:
+		FifoCache(size_t vertexCount, uint32 cacheSize)
+			: mLoadTime(vertexCount, 0), mCacheSize(cacheSize), mTime(cacheSize + 1)
+		{
+		}
+
+		// Returns true on a miss.
+		bool Access(uint32 v)
+		{
+			if(mTime - mLoadTime[v] <= mCacheSize)
+				return false;
+
+			mLoadTime[v] = mTime++;
+			return true;
+		}
+
+		void Reset()
+		{
+			mTime += mCacheSize + 1;
+		}
+
+	private:
+		std::vector<uint32> mLoadTime;
+		uint32 mCacheSize;
+		uint32 mTime;
+	};
+
+	uint32 TriangleMisses(FifoCache& cache, const uint32* tri)
+	{
+		return uint32(cache.Access(tri[0])) + uint32(cache.Access(tri[1])) + uint32(cache.Access(tri[2]));
+	}
+}
+
+void MeshOptimizer::OptimizeMesh(MeshData& meshData, uint32 cacheSize)
+{
+	// Small meshes can already be in a better order than the one Forsyth's
+	// algorithm finds for its LRU cache; keep theirs then.
+	std::vector<uint32> indices = meshData.Indices32;
+	OptimizeVertexCache(indices, meshData.Vertices.size());
+	if(AnalyzeVertexCache(indices, meshData.Vertices.size(), cacheSize).Transforms <
+		AnalyzeVertexCache(meshData.Indices32, meshData.Vertices.size(), cacheSize).Transforms)
+		meshData.Indices32.swap(indices);
+
+	OptimizeOverdraw(meshData.Indices32, meshData.Vertices, cacheSize);
+	OptimizeVertexFetch(meshData);
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32>& indices, size_t vertexCount)
+{
+	size_t triCount = indices.size() / 3;
+	if(triCount == 0)
+		return;
+
+	//
+	// Triangles still to draw of each vertex: vertex v's are
+	// adjacency[offset[v], offset[v] + valence[v]).
+	//
+
+	std::vector<uint32> valence(vertexCount, 0);
+	for(uint32 v : indices)
+		++valence[v];
+
+	std::vector<uint32> offset(vertexCount + 1, 0);
+	for(size_t v = 0; v < vertexCount; ++v)
+		offset[v + 1] = offset[v] + valence[v];
+
+	std::vector<uint32> adjacency(indices.size());
+	std::vector<uint32> fill(offset.begin(), offset.end() - 1);
+	for(size_t t = 0; t < triCount; ++t)
+	{
+		for(int k = 0; k < 3; ++k)
+			adjacency[fill[indices[t*3 + k]]++] = static_cast<uint32>(t);
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for(size_t v = 0; v < vertexCount; ++v)
+		score[v] = VertexScore(-1, valence[v]);
+
+	std::vector<bool> emitted(triCount, false);
+	std::vector<uint32> result;
+	result.reserve(indices.size());
+
+	// The LRU cache, most recent first; it briefly holds up to three extra
+	// vertices while a triangle is added.
+	uint32 cache[ForsythCacheSize + 3];
+	int cacheCount = 0;
+
+	size_t nextUnemitted = 0;
+	size_t bestTri = 0;
+
+	for(size_t n = 0; n < triCount; ++n)
+	{
+		const uint32* tri = &indices[bestTri*3];
+		emitted[bestTri] = true;
+		result.insert(result.end(), tri, tri + 3);
+
+		// Take the triangle off its vertices' lists.
+		for(int k = 0; k < 3; ++k)
+		{
+			uint32 v = tri[k];
+			uint32* first = &adjacency[offset[v]];
+			uint32* last = first + valence[v];
+			uint32* it = std::find(first, last, static_cast<uint32>(bestTri));
+			if(it != last)
+			{
+				*it = *(last - 1);
+				--valence[v];
+			}
+		}
+
+		// Move its vertices to the front of the cache.
+		uint32 newCache[ForsythCacheSize + 3];
+		int newCount = 0;
+		for(int k = 0; k < 3; ++k)
+		{
+			if(std::find(newCache, newCache + newCount, tri[k]) == newCache + newCount)
+				newCache[newCount++] = tri[k];
+		}
+		for(int c = 0; c < cacheCount; ++c)
+		{
+			if(cache[c] != tri[0] && cache[c] != tri[1] && cache[c] != tri[2])
+				newCache[newCount++] = cache[c];
+		}
+
+		// Whatever falls off the end is no longer cached.
+		for(int c = ForsythCacheSize; c < newCount; ++c)
+		{
+			cachePosition[newCache[c]] = -1;
+			score[newCache[c]] = VertexScore(-1, valence[newCache[c]]);
+		}
+
+		cacheCount = std::min(newCount, ForsythCacheSize);
+		for(int c = 0; c < cacheCount; ++c)
+		{
+			cache[c] = newCache[c];
+			cachePosition[cache[c]] = c;
+			score[cache[c]] = VertexScore(c, valence[cache[c]]);
+		}
+
+		// The next triangle is the best one using a cached vertex...
+		float bestScore = -1.0f;
+		bool found = false;
+		for(int c = 0; c < cacheCount; ++c)
+		{
+			uint32 v = cache[c];
+			for(uint32 a = offset[v]; a < offset[v] + valence[v]; ++a)
+			{
+				const uint32* candidate = &indices[adjacency[a]*3];
+				float triScore = score[candidate[0]] + score[candidate[1]] + score[candidate[2]];
+				if(triScore > bestScore)
+				{
+					bestScore = triScore;
+					bestTri = adjacency[a];
+					found = true;
+				}
+			}
+		}
+
+		// ... or, at a dead end, the next one not drawn yet.
+		if(!found)
+		{
+			while(nextUnemitted < triCount && emitted[nextUnemitted])
+				++nextUnemitted;
+			bestTri = nextUnemitted;
+		}
+	}
+
+	indices.swap(result);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<uint32>& indices, const std::vector<GeometryGenerator::Vertex>& vertices,
+	uint32 cacheSize, float threshold)
+{
+	uint32 triCount = static_cast<uint32>(indices.size() / 3);
+	if(triCount == 0)
+		return;
+
+	//
+	// Hard boundaries: the triangles where the cache order starts over anyway,
+	// i.e. all three vertices miss.
+	//
+
+	std::vector<uint32> hardStart;
+	{
+		FifoCache cache(vertices.size(), cacheSize);
+		for(uint32 t = 0; t < triCount; ++t)
+		{
+			if(TriangleMisses(cache, &indices[t*3]) == 3 || t == 0)
+				hardStart.push_back(t);
+		}
+		hardStart.push_back(triCount);
+	}
+
+	//
+	// Soft boundaries: split a hard cluster again as soon as the part so far is
+	// (nearly) as cache efficient as the whole, starting the cache cold.
+	//
+
+	std::vector<uint32> clusterStart;
+	{
+		FifoCache cache(vertices.size(), cacheSize);
+		for(size_t h = 0; h + 1 < hardStart.size(); ++h)
+		{
+			uint32 first = hardStart[h];
+			uint32 last = hardStart[h + 1];
+
+			cache.Reset();
+			uint32 misses = 0;
+			for(uint32 t = first; t < last; ++t)
+				misses += TriangleMisses(cache, &indices[t*3]);
+			float clusterAcmr = float(misses) / (last - first);
+
+			cache.Reset();
+			uint32 start = first;
+			uint32 runningMisses = 0;
+			clusterStart.push_back(first);
+			for(uint32 t = first; t < last; ++t)
+			{
+				runningMisses += TriangleMisses(cache, &indices[t*3]);
+
+				uint32 size = t + 1 - start;
+				if(t + 1 < last && size >= MinClusterSize &&
+					float(runningMisses) / size <= threshold*clusterAcmr)
+				{
+					start = t + 1;
+					runningMisses = 0;
+					clusterStart.push_back(start);
+					cache.Reset();
+				}
+			}
+
+			// The tail is whatever is left; if it is the expensive part, keep it
+			// with the cluster before it.
+			if(start != first && float(runningMisses) / (last - start) > threshold*clusterAcmr)
+				clusterStart.pop_back();
+		}
+		clusterStart.push_back(triCount);
+	}
+
+	size_t clusterCount = clusterStart.size() - 1;
+
+	//
+	// Sort the clusters by how much they face away from the centre of the mesh,
+	// so that outer surfaces are drawn first and occlude the rest.
+	//
+
+	XMVECTOR meshCentre = XMVectorZero();
+	for(const GeometryGenerator::Vertex& v : vertices)
+		meshCentre += XMLoadFloat3(&v.Position);
+	meshCentre /= float(std::max<size_t>(vertices.size(), 1));
+
+	std::vector<float> sortKey(clusterCount);
+	for(size_t c = 0; c < clusterCount; ++c)
+	{
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+
+		for(uint32 t = clusterStart[c]; t < clusterStart[c + 1]; ++t)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t*3 + 0]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t*3 + 1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t*3 + 2]].Position);
+
+			// Twice the area-weighted normal.  Triangles are clockwise seen from
+			// the front, so with left-handed coordinates the cross product points
+			// outwards.
+			XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+			float triArea = XMVectorGetX(XMVector3Length(n));
+
+			centroid += (p0 + p1 + p2)*(triArea / 3.0f);
+			normal += n;
+			area += triArea;
+		}
+
+		if(area > 0.0f)
+			centroid /= area;
+
+		sortKey[c] = XMVectorGetX(XMVector3Dot(centroid - meshCentre, XMVector3Normalize(normal)));
+	}
+
+	std::vector<uint32> order(clusterCount);
+	for(size_t c = 0; c < clusterCount; ++c)
+		order[c] = static_cast<uint32>(c);
+	std::stable_sort(order.begin(), order.end(),
+		[&sortKey](uint32 a, uint32 b) { return sortKey[a] > sortKey[b]; });
+
+	std::vector<uint32> result;
+	result.reserve(indices.size());
+	for(uint32 c : order)
+		result.insert(result.end(), &indices[0] + clusterStart[c]*3, &indices[0] + clusterStart[c + 1]*3);
+
+	// Clusters start cold, and on small meshes that alone can cost more than the
+	// threshold allows; keep the cache order then.
+	if(AnalyzeVertexCache(result, vertices.size(), cacheSize).Transforms >
+		threshold*AnalyzeVertexCache(indices, vertices.size(), cacheSize).Transforms)
+		return;
+
+	indices.swap(result);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(MeshData& meshData)
+{
+	const uint32 Unused = ~0u;
+	std::vector<uint32> remap(meshData.Vertices.size(), Unused);
+
+	std::vector<GeometryGenerator::Vertex> vertices;
+	vertices.reserve(meshData.Vertices.size());
+
+	for(uint32& index : meshData.Indices32)
+	{
+		if(remap[index] == Unused)
+		{
+			remap[index] = static_cast<uint32>(vertices.size());
+			vertices.push_back(meshData.Vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	meshData.Vertices.swap(vertices);
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32>& indices, size_t vertexCount,
+	uint32 cacheSize)
+{
+	CacheStats stats;
+
+	FifoCache cache(vertexCount, cacheSize);
+	for(uint32 v : indices)
+		stats.Transforms += cache.Access(v) ? 1 : 0;
+
+	if(!indices.empty())
+		stats.Acmr = float(stats.Transforms) / (indices.size() / 3);
+	if(vertexCount > 0)
+		stats.Atvr = float(stats.Transforms) / vertexCount;
+
+	return stats;
+}
@@ -0,0 +1,73 @@
+//***************************************************************************************
+// MeshOptimizer.h
+//
+// Reorders the triangles and vertices of a GeometryGenerator mesh for the GPU: first
+// for the post-transform vertex cache (Forsyth's linear-speed algorithm), then, within
+// the freedom that leaves, for less overdraw (clusters sorted outside-in, after Sander,
+// Nehab and Barczak's "Fast Triangle Reordering for Vertex Locality and Reduced
+// Overdraw"), and finally the vertices into the order the indices first use them, so
+// vertex fetch streams through memory.
+//
+// None of the stages changes what is drawn: the same triangles with the same winding,
+// only in a different order.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <cstdint>
+#include <vector>
+
+class MeshOptimizer
+{
+public:
+	using uint32 = std::uint32_t;
+	using MeshData = GeometryGenerator::MeshData;
+
+	// Post-transform cache efficiency of an index buffer, as simulated with a FIFO
+	// cache.  ACMR is the average number of vertices transformed per triangle (0.5
+	// at best for large regular meshes, 3 at worst); ATVR is the number transformed
+	// per vertex in the mesh (1 at best).
+	struct CacheStats
+	{
+		uint32 Transforms = 0;
+		float Acmr = 0.0f;
+		float Atvr = 0.0f;
+	};
+
+	///<summary>
+	/// Runs OptimizeVertexCache, OptimizeOverdraw and OptimizeVertexFetch on the mesh,
+	/// skipping OptimizeVertexCache if the triangles are already in a better order
+	/// for the cache.  Call it before GetIndices16, which caches its result.
+	///</summary>
+	static void OptimizeMesh(MeshData& meshData, uint32 cacheSize = DefaultCacheSize);
+
+	///<summary>
+	/// Reorders the triangles for the post-transform vertex cache.  The algorithm
+	/// models a 32 entry LRU cache, which also suits FIFO caches of similar size.
+	///</summary>
+	static void OptimizeVertexCache(std::vector<uint32>& indices, size_t vertexCount);
+
+	///<summary>
+	/// Splits cache-optimized triangles into clusters wherever that costs little cache
+	/// efficiency (ACMR at most threshold times that of the input) and draws the
+	/// clusters facing away from the mesh centre first.  If the clusters together
+	/// still cost more than threshold, the order is left as it is.
+	///</summary>
+	static void OptimizeOverdraw(std::vector<uint32>& indices, const std::vector<GeometryGenerator::Vertex>& vertices,
+		uint32 cacheSize = DefaultCacheSize, float threshold = 1.05f);
+
+	///<summary>
+	/// Renumbers the vertices in the order the indices first reference them.
+	/// Vertices no triangle uses are dropped.
+	///</summary>
+	static void OptimizeVertexFetch(MeshData& meshData);
+
+	///<summary>
+	/// Simulates a FIFO post-transform cache of cacheSize entries over the indices.
+	///</summary>
+	static CacheStats AnalyzeVertexCache(const std::vector<uint32>& indices, size_t vertexCount,
+		uint32 cacheSize = DefaultCacheSize);
+
+	static const uint32 DefaultCacheSize = 16;
+};
@@ -0,0 +1,304 @@
+//***************************************************************************************
+// MeshQuantizer.cpp
+//***************************************************************************************
+
+#include "MeshQuantizer.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	// Bytes of each encoded attribute.
+	int PositionSize(MeshQuantizer::PositionFormat format)
+	{
+		return format == MeshQuantizer::PositionFormat::Float3 ? 12 : 8;
+	}
+
+	const int OctahedralSize = 4;
+	const int TexCSize = 4;
+
+	// Angle between a decoded and a source direction, in degrees.  Meshes that
+	// leave a direction zero (nothing to encode) count as exact.
+	float AngleDegrees(const XMFLOAT3& decoded, const XMFLOAT3& source)
+	{
+		XMVECTOR s = XMLoadFloat3(&source);
+		if (XMVector3Equal(s, XMVectorZero()))
+			return 0.0f;
+
+		// atan2 of the sine and cosine stays accurate for the tiny angles that
+		// quantization gives, where acos of the cosine alone rounds to ~0.02 degrees.
+		XMVECTOR d = XMLoadFloat3(&decoded);
+		float sinAngle = XMVectorGetX(XMVector3Length(XMVector3Cross(d, s)));
+		float cosAngle = XMVectorGetX(XMVector3Dot(d, s));
+		return XMConvertToDegrees(atan2f(sinAngle, cosAngle));
+	}
+
+	// Scale that maps [-extent, extent] to [-1, 1]; flat axes get 1.
+	float SafeExtent(float extent)
+	{
+		return extent > 0.0f ? extent : 1.0f;
+	}
+}
+
+MeshQuantizer::EncodedMesh MeshQuantizer::Encode(const GeometryGenerator::MeshData& meshData, const Layout& layout)
+{
+	EncodedMesh mesh;
+	mesh.Format = layout;
+	mesh.VertexCount = static_cast<std::uint32_t>(meshData.Vertices.size());
+
+	mesh.PositionOffset = 0;
+	mesh.Stride = PositionSize(layout.Position);
+	if (layout.Normal)
+	{
+		mesh.NormalOffset = mesh.Stride;
+		mesh.Stride += OctahedralSize;
+	}
+	if (layout.Tangent)
+	{
+		mesh.TangentOffset = mesh.Stride;
+		mesh.Stride += OctahedralSize;
+	}
+	if (layout.TexC)
+	{
+		mesh.TexCOffset = mesh.Stride;
+		mesh.Stride += TexCSize;
+	}
+
+	mesh.Vertices.resize(size_t(mesh.Stride) * mesh.VertexCount);
+	if (mesh.VertexCount == 0)
+		return mesh;
+
+	//
+	// Bounds of the positions and texture coordinates.
+	//
+
+	XMVECTOR pMin = XMLoadFloat3(&meshData.Vertices[0].Position);
+	XMVECTOR pMax = pMin;
+	XMVECTOR tMin = XMLoadFloat2(&meshData.Vertices[0].TexC);
+	XMVECTOR tMax = tMin;
+	for (const GeometryGenerator::Vertex& v : meshData.Vertices)
+	{
+		XMVECTOR p = XMLoadFloat3(&v.Position);
+		XMVECTOR t = XMLoadFloat2(&v.TexC);
+		pMin = XMVectorMin(pMin, p);
+		pMax = XMVectorMax(pMax, p);
+		tMin = XMVectorMin(tMin, t);
+		tMax = XMVectorMax(tMax, t);
+	}
+
+	XMStoreFloat3(&mesh.Center, 0.5f * (pMin + pMax));
+	XMStoreFloat3(&mesh.Extent, 0.5f * (pMax - pMin));
+	mesh.Extent = XMFLOAT3(SafeExtent(mesh.Extent.x), SafeExtent(mesh.Extent.y), SafeExtent(mesh.Extent.z));
+
+	XMStoreFloat2(&mesh.TexCMin, tMin);
+	XMStoreFloat2(&mesh.TexCScale, tMax - tMin);
+	mesh.TexCScale = XMFLOAT2(SafeExtent(mesh.TexCScale.x), SafeExtent(mesh.TexCScale.y));
+
+	XMVECTOR center = XMLoadFloat3(&mesh.Center);
+	XMVECTOR invExtent = XMVectorReciprocal(XMLoadFloat3(&mesh.Extent));
+	XMVECTOR texCMin = XMLoadFloat2(&mesh.TexCMin);
+	XMVECTOR invTexCScale = XMVectorReciprocal(XMLoadFloat2(&mesh.TexCScale));
+
+	//
+	// Pack the vertices.
+	//
+
+	for (std::uint32_t i = 0; i < mesh.VertexCount; ++i)
+	{
+		const GeometryGenerator::Vertex& v = meshData.Vertices[i];
+		std::uint8_t* dst = &mesh.Vertices[size_t(i) * mesh.Stride];
+
+		XMVECTOR offset = XMVectorSetW(XMLoadFloat3(&v.Position) - center, 1.0f);
+		switch (layout.Position)
+		{
+		case PositionFormat::Float3:
+			memcpy(dst, &v.Position, sizeof(XMFLOAT3));
+			break;
+
+		case PositionFormat::Half4:
+		{
+			XMHALF4 p;
+			XMStoreHalf4(&p, offset);
+			memcpy(dst, &p, sizeof(p));
+			break;
+		}
+
+		case PositionFormat::SNorm16x4:
+		{
+			XMSHORTN4 p;
+			XMStoreShortN4(&p, XMVectorSetW(offset * invExtent, 1.0f));
+			memcpy(dst, &p, sizeof(p));
+			break;
+		}
+		}
+
+		if (layout.Normal)
+		{
+			std::int16_t n[2];
+			EncodeOctahedral(v.Normal, n);
+			memcpy(dst + mesh.NormalOffset, n, sizeof(n));
+		}
+
+		if (layout.Tangent)
+		{
+			std::int16_t t[2];
+			EncodeOctahedral(v.TangentU, t);
+			memcpy(dst + mesh.TangentOffset, t, sizeof(t));
+		}
+
+		if (layout.TexC)
+		{
+			XMUSHORTN2 t;
+			XMStoreUShortN2(&t, (XMLoadFloat2(&v.TexC) - texCMin) * invTexCScale);
+			memcpy(dst + mesh.TexCOffset, &t, sizeof(t));
+		}
+	}
+
+	return mesh;
+}
+
+MeshQuantizer::EncodedMesh MeshQuantizer::Encode(const GeometryGenerator::MeshData& meshData)
+{
+	return Encode(meshData, Layout());
+}
+
+GeometryGenerator::Vertex MeshQuantizer::DecodeVertex(const EncodedMesh& mesh, std::uint32_t i)
+{
+	const std::uint8_t* src = &mesh.Vertices[size_t(i) * mesh.Stride];
+
+	GeometryGenerator::Vertex v(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+
+	XMVECTOR center = XMLoadFloat3(&mesh.Center);
+	switch (mesh.Format.Position)
+	{
+	case PositionFormat::Float3:
+		memcpy(&v.Position, src, sizeof(XMFLOAT3));
+		break;
+
+	case PositionFormat::Half4:
+	{
+		XMHALF4 p;
+		memcpy(&p, src, sizeof(p));
+		XMStoreFloat3(&v.Position, center + XMLoadHalf4(&p));
+		break;
+	}
+
+	case PositionFormat::SNorm16x4:
+	{
+		XMSHORTN4 p;
+		memcpy(&p, src, sizeof(p));
+		XMStoreFloat3(&v.Position, center + XMLoadShortN4(&p) * XMLoadFloat3(&mesh.Extent));
+		break;
+	}
+	}
+
+	if (mesh.NormalOffset >= 0)
+	{
+		std::int16_t n[2];
+		memcpy(n, src + mesh.NormalOffset, sizeof(n));
+		v.Normal = DecodeOctahedral(n);
+	}
+
+	if (mesh.TangentOffset >= 0)
+	{
+		std::int16_t t[2];
+		memcpy(t, src + mesh.TangentOffset, sizeof(t));
+		v.TangentU = DecodeOctahedral(t);
+	}
+
+	if (mesh.TexCOffset >= 0)
+	{
+		XMUSHORTN2 t;
+		memcpy(&t, src + mesh.TexCOffset, sizeof(t));
+		XMStoreFloat2(&v.TexC, XMLoadFloat2(&mesh.TexCMin) + XMLoadUShortN2(&t) * XMLoadFloat2(&mesh.TexCScale));
+	}
+
+	return v;
+}
+
+std::vector<GeometryGenerator::Vertex> MeshQuantizer::Decode(const EncodedMesh& mesh)
+{
+	std::vector<GeometryGenerator::Vertex> vertices(mesh.VertexCount);
+	for (std::uint32_t i = 0; i < mesh.VertexCount; ++i)
+		vertices[i] = DecodeVertex(mesh, i);
+
+	return vertices;
+}
+
+MeshQuantizer::EncodeReport MeshQuantizer::Measure(const GeometryGenerator::MeshData& meshData, const EncodedMesh& mesh)
+{
+	EncodeReport report;
+	report.SourceBytes = meshData.Vertices.size() * sizeof(GeometryGenerator::Vertex);
+	report.EncodedBytes = mesh.Vertices.size();
+
+	for (std::uint32_t i = 0; i < mesh.VertexCount; ++i)
+	{
+		const GeometryGenerator::Vertex& source = meshData.Vertices[i];
+		GeometryGenerator::Vertex decoded = DecodeVertex(mesh, i);
+
+		XMVECTOR dp = XMVectorAbs(XMLoadFloat3(&decoded.Position) - XMLoadFloat3(&source.Position));
+		report.MaxPositionError = std::max(report.MaxPositionError, XMVectorGetX(XMVector3Length(dp)));
+
+		if (mesh.NormalOffset >= 0)
+			report.MaxNormalErrorDegrees = std::max(report.MaxNormalErrorDegrees, AngleDegrees(decoded.Normal, source.Normal));
+
+		if (mesh.TangentOffset >= 0)
+			report.MaxTangentErrorDegrees = std::max(report.MaxTangentErrorDegrees, AngleDegrees(decoded.TangentU, source.TangentU));
+
+		if (mesh.TexCOffset >= 0)
+		{
+			XMVECTOR dt = XMVectorAbs(XMLoadFloat2(&decoded.TexC) - XMLoadFloat2(&source.TexC));
+			report.MaxTexCError = std::max(report.MaxTexCError, std::max(XMVectorGetX(dt), XMVectorGetY(dt)));
+		}
+	}
+
+	return report;
+}
+
+void MeshQuantizer::EncodeOctahedral(const XMFLOAT3& n, std::int16_t out[2])
+{
+	// Project onto the octahedron |x| + |y| + |z| = 1 and keep x/z; the lower
+	// half (y < 0) is folded out over the diagonals of the upper one.
+	float sum = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	float u = sum > 0.0f ? n.x / sum : 0.0f;
+	float v = sum > 0.0f ? n.z / sum : 0.0f;
+
+	if (n.y < 0.0f)
+	{
+		float foldU = copysignf(1.0f - fabsf(v), u);
+		float foldV = copysignf(1.0f - fabsf(u), v);
+		u = foldU;
+		v = foldV;
+	}
+
+	XMSHORTN2 packed;
+	XMStoreShortN2(&packed, XMVectorSet(u, v, 0.0f, 0.0f));
+	out[0] = packed.x;
+	out[1] = packed.y;
+}
+
+XMFLOAT3 MeshQuantizer::DecodeOctahedral(const std::int16_t in[2])
+{
+	XMSHORTN2 packed;
+	packed.x = in[0];
+	packed.y = in[1];
+
+	XMFLOAT2 e;
+	XMStoreFloat2(&e, XMLoadShortN2(&packed));
+
+	XMFLOAT3 n(e.x, 1.0f - fabsf(e.x) - fabsf(e.y), e.y);
+	if (n.y < 0.0f)
+	{
+		n.x = copysignf(1.0f - fabsf(e.y), e.x);
+		n.z = copysignf(1.0f - fabsf(e.x), e.y);
+	}
+
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, XMVector3Normalize(XMLoadFloat3(&n)));
+	return result;
+}
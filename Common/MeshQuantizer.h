@@ -0,0 +1,105 @@
+//***************************************************************************************
+// MeshQuantizer.h
+//
+// Packs the 44-byte float vertices of a GeometryGenerator mesh into a compact,
+// interleaved vertex buffer: positions as half floats or snorm16s relative to the
+// mesh bounds, normals and tangents octahedral-encoded into two snorm16s, and texture
+// coordinates as unorm16s relative to their range.  Decode turns the buffer back into
+// GeometryGenerator vertices, which is what the vertex shader does on the GPU, so the
+// error of a layout can be checked on the CPU.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <cstdint>
+#include <vector>
+
+class MeshQuantizer
+{
+public:
+	enum class PositionFormat
+	{
+		// DXGI_FORMAT_R32G32B32_FLOAT, 12 bytes, stored as is.
+		Float3,
+
+		// DXGI_FORMAT_R16G16B16A16_FLOAT, 8 bytes: the offset from the centre of
+		// the bounds (w = 1).  Position = Center + p.
+		Half4,
+
+		// DXGI_FORMAT_R16G16B16A16_SNORM, 8 bytes: the offset from the centre of
+		// the bounds over their half extent (w = 1).  Position = Center + p*Extent.
+		SNorm16x4,
+	};
+
+	// Which attributes a compact vertex holds, in this order.  Normals and tangents
+	// are DXGI_FORMAT_R16G16_SNORM, texture coordinates DXGI_FORMAT_R16G16_UNORM
+	// with TexC = TexCMin + t*TexCScale.
+	struct Layout
+	{
+		PositionFormat Position = PositionFormat::SNorm16x4;
+		bool Normal = true;
+		bool Tangent = false;
+		bool TexC = true;
+	};
+
+	struct EncodedMesh
+	{
+		Layout Format;
+
+		// Bytes per vertex and the byte offset of each attribute (-1 if absent).
+		int Stride = 0;
+		int PositionOffset = -1;
+		int NormalOffset = -1;
+		int TangentOffset = -1;
+		int TexCOffset = -1;
+
+		// Dequantization constants; see PositionFormat and Layout.
+		DirectX::XMFLOAT3 Center = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 Extent = { 1.0f, 1.0f, 1.0f };
+		DirectX::XMFLOAT2 TexCMin = { 0.0f, 0.0f };
+		DirectX::XMFLOAT2 TexCScale = { 1.0f, 1.0f };
+
+		std::uint32_t VertexCount = 0;
+		std::vector<std::uint8_t> Vertices;
+	};
+
+	// Memory and worst-case error of an encoded mesh against its source.
+	struct EncodeReport
+	{
+		size_t SourceBytes = 0;
+		size_t EncodedBytes = 0;
+		float MaxPositionError = 0.0f;
+		float MaxNormalErrorDegrees = 0.0f;
+		float MaxTangentErrorDegrees = 0.0f;
+		float MaxTexCError = 0.0f;
+
+		float SavedFraction() const
+		{
+			return SourceBytes > 0 ? 1.0f - float(EncodedBytes) / SourceBytes : 0.0f;
+		}
+	};
+
+	///<summary>
+	/// Packs the vertices of the mesh into the given layout (the default Layout if
+	/// none is given).  The indices are not touched.
+	///</summary>
+	static EncodedMesh Encode(const GeometryGenerator::MeshData& meshData, const Layout& layout);
+	static EncodedMesh Encode(const GeometryGenerator::MeshData& meshData);
+
+	///<summary>
+	/// Unpacks vertex i.  Attributes the layout does not hold are zero.
+	///</summary>
+	static GeometryGenerator::Vertex DecodeVertex(const EncodedMesh& mesh, std::uint32_t i);
+
+	static std::vector<GeometryGenerator::Vertex> Decode(const EncodedMesh& mesh);
+
+	///<summary>
+	/// Compares the decoded mesh with the source it was encoded from.
+	///</summary>
+	static EncodeReport Measure(const GeometryGenerator::MeshData& meshData, const EncodedMesh& mesh);
+
+	// Unit vector <-> octahedral snorm16 pair, as used for normals and tangents.
+	static void EncodeOctahedral(const DirectX::XMFLOAT3& n, std::int16_t out[2]);
+	static DirectX::XMFLOAT3 DecodeOctahedral(const std::int16_t in[2]);
+};
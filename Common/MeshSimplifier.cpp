@@ -0,0 +1,644 @@
+//***************************************************************************************
+// MeshSimplifier.cpp
+//***************************************************************************************
+
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	// Border and seam edges also get a plane through them, perpendicular to their
+	// triangle, so that collapses keep the outline in place.  Its weight relative
+	// to the triangle planes.
+	const double BoundaryWeight = 10.0;
+
+	const uint32 NoVertex = ~0u;
+
+	// Sum of weighted squared distances to a set of planes, as the symmetric 4x4
+	// matrix of Garland and Heckbert (upper triangle only), plus the total weight
+	// of the triangle planes so the error can be turned back into a distance.
+	struct Quadric
+	{
+		double A00 = 0.0, A01 = 0.0, A02 = 0.0, A03 = 0.0;
+		double A11 = 0.0, A12 = 0.0, A13 = 0.0;
+		double A22 = 0.0, A23 = 0.0;
+		double A33 = 0.0;
+		double Weight = 0.0;
+
+		void AddPlane(double a, double b, double c, double d, double w, bool boundary = false)
+		{
+			A00 += w*a*a; A01 += w*a*b; A02 += w*a*c; A03 += w*a*d;
+			A11 += w*b*b; A12 += w*b*c; A13 += w*b*d;
+			A22 += w*c*c; A23 += w*c*d;
+			A33 += w*d*d;
+			if(!boundary)
+				Weight += w;
+		}
+
+		void Add(const Quadric& q)
+		{
+			A00 += q.A00; A01 += q.A01; A02 += q.A02; A03 += q.A03;
+			A11 += q.A11; A12 += q.A12; A13 += q.A13;
+			A22 += q.A22; A23 += q.A23;
+			A33 += q.A33;
+			Weight += q.Weight;
+		}
+
+		// Root mean square distance of p from the planes.
+		float Distance(const XMFLOAT3& p) const
+		{
+			if(Weight <= 0.0)
+				return 0.0f;
+
+			double x = p.x, y = p.y, z = p.z;
+			double e = A00*x*x + A11*y*y + A22*z*z + A33
+				+ 2.0*(A01*x*y + A02*x*z + A12*y*z + A03*x + A13*y + A23*z);
+
+			return static_cast<float>(sqrt(std::max(e, 0.0) / Weight));
+		}
+	};
+
+	struct Candidate
+	{
+		float Error;
+		uint32 From;
+		uint32 To;
+	};
+
+	// Half-edge collapse simplification of one mesh.  Vertices of the mesh are the
+	// "wedges"; wedges at the same position form a group, and collapses move whole
+	// groups.  Triangles keep referring to wedges, so the attributes stay exact.
+	class EdgeCollapser
+	{
+	public:
+		explicit EdgeCollapser(const GeometryGenerator::MeshData& meshData);
+
+		void Run(uint32 targetTriangleCount);
+
+		GeometryGenerator::MeshData Result() const;
+		float Error() const { return mError; }
+
+	private:
+		void WeldPositions();
+		void BuildQuadrics();
+
+		uint32 GroupOf(uint32 tri, int k) const { return mGroup[mCorners[tri*3 + k]]; }
+		bool HasGroup(uint32 tri, uint32 g) const;
+		const XMFLOAT3& Position(uint32 g) const { return mVertices[mWedges[g][0]].Position; }
+
+		// Live triangles with both groups, and of those how many use more than one
+		// wedge of u.
+		uint32 SharedTriangles(uint32 u, uint32 v, uint32* seamWedges = nullptr) const;
+		// Whether the triangles on either side of the edge use different wedges of
+		// u or of v.
+		bool OnSeam(uint32 u, uint32 v) const;
+		void Neighbours(uint32 g, std::vector<uint32>& out) const;
+
+		bool CanCollapse(uint32 u, uint32 v);
+		void Collapse(uint32 u, uint32 v);
+
+	private:
+		const std::vector<GeometryGenerator::Vertex>& mVertices;
+
+		std::vector<uint32> mCorners;
+		std::vector<bool> mTriAlive;
+		uint32 mTriCount = 0;
+
+		std::vector<uint32> mGroup;
+		std::vector<std::vector<uint32>> mWedges;
+		std::vector<std::vector<uint32>> mGroupTris;
+		std::vector<Quadric> mQuadrics;
+		std::vector<bool> mBorder;
+		std::vector<bool> mSeam;
+		std::vector<bool> mLocked;
+
+		// Wedge of the target group that each wedge of the collapsing group moves
+		// to; filled by CanCollapse.
+		std::vector<std::pair<uint32, uint32>> mWedgeMap;
+		std::vector<uint32> mScratchU;
+		std::vector<uint32> mScratchV;
+
+		float mError = 0.0f;
+	};
+
+	EdgeCollapser::EdgeCollapser(const GeometryGenerator::MeshData& meshData)
+		: mVertices(meshData.Vertices), mCorners(meshData.Indices32)
+	{
+		mCorners.resize(mCorners.size() / 3 * 3);
+		mTriAlive.assign(mCorners.size() / 3, true);
+		mTriCount = static_cast<uint32>(mTriAlive.size());
+
+		WeldPositions();
+
+		mGroupTris.resize(mWedges.size());
+		for(uint32 t = 0; t < mTriAlive.size(); ++t)
+		{
+			uint32 g0 = GroupOf(t, 0);
+			uint32 g1 = GroupOf(t, 1);
+			uint32 g2 = GroupOf(t, 2);
+
+			// Zero-area triangles by index never come back from a collapse either.
+			if(g0 == g1 || g1 == g2 || g0 == g2)
+			{
+				mTriAlive[t] = false;
+				--mTriCount;
+				continue;
+			}
+
+			mGroupTris[g0].push_back(t);
+			mGroupTris[g1].push_back(t);
+			mGroupTris[g2].push_back(t);
+		}
+
+		BuildQuadrics();
+	}
+
+	void EdgeCollapser::WeldPositions()
+	{
+		uint32 vertexCount = static_cast<uint32>(mVertices.size());
+
+		std::vector<uint32> order(vertexCount);
+		for(uint32 i = 0; i < vertexCount; ++i)
+			order[i] = i;
+
+		auto less = [this](uint32 a, uint32 b)
+		{
+			const XMFLOAT3& p = mVertices[a].Position;
+			const XMFLOAT3& q = mVertices[b].Position;
+			if(p.x != q.x) return p.x < q.x;
+			if(p.y != q.y) return p.y < q.y;
+			return p.z < q.z;
+		};
+		std::sort(order.begin(), order.end(), less);
+
+		mGroup.assign(vertexCount, NoVertex);
+		for(uint32 i = 0; i < vertexCount; ++i)
+		{
+			if(i == 0 || less(order[i - 1], order[i]))
+				mWedges.emplace_back();
+
+			mGroup[order[i]] = static_cast<uint32>(mWedges.size()) - 1;
+			mWedges.back().push_back(order[i]);
+		}
+	}
+
+	void EdgeCollapser::BuildQuadrics()
+	{
+		mQuadrics.assign(mWedges.size(), Quadric());
+		mBorder.assign(mWedges.size(), false);
+		mSeam.assign(mWedges.size(), false);
+
+		for(uint32 t = 0; t < mTriAlive.size(); ++t)
+		{
+			if(!mTriAlive[t])
+				continue;
+
+			XMVECTOR p[3];
+			for(int k = 0; k < 3; ++k)
+				p[k] = XMLoadFloat3(&Position(GroupOf(t, k)));
+
+			XMVECTOR n = XMVector3Cross(p[1] - p[0], p[2] - p[0]);
+			float twiceArea = XMVectorGetX(XMVector3Length(n));
+			if(twiceArea <= 0.0f)
+				continue;
+
+			n /= twiceArea;
+			XMFLOAT3 plane;
+			XMStoreFloat3(&plane, n);
+			double d = -XMVectorGetX(XMVector3Dot(n, p[0]));
+
+			for(int k = 0; k < 3; ++k)
+				mQuadrics[GroupOf(t, k)].AddPlane(plane.x, plane.y, plane.z, d, 0.5*twiceArea);
+
+			// Edges with only this triangle, or where the neighbour uses other
+			// wedges (a seam), are pinned by a perpendicular plane.
+			for(int k = 0; k < 3; ++k)
+			{
+				uint32 a = GroupOf(t, k);
+				uint32 b = GroupOf(t, (k + 1) % 3);
+
+				bool border = SharedTriangles(a, b) == 1;
+				bool seam = false;
+				if(!border)
+				{
+					for(uint32 other : mGroupTris[a])
+					{
+						if(other != t && mTriAlive[other] && HasGroup(other, b))
+						{
+							for(int j = 0; j < 3; ++j)
+							{
+								uint32 w = mCorners[other*3 + j];
+								if((mGroup[w] == a || mGroup[w] == b) &&
+									w != mCorners[t*3 + k] && w != mCorners[t*3 + (k + 1) % 3])
+									seam = true;
+							}
+						}
+					}
+				}
+
+				if(!border && !seam)
+					continue;
+
+				if(border)
+				{
+					mBorder[a] = true;
+					mBorder[b] = true;
+				}
+				else
+				{
+					mSeam[a] = true;
+					mSeam[b] = true;
+				}
+
+				XMVECTOR edge = p[(k + 1) % 3] - p[k];
+				XMVECTOR bn = XMVector3Normalize(XMVector3Cross(edge, n));
+				XMFLOAT3 boundary;
+				XMStoreFloat3(&boundary, bn);
+				double bd = -XMVectorGetX(XMVector3Dot(bn, p[k]));
+				double w = BoundaryWeight*XMVectorGetX(XMVector3LengthSq(edge));
+
+				mQuadrics[a].AddPlane(boundary.x, boundary.y, boundary.z, bd, w, true);
+				mQuadrics[b].AddPlane(boundary.x, boundary.y, boundary.z, bd, w, true);
+			}
+		}
+	}
+
+	bool EdgeCollapser::HasGroup(uint32 tri, uint32 g) const
+	{
+		return GroupOf(tri, 0) == g || GroupOf(tri, 1) == g || GroupOf(tri, 2) == g;
+	}
+
+	uint32 EdgeCollapser::SharedTriangles(uint32 u, uint32 v, uint32* seamWedges) const
+	{
+		uint32 shared = 0;
+		uint32 firstWedge = NoVertex;
+		bool distinctWedges = false;
+
+		for(uint32 t : mGroupTris[u])
+		{
+			if(!mTriAlive[t] || !HasGroup(t, v))
+				continue;
+
+			++shared;
+			for(int k = 0; k < 3; ++k)
+			{
+				uint32 w = mCorners[t*3 + k];
+				if(mGroup[w] != u)
+					continue;
+
+				if(firstWedge == NoVertex)
+					firstWedge = w;
+				else if(w != firstWedge)
+					distinctWedges = true;
+			}
+		}
+
+		if(seamWedges != nullptr)
+			*seamWedges = distinctWedges ? 2 : 1;
+
+		return shared;
+	}
+
+	bool EdgeCollapser::OnSeam(uint32 u, uint32 v) const
+	{
+		uint32 wedgeU = NoVertex;
+		uint32 wedgeV = NoVertex;
+
+		for(uint32 t : mGroupTris[u])
+		{
+			if(!mTriAlive[t] || !HasGroup(t, v))
+				continue;
+
+			for(int k = 0; k < 3; ++k)
+			{
+				uint32 w = mCorners[t*3 + k];
+				if(mGroup[w] != u && mGroup[w] != v)
+					continue;
+
+				uint32& first = mGroup[w] == u ? wedgeU : wedgeV;
+				if(first == NoVertex)
+					first = w;
+				else if(first != w)
+					return true;
+			}
+		}
+
+		return false;
+	}
+
+	void EdgeCollapser::Neighbours(uint32 g, std::vector<uint32>& out) const
+	{
+		out.clear();
+		for(uint32 t : mGroupTris[g])
+		{
+			if(!mTriAlive[t])
+				continue;
+
+			for(int k = 0; k < 3; ++k)
+			{
+				if(GroupOf(t, k) != g)
+					out.push_back(GroupOf(t, k));
+			}
+		}
+
+		std::sort(out.begin(), out.end());
+		out.erase(std::unique(out.begin(), out.end()), out.end());
+	}
+
+	bool EdgeCollapser::CanCollapse(uint32 u, uint32 v)
+	{
+		uint32 seamWedges = 0;
+		uint32 shared = SharedTriangles(u, v, &seamWedges);
+		if(shared == 0)
+			return false;
+
+		// Border vertices only slide along the border, and seam vertices along the
+		// seam.  A vertex with one wedge can still be the end of a seam, such as
+		// the ring under a cone's tip; taking it anywhere else would drag the seam
+		// across the surface after it.
+		if(mBorder[u] && shared != 1)
+			return false;
+		if(mSeam[u] && !mBorder[u] && !OnSeam(u, v))
+			return false;
+
+		//
+		// Every wedge of u must move to a wedge of v it shares a triangle with;
+		// otherwise the collapse would smear attributes across a seam.  If u has
+		// several wedges, the edge itself has to be on the seam.
+		//
+
+		mWedgeMap.clear();
+		uint32 liveWedges = 0;
+		for(uint32 a : mWedges[u])
+		{
+			uint32 best = NoVertex;
+			float bestDistance = 0.0f;
+			bool used = false;
+
+			for(uint32 t : mGroupTris[u])
+			{
+				if(!mTriAlive[t])
+					continue;
+
+				bool hasA = mCorners[t*3] == a || mCorners[t*3 + 1] == a || mCorners[t*3 + 2] == a;
+				if(!hasA)
+					continue;
+				used = true;
+
+				for(int k = 0; k < 3; ++k)
+				{
+					uint32 b = mCorners[t*3 + k];
+					if(mGroup[b] != v)
+						continue;
+
+					const GeometryGenerator::Vertex& va = mVertices[a];
+					const GeometryGenerator::Vertex& vb = mVertices[b];
+					float du = va.TexC.x - vb.TexC.x;
+					float dv = va.TexC.y - vb.TexC.y;
+					float dn = 1.0f - (va.Normal.x*vb.Normal.x + va.Normal.y*vb.Normal.y + va.Normal.z*vb.Normal.z);
+					float distance = du*du + dv*dv + dn;
+
+					if(best == NoVertex || distance < bestDistance)
+					{
+						best = b;
+						bestDistance = distance;
+					}
+				}
+			}
+
+			if(!used)
+				continue;
+			if(best == NoVertex)
+				return false;
+
+			++liveWedges;
+			mWedgeMap.push_back(std::make_pair(a, best));
+		}
+
+		if(liveWedges > 1 && seamWedges < 2)
+			return false;
+
+		//
+		// Link condition: the only vertices next to both u and v are the third
+		// vertices of their shared triangles.  Anything else would fold the
+		// surface onto itself.
+		//
+
+		Neighbours(u, mScratchU);
+		Neighbours(v, mScratchV);
+
+		uint32 common = 0;
+		for(size_t i = 0, j = 0; i < mScratchU.size() && j < mScratchV.size();)
+		{
+			if(mScratchU[i] < mScratchV[j])
+				++i;
+			else if(mScratchV[j] < mScratchU[i])
+				++j;
+			else
+			{
+				++common;
+				++i;
+				++j;
+			}
+		}
+
+		if(common != shared)
+			return false;
+
+		//
+		// No triangle that survives may flip over, or turn away from the normals
+		// its vertices will have.  The first test alone lets a triangle turn a
+		// little further with every collapse around it, until it faces backwards.
+		//
+
+		XMVECTOR target = XMLoadFloat3(&Position(v));
+		for(uint32 t : mGroupTris[u])
+		{
+			if(!mTriAlive[t] || HasGroup(t, v))
+				continue;
+
+			XMVECTOR before[3];
+			XMVECTOR after[3];
+			XMVECTOR normal = XMVectorZero();
+			for(int k = 0; k < 3; ++k)
+			{
+				uint32 g = GroupOf(t, k);
+				before[k] = XMLoadFloat3(&Position(g));
+				after[k] = g == u ? target : before[k];
+
+				uint32 w = mCorners[t*3 + k];
+				for(const auto& move : mWedgeMap)
+				{
+					if(w == move.first)
+						w = move.second;
+				}
+				normal += XMLoadFloat3(&mVertices[w].Normal);
+			}
+
+			XMVECTOR n0 = XMVector3Cross(before[1] - before[0], before[2] - before[0]);
+			XMVECTOR n1 = XMVector3Cross(after[1] - after[0], after[2] - after[0]);
+			if(XMVectorGetX(XMVector3Dot(n0, n1)) <= 0.0f || XMVectorGetX(XMVector3Dot(normal, n1)) <= 0.0f)
+				return false;
+		}
+
+		return true;
+	}
+
+	void EdgeCollapser::Collapse(uint32 u, uint32 v)
+	{
+		// Everything around u changes; leave it for the next pass.
+		for(uint32 g : mScratchU)
+			mLocked[g] = true;
+		mLocked[u] = true;
+		mLocked[v] = true;
+
+		for(uint32 t : mGroupTris[u])
+		{
+			if(!mTriAlive[t])
+				continue;
+
+			if(HasGroup(t, v))
+			{
+				mTriAlive[t] = false;
+				--mTriCount;
+				continue;
+			}
+
+			for(int k = 0; k < 3; ++k)
+			{
+				uint32& corner = mCorners[t*3 + k];
+				for(const auto& move : mWedgeMap)
+				{
+					if(corner == move.first)
+					{
+						corner = move.second;
+						break;
+					}
+				}
+			}
+
+			mGroupTris[v].push_back(t);
+		}
+
+		mQuadrics[v].Add(mQuadrics[u]);
+		mGroupTris[u].clear();
+	}
+
+	void EdgeCollapser::Run(uint32 targetTriangleCount)
+	{
+		std::vector<Candidate> candidates;
+		mLocked.assign(mWedges.size(), false);
+
+		while(mTriCount > targetTriangleCount)
+		{
+			//
+			// Every collapse along an edge, not just the cheapest of each group,
+			// since that one may be blocked when another is not.
+			//
+
+			candidates.clear();
+			for(uint32 u = 0; u < mWedges.size(); ++u)
+			{
+				std::vector<uint32>& tris = mGroupTris[u];
+				tris.erase(std::remove_if(tris.begin(), tris.end(),
+					[this](uint32 t) { return !mTriAlive[t]; }), tris.end());
+
+				Neighbours(u, mScratchV);
+				for(uint32 v : mScratchV)
+				{
+					if(mBorder[u] && SharedTriangles(u, v) != 1)
+						continue;
+
+					Quadric q = mQuadrics[u];
+					q.Add(mQuadrics[v]);
+					candidates.push_back({ q.Distance(Position(v)), u, v });
+				}
+			}
+
+			std::sort(candidates.begin(), candidates.end(),
+				[](const Candidate& a, const Candidate& b) { return a.Error < b.Error; });
+
+			//
+			// Take them cheapest first, at most one per neighbourhood per pass, and
+			// only as many as about half the triangles still to go so later passes
+			// see the updated costs.
+			//
+
+			std::fill(mLocked.begin(), mLocked.end(), false);
+			uint32 passStep = std::max<uint32>((mTriCount - targetTriangleCount) / 2, 2);
+			uint32 passTarget = mTriCount > targetTriangleCount + passStep ? mTriCount - passStep : targetTriangleCount;
+
+			uint32 collapses = 0;
+			for(const Candidate& c : candidates)
+			{
+				if(mTriCount <= passTarget)
+					break;
+				if(mLocked[c.From] || mLocked[c.To] || !CanCollapse(c.From, c.To))
+					continue;
+
+				Collapse(c.From, c.To);
+				mError = std::max(mError, c.Error);
+				++collapses;
+			}
+
+			if(collapses == 0)
+				break;
+		}
+	}
+
+	GeometryGenerator::MeshData EdgeCollapser::Result() const
+	{
+		GeometryGenerator::MeshData result;
+		std::vector<uint32> remap(mVertices.size(), NoVertex);
+
+		for(uint32 t = 0; t < mTriAlive.size(); ++t)
+		{
+			if(!mTriAlive[t])
+				continue;
+
+			for(int k = 0; k < 3; ++k)
+			{
+				uint32 w = mCorners[t*3 + k];
+				if(remap[w] == NoVertex)
+				{
+					remap[w] = static_cast<uint32>(result.Vertices.size());
+					result.Vertices.push_back(mVertices[w]);
+				}
+				result.Indices32.push_back(remap[w]);
+			}
+		}
+
+		return result;
+	}
+}
+
+MeshSimplifier::MeshData MeshSimplifier::Simplify(const MeshData& meshData, uint32 targetTriangleCount, float* error)
+{
+	EdgeCollapser collapser(meshData);
+	collapser.Run(targetTriangleCount);
+
+	if(error != nullptr)
+		*error = collapser.Error();
+
+	return collapser.Result();
+}
+
+std::vector<MeshSimplifier::Lod> MeshSimplifier::BuildLodChain(const MeshData& meshData,
+	const std::vector<float>& triangleRatios)
+{
+	uint32 triCount = static_cast<uint32>(meshData.Indices32.size() / 3);
+
+	std::vector<Lod> lods(triangleRatios.size());
+	for(size_t level = 0; level < triangleRatios.size(); ++level)
+	{
+		uint32 target = static_cast<uint32>(triCount*std::max(triangleRatios[level], 0.0f));
+		lods[level].Mesh = Simplify(meshData, target, &lods[level].Error);
+	}
+
+	return lods;
+}
@@ -0,0 +1,46 @@
+//***************************************************************************************
+// MeshSimplifier.h
+//
+// Reduces the triangle count of a GeometryGenerator mesh by edge collapse, cheapest
+// quadric error first (Garland and Heckbert, "Surface Simplification Using Quadric
+// Error Metrics").  Collapses move a vertex onto one of its neighbours, so no new
+// positions are made up and every remaining vertex keeps its own normal, tangent and
+// texture coordinates.  Vertices at the same position with different attributes (UV
+// seams, hard edges) only move along the seam, and open borders only along the border.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <cstdint>
+#include <vector>
+
+class MeshSimplifier
+{
+public:
+	using uint32 = std::uint32_t;
+	using MeshData = GeometryGenerator::MeshData;
+
+	struct Lod
+	{
+		MeshData Mesh;
+
+		// Largest collapse error, as an object-space distance from the original
+		// surface.  Divide by view distance (and scale by the projection) to get the
+		// error on screen.
+		float Error = 0.0f;
+	};
+
+	///<summary>
+	/// Collapses edges until at most targetTriangleCount triangles are left, or no
+	/// collapse is possible without flipping triangles or breaking the topology.
+	/// error (if not null) receives the largest collapse error.
+	///</summary>
+	static MeshData Simplify(const MeshData& meshData, uint32 targetTriangleCount, float* error = nullptr);
+
+	///<summary>
+	/// Simplifies the mesh to each fraction of its triangle count in turn, e.g.
+	/// { 0.5f, 0.25f }.  Every level is made from the full mesh.
+	///</summary>
+	static std::vector<Lod> BuildLodChain(const MeshData& meshData, const std::vector<float>& triangleRatios);
+};
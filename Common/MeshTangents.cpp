@@ -0,0 +1,441 @@
+//***************************************************************************************
+// MeshTangents.cpp
+//***************************************************************************************
+
+#include "MeshTangents.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	using Vertex = GeometryGenerator::Vertex;
+
+	const size_t ParallelTriangleThreshold = 16384;
+	const int GrainBatches = 512;
+	const int GrainVertices = 4096;
+
+	// Below this a length or UV area counts as zero, as in MikkTSpace.
+	const float TinyLengthSq = 1e-20f;
+	const float TinyArea = 1e-20f;
+
+	// Four 3D vectors, one in each lane.
+	struct Vector3x4
+	{
+		XMVECTOR X;
+		XMVECTOR Y;
+		XMVECTOR Z;
+	};
+
+	Vector3x4 operator-(const Vector3x4& a, const Vector3x4& b)
+	{
+		return { a.X - b.X, a.Y - b.Y, a.Z - b.Z };
+	}
+
+	Vector3x4 Scale(const Vector3x4& a, FXMVECTOR s)
+	{
+		return { a.X * s, a.Y * s, a.Z * s };
+	}
+
+	XMVECTOR Dot(const Vector3x4& a, const Vector3x4& b)
+	{
+		return XMVectorMultiplyAdd(a.X, b.X, XMVectorMultiplyAdd(a.Y, b.Y, a.Z * b.Z));
+	}
+
+	Vector3x4 Cross(const Vector3x4& a, const Vector3x4& b)
+	{
+		return { a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X };
+	}
+
+	// Zero-length vectors stay zero.
+	Vector3x4 Normalize(const Vector3x4& a)
+	{
+		XMVECTOR lengthSq = Dot(a, a);
+		XMVECTOR nonZero = XMVectorGreater(lengthSq, XMVectorReplicate(TinyLengthSq));
+		XMVECTOR scale = XMVectorReciprocalSqrt(XMVectorMax(lengthSq, XMVectorReplicate(TinyLengthSq)));
+		return Scale(a, XMVectorSelect(XMVectorZero(), scale, nonZero));
+	}
+
+	// a less its part along the unit vector n.
+	Vector3x4 Project(const Vector3x4& a, const Vector3x4& n)
+	{
+		return a - Scale(n, Dot(a, n));
+	}
+
+	// Angle at p0 between the edges to p1 and p2, seen along n if given.
+	XMVECTOR CornerAngle(const Vector3x4& p0, const Vector3x4& p1, const Vector3x4& p2, const Vector3x4* n)
+	{
+		Vector3x4 a = p1 - p0;
+		Vector3x4 b = p2 - p0;
+		if (n != nullptr)
+		{
+			a = Project(a, *n);
+			b = Project(b, *n);
+		}
+
+		XMVECTOR cosine = Dot(Normalize(a), Normalize(b));
+		return XMVectorACos(XMVectorClamp(cosine, XMVectorReplicate(-1.0f), XMVectorReplicate(1.0f)));
+	}
+
+	// Four triangles, the last repeated when there are fewer left.
+	struct TriangleBatch
+	{
+		uint32_t Index[3][4];
+		size_t Count = 0;
+
+		TriangleBatch(const std::vector<uint32_t>& indices, size_t firstTriangle, size_t triangleCount)
+		{
+			Count = std::min<size_t>(4, triangleCount - firstTriangle);
+			for (size_t lane = 0; lane < 4; ++lane)
+			{
+				size_t t = firstTriangle + std::min(lane, Count - 1);
+				for (int c = 0; c < 3; ++c)
+					Index[c][lane] = indices[t * 3 + c];
+			}
+		}
+
+		Vector3x4 Gather(const Vertex* vertices, int corner, XMFLOAT3 Vertex::* field) const
+		{
+			const XMFLOAT3& a = vertices[Index[corner][0]].*field;
+			const XMFLOAT3& b = vertices[Index[corner][1]].*field;
+			const XMFLOAT3& c = vertices[Index[corner][2]].*field;
+			const XMFLOAT3& d = vertices[Index[corner][3]].*field;
+			return { XMVectorSet(a.x, b.x, c.x, d.x), XMVectorSet(a.y, b.y, c.y, d.y), XMVectorSet(a.z, b.z, c.z, d.z) };
+		}
+
+		void GatherTexC(const Vertex* vertices, int corner, XMVECTOR& u, XMVECTOR& v) const
+		{
+			const XMFLOAT2& a = vertices[Index[corner][0]].TexC;
+			const XMFLOAT2& b = vertices[Index[corner][1]].TexC;
+			const XMFLOAT2& c = vertices[Index[corner][2]].TexC;
+			const XMFLOAT2& d = vertices[Index[corner][3]].TexC;
+			u = XMVectorSet(a.x, b.x, c.x, d.x);
+			v = XMVectorSet(a.y, b.y, c.y, d.y);
+		}
+
+		// Writes the lanes in use to the corner's slot of each triangle.
+		void Scatter(const Vector3x4& value, size_t firstTriangle, int corner, std::vector<XMFLOAT3>& out) const
+		{
+			XMFLOAT4A x, y, z;
+			XMStoreFloat4A(&x, value.X);
+			XMStoreFloat4A(&y, value.Y);
+			XMStoreFloat4A(&z, value.Z);
+
+			const float* xs = &x.x;
+			const float* ys = &y.x;
+			const float* zs = &z.x;
+			for (size_t lane = 0; lane < Count; ++lane)
+				out[(firstTriangle + lane) * 3 + corner] = XMFLOAT3(xs[lane], ys[lane], zs[lane]);
+		}
+	};
+
+	void ParallelRange(TaskScheduler* scheduler, size_t count, bool parallel, int grainSize, const std::function<void(int, int)>& body)
+	{
+		if (!parallel)
+		{
+			body(0, static_cast<int>(count));
+			return;
+		}
+
+		TaskScheduler& pool = scheduler != nullptr ? *scheduler : TaskScheduler::Default();
+		pool.ParallelForRange(0, static_cast<int>(count), grainSize, body);
+	}
+
+	// The corners (triangle * 3 + corner) around each vertex, in triangle order, so
+	// every vertex sums them in the same order however the vertices are split up.
+	struct VertexCorners
+	{
+		std::vector<uint32_t> Start;
+		std::vector<uint32_t> Corners;
+
+		VertexCorners(const std::vector<uint32_t>& indices, size_t cornerCount, size_t vertexCount)
+			: Start(vertexCount + 1, 0), Corners(cornerCount)
+		{
+			for (size_t i = 0; i < cornerCount; ++i)
+				++Start[indices[i] + 1];
+			for (size_t v = 0; v < vertexCount; ++v)
+				Start[v + 1] += Start[v];
+
+			std::vector<uint32_t> next(Start.begin(), Start.end() - 1);
+			for (size_t i = 0; i < cornerCount; ++i)
+				Corners[next[indices[i]]++] = static_cast<uint32_t>(i);
+		}
+
+		XMVECTOR Sum(size_t vertex, const std::vector<XMFLOAT3>& values) const
+		{
+			XMVECTOR sum = XMVectorZero();
+			for (uint32_t i = Start[vertex]; i < Start[vertex + 1]; ++i)
+				sum += XMLoadFloat3(&values[Corners[i]]);
+			return sum;
+		}
+	};
+
+	float LengthSq(FXMVECTOR v)
+	{
+		return XMVectorGetX(XMVector3LengthSq(v));
+	}
+
+	// Any unit vector perpendicular to n.
+	XMVECTOR Perpendicular(FXMVECTOR n)
+	{
+		XMVECTOR axis = fabsf(XMVectorGetX(n)) < 0.9f ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+		return XMVector3Normalize(axis - n * XMVector3Dot(axis, n));
+	}
+}
+
+MeshTangents::TangentReport MeshTangents::Generate(GeometryGenerator::MeshData& meshData, const TangentOptions& options)
+{
+	TangentReport report;
+
+	std::vector<Vertex>& vertices = meshData.Vertices;
+	const std::vector<uint32>& indices = meshData.Indices32;
+	size_t triangleCount = indices.size() / 3;
+	size_t batchCount = (triangleCount + 3) / 4;
+	bool parallel = triangleCount >= ParallelTriangleThreshold;
+
+	if (vertices.empty())
+		return report;
+
+	VertexCorners vertexCorners(indices, triangleCount * 3, vertices.size());
+	std::vector<XMFLOAT3> cornerValues(triangleCount * 3);
+	std::vector<XMFLOAT3> cornerBitangents(triangleCount * 3);
+
+	std::atomic<size_t> computedNormals{ 0 };
+	std::atomic<size_t> degenerateTriangles{ 0 };
+	std::atomic<size_t> fallbackTangents{ 0 };
+	std::atomic<size_t> mirroredVertices{ 0 };
+
+	//
+	// Normals, if asked for or missing: the unit normal of each triangle weighted
+	// by the angle at each corner.
+	//
+
+	bool needNormals = options.ComputeNormals;
+	for (size_t i = 0; i < vertices.size() && !needNormals; ++i)
+		needNormals = LengthSq(XMLoadFloat3(&vertices[i].Normal)) < TinyLengthSq;
+
+	if (needNormals)
+	{
+		ParallelRange(options.Scheduler, batchCount, parallel, GrainBatches, [&](int first, int last)
+		{
+			for (int b = first; b < last; ++b)
+			{
+				size_t t = size_t(b) * 4;
+				TriangleBatch batch(indices, t, triangleCount);
+
+				Vector3x4 p[3];
+				for (int c = 0; c < 3; ++c)
+					p[c] = batch.Gather(vertices.data(), c, &Vertex::Position);
+
+				Vector3x4 faceNormal = Normalize(Cross(p[1] - p[0], p[2] - p[0]));
+				for (int c = 0; c < 3; ++c)
+				{
+					XMVECTOR angle = CornerAngle(p[c], p[(c + 1) % 3], p[(c + 2) % 3], nullptr);
+					batch.Scatter(Scale(faceNormal, angle), t, c, cornerValues);
+				}
+			}
+		});
+
+		ParallelRange(options.Scheduler, vertices.size(), parallel, GrainVertices, [&](int first, int last)
+		{
+			size_t computed = 0;
+			for (int v = first; v < last; ++v)
+			{
+				if (!options.ComputeNormals && LengthSq(XMLoadFloat3(&vertices[v].Normal)) >= TinyLengthSq)
+					continue;
+
+				XMVECTOR sum = vertexCorners.Sum(v, cornerValues);
+				if (LengthSq(sum) < TinyLengthSq)
+					continue;
+
+				XMStoreFloat3(&vertices[v].Normal, XMVector3Normalize(sum));
+				++computed;
+			}
+			computedNormals += computed;
+		});
+	}
+
+	//
+	// Tangents.  Each triangle's U and V directions, with the sign of its UV area
+	// so that mirrored triangles still point the way U grows, are projected into
+	// the tangent plane of each corner and weighted by the angle there.
+	//
+
+	ParallelRange(options.Scheduler, batchCount, parallel, GrainBatches, [&](int first, int last)
+	{
+		size_t degenerate = 0;
+		for (int b = first; b < last; ++b)
+		{
+			size_t t = size_t(b) * 4;
+			TriangleBatch batch(indices, t, triangleCount);
+
+			Vector3x4 p[3];
+			Vector3x4 n[3];
+			XMVECTOR u[3];
+			XMVECTOR v[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				p[c] = batch.Gather(vertices.data(), c, &Vertex::Position);
+				n[c] = batch.Gather(vertices.data(), c, &Vertex::Normal);
+				batch.GatherTexC(vertices.data(), c, u[c], v[c]);
+			}
+
+			Vector3x4 e1 = p[1] - p[0];
+			Vector3x4 e2 = p[2] - p[0];
+			XMVECTOR du1 = u[1] - u[0];
+			XMVECTOR dv1 = v[1] - v[0];
+			XMVECTOR du2 = u[2] - u[0];
+			XMVECTOR dv2 = v[2] - v[0];
+
+			XMVECTOR area = du1 * dv2 - dv1 * du2;
+			Vector3x4 os = Scale(e1, dv2) - Scale(e2, dv1);
+			Vector3x4 ot = Scale(e2, du1) - Scale(e1, du2);
+
+			XMVECTOR valid = XMVectorAndInt(XMVectorGreater(XMVectorAbs(area), XMVectorReplicate(TinyArea)),
+				XMVectorGreater(Dot(os, os), XMVectorReplicate(TinyLengthSq)));
+			XMVECTOR sign = XMVectorSelect(XMVectorReplicate(-1.0f), XMVectorReplicate(1.0f), XMVectorGreater(area, XMVectorZero()));
+			os = Scale(Normalize(os), sign);
+			ot = Scale(Normalize(ot), sign);
+
+			uint32_t validLanes[4];
+			XMStoreInt4(validLanes, valid);
+			for (size_t lane = 0; lane < batch.Count; ++lane)
+				degenerate += validLanes[lane] == 0 ? 1 : 0;
+
+			for (int c = 0; c < 3; ++c)
+			{
+				XMVECTOR weight = XMVectorAndInt(CornerAngle(p[c], p[(c + 1) % 3], p[(c + 2) % 3], &n[c]), valid);
+				batch.Scatter(Scale(Normalize(Project(os, n[c])), weight), t, c, cornerValues);
+				batch.Scatter(Scale(Normalize(Project(ot, n[c])), weight), t, c, cornerBitangents);
+			}
+		}
+		degenerateTriangles += degenerate;
+	});
+
+	ParallelRange(options.Scheduler, vertices.size(), parallel, GrainVertices, [&](int first, int last)
+	{
+		size_t fallback = 0;
+		size_t mirrored = 0;
+		for (int v = first; v < last; ++v)
+		{
+			XMVECTOR normal = XMLoadFloat3(&vertices[v].Normal);
+			XMVECTOR tangent = vertexCorners.Sum(v, cornerValues);
+			tangent -= normal * XMVector3Dot(normal, tangent);
+
+			if (LengthSq(tangent) < TinyLengthSq)
+			{
+				tangent = Perpendicular(normal);
+				++fallback;
+			}
+			else
+			{
+				tangent = XMVector3Normalize(tangent);
+				XMVECTOR bitangent = vertexCorners.Sum(v, cornerBitangents);
+				if (XMVectorGetX(XMVector3Dot(XMVector3Cross(normal, tangent), bitangent)) < 0.0f)
+					++mirrored;
+			}
+
+			XMStoreFloat3(&vertices[v].TangentU, tangent);
+		}
+		fallbackTangents += fallback;
+		mirroredVertices += mirrored;
+	});
+
+	report.ComputedNormals = computedNormals;
+	report.DegenerateTriangles = degenerateTriangles;
+	report.FallbackTangents = fallbackTangents;
+	report.MirroredVertices = mirroredVertices;
+	return report;
+}
+
+MeshTangents::CheckReport MeshTangents::Validate(const GeometryGenerator::MeshData& meshData, float tolerance)
+{
+	const std::vector<Vertex>& vertices = meshData.Vertices;
+	const std::vector<uint32>& indices = meshData.Indices32;
+
+	// What the triangles around each vertex say: angle-weighted unit normals and U
+	// directions in the vertex's tangent plane, and the total weight of each.
+	std::vector<XMFLOAT3> normalSums(vertices.size(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+	std::vector<XMFLOAT3> uSums(vertices.size(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+	std::vector<float> normalWeights(vertices.size(), 0.0f);
+	std::vector<float> uWeights(vertices.size(), 0.0f);
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		const Vertex* v[3] = { &vertices[indices[i]], &vertices[indices[i + 1]], &vertices[indices[i + 2]] };
+
+		XMVECTOR p[3];
+		for (int c = 0; c < 3; ++c)
+			p[c] = XMLoadFloat3(&v[c]->Position);
+
+		XMVECTOR e1 = p[1] - p[0];
+		XMVECTOR e2 = p[2] - p[0];
+		XMVECTOR faceNormal = XMVector3Cross(e1, e2);
+		if (LengthSq(faceNormal) < TinyLengthSq)
+			continue;
+		faceNormal = XMVector3Normalize(faceNormal);
+
+		float du1 = v[1]->TexC.x - v[0]->TexC.x;
+		float dv1 = v[1]->TexC.y - v[0]->TexC.y;
+		float du2 = v[2]->TexC.x - v[0]->TexC.x;
+		float dv2 = v[2]->TexC.y - v[0]->TexC.y;
+		float area = du1 * dv2 - dv1 * du2;
+
+		XMVECTOR uDirection = XMVectorZero();
+		if (fabsf(area) > TinyArea)
+			uDirection = XMVector3Normalize((e1 * dv2 - e2 * dv1) * (area > 0.0f ? 1.0f : -1.0f));
+
+		for (int c = 0; c < 3; ++c)
+		{
+			XMVECTOR a = XMVector3Normalize(p[(c + 1) % 3] - p[c]);
+			XMVECTOR b = XMVector3Normalize(p[(c + 2) % 3] - p[c]);
+			float angle = acosf(std::max(-1.0f, std::min(1.0f, XMVectorGetX(XMVector3Dot(a, b)))));
+
+			uint32 index = indices[i + c];
+			XMStoreFloat3(&normalSums[index], XMLoadFloat3(&normalSums[index]) + faceNormal * angle);
+			normalWeights[index] += angle;
+
+			if (fabsf(area) > TinyArea)
+			{
+				XMVECTOR normal = XMLoadFloat3(&vertices[index].Normal);
+				XMVECTOR u = uDirection - normal * XMVector3Dot(uDirection, normal);
+				if (LengthSq(u) >= TinyLengthSq)
+					u = XMVector3Normalize(u);
+				XMStoreFloat3(&uSums[index], XMLoadFloat3(&uSums[index]) + u * angle);
+				uWeights[index] += angle;
+			}
+		}
+	}
+
+	// A direction counts only where the triangles mostly agree on it.
+	const float Agreement = 0.25f;
+
+	CheckReport report;
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		XMVECTOR normal = XMLoadFloat3(&vertices[i].Normal);
+		XMVECTOR tangent = XMLoadFloat3(&vertices[i].TangentU);
+		XMVECTOR normalSum = XMLoadFloat3(&normalSums[i]);
+		XMVECTOR uSum = XMLoadFloat3(&uSums[i]);
+
+		bool normalAgrees = sqrtf(LengthSq(normalSum)) <= Agreement * normalWeights[i] ||
+			XMVectorGetX(XMVector3Dot(normal, normalSum)) > 0.0f;
+		if (fabsf(sqrtf(LengthSq(normal)) - 1.0f) > tolerance || !normalAgrees)
+			++report.BadNormals;
+
+		if (fabsf(sqrtf(LengthSq(tangent)) - 1.0f) > tolerance ||
+			fabsf(XMVectorGetX(XMVector3Dot(normal, tangent))) > tolerance)
+			++report.BadTangents;
+
+		if (sqrtf(LengthSq(uSum)) >= Agreement * uWeights[i] && uWeights[i] > 0.0f &&
+			XMVectorGetX(XMVector3Dot(tangent, uSum)) <= 0.0f)
+			++report.FlippedTangents;
+	}
+
+	return report;
+}
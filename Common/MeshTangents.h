@@ -0,0 +1,78 @@
+//***************************************************************************************
+// MeshTangents.h
+//
+// Generates TangentU (and, where asked or missing, normals) for any GeometryGenerator
+// mesh the way MikkTSpace (Mikkelsen) does: every triangle gives its UV direction,
+// projected into the tangent plane of each corner's normal and weighted by the
+// corner angle, and each vertex averages what its corners give it.  Triangles are
+// processed four at a time with DirectXMath vectors, spread over a TaskScheduler for
+// large meshes; the result does not depend on the thread count.
+//
+// Vertex has no bitangent sign, so the shaders take B = cross(N, T).  Vertices whose
+// UVs are mirrored, where that B points against the V direction, are counted in the
+// report rather than split.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <cstdint>
+
+class TaskScheduler;
+
+class MeshTangents
+{
+public:
+	using uint32 = std::uint32_t;
+
+	struct TangentOptions
+	{
+		// Replace every normal with the angle-weighted average of the normals of
+		// the triangles around it.  Otherwise only zero-length normals are replaced.
+		bool ComputeNormals = false;
+
+		// Scheduler for large meshes (the process-wide default if null).
+		TaskScheduler* Scheduler = nullptr;
+	};
+
+	struct TangentReport
+	{
+		// Triangles with no area or no UV area; they add nothing to their vertices.
+		size_t DegenerateTriangles = 0;
+
+		size_t ComputedNormals = 0;
+
+		// Vertices with no UV direction around them, given any tangent perpendicular
+		// to the normal.
+		size_t FallbackTangents = 0;
+
+		size_t MirroredVertices = 0;
+	};
+
+	// Vertices that failed each check of Validate.
+	struct CheckReport
+	{
+		// Not unit length, or facing away from the triangles around the vertex.
+		size_t BadNormals = 0;
+
+		// Not unit length or not perpendicular to the normal.
+		size_t BadTangents = 0;
+
+		// Pointing against the U direction of the triangles around the vertex.
+		size_t FlippedTangents = 0;
+
+		bool Passed() const { return BadNormals == 0 && BadTangents == 0 && FlippedTangents == 0; }
+	};
+
+	///<summary>
+	/// Writes TangentU of every vertex, and the normals the options ask for.
+	///</summary>
+	static TangentReport Generate(GeometryGenerator::MeshData& meshData, const TangentOptions& options);
+
+	///<summary>
+	/// Checks the normals and tangents of a mesh against its triangles.  Vertices
+	/// whose triangles disagree too much to give a direction (poles, cone tips,
+	/// vertices with no UV area) are not checked for it.
+	///</summary>
+	static CheckReport Validate(const GeometryGenerator::MeshData& meshData, float tolerance = 1e-3f);
+};
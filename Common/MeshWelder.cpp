@@ -0,0 +1,201 @@
+//***************************************************************************************
+// MeshWelder.cpp
+//***************************************************************************************
+
+#include "MeshWelder.h"
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef GeometryGenerator::Vertex Vertex;
+
+	bool Near(const float* a, const float* b, int count, float epsilon)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			if (!(fabsf(a[i] - b[i]) <= epsilon))
+				return false;
+		}
+		return true;
+	}
+
+	bool Matches(const Vertex& a, const Vertex& b, const MeshWelder::WeldOptions& options)
+	{
+		return Near(&a.Position.x, &b.Position.x, 3, options.PositionEpsilon) &&
+			Near(&a.Normal.x, &b.Normal.x, 3, options.NormalEpsilon) &&
+			Near(&a.TexC.x, &b.TexC.x, 2, options.TexCEpsilon) &&
+			(!options.CompareTangents || Near(&a.TangentU.x, &b.TangentU.x, 3, options.NormalEpsilon));
+	}
+
+	std::uint64_t CellKey(std::int64_t x, std::int64_t y, std::int64_t z)
+	{
+		return std::uint64_t(x) * 73856093u ^ std::uint64_t(y) * 19349663u ^ std::uint64_t(z) * 83492791u;
+	}
+
+	// Maps every vertex to the first vertex matching it and returns the number of
+	// distinct vertices.  Vertices are bucketed by position: by cells of
+	// PositionEpsilon, searching the neighbouring cells too, or by their bits when
+	// only exact copies merge.
+	MeshWelder::uint32 BuildRemap(const std::vector<Vertex>& vertices, const MeshWelder::WeldOptions& options,
+		std::vector<MeshWelder::uint32>& remap)
+	{
+		const MeshWelder::uint32 none = UINT32_MAX;
+		const bool exact = !(options.PositionEpsilon > 0.0f);
+		const float invCell = exact ? 0.0f : 1.0f / options.PositionEpsilon;
+
+		std::unordered_map<std::uint64_t, MeshWelder::uint32> cellFirst;
+		cellFirst.reserve(vertices.size());
+		std::vector<MeshWelder::uint32> next;
+
+		// Representatives, in the order they were found.
+		std::vector<MeshWelder::uint32> kept;
+
+		remap.assign(vertices.size(), none);
+
+		for (MeshWelder::uint32 i = 0; i < vertices.size(); ++i)
+		{
+			const XMFLOAT3& p = vertices[i].Position;
+
+			std::int64_t cell[3];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				float c = (&p.x)[axis];
+				if (exact)
+				{
+					// -0 and +0 match, so they must land in the same bucket.
+					if (c == 0.0f)
+						c = 0.0f;
+
+					std::uint32_t bits;
+					memcpy(&bits, &c, sizeof(bits));
+					cell[axis] = bits;
+				}
+				else
+				{
+					cell[axis] = static_cast<std::int64_t>(floorf(c * invCell));
+				}
+			}
+
+			// Search the vertex's own cell, and with a tolerance its neighbours.
+			int reach = exact ? 0 : 1;
+			for (int dx = -reach; dx <= reach && remap[i] == none; ++dx)
+			{
+				for (int dy = -reach; dy <= reach && remap[i] == none; ++dy)
+				{
+					for (int dz = -reach; dz <= reach && remap[i] == none; ++dz)
+					{
+						auto it = cellFirst.find(CellKey(cell[0] + dx, cell[1] + dy, cell[2] + dz));
+						if (it == cellFirst.end())
+							continue;
+
+						for (MeshWelder::uint32 k = it->second; k != none; k = next[k])
+						{
+							if (Matches(vertices[i], vertices[kept[k]], options))
+							{
+								remap[i] = k;
+								break;
+							}
+						}
+					}
+				}
+			}
+
+			if (remap[i] != none)
+				continue;
+
+			MeshWelder::uint32 k = static_cast<MeshWelder::uint32>(kept.size());
+			kept.push_back(i);
+			remap[i] = k;
+
+			auto inserted = cellFirst.insert(std::make_pair(CellKey(cell[0], cell[1], cell[2]), k));
+			next.push_back(inserted.second ? none : inserted.first->second);
+			inserted.first->second = k;
+		}
+
+		return static_cast<MeshWelder::uint32>(kept.size());
+	}
+}
+
+MeshWelder::WeldReport MeshWelder::Weld(GeometryGenerator::MeshData& meshData, const WeldOptions& options)
+{
+	WeldReport report;
+	report.VerticesBefore = meshData.Vertices.size();
+
+	std::vector<uint32> remap;
+	uint32 keptCount = BuildRemap(meshData.Vertices, options, remap);
+	report.VerticesAfter = keptCount;
+
+	if (keptCount == meshData.Vertices.size())
+		return report;
+
+	// Representatives come in vertex order, so each one's new place is at or
+	// before its old one and the move can be done in place.
+	uint32 written = 0;
+	for (size_t i = 0; i < meshData.Vertices.size(); ++i)
+	{
+		if (remap[i] == written)
+			meshData.Vertices[written++] = meshData.Vertices[i];
+	}
+	meshData.Vertices.resize(keptCount);
+
+	for (uint32& index : meshData.Indices32)
+		index = remap[index];
+
+	return report;
+}
+
+MeshWelder::WeldReport MeshWelder::Weld(GeometryGenerator::MeshData& meshData)
+{
+	return Weld(meshData, WeldOptions());
+}
+
+GeometryGenerator::MeshData MeshWelder::Merge(const std::vector<const GeometryGenerator::MeshData*>& meshes,
+	bool shareDuplicates, std::vector<MergedSubmesh>& submeshes, WeldReport* report)
+{
+	GeometryGenerator::MeshData merged;
+	submeshes.clear();
+
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+	for (const GeometryGenerator::MeshData* mesh : meshes)
+	{
+		vertexCount += mesh->Vertices.size();
+		indexCount += mesh->Indices32.size();
+	}
+	merged.Vertices.reserve(vertexCount);
+	merged.Indices32.reserve(indexCount);
+
+	for (const GeometryGenerator::MeshData* mesh : meshes)
+	{
+		uint32 base = static_cast<uint32>(merged.Vertices.size());
+
+		MergedSubmesh submesh;
+		submesh.IndexCount = static_cast<uint32>(mesh->Indices32.size());
+		submesh.StartIndexLocation = static_cast<uint32>(merged.Indices32.size());
+		submeshes.push_back(submesh);
+
+		merged.Vertices.insert(merged.Vertices.end(), mesh->Vertices.begin(), mesh->Vertices.end());
+		for (uint32 index : mesh->Indices32)
+			merged.Indices32.push_back(base + index);
+	}
+
+	WeldReport shared;
+	shared.VerticesBefore = shared.VerticesAfter = merged.Vertices.size();
+	if (shareDuplicates)
+	{
+		WeldOptions exact;
+		exact.PositionEpsilon = 0.0f;
+		exact.NormalEpsilon = 0.0f;
+		exact.TexCEpsilon = 0.0f;
+		shared = Weld(merged, exact);
+	}
+
+	if (report != nullptr)
+		*report = shared;
+
+	return merged;
+}
@@ -0,0 +1,68 @@
+//***************************************************************************************
+// MeshWelder.h
+//
+// Merges vertices of a GeometryGenerator mesh whose attributes agree to within a given
+// tolerance and remaps the indices to the vertices that are left.  The box generator
+// makes every face its own vertices, which share positions but not normals, and
+// imported or concatenated meshes can leave exact copies behind.  Merge also concatenates several
+// meshes into one vertex and index buffer, sharing exact duplicates between them.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <cstdint>
+#include <vector>
+
+class MeshWelder
+{
+public:
+	using uint32 = std::uint32_t;
+
+	// Two vertices are merged when every component of each attribute is within
+	// its epsilon of the other's.  Zero epsilons merge exact copies only.
+	struct WeldOptions
+	{
+		float PositionEpsilon = 1e-5f;
+		float NormalEpsilon = 1e-3f;
+		float TexCEpsilon = 1e-5f;
+
+		// Off for vertex formats that drop TangentU, so it cannot keep vertices apart.
+		bool CompareTangents = true;
+	};
+
+	struct WeldReport
+	{
+		size_t VerticesBefore = 0;
+		size_t VerticesAfter = 0;
+
+		float SavedFraction() const
+		{
+			return VerticesBefore > 0 ? 1.0f - float(VerticesAfter) / VerticesBefore : 0.0f;
+		}
+	};
+
+	// Where one of the meshes passed to Merge ended up in the merged index buffer.
+	// Its indices point straight into the merged vertices (BaseVertexLocation 0).
+	struct MergedSubmesh
+	{
+		uint32 IndexCount = 0;
+		uint32 StartIndexLocation = 0;
+	};
+
+	///<summary>
+	/// Merges matching vertices in place.  The first vertex of each group is the
+	/// one kept, and kept vertices stay in their original order.
+	///</summary>
+	static WeldReport Weld(GeometryGenerator::MeshData& meshData, const WeldOptions& options);
+	static WeldReport Weld(GeometryGenerator::MeshData& meshData);
+
+	///<summary>
+	/// Appends the meshes into one vertex and index buffer, in order.  With
+	/// shareDuplicates set, vertices that are exact copies of one in another (or
+	/// the same) mesh are stored once.  Note GetIndices16 of the result is only
+	/// usable while it has no more than 65536 vertices.
+	///</summary>
+	static GeometryGenerator::MeshData Merge(const std::vector<const GeometryGenerator::MeshData*>& meshes,
+		bool shareDuplicates, std::vector<MergedSubmesh>& submeshes, WeldReport* report = nullptr);
+};
@@ -0,0 +1,377 @@
+//***************************************************************************************
+// MeshletBuilder.cpp
+//***************************************************************************************
+
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// Triangles using each vertex, as offsets into one shared list.
+	struct VertexTriangles
+	{
+		std::vector<std::uint32_t> Offsets;
+		std::vector<std::uint32_t> Triangles;
+
+		VertexTriangles(const std::vector<std::uint32_t>& indices, size_t vertexCount)
+			: Offsets(vertexCount + 1, 0), Triangles(indices.size())
+		{
+			for (std::uint32_t index : indices)
+				++Offsets[index + 1];
+			for (size_t i = 0; i < vertexCount; ++i)
+				Offsets[i + 1] += Offsets[i];
+
+			std::vector<std::uint32_t> fill(Offsets.begin(), Offsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); ++i)
+				Triangles[fill[indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+		}
+	};
+}
+
+MeshletBuilder::MeshletMesh MeshletBuilder::Build(const GeometryGenerator::MeshData& meshData, uint32 maxVertices, uint32 maxTriangles)
+{
+	// Local vertex indices are stored in a byte, and a triangle needs three.
+	maxVertices = std::min(std::max(maxVertices, 3u), 256u);
+	maxTriangles = std::max(maxTriangles, 1u);
+
+	const std::vector<uint32>& indices = meshData.Indices32;
+	const uint32 triangleCount = static_cast<uint32>(indices.size() / 3);
+	const size_t vertexCount = meshData.Vertices.size();
+
+	VertexTriangles adjacency(indices, vertexCount);
+	std::vector<bool> emitted(triangleCount, false);
+
+	// Local index of each mesh vertex in the meshlet being built, or -1.
+	std::vector<int> localIndex(vertexCount, -1);
+
+	// Centre of each triangle, to keep meshlets round when neighbours tie.
+	std::vector<XMFLOAT3> centroids(triangleCount);
+	for (uint32 t = 0; t < triangleCount; ++t)
+	{
+		XMVECTOR sum = XMLoadFloat3(&meshData.Vertices[indices[t * 3 + 0]].Position) +
+			XMLoadFloat3(&meshData.Vertices[indices[t * 3 + 1]].Position) +
+			XMLoadFloat3(&meshData.Vertices[indices[t * 3 + 2]].Position);
+		XMStoreFloat3(&centroids[t], sum / 3.0f);
+	}
+
+	MeshletMesh result;
+	Meshlet meshlet;
+	XMVECTOR meshletSum = XMVectorZero();
+	uint32 seed = 0;
+
+	auto finishMeshlet = [&]()
+	{
+		for (uint32 i = 0; i < meshlet.VertexCount; ++i)
+			localIndex[result.Vertices[meshlet.VertexOffset + i]] = -1;
+
+		std::vector<uint32> meshletIndices(meshlet.TriangleCount * 3);
+		for (uint32 i = 0; i < meshlet.TriangleCount * 3; ++i)
+			meshletIndices[i] = result.Vertices[meshlet.VertexOffset + result.Triangles[meshlet.TriangleOffset + i]];
+
+		result.Meshlets.push_back(meshlet);
+		result.MeshletBounds.push_back(ComputeBounds(meshData.Vertices, meshletIndices.data(), meshlet.TriangleCount * 3));
+
+		meshlet.VertexOffset = static_cast<uint32>(result.Vertices.size());
+		meshlet.VertexCount = 0;
+		meshlet.TriangleOffset = static_cast<uint32>(result.Triangles.size());
+		meshlet.TriangleCount = 0;
+		meshletSum = XMVectorZero();
+	};
+
+	for (;;)
+	{
+		// Pick the next triangle: the neighbour adding the fewest new vertices and
+		// then the one nearest the middle of the meshlet, or the first triangle not
+		// yet emitted when starting a meshlet.
+		uint32 best = UINT32_MAX;
+		uint32 bestNew = 4;
+		float bestDistanceSq = FLT_MAX;
+		XMVECTOR middle = meshlet.TriangleCount > 0 ? meshletSum / float(meshlet.TriangleCount) : XMVectorZero();
+
+		for (uint32 i = 0; i < meshlet.VertexCount; ++i)
+		{
+			uint32 v = result.Vertices[meshlet.VertexOffset + i];
+			for (uint32 a = adjacency.Offsets[v]; a < adjacency.Offsets[v + 1]; ++a)
+			{
+				uint32 t = adjacency.Triangles[a];
+				if (emitted[t])
+					continue;
+
+				uint32 newVertices = 0;
+				for (int k = 0; k < 3; ++k)
+					newVertices += localIndex[indices[t * 3 + k]] < 0 ? 1 : 0;
+
+				if (meshlet.VertexCount + newVertices > maxVertices)
+					continue;
+
+				if (newVertices > bestNew)
+					continue;
+
+				float distanceSq = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&centroids[t]) - middle));
+				if (newVertices < bestNew || distanceSq < bestDistanceSq)
+				{
+					best = t;
+					bestNew = newVertices;
+					bestDistanceSq = distanceSq;
+				}
+			}
+		}
+
+		if (best == UINT32_MAX)
+		{
+			if (meshlet.TriangleCount > 0)
+			{
+				finishMeshlet();
+				continue;
+			}
+
+			while (seed < triangleCount && emitted[seed])
+				++seed;
+			if (seed == triangleCount)
+				break;
+
+			best = seed;
+		}
+
+		for (int k = 0; k < 3; ++k)
+		{
+			uint32 v = indices[best * 3 + k];
+			if (localIndex[v] < 0)
+			{
+				localIndex[v] = static_cast<int>(meshlet.VertexCount++);
+				result.Vertices.push_back(v);
+			}
+			result.Triangles.push_back(static_cast<std::uint8_t>(localIndex[v]));
+		}
+		emitted[best] = true;
+		meshletSum += XMLoadFloat3(&centroids[best]);
+
+		if (++meshlet.TriangleCount == maxTriangles)
+			finishMeshlet();
+	}
+
+	return result;
+}
+
+MeshletBuilder::Bounds MeshletBuilder::ComputeBounds(const std::vector<GeometryGenerator::Vertex>& vertices,
+	const uint32* indices, uint32 indexCount)
+{
+	Bounds bounds;
+	if (indexCount == 0)
+		return bounds;
+
+	//
+	// Box, and a sphere by Ritter's method: start from the two points furthest apart
+	// along the widest axis and grow the sphere to take in any point outside it.
+	//
+
+	XMVECTOR boxMin = XMLoadFloat3(&vertices[indices[0]].Position);
+	XMVECTOR boxMax = boxMin;
+	uint32 minIndex[3] = { indices[0], indices[0], indices[0] };
+	uint32 maxIndex[3] = { indices[0], indices[0], indices[0] };
+
+	for (uint32 i = 0; i < indexCount; ++i)
+	{
+		const XMFLOAT3& p = vertices[indices[i]].Position;
+		boxMin = XMVectorMin(boxMin, XMLoadFloat3(&p));
+		boxMax = XMVectorMax(boxMax, XMLoadFloat3(&p));
+
+		const float* c = &p.x;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (c[axis] < (&vertices[minIndex[axis]].Position.x)[axis])
+				minIndex[axis] = indices[i];
+			if (c[axis] > (&vertices[maxIndex[axis]].Position.x)[axis])
+				maxIndex[axis] = indices[i];
+		}
+	}
+
+	XMStoreFloat3(&bounds.BoxMin, boxMin);
+	XMStoreFloat3(&bounds.BoxMax, boxMax);
+
+	int widest = 0;
+	float widestSq = -1.0f;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		XMVECTOR d = XMLoadFloat3(&vertices[maxIndex[axis]].Position) - XMLoadFloat3(&vertices[minIndex[axis]].Position);
+		float lengthSq = XMVectorGetX(XMVector3LengthSq(d));
+		if (lengthSq > widestSq)
+		{
+			widest = axis;
+			widestSq = lengthSq;
+		}
+	}
+
+	XMVECTOR center = 0.5f * (XMLoadFloat3(&vertices[minIndex[widest]].Position) + XMLoadFloat3(&vertices[maxIndex[widest]].Position));
+	float radius = 0.5f * sqrtf(widestSq);
+
+	for (uint32 i = 0; i < indexCount; ++i)
+	{
+		XMVECTOR p = XMLoadFloat3(&vertices[indices[i]].Position);
+		float distance = XMVectorGetX(XMVector3Length(p - center));
+		if (distance > radius)
+		{
+			float grown = 0.5f * (radius + distance);
+			center += (p - center) * ((grown - radius) / distance);
+			radius = grown;
+		}
+	}
+
+	XMStoreFloat3(&bounds.Center, center);
+	bounds.Radius = radius;
+
+	//
+	// Normal cone: the average face normal, and how far the normals spread from it.
+	//
+
+	std::vector<XMVECTOR> normals;
+	normals.reserve(indexCount / 3);
+	XMVECTOR axis = XMVectorZero();
+
+	for (uint32 i = 0; i + 2 < indexCount; i += 3)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[indices[i + 0]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[indices[i + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[indices[i + 2]].Position);
+
+		XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+		if (XMVectorGetX(XMVector3LengthSq(n)) <= 0.0f)
+			continue;
+
+		n = XMVector3Normalize(n);
+		normals.push_back(n);
+		axis += n;
+	}
+
+	if (normals.empty() || XMVectorGetX(XMVector3LengthSq(axis)) <= 0.0f)
+		return bounds;
+
+	axis = XMVector3Normalize(axis);
+
+	float minDot = 1.0f;
+	for (const XMVECTOR& n : normals)
+		minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(n, axis)));
+
+	XMStoreFloat3(&bounds.ConeAxis, axis);
+
+	// With the normals over 90 degrees apart some triangle always faces the eye.
+	bounds.ConeCutoff = minDot <= 0.0f ? 1.0f : sqrtf(1.0f - minDot * minDot);
+
+	return bounds;
+}
+
+MeshletCuller::MeshletCuller(const MeshletBuilder::MeshletMesh& mesh)
+	: mMesh(mesh), mMeshletCount(static_cast<uint32>(mesh.Meshlets.size()))
+{
+	mBlocks.resize((mMeshletCount + 3) / 4);
+
+	for (size_t b = 0; b < mBlocks.size(); ++b)
+	{
+		XMFLOAT4 lanes[8];
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			size_t m = b * 4 + lane;
+
+			// A spare lane gets a radius no plane test can pass.
+			MeshletBuilder::Bounds bounds;
+			bounds.Radius = -FLT_MAX;
+			if (m < mMeshletCount)
+				bounds = mesh.MeshletBounds[m];
+
+			(&lanes[0].x)[lane] = bounds.Center.x;
+			(&lanes[1].x)[lane] = bounds.Center.y;
+			(&lanes[2].x)[lane] = bounds.Center.z;
+			(&lanes[3].x)[lane] = bounds.Radius;
+			(&lanes[4].x)[lane] = bounds.ConeAxis.x;
+			(&lanes[5].x)[lane] = bounds.ConeAxis.y;
+			(&lanes[6].x)[lane] = bounds.ConeAxis.z;
+			(&lanes[7].x)[lane] = bounds.ConeCutoff;
+		}
+
+		BoundsBlock& block = mBlocks[b];
+		block.CenterX = XMLoadFloat4(&lanes[0]);
+		block.CenterY = XMLoadFloat4(&lanes[1]);
+		block.CenterZ = XMLoadFloat4(&lanes[2]);
+		block.Radius = XMLoadFloat4(&lanes[3]);
+		block.AxisX = XMLoadFloat4(&lanes[4]);
+		block.AxisY = XMLoadFloat4(&lanes[5]);
+		block.AxisZ = XMLoadFloat4(&lanes[6]);
+		block.Cutoff = XMLoadFloat4(&lanes[7]);
+	}
+}
+
+MeshletCuller::uint32 MeshletCuller::Cull(FXMMATRIX world, CXMMATRIX viewProj, const XMFLOAT3& eyePosW,
+	std::vector<uint32>& indices) const
+{
+	indices.clear();
+
+	// Frustum planes in object space from the columns of world*viewProj (clip-space
+	// z runs from 0 to 1), normalized so that they give distances.
+	XMMATRIX columns = XMMatrixTranspose(XMMatrixMultiply(world, viewProj));
+	XMVECTOR planes[6] =
+	{
+		columns.r[3] + columns.r[0],
+		columns.r[3] - columns.r[0],
+		columns.r[3] + columns.r[1],
+		columns.r[3] - columns.r[1],
+		columns.r[2],
+		columns.r[3] - columns.r[2],
+	};
+
+	for (XMVECTOR& plane : planes)
+		plane = plane * (1.0f / XMVectorGetX(XMVector3Length(plane)));
+
+	XMVECTOR eye = XMVector3TransformCoord(XMLoadFloat3(&eyePosW), XMMatrixInverse(nullptr, world));
+	XMVECTOR eyeX = XMVectorSplatX(eye);
+	XMVECTOR eyeY = XMVectorSplatY(eye);
+	XMVECTOR eyeZ = XMVectorSplatZ(eye);
+
+	uint32 drawn = 0;
+	for (size_t b = 0; b < mBlocks.size(); ++b)
+	{
+		const BoundsBlock& block = mBlocks[b];
+
+		// Inside (or crossing) every plane.
+		XMVECTOR negRadius = XMVectorNegate(block.Radius);
+		XMVECTOR visible = XMVectorTrueInt();
+		for (const XMVECTOR& plane : planes)
+		{
+			XMVECTOR d = XMVectorMultiplyAdd(block.CenterX, XMVectorSplatX(plane), XMVectorSplatW(plane));
+			d = XMVectorMultiplyAdd(block.CenterY, XMVectorSplatY(plane), d);
+			d = XMVectorMultiplyAdd(block.CenterZ, XMVectorSplatZ(plane), d);
+			visible = XMVectorAndInt(visible, XMVectorGreater(d, negRadius));
+		}
+
+		// Not entirely back-facing.
+		XMVECTOR dx = block.CenterX - eyeX;
+		XMVECTOR dy = block.CenterY - eyeY;
+		XMVECTOR dz = block.CenterZ - eyeZ;
+		XMVECTOR dot = XMVectorMultiplyAdd(dx, block.AxisX, XMVectorMultiplyAdd(dy, block.AxisY, dz * block.AxisZ));
+		XMVECTOR length = XMVectorSqrt(XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, dz * dz)));
+		XMVECTOR backFacing = XMVectorGreaterOrEqual(dot, XMVectorMultiplyAdd(block.Cutoff, length, block.Radius));
+		visible = XMVectorAndCInt(visible, backFacing);
+
+		std::uint32_t mask[4];
+		XMStoreInt4(mask, visible);
+
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			if (mask[lane] == 0)
+				continue;
+
+			const MeshletBuilder::Meshlet& meshlet = mMesh.Meshlets[b * 4 + lane];
+			const uint32* vertices = &mMesh.Vertices[meshlet.VertexOffset];
+			const std::uint8_t* triangles = &mMesh.Triangles[meshlet.TriangleOffset];
+
+			for (uint32 i = 0; i < meshlet.TriangleCount * 3; ++i)
+				indices.push_back(vertices[triangles[i]]);
+			++drawn;
+		}
+	}
+
+	return drawn;
+}
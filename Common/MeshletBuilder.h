@@ -0,0 +1,108 @@
+//***************************************************************************************
+// MeshletBuilder.h
+//
+// Splits a GeometryGenerator mesh into small clusters of triangles ("meshlets", at most
+// 64 vertices and 124 triangles by default) and works out a bounding sphere, a box and
+// a backface normal cone for each.  MeshletCuller then tests the clusters four at a
+// time against the view frustum and the eye position and writes the triangles of the
+// visible ones into an index list, so a dense mesh can be culled finer than one draw.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <cstdint>
+#include <vector>
+
+class MeshletBuilder
+{
+public:
+	using uint32 = std::uint32_t;
+
+	static const uint32 DefaultMaxVertices = 64;
+	static const uint32 DefaultMaxTriangles = 124;
+
+	struct Meshlet
+	{
+		// Range of MeshletMesh::Vertices holding the mesh vertex of each local vertex.
+		uint32 VertexOffset = 0;
+		uint32 VertexCount = 0;
+
+		// First byte of MeshletMesh::Triangles used by the meshlet, which holds three
+		// local vertex indices per triangle.
+		uint32 TriangleOffset = 0;
+		uint32 TriangleCount = 0;
+	};
+
+	struct Bounds
+	{
+		DirectX::XMFLOAT3 Center = { 0.0f, 0.0f, 0.0f };
+		float Radius = 0.0f;
+
+		DirectX::XMFLOAT3 BoxMin = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 BoxMax = { 0.0f, 0.0f, 0.0f };
+
+		// Every triangle faces away from an eye for which
+		//   dot(Center - eye, ConeAxis) >= ConeCutoff*length(Center - eye) + Radius.
+		// ConeCutoff is 1 when the normals spread too far for the test to hold.
+		DirectX::XMFLOAT3 ConeAxis = { 0.0f, 0.0f, 0.0f };
+		float ConeCutoff = 1.0f;
+	};
+
+	struct MeshletMesh
+	{
+		std::vector<Meshlet> Meshlets;
+		std::vector<Bounds> MeshletBounds;
+
+		std::vector<uint32> Vertices;
+		std::vector<std::uint8_t> Triangles;
+	};
+
+	///<summary>
+	/// Groups the triangles of the mesh into meshlets.  Each meshlet grows from a
+	/// seed triangle by adding the neighbouring triangle that brings in the fewest
+	/// new vertices (the one nearest its middle on a tie), until it runs out of
+	/// vertices, triangles or neighbours.
+	///</summary>
+	static MeshletMesh Build(const GeometryGenerator::MeshData& meshData,
+		uint32 maxVertices = DefaultMaxVertices, uint32 maxTriangles = DefaultMaxTriangles);
+
+	///<summary>
+	/// Bounds of the given triangles (indices into vertices).
+	///</summary>
+	static Bounds ComputeBounds(const std::vector<GeometryGenerator::Vertex>& vertices,
+		const uint32* indices, uint32 indexCount);
+};
+
+class MeshletCuller
+{
+public:
+	using uint32 = std::uint32_t;
+
+	// The mesh is referenced, not copied, and must outlive the culler.
+	explicit MeshletCuller(const MeshletBuilder::MeshletMesh& mesh);
+
+	///<summary>
+	/// Tests every meshlet against the frustum of world*viewProj and against the
+	/// eye (in world space) and writes the mesh indices of the triangles of the
+	/// meshlets that pass into indices.  Returns the number of meshlets drawn.  The
+	/// cone test assumes world has no non-uniform scale.
+	///</summary>
+	uint32 Cull(DirectX::FXMMATRIX world, DirectX::CXMMATRIX viewProj, const DirectX::XMFLOAT3& eyePosW,
+		std::vector<uint32>& indices) const;
+
+	uint32 MeshletCount() const { return mMeshletCount; }
+
+private:
+	// The bounds of four meshlets per entry, one meshlet per lane; the unused lanes
+	// of the last entry never pass.
+	struct BoundsBlock
+	{
+		DirectX::XMVECTOR CenterX, CenterY, CenterZ, Radius;
+		DirectX::XMVECTOR AxisX, AxisY, AxisZ, Cutoff;
+	};
+
+	const MeshletBuilder::MeshletMesh& mMesh;
+	uint32 mMeshletCount = 0;
+	std::vector<BoundsBlock> mBlocks;
+};
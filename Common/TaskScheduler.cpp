@@ -0,0 +1,197 @@
+//***************************************************************************************
+// TaskScheduler.cpp
+//***************************************************************************************
+
+#include "TaskScheduler.h"
+#include <algorithm>
+
+namespace
+{
+	// Identifies the scheduler (if any) the current thread is a worker of, so that
+	// nested ParallelFor calls push onto the worker's own deque.
+	struct WorkerIdentity
+	{
+		const TaskScheduler* Scheduler = nullptr;
+		int QueueIndex = -1;
+	};
+
+	thread_local WorkerIdentity tWorker;
+}
+
+TaskScheduler::TaskScheduler(int workerCount)
+{
+	if(workerCount < 0)
+	{
+		int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+		workerCount = std::max(hardwareThreads - 1, 0);
+	}
+
+	for(int i = 0; i < workerCount + 1; ++i)
+		mQueues.push_back(std::make_unique<WorkQueue>());
+
+	for(int i = 0; i < workerCount; ++i)
+		mWorkers.emplace_back(&TaskScheduler::WorkerMain, this, i);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mStopping = true;
+	}
+	mWakeCondition.notify_all();
+
+	for(auto& worker : mWorkers)
+		worker.join();
+}
+
+TaskScheduler& TaskScheduler::Default()
+{
+	static TaskScheduler scheduler;
+	return scheduler;
+}
+
+void TaskScheduler::ParallelForRange(int begin, int end, int grainSize, const std::function<void(int, int)>& body)
+{
+	if(end <= begin)
+		return;
+
+	int count = end - begin;
+	if(grainSize <= 0)
+		grainSize = std::max(1, count / (ThreadCount() * 4));
+
+	// Not worth waking anyone up.
+	if(mWorkers.empty() || count <= grainSize)
+	{
+		body(begin, end);
+		return;
+	}
+
+	Job job;
+	job.Body = &body;
+	job.GrainSize = grainSize;
+	job.Remaining.store(count);
+
+	int queueIndex = CurrentQueueIndex();
+
+	Range range;
+	range.Owner = &job;
+	range.Begin = begin;
+	range.End = end;
+	Execute(queueIndex, range);
+
+	// Help out (with this job or any other) until every sub-range of ours is done.
+	while(job.Remaining.load(std::memory_order_acquire) > 0)
+	{
+		if(PopOrSteal(queueIndex, range))
+			Execute(queueIndex, range);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void TaskScheduler::WorkerMain(int queueIndex)
+{
+	tWorker.Scheduler = this;
+	tWorker.QueueIndex = queueIndex;
+
+	for(;;)
+	{
+		Range range;
+		if(PopOrSteal(queueIndex, range))
+		{
+			Execute(queueIndex, range);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mWakeMutex);
+		++mSleepingWorkers;
+		mWakeCondition.wait(lock, [this]() { return mStopping || mQueuedRanges.load() > 0; });
+		--mSleepingWorkers;
+
+		if(mStopping && mQueuedRanges.load() <= 0)
+			return;
+	}
+}
+
+int TaskScheduler::CurrentQueueIndex() const
+{
+	if(tWorker.Scheduler == this)
+		return tWorker.QueueIndex;
+
+	// Threads outside the pool share the last queue.
+	return static_cast<int>(mQueues.size()) - 1;
+}
+
+void TaskScheduler::Push(int queueIndex, const Range& range)
+{
+	{
+		std::lock_guard<std::mutex> lock(mQueues[queueIndex]->Mutex);
+		mQueues[queueIndex]->Ranges.push_back(range);
+	}
+	++mQueuedRanges;
+
+	if(mSleepingWorkers.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mWakeCondition.notify_one();
+	}
+}
+
+bool TaskScheduler::PopOrSteal(int queueIndex, Range& range)
+{
+	// Our own most recently pushed (smallest, cache-warm) range first.
+	{
+		WorkQueue& own = *mQueues[queueIndex];
+		std::lock_guard<std::mutex> lock(own.Mutex);
+		if(!own.Ranges.empty())
+		{
+			range = own.Ranges.back();
+			own.Ranges.pop_back();
+			--mQueuedRanges;
+			return true;
+		}
+	}
+
+	// Otherwise steal the oldest (largest) range from someone else.
+	int queueCount = static_cast<int>(mQueues.size());
+	for(int k = 1; k < queueCount; ++k)
+	{
+		WorkQueue& victim = *mQueues[(queueIndex + k) % queueCount];
+		std::lock_guard<std::mutex> lock(victim.Mutex);
+		if(!victim.Ranges.empty())
+		{
+			range = victim.Ranges.front();
+			victim.Ranges.pop_front();
+			--mQueuedRanges;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void TaskScheduler::Execute(int queueIndex, Range range)
+{
+	Job* job = range.Owner;
+
+	// Split lazily: publish the upper half for thieves and keep the lower half.
+	while(range.End - range.Begin > job->GrainSize)
+	{
+		int mid = range.Begin + (range.End - range.Begin) / 2;
+
+		Range upper;
+		upper.Owner = job;
+		upper.Begin = mid;
+		upper.End = range.End;
+		Push(queueIndex, upper);
+
+		range.End = mid;
+	}
+
+	(*job->Body)(range.Begin, range.End);
+
+	// The job lives on the stack of the thread that started it, so this must be the
+	// last access to it.
+	job->Remaining.fetch_sub(range.End - range.Begin, std::memory_order_release);
+}
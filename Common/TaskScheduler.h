@@ -0,0 +1,99 @@
+//***************************************************************************************
+// TaskScheduler.h
+//
+// Small work-stealing thread pool for data-parallel CPU work.  Every worker owns a
+// deque of ranges; it pops work from the back of its own deque and, when that runs
+// dry, steals from the front of another worker's deque.  Large ranges are split
+// lazily: a worker that picks up a range bigger than the grain size pushes the upper
+// half back onto its deque (where idle workers can steal it) and keeps going with
+// the lower half.
+//
+// The thread that calls ParallelFor takes part in the work and only returns once the
+// whole range has been processed, so ParallelFor can be nested and called from any
+// thread.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskScheduler
+{
+public:
+	// Creates a scheduler with the given number of background workers.  The calling
+	// thread of ParallelFor always participates, so workerCount = 0 runs everything
+	// serially on the caller.  A negative count uses one worker per hardware thread,
+	// minus one for the caller.
+	explicit TaskScheduler(int workerCount = -1);
+	TaskScheduler(const TaskScheduler& rhs) = delete;
+	TaskScheduler& operator=(const TaskScheduler& rhs) = delete;
+	~TaskScheduler();
+
+	// Number of threads that execute ParallelFor work (workers + the caller).
+	int ThreadCount() const { return static_cast<int>(mWorkers.size()) + 1; }
+
+	// Calls body(first, last) over disjoint sub-ranges that together cover [begin, end).
+	// Sub-ranges are never split below grainSize iterations; grainSize <= 0 picks a
+	// grain that gives each thread a few chunks to balance with.
+	void ParallelForRange(int begin, int end, int grainSize, const std::function<void(int, int)>& body);
+
+	// Calls body(i) for every i in [begin, end).
+	template <typename Func>
+	void ParallelFor(int begin, int end, int grainSize, const Func& body)
+	{
+		ParallelForRange(begin, end, grainSize, [&body](int first, int last)
+		{
+			for(int i = first; i < last; ++i)
+				body(i);
+		});
+	}
+
+	// Process-wide scheduler sized to the machine.
+	static TaskScheduler& Default();
+
+private:
+	struct Job
+	{
+		const std::function<void(int, int)>* Body = nullptr;
+		int GrainSize = 1;
+		std::atomic<int> Remaining{0};
+	};
+
+	struct Range
+	{
+		Job* Owner = nullptr;
+		int Begin = 0;
+		int End = 0;
+	};
+
+	struct WorkQueue
+	{
+		std::mutex Mutex;
+		std::deque<Range> Ranges;
+	};
+
+	void WorkerMain(int queueIndex);
+	int CurrentQueueIndex() const;
+
+	void Push(int queueIndex, const Range& range);
+	bool PopOrSteal(int queueIndex, Range& range);
+	void Execute(int queueIndex, Range range);
+
+	// One queue per worker, plus a shared queue (the last one) for threads that are
+	// not workers of this scheduler.
+	std::vector<std::unique_ptr<WorkQueue>> mQueues;
+	std::vector<std::thread> mWorkers;
+
+	std::mutex mWakeMutex;
+	std::condition_variable mWakeCondition;
+	std::atomic<int> mQueuedRanges{0};
+	std::atomic<int> mSleepingWorkers{0};
+	bool mStopping = false;
+};
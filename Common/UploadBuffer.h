@@ -56,6 +56,13 @@ public:
 		memcpy(&mMappedData[elementIndex * mElementByteSize], &data, sizeof(T));
 	}
 
+	// Direct access to the mapped memory, for clients that fill many elements in
+	// one pass instead of calling CopyData per element.
+	BYTE* MappedData() const
+	{
+		return mMappedData;
+	}
+
 private:
 	Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
 	BYTE* mMappedData = nullptr;
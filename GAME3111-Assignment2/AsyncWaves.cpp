@@ -0,0 +1,187 @@
+//***************************************************************************************
+// AsyncWaves.cpp
+//***************************************************************************************
+
+#include "AsyncWaves.h"
+#include <algorithm>
+
+namespace
+{
+	// Set in AsyncWaves::mShared while the shared slot holds an unread frame.
+	const unsigned FreshBit = 4;
+	const unsigned SlotMask = 3;
+
+	// How many steps the simulation thread may fall behind its schedule before
+	// it gives up on catching up and restarts the schedule from now.
+	const int MaxCatchUpSteps = 4;
+}
+
+AsyncWaves::AsyncWaves(Waves* waves)
+	: mWaves(waves), mCompact(true), mStride(sizeof(Waves::CompactVertex))
+{
+	for(Slot& slot : mSlots)
+		slot.Vertices.resize(static_cast<size_t>(mWaves->VertexCount())*mStride);
+}
+
+AsyncWaves::AsyncWaves(Waves* waves, const Waves::VertexLayout& layout)
+	: mWaves(waves), mCompact(false), mLayout(layout), mStride(layout.Stride)
+{
+	for(Slot& slot : mSlots)
+		slot.Vertices.resize(static_cast<size_t>(mWaves->VertexCount())*mStride);
+}
+
+AsyncWaves::~AsyncWaves()
+{
+	Stop();
+}
+
+void AsyncWaves::Start()
+{
+	if(mThread.joinable())
+		return;
+
+	PublishFrame();
+
+	mStopping = false;
+	mThread = std::thread([this]() { SimulationMain(); });
+}
+
+void AsyncWaves::Stop()
+{
+	if(!mThread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mStopMutex);
+		mStopping = true;
+	}
+	mStopCondition.notify_one();
+
+	mThread.join();
+
+	// Disturbances queued after the last step are applied now, so none are lost
+	// if the simulation is stepped synchronously afterwards.
+	ApplyDisturbances();
+}
+
+void AsyncWaves::Disturb(int i, int j, float magnitude)
+{
+	std::lock_guard<std::mutex> lock(mDisturbMutex);
+	mDisturbances.push_back({ i, j, magnitude });
+}
+
+void AsyncWaves::Disturb(const Waves::Impulse* impulses, int count)
+{
+	std::lock_guard<std::mutex> lock(mDisturbMutex);
+	mImpulses.insert(mImpulses.end(), impulses, impulses + count);
+}
+
+const void* AsyncWaves::AcquireLatest()
+{
+	if(mShared.load(std::memory_order_relaxed) & FreshBit)
+	{
+		// Hand our slot back and take the fresh one; acquire makes the simulation
+		// thread's writes to it visible.
+		mFrontSlot = mShared.exchange(mFrontSlot, std::memory_order_acq_rel) & SlotMask;
+
+		double latencyMs = std::chrono::duration<double, std::milli>(
+			Clock::now() - mSlots[mFrontSlot].PublishTime).count();
+
+		++mFramesAcquired;
+		mTotalLatencyMs += latencyMs;
+		mMaxLatencyMs = std::max(mMaxLatencyMs, latencyMs);
+	}
+
+	return mSlots[mFrontSlot].Vertices.data();
+}
+
+AsyncWaves::Stats AsyncWaves::GetStats() const
+{
+	Stats stats;
+	stats.StepsSimulated = mStepsSimulated.load(std::memory_order_relaxed);
+	stats.FramesPublished = mFramesPublished.load(std::memory_order_relaxed);
+	stats.FramesAcquired = mFramesAcquired;
+	stats.FramesDropped = mFramesDropped.load(std::memory_order_relaxed);
+
+	if(stats.StepsSimulated > 0)
+		stats.AverageStepMs = mStepNanoseconds.load(std::memory_order_relaxed) * 1.0e-6 / stats.StepsSimulated;
+	if(mFramesAcquired > 0)
+		stats.AverageLatencyMs = mTotalLatencyMs / mFramesAcquired;
+	stats.MaxLatencyMs = mMaxLatencyMs;
+
+	return stats;
+}
+
+void AsyncWaves::SimulationMain()
+{
+	const float timeStep = mWaves->TimeStep();
+	const Clock::duration period = std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<float>(timeStep));
+
+	Clock::time_point nextStep = Clock::now() + period;
+	for(;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mStopMutex);
+			if(mStopCondition.wait_until(lock, nextStep, [this]() { return mStopping; }))
+				break;
+		}
+
+		Clock::time_point start = Clock::now();
+
+		ApplyDisturbances();
+		mWaves->Update(timeStep);
+		PublishFrame();
+
+		Clock::time_point end = Clock::now();
+		mStepNanoseconds.fetch_add(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(),
+			std::memory_order_relaxed);
+		mStepsSimulated.fetch_add(1, std::memory_order_relaxed);
+
+		// If steps take longer than the period we fall behind; step back to back
+		// for a while, but do not let the backlog grow without bound.
+		nextStep += period;
+		if(end - nextStep > MaxCatchUpSteps*period)
+			nextStep = end;
+	}
+}
+
+void AsyncWaves::ApplyDisturbances()
+{
+	std::vector<Disturbance> disturbances;
+	std::vector<Waves::Impulse> impulses;
+	{
+		std::lock_guard<std::mutex> lock(mDisturbMutex);
+		disturbances.swap(mDisturbances);
+		impulses.swap(mImpulses);
+	}
+
+	for(const Disturbance& d : disturbances)
+		mWaves->Disturb(d.I, d.J, d.Magnitude);
+
+	if(!impulses.empty())
+		mWaves->Disturb(impulses.data(), static_cast<int>(impulses.size()));
+}
+
+void AsyncWaves::PublishFrame()
+{
+	Slot& slot = mSlots[mBackSlot];
+
+	if(mCompact)
+		mWaves->WriteCompactVertices(reinterpret_cast<Waves::CompactVertex*>(slot.Vertices.data()));
+	else
+		mWaves->WriteVertices(slot.Vertices.data(), mLayout);
+
+	slot.PublishTime = Clock::now();
+	slot.Frame = mFramesPublished.load(std::memory_order_relaxed);
+
+	// Swap the finished slot into the shared position; release makes the writes
+	// above visible to the render thread's acquire.
+	unsigned previous = mShared.exchange(mBackSlot | FreshBit, std::memory_order_acq_rel);
+	if(previous & FreshBit)
+		mFramesDropped.fetch_add(1, std::memory_order_relaxed);
+
+	mBackSlot = previous & SlotMask;
+	mFramesPublished.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,137 @@
+//***************************************************************************************
+// AsyncWaves.h
+//
+// Steps a Waves simulation on a background thread at the simulation's own fixed rate
+// instead of inside the render loop.  After every step the solution is encoded into
+// vertices and published through a lock-free triple buffer: the simulation thread
+// always has a slot to write into, the render thread always has the latest finished
+// frame to read from, and neither ever waits for the other.  Frames the render thread
+// did not get to are overwritten.
+//
+// While the thread runs, the Waves object belongs to it; disturbances have to go
+// through AsyncWaves::Disturb.
+//***************************************************************************************
+
+#ifndef ASYNC_WAVES_H
+#define ASYNC_WAVES_H
+
+#include "Waves.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class AsyncWaves
+{
+public:
+	struct Stats
+	{
+		std::int64_t StepsSimulated = 0;
+		std::int64_t FramesPublished = 0;
+
+		// Distinct frames picked up by AcquireLatest, and published frames that
+		// were overwritten before the render thread got to them.
+		std::int64_t FramesAcquired = 0;
+		std::int64_t FramesDropped = 0;
+
+		// Time to step and encode one frame on the simulation thread.
+		double AverageStepMs = 0.0;
+
+		// Time from publishing a frame to the render thread picking it up.
+		double AverageLatencyMs = 0.0;
+		double MaxLatencyMs = 0.0;
+	};
+
+	// Publishes frames of Waves::CompactVertex.
+	explicit AsyncWaves(Waves* waves);
+
+	// Publishes frames of full vertices in the given layout.
+	AsyncWaves(Waves* waves, const Waves::VertexLayout& layout);
+
+	AsyncWaves(const AsyncWaves& rhs) = delete;
+	AsyncWaves& operator=(const AsyncWaves& rhs) = delete;
+	~AsyncWaves();
+
+	// Publishes the current solution, so AcquireLatest always has a frame, and
+	// starts the simulation thread.
+	void Start();
+	void Stop();
+	bool IsRunning() const { return mThread.joinable(); }
+
+	// Queue Waves::Disturb calls; they are applied before the next step.
+	void Disturb(int i, int j, float magnitude);
+	void Disturb(const Waves::Impulse* impulses, int count);
+
+	// Returns the most recently published frame: Waves::VertexCount() vertices
+	// of VertexStride() bytes each.  The frame stays valid and unchanged until
+	// the next call.  Only call from one (render) thread.
+	const void* AcquireLatest();
+	int VertexStride() const { return mStride; }
+
+	// Number of the frame AcquireLatest last returned, counting published frames
+	// from 0; unchanged while no new frame has been published.
+	std::int64_t AcquiredFrame() const { return mSlots[mFrontSlot].Frame; }
+
+	// Counters so far.  The latency figures are kept by AcquireLatest, so call
+	// this from the render thread as well.
+	Stats GetStats() const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Slot
+	{
+		std::vector<std::uint8_t> Vertices;
+		Clock::time_point PublishTime;
+		std::int64_t Frame = -1;
+	};
+
+	struct Disturbance
+	{
+		int I;
+		int J;
+		float Magnitude;
+	};
+
+	void SimulationMain();
+	void ApplyDisturbances();
+	void PublishFrame();
+
+private:
+	Waves* mWaves = nullptr;
+	bool mCompact = true;
+	Waves::VertexLayout mLayout;
+	int mStride = 0;
+
+	// The triple buffer.  mBackSlot is owned by the simulation thread and
+	// mFrontSlot by the render thread; mShared holds the index of the third slot,
+	// with FreshBit set while it holds a frame the render thread has not taken.
+	Slot mSlots[3];
+	int mBackSlot = 0;
+	int mFrontSlot = 2;
+	std::atomic<unsigned> mShared{1};
+
+	std::mutex mDisturbMutex;
+	std::vector<Disturbance> mDisturbances;
+	std::vector<Waves::Impulse> mImpulses;
+
+	std::thread mThread;
+	std::mutex mStopMutex;
+	std::condition_variable mStopCondition;
+	bool mStopping = false;
+
+	std::atomic<std::int64_t> mStepsSimulated{0};
+	std::atomic<std::int64_t> mFramesPublished{0};
+	std::atomic<std::int64_t> mFramesDropped{0};
+	std::atomic<std::int64_t> mStepNanoseconds{0};
+
+	// Render thread only.
+	std::int64_t mFramesAcquired = 0;
+	double mTotalLatencyMs = 0.0;
+	double mMaxLatencyMs = 0.0;
+};
+
+#endif // ASYNC_WAVES_H
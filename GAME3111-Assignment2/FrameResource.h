@@ -3,6 +3,7 @@
 #include "../Common/d3dUtil.h"
 #include "../Common/MathHelper.h"
 #include "../Common/UploadBuffer.h"
+#include "Waves.h"
 
 struct ObjectConstants
 {
@@ -53,7 +54,7 @@ struct Vertex
 struct FrameResource
 {
 public:
-	FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount);
+	FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount, bool compactWaves = false);
 	FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount);
 	FrameResource(const FrameResource& rhs) = delete;
 	FrameResource& operator=(const FrameResource& rhs) = delete;
@@ -72,7 +73,18 @@ public:
 
 	// We cannot update a dynamic vertex buffer until the GPU is done processing
 	// the commands that reference it.  So each frame needs their own.
+	// Only one of the two is created: WavesVB holds full vertices, WavesCompactVB
+	// the height/normal half of the compact two-stream layout.
 	std::unique_ptr<UploadBuffer<Vertex>> WavesVB = nullptr;
+	std::unique_ptr<UploadBuffer<Waves::CompactVertex>> WavesCompactVB = nullptr;
+
+	// Wave vertices that changed since this frame's buffer was last written; only
+	// those are rewritten when the waves are stepped on the render thread.
+	Waves::DirtyRegion WavesDirty;
+
+	// AsyncWaves frame this frame's buffer holds, or -1; the buffer is only copied
+	// into again when a newer frame has been published.
+	std::int64_t WavesAsyncFrame = -1;
 
 	// Fence value to mark commands up to this fence point.  This lets us
 	// check if these frame resources are still in use by the GPU.
@@ -0,0 +1,510 @@
+//***************************************************************************************
+// OceanWaves.cpp
+//***************************************************************************************
+
+#include "OceanWaves.h"
+#include "../Common/TaskScheduler.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	const float Gravity = 9.81f;
+
+	// Waves shorter than this fraction of the largest wind-driven wave are
+	// damped out of the spectrum.
+	const float SmallWaveFraction = 0.001f;
+
+	// Columns transformed per task by one FFT pass; 16 floats of a row are one
+	// cache line.
+	const int FftColumnGroup = 16;
+
+	inline XMVECTOR LoadFloats(const float* p)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+	}
+
+	inline void StoreFloats(float* p, FXMVECTOR v)
+	{
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p), v);
+	}
+
+	// Phillips spectrum for the wave vector (kx, kz), without the amplitude constant.
+	float Phillips(float kx, float kz, float windX, float windZ, float largestWave)
+	{
+		float kSq = kx*kx + kz*kz;
+		if(kSq == 0.0f)
+			return 0.0f;
+
+		float kLSq = kSq*largestWave*largestWave;
+		float cosWind = (kx*windX + kz*windZ) / sqrtf(kSq);
+		float smallWave = largestWave*SmallWaveFraction;
+
+		return expf(-1.0f / kLSq) / (kSq*kSq) * cosWind*cosWind * expf(-kSq*smallWave*smallWave);
+	}
+}
+
+OceanWaves::OceanWaves(int n, float patchSize, float windSpeed, const XMFLOAT2& windDirection,
+	float amplitude, float choppiness, unsigned seed)
+{
+	assert(n >= 4 && (n & (n - 1)) == 0);
+
+	mFftSize = n;
+	mLogFftSize = 0;
+	while((1 << mLogFftSize) < n)
+		++mLogFftSize;
+
+	// One more vertex than FFT samples per side; the last row and column wrap
+	// around to the first so patches tile.
+	mNumRows = n + 1;
+	mNumCols = n + 1;
+
+	mPatchSize = patchSize;
+	mChoppiness = choppiness;
+	mScheduler = &TaskScheduler::Default();
+
+	float dx = patchSize / n;
+	mHalfWidth = 0.5f*patchSize;
+	mHalfDepth = 0.5f*patchSize;
+
+	mColumnX.resize(mNumCols);
+	mColumnU.resize(mNumCols);
+	for(int j = 0; j < mNumCols; ++j)
+	{
+		mColumnX[j] = -mHalfWidth + j*dx;
+		mColumnU[j] = static_cast<float>(j) / n;
+	}
+
+	mRowZ.resize(mNumRows);
+	mRowV.resize(mNumRows);
+	for(int i = 0; i < mNumRows; ++i)
+	{
+		mRowZ[i] = mHalfDepth - i*dx;
+		mRowV[i] = static_cast<float>(i) / n;
+	}
+
+	//
+	// Set up the spectrum.  Entry (m, c) holds the wave with index frequencies
+	// (m', c'), where an index at or above n/2 stands for index - n.  Rows run
+	// towards -z, so the physical kz has the opposite sign of m'.
+	//
+
+	XMFLOAT2 wind;
+	XMStoreFloat2(&wind, XMVector2Normalize(XMLoadFloat2(&windDirection)));
+
+	// The Phillips spectrum integrates to a height variance of A*pi*L^2/2, where
+	// L = V^2/g is the largest wave the wind produces; pick A so that the RMS
+	// height comes out at roughly the requested amplitude.
+	float largestWave = windSpeed*windSpeed / Gravity;
+	float phillipsA = amplitude*amplitude * 2.0f / (XM_PI*largestWave*largestWave);
+	float dk = XM_2PI / patchSize;
+
+	size_t count = static_cast<size_t>(n)*n;
+	mH0Re.resize(count);
+	mH0Im.resize(count);
+	mH0MinusConjRe.resize(count);
+	mH0MinusConjIm.resize(count);
+	mOmega.resize(count);
+	mWaveX.resize(count);
+	mWaveZ.resize(count);
+	mWaveDirX.resize(count);
+	mWaveDirZ.resize(count);
+
+	std::mt19937 rng(seed);
+	std::normal_distribution<float> gaussian;
+
+	for(int m = 0; m < n; ++m)
+	{
+		int mi = m < n/2 ? m : m - n;
+		for(int c = 0; c < n; ++c)
+		{
+			int ci = c < n/2 ? c : c - n;
+			int k = m*n + c;
+
+			float kx = dk*ci;
+			float kz = -dk*mi;
+			float kLength = sqrtf(kx*kx + kz*kz);
+
+			mWaveX[k] = kx;
+			mWaveZ[k] = kz;
+			mWaveDirX[k] = kLength > 0.0f ? kx / kLength : 0.0f;
+			mWaveDirZ[k] = kLength > 0.0f ? kz / kLength : 0.0f;
+			mOmega[k] = sqrtf(Gravity*kLength);
+
+			// h0(k) = (xi_r + i*xi_i) * sqrt(P(k)/2) * dk.  The Nyquist row and
+			// column have no partner of opposite frequency, so they are left
+			// empty to keep the transformed fields real.
+			float xiRe = gaussian(rng);
+			float xiIm = gaussian(rng);
+			float scale = 0.0f;
+			if(m != n/2 && c != n/2)
+				scale = sqrtf(0.5f*phillipsA*Phillips(kx, kz, wind.x, wind.y, largestWave))*dk;
+
+			mH0Re[k] = xiRe*scale;
+			mH0Im[k] = xiIm*scale;
+		}
+	}
+
+	for(int m = 0; m < n; ++m)
+	{
+		for(int c = 0; c < n; ++c)
+		{
+			int k = m*n + c;
+			int minusK = ((n - m) % n)*n + (n - c) % n;
+			mH0MinusConjRe[k] = mH0Re[minusK];
+			mH0MinusConjIm[k] = -mH0Im[minusK];
+		}
+	}
+
+	//
+	// FFT tables.
+	//
+
+	mTwiddleRe.resize(n/2);
+	mTwiddleIm.resize(n/2);
+	for(int k = 0; k < n/2; ++k)
+	{
+		float angle = XM_2PI*k / n;
+		mTwiddleRe[k] = cosf(angle);
+		mTwiddleIm[k] = sinf(angle);
+	}
+
+	mBitReverse.resize(n);
+	for(int r = 0; r < n; ++r)
+	{
+		int reversed = 0;
+		for(int b = 0; b < mLogFftSize; ++b)
+			reversed |= ((r >> b) & 1) << (mLogFftSize - 1 - b);
+		mBitReverse[r] = reversed;
+	}
+
+	for(ComplexGrid& field : mFields)
+	{
+		field.Re.resize(count);
+		field.Im.resize(count);
+	}
+	mScratch.Re.resize(count);
+	mScratch.Im.resize(count);
+
+	size_t vertexCount = static_cast<size_t>(mNumRows)*mNumCols;
+	mHeights.resize(vertexCount);
+	mDisplaceX.resize(vertexCount);
+	mDisplaceZ.resize(vertexCount);
+	mNormalsX.resize(vertexCount);
+	mNormalsY.resize(vertexCount);
+	mNormalsZ.resize(vertexCount);
+	mTangentsX.resize(vertexCount);
+	mTangentsY.resize(vertexCount);
+
+	Evaluate(0.0f);
+}
+
+OceanWaves::~OceanWaves()
+{
+}
+
+int OceanWaves::RowCount()const
+{
+	return mNumRows;
+}
+
+int OceanWaves::ColumnCount()const
+{
+	return mNumCols;
+}
+
+int OceanWaves::VertexCount()const
+{
+	return mNumRows*mNumCols;
+}
+
+int OceanWaves::TriangleCount()const
+{
+	return (mNumRows - 1)*(mNumCols - 1)*2;
+}
+
+float OceanWaves::Width()const
+{
+	return mPatchSize;
+}
+
+float OceanWaves::Depth()const
+{
+	return mPatchSize;
+}
+
+float OceanWaves::SpatialStep()const
+{
+	return mPatchSize / mFftSize;
+}
+
+void OceanWaves::SetScheduler(TaskScheduler* scheduler)
+{
+	mScheduler = scheduler != nullptr ? scheduler : &TaskScheduler::Default();
+}
+
+void OceanWaves::Update(float dt)
+{
+	Evaluate(mTime + dt);
+}
+
+void OceanWaves::Evaluate(float time)
+{
+	mTime = time;
+
+	mScheduler->ParallelFor(0, mFftSize, 0, [this, time](int m)
+	{
+		BuildSpectrumRow(m, time);
+	});
+
+	for(ComplexGrid& field : mFields)
+		InverseFft(field);
+
+	mScheduler->ParallelFor(0, mNumRows, 0, [this](int i)
+	{
+		BuildSurfaceRow(i);
+	});
+}
+
+void OceanWaves::BuildSpectrumRow(int m, float time)
+{
+	const XMVECTOR Time = XMVectorReplicate(time);
+
+	int first = m*mFftSize;
+	for(int c = 0; c < mFftSize; c += 4)
+	{
+		int k = first + c;
+
+		// h(k, t) = h0(k) e^(iwt) + conj(h0(-k)) e^(-iwt)
+		XMVECTOR sinWt, cosWt;
+		XMVectorSinCos(&sinWt, &cosWt, LoadFloats(&mOmega[k])*Time);
+
+		XMVECTOR h0Re = LoadFloats(&mH0Re[k]);
+		XMVECTOR h0Im = LoadFloats(&mH0Im[k]);
+		XMVECTOR hmRe = LoadFloats(&mH0MinusConjRe[k]);
+		XMVECTOR hmIm = LoadFloats(&mH0MinusConjIm[k]);
+
+		XMVECTOR hRe = (h0Re + hmRe)*cosWt + (hmIm - h0Im)*sinWt;
+		XMVECTOR hIm = (h0Im + hmIm)*cosWt + (h0Re - hmRe)*sinWt;
+
+		// Slopes i*k*h and choppy displacements -i*(k/|k|)*h.
+		XMVECTOR kx = LoadFloats(&mWaveX[k]);
+		XMVECTOR kz = LoadFloats(&mWaveZ[k]);
+		XMVECTOR dirX = LoadFloats(&mWaveDirX[k]);
+		XMVECTOR dirZ = LoadFloats(&mWaveDirZ[k]);
+
+		XMVECTOR slopeXRe = -kx*hIm;
+		XMVECTOR slopeXIm = kx*hRe;
+		XMVECTOR slopeZRe = -kz*hIm;
+		XMVECTOR slopeZIm = kz*hRe;
+		XMVECTOR dispXRe = dirX*hIm;
+		XMVECTOR dispXIm = -dirX*hRe;
+		XMVECTOR dispZRe = dirZ*hIm;
+		XMVECTOR dispZIm = -dirZ*hRe;
+
+		// The transforms of all five fields are real, so pair them up as
+		// a + i*b, whose transform is A + i*B.
+		StoreFloats(&mFields[0].Re[k], hRe - slopeXIm);
+		StoreFloats(&mFields[0].Im[k], hIm + slopeXRe);
+		StoreFloats(&mFields[1].Re[k], slopeZRe - dispXIm);
+		StoreFloats(&mFields[1].Im[k], slopeZIm + dispXRe);
+		StoreFloats(&mFields[2].Re[k], dispZRe);
+		StoreFloats(&mFields[2].Im[k], dispZIm);
+	}
+}
+
+void OceanWaves::InverseFft(ComplexGrid& grid)
+{
+	// Transform along the columns, transpose so the rows become columns,
+	// transform those and transpose back.
+	int groupSize = std::min(mFftSize, FftColumnGroup);
+	int groupCount = mFftSize / groupSize;
+	int blockCount = mFftSize / 4;
+
+	mScheduler->ParallelFor(0, groupCount, 1, [this, &grid, groupSize](int g)
+	{
+		FftColumns(grid, g*groupSize, (g + 1)*groupSize);
+	});
+
+	mScheduler->ParallelFor(0, blockCount, 0, [this, &grid](int b)
+	{
+		Transpose(grid, mScratch, 4*b, 4*b + 4);
+	});
+
+	mScheduler->ParallelFor(0, groupCount, 1, [this, groupSize](int g)
+	{
+		FftColumns(mScratch, g*groupSize, (g + 1)*groupSize);
+	});
+
+	mScheduler->ParallelFor(0, blockCount, 0, [this, &grid](int b)
+	{
+		Transpose(mScratch, grid, 4*b, 4*b + 4);
+	});
+}
+
+void OceanWaves::FftColumns(ComplexGrid& grid, int first, int last) const
+{
+	// Iterative radix-2 inverse FFT along columns [first, last), four columns at
+	// a time: every butterfly works on the same rows of all the columns.
+	int n = mFftSize;
+	float* re = &grid.Re[0];
+	float* im = &grid.Im[0];
+
+	for(int r = 0; r < n; ++r)
+	{
+		int s = mBitReverse[r];
+		if(s <= r)
+			continue;
+
+		for(int c = first; c < last; c += 4)
+		{
+			XMVECTOR aRe = LoadFloats(re + r*n + c);
+			XMVECTOR aIm = LoadFloats(im + r*n + c);
+			StoreFloats(re + r*n + c, LoadFloats(re + s*n + c));
+			StoreFloats(im + r*n + c, LoadFloats(im + s*n + c));
+			StoreFloats(re + s*n + c, aRe);
+			StoreFloats(im + s*n + c, aIm);
+		}
+	}
+
+	for(int half = 1; half < n; half *= 2)
+	{
+		int twiddleStep = n / (2*half);
+		for(int block = 0; block < n; block += 2*half)
+		{
+			for(int k = 0; k < half; ++k)
+			{
+				XMVECTOR wRe = XMVectorReplicate(mTwiddleRe[k*twiddleStep]);
+				XMVECTOR wIm = XMVectorReplicate(mTwiddleIm[k*twiddleStep]);
+
+				float* aRe = re + (block + k)*n;
+				float* aIm = im + (block + k)*n;
+				float* bRe = re + (block + k + half)*n;
+				float* bIm = im + (block + k + half)*n;
+
+				for(int c = first; c < last; c += 4)
+				{
+					XMVECTOR xRe = LoadFloats(bRe + c);
+					XMVECTOR xIm = LoadFloats(bIm + c);
+					XMVECTOR tRe = wRe*xRe - wIm*xIm;
+					XMVECTOR tIm = wRe*xIm + wIm*xRe;
+
+					XMVECTOR yRe = LoadFloats(aRe + c);
+					XMVECTOR yIm = LoadFloats(aIm + c);
+					StoreFloats(aRe + c, yRe + tRe);
+					StoreFloats(aIm + c, yIm + tIm);
+					StoreFloats(bRe + c, yRe - tRe);
+					StoreFloats(bIm + c, yIm - tIm);
+				}
+			}
+		}
+	}
+}
+
+void OceanWaves::Transpose(const ComplexGrid& src, ComplexGrid& dst, int firstRow, int lastRow) const
+{
+	int n = mFftSize;
+	for(int r = firstRow; r < lastRow; r += 4)
+	{
+		for(int c = 0; c < n; c += 4)
+		{
+			XMMATRIX blockRe = XMMatrixTranspose(XMMATRIX(
+				LoadFloats(&src.Re[r*n + c]), LoadFloats(&src.Re[(r + 1)*n + c]),
+				LoadFloats(&src.Re[(r + 2)*n + c]), LoadFloats(&src.Re[(r + 3)*n + c])));
+			XMMATRIX blockIm = XMMatrixTranspose(XMMATRIX(
+				LoadFloats(&src.Im[r*n + c]), LoadFloats(&src.Im[(r + 1)*n + c]),
+				LoadFloats(&src.Im[(r + 2)*n + c]), LoadFloats(&src.Im[(r + 3)*n + c])));
+
+			for(int k = 0; k < 4; ++k)
+			{
+				StoreFloats(&dst.Re[(c + k)*n + r], blockRe.r[k]);
+				StoreFloats(&dst.Im[(c + k)*n + r], blockIm.r[k]);
+			}
+		}
+	}
+}
+
+void OceanWaves::BuildSurfaceRow(int i)
+{
+	const XMVECTOR One = XMVectorSplatOne();
+	const XMVECTOR Choppiness = XMVectorReplicate(mChoppiness);
+
+	int n = mFftSize;
+	int src = (i % n)*n;
+	int dst = i*mNumCols;
+
+	for(int j = 0; j < n; j += 4)
+	{
+		XMVECTOR h = LoadFloats(&mFields[0].Re[src + j]);
+		XMVECTOR slopeX = LoadFloats(&mFields[0].Im[src + j]);
+		XMVECTOR slopeZ = LoadFloats(&mFields[1].Re[src + j]);
+		XMVECTOR dispX = LoadFloats(&mFields[1].Im[src + j]);
+		XMVECTOR dispZ = LoadFloats(&mFields[2].Re[src + j]);
+
+		// n = (-dh/dx, 1, -dh/dz) and T = (1, dh/dx, 0), both normalized.
+		XMVECTOR slopeXSq = slopeX*slopeX;
+		XMVECTOR invLenN = XMVectorReciprocalSqrt(slopeXSq + One + slopeZ*slopeZ);
+		XMVECTOR invLenT = XMVectorReciprocalSqrt(slopeXSq + One);
+
+		StoreFloats(&mHeights[dst + j], h);
+		StoreFloats(&mDisplaceX[dst + j], Choppiness*dispX);
+		StoreFloats(&mDisplaceZ[dst + j], Choppiness*dispZ);
+		StoreFloats(&mNormalsX[dst + j], -slopeX*invLenN);
+		StoreFloats(&mNormalsY[dst + j], invLenN);
+		StoreFloats(&mNormalsZ[dst + j], -slopeZ*invLenN);
+		StoreFloats(&mTangentsX[dst + j], invLenT);
+		StoreFloats(&mTangentsY[dst + j], slopeX*invLenT);
+	}
+
+	// The last column repeats the first.
+	int last = dst + n;
+	mHeights[last] = mHeights[dst];
+	mDisplaceX[last] = mDisplaceX[dst];
+	mDisplaceZ[last] = mDisplaceZ[dst];
+	mNormalsX[last] = mNormalsX[dst];
+	mNormalsY[last] = mNormalsY[dst];
+	mNormalsZ[last] = mNormalsZ[dst];
+	mTangentsX[last] = mTangentsX[dst];
+	mTangentsY[last] = mTangentsY[dst];
+}
+
+void OceanWaves::WriteVertices(void* dst, const Waves::VertexLayout& layout) const
+{
+	std::uint8_t* base = static_cast<std::uint8_t*>(dst);
+
+	mScheduler->ParallelFor(0, mNumRows, 0, [&](int i)
+	{
+		for(int j = 0; j < mNumCols; ++j)
+		{
+			int k = i*mNumCols + j;
+			std::uint8_t* v = base + static_cast<size_t>(k)*layout.Stride;
+
+			if(layout.PositionOffset >= 0)
+			{
+				XMFLOAT3 p = Position(k);
+				std::memcpy(v + layout.PositionOffset, &p, sizeof(p));
+			}
+			if(layout.NormalOffset >= 0)
+			{
+				XMFLOAT3 nrm = Normal(k);
+				std::memcpy(v + layout.NormalOffset, &nrm, sizeof(nrm));
+			}
+			if(layout.TexCOffset >= 0)
+			{
+				XMFLOAT2 uv = TexC(k);
+				std::memcpy(v + layout.TexCOffset, &uv, sizeof(uv));
+			}
+			if(layout.TangentOffset >= 0)
+			{
+				XMFLOAT3 t = TangentX(k);
+				std::memcpy(v + layout.TangentOffset, &t, sizeof(t));
+			}
+		}
+	});
+}
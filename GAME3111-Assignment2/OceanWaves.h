@@ -0,0 +1,161 @@
+//***************************************************************************************
+// OceanWaves.h
+//
+// Spectral ocean surface in the style of Tessendorf's "Simulating Ocean Water".  A
+// Phillips spectrum of random wave amplitudes is set up once; every update advances
+// each wave by its deep water dispersion relation and transforms the spectrum back to
+// heights, slopes and horizontal (choppy) displacements with an inverse FFT.
+//
+// Unlike Waves there is no time stepping, so the cost does not depend on dt and the
+// surface can be evaluated at any time.  The result is periodic over the patch, so
+// patches tile seamlessly: the grid has N+1 vertices per side, and the last row and
+// column repeat the first.
+//
+// The vertex accessors match those of Waves, so code that reads a Waves solution can
+// read an OceanWaves one the same way.  Because the displacement moves x and z, there
+// is no compact vertex stream.
+//***************************************************************************************
+
+#ifndef OCEAN_WAVES_H
+#define OCEAN_WAVES_H
+
+#include "Waves.h"
+#include <vector>
+#include <DirectXMath.h>
+
+class TaskScheduler;
+
+class OceanWaves
+{
+public:
+	// n is the FFT size: a power of two, at least 4.  patchSize is the width of a
+	// (square) patch in world units.  windSpeed and windDirection drive the
+	// spectrum; amplitude is roughly the RMS wave height it produces.  choppiness
+	// scales the horizontal displacement (0 gives a plain height field).
+	OceanWaves(int n, float patchSize, float windSpeed, const DirectX::XMFLOAT2& windDirection,
+		float amplitude = 1.0f, float choppiness = 1.0f, unsigned seed = 1);
+	OceanWaves(const OceanWaves& rhs) = delete;
+	OceanWaves& operator=(const OceanWaves& rhs) = delete;
+	~OceanWaves();
+
+	int RowCount() const;
+	int ColumnCount() const;
+	int VertexCount() const;
+	int TriangleCount() const;
+	float Width() const;
+	float Depth() const;
+	float SpatialStep() const;
+
+	// Time the surface was last evaluated at.
+	float Time() const { return mTime; }
+
+	// Returns the displaced position of the ith grid point.
+	DirectX::XMFLOAT3 Position(int i) const
+	{
+		return DirectX::XMFLOAT3(
+			mColumnX[i % mNumCols] + mDisplaceX[i],
+			mHeights[i],
+			mRowZ[i / mNumCols] + mDisplaceZ[i]);
+	}
+
+	// Returns the texture coordinates at the ith grid point; [0,1] over a patch.
+	DirectX::XMFLOAT2 TexC(int i) const
+	{
+		return DirectX::XMFLOAT2(mColumnU[i % mNumCols], mRowV[i / mNumCols]);
+	}
+
+	float Height(int i) const { return mHeights[i]; }
+
+	DirectX::XMFLOAT3 Normal(int i) const
+	{
+		return DirectX::XMFLOAT3(mNormalsX[i], mNormalsY[i], mNormalsZ[i]);
+	}
+
+	DirectX::XMFLOAT3 TangentX(int i) const
+	{
+		return DirectX::XMFLOAT3(mTangentsX[i], mTangentsY[i], 0.0f);
+	}
+
+	// Runs the transforms on the given scheduler (the process-wide default if null).
+	void SetScheduler(TaskScheduler* scheduler);
+
+	// Advances the surface by dt seconds and re-evaluates it.
+	void Update(float dt);
+
+	// Evaluates the surface at the given time.
+	void Evaluate(float time);
+
+	// Same as Waves::WriteVertices.
+	void WriteVertices(void* dst, const Waves::VertexLayout& layout) const;
+
+private:
+	// A square complex grid stored as separate real and imaginary planes.
+	struct ComplexGrid
+	{
+		std::vector<float> Re;
+		std::vector<float> Im;
+	};
+
+	void BuildSpectrumRow(int m, float time);
+	void InverseFft(ComplexGrid& grid);
+	void FftColumns(ComplexGrid& grid, int first, int last) const;
+	void Transpose(const ComplexGrid& src, ComplexGrid& dst, int firstRow, int lastRow) const;
+	void BuildSurfaceRow(int i);
+
+private:
+	int mFftSize = 0;
+	int mLogFftSize = 0;
+
+	int mNumRows = 0;
+	int mNumCols = 0;
+
+	float mPatchSize = 0.0f;
+	float mChoppiness = 0.0f;
+	float mTime = 0.0f;
+
+	TaskScheduler* mScheduler = nullptr;
+
+	// Initial amplitudes h0(k) and conj(h0(-k)), the angular frequency w(k), the
+	// wave vector k and its direction k/|k| of every spectrum entry, row-major by
+	// (kz, kx) index.
+	std::vector<float> mH0Re;
+	std::vector<float> mH0Im;
+	std::vector<float> mH0MinusConjRe;
+	std::vector<float> mH0MinusConjIm;
+	std::vector<float> mOmega;
+	std::vector<float> mWaveX;
+	std::vector<float> mWaveZ;
+	std::vector<float> mWaveDirX;
+	std::vector<float> mWaveDirZ;
+
+	// Inverse FFT twiddles exp(2 pi i k / N) for k < N/2, and the bit-reversal
+	// permutation of a row index.
+	std::vector<float> mTwiddleRe;
+	std::vector<float> mTwiddleIm;
+	std::vector<int> mBitReverse;
+
+	// Two real fields are transformed per complex grid: height + i*slopeX,
+	// slopeZ + i*displaceX and displaceZ.
+	ComplexGrid mFields[3];
+	ComplexGrid mScratch;
+
+	float mHalfWidth = 0.0f;
+	float mHalfDepth = 0.0f;
+
+	std::vector<float> mColumnX;
+	std::vector<float> mColumnU;
+	std::vector<float> mRowZ;
+	std::vector<float> mRowV;
+
+	// The evaluated surface, one entry per grid vertex.
+	std::vector<float> mHeights;
+	std::vector<float> mDisplaceX;
+	std::vector<float> mDisplaceZ;
+	std::vector<float> mNormalsX;
+	std::vector<float> mNormalsY;
+	std::vector<float> mNormalsZ;
+	std::vector<float> mTangentsX;
+	std::vector<float> mTangentsY;
+};
+
+#endif // OCEAN_WAVES_H
@@ -78,9 +78,17 @@ cbuffer cbMaterial : register(b2)
 
 struct VertexIn
 {
+#ifdef COMPACT_WAVES
+	// Slot 0: per-frame height and octahedral normal; slot 1: static grid x/z and tex-coords.
+	float  Height    : HEIGHT;
+	float2 NormalOct : NORMAL;
+	float2 PosXZ     : POSITION;
+	float2 TexC      : TEXCOORD;
+#else
 	float3 PosL    : POSITION;
     float3 NormalL : NORMAL;
 	float2 TexC    : TEXCOORD;
+#endif
 };
 
 struct VertexOut
@@ -91,16 +99,35 @@ struct VertexOut
 	float2 TexC    : TEXCOORD;
 };
 
+#ifdef COMPACT_WAVES
+// Inverse of the octahedral encoding in Waves::EncodeCompact (folded about y).
+float3 OctDecode(float2 e)
+{
+	float3 n = float3(e.x, 1.0f - abs(e.x) - abs(e.y), e.y);
+	if(n.y < 0.0f)
+		n.xz = (1.0f - abs(e.yx)) * (e >= 0.0f ? 1.0f : -1.0f);
+	return normalize(n);
+}
+#endif
+
 VertexOut VS(VertexIn vin)
 {
 	VertexOut vout = (VertexOut)0.0f;
+
+#ifdef COMPACT_WAVES
+	float3 PosL = float3(vin.PosXZ.x, vin.Height, vin.PosXZ.y);
+	float3 NormalL = OctDecode(vin.NormalOct);
+#else
+	float3 PosL = vin.PosL;
+	float3 NormalL = vin.NormalL;
+#endif
 	
     // Transform to world space.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(PosL, 1.0f), gWorld);
     vout.PosW = posW.xyz;
 
     // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-    vout.NormalW = mul(vin.NormalL, (float3x3)gWorld);
+    vout.NormalW = mul(NormalL, (float3x3)gWorld);
 
     // Transform to homogeneous clip space.
     vout.PosH = mul(posW, gViewProj);
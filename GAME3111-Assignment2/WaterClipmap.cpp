@@ -0,0 +1,347 @@
+//***************************************************************************************
+// WaterClipmap.cpp
+//***************************************************************************************
+
+#include "WaterClipmap.h"
+#include "../Common/TaskScheduler.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	// Largest multiple of step that is <= f.
+	inline int FloorToMultiple(float f, int step)
+	{
+		return static_cast<int>(floorf(f / step))*step;
+	}
+
+	inline int Wrap(int i, int count)
+	{
+		i %= count;
+		return i < 0 ? i + count : i;
+	}
+}
+
+WaterClipmap::WaterClipmap(int levelCount, int ringSize)
+{
+	assert(levelCount >= 1 && ringSize >= 1);
+
+	mLevelCount = levelCount;
+	mRingSize = ringSize;
+	mLevelSize = 4*ringSize + 1;
+	mScheduler = &TaskScheduler::Default();
+
+	mMips.resize(levelCount);
+	mLevelRow.assign(levelCount, 0);
+	mLevelCol.assign(levelCount, 0);
+
+	BuildIndices();
+
+	// Flat water until a source is set.
+	float flat = 0.0f;
+	SetSource(&flat, 1, 1, 1.0f, false);
+	Recenter(0.0f, 0.0f);
+}
+
+WaterClipmap::~WaterClipmap()
+{
+}
+
+void WaterClipmap::SetScheduler(TaskScheduler* scheduler)
+{
+	mScheduler = scheduler != nullptr ? scheduler : &TaskScheduler::Default();
+}
+
+void WaterClipmap::BuildIndices()
+{
+	const int n = mLevelSize;
+	const int cells = n - 1;
+	const int holeCells = cells / 2;
+
+	mIndices.clear();
+
+	// Corners are given clockwise seen from above (TL, TR, BR, BL), matching the
+	// winding of the Waves grid.
+	auto emitCell = [this](const std::uint32_t corners[4])
+	{
+		mIndices.push_back(corners[0]);
+		mIndices.push_back(corners[1]);
+		mIndices.push_back(corners[3]);
+
+		mIndices.push_back(corners[3]);
+		mIndices.push_back(corners[1]);
+		mIndices.push_back(corners[2]);
+	};
+
+	// A cell with an extra vertex in the middle of side s (the side from
+	// corners[s] to corners[s+1]) is drawn as a fan around that vertex.
+	auto emitStitchedCell = [this](const std::uint32_t corners[4], int s, std::uint32_t mid)
+	{
+		for(int t = 1; t <= 3; ++t)
+		{
+			mIndices.push_back(mid);
+			mIndices.push_back(corners[(s + t) % 4]);
+			mIndices.push_back(corners[(s + t + 1) % 4]);
+		}
+	};
+
+	//
+	// Level 0 is the whole grid.
+	//
+
+	for(int a = 0; a < cells; ++a)
+	{
+		for(int b = 0; b < cells; ++b)
+		{
+			std::uint32_t corners[4] =
+			{
+				static_cast<std::uint32_t>(a*n + b),
+				static_cast<std::uint32_t>(a*n + b + 1),
+				static_cast<std::uint32_t>((a + 1)*n + b + 1),
+				static_cast<std::uint32_t>((a + 1)*n + b)
+			};
+			emitCell(corners);
+		}
+	}
+	mGridIndexCount = static_cast<int>(mIndices.size());
+
+	//
+	// Rings, one for each position of the hole.  Relative to the base vertex of
+	// the finer level, its vertices are [0, n*n) and the ring's are [n*n, 2*n*n).
+	//
+
+	for(int v = 0; v < 4; ++v)
+	{
+		const int holeRow = mRingSize + v / 2;
+		const int holeCol = mRingSize + v % 2;
+
+		// Ring vertex (a, b), or the finer level's vertex at the same spot when
+		// it lies on the edge of the hole.
+		auto vertex = [=](int a, int b)
+		{
+			int fa = a - holeRow;
+			int fb = b - holeCol;
+			if(fa >= 0 && fa <= holeCells && fb >= 0 && fb <= holeCells)
+				return static_cast<std::uint32_t>(2*fa*n + 2*fb);
+			return static_cast<std::uint32_t>(n*n + a*n + b);
+		};
+
+		auto fine = [=](int fa, int fb)
+		{
+			return static_cast<std::uint32_t>(fa*n + fb);
+		};
+
+		mRingIndexStart[v] = static_cast<int>(mIndices.size());
+
+		for(int a = 0; a < cells; ++a)
+		{
+			int ra = a - holeRow;
+			bool inHoleRows = ra >= 0 && ra < holeCells;
+
+			for(int b = 0; b < cells; ++b)
+			{
+				int rb = b - holeCol;
+				bool inHoleCols = rb >= 0 && rb < holeCells;
+
+				if(inHoleRows && inHoleCols)
+					continue;
+
+				std::uint32_t corners[4] = { vertex(a, b), vertex(a, b + 1), vertex(a + 1, b + 1), vertex(a + 1, b) };
+
+				// Cells along the hole pick up the finer vertex halfway along
+				// their shared side.
+				if(inHoleCols && ra == -1)
+					emitStitchedCell(corners, 2, fine(0, 2*rb + 1));
+				else if(inHoleCols && ra == holeCells)
+					emitStitchedCell(corners, 0, fine(cells, 2*rb + 1));
+				else if(inHoleRows && rb == -1)
+					emitStitchedCell(corners, 1, fine(2*ra + 1, 0));
+				else if(inHoleRows && rb == holeCells)
+					emitStitchedCell(corners, 3, fine(2*ra + 1, cells));
+				else
+					emitCell(corners);
+			}
+		}
+
+		mRingIndexCount[v] = static_cast<int>(mIndices.size()) - mRingIndexStart[v];
+	}
+}
+
+void WaterClipmap::SetSource(const float* heights, int rows, int cols, float spacing, bool tileable)
+{
+	mSpacing = spacing;
+	mSourceRows = rows;
+	mSourceCols = cols;
+	mTileable = tileable && rows > 1 && cols > 1;
+
+	// A tileable source's last row and column repeat the first, so leave them out.
+	Mip& base = mMips[0];
+	base.Rows = mTileable ? rows - 1 : rows;
+	base.Cols = mTileable ? cols - 1 : cols;
+	base.Heights.resize(base.Rows*base.Cols);
+	for(int r = 0; r < base.Rows; ++r)
+		std::memcpy(&base.Heights[r*base.Cols], heights + r*cols, base.Cols*sizeof(float));
+
+	// Downsample for as many levels as the source allows; coarser levels keep
+	// reading the last mip.
+	mMipCount = 1;
+	while(mMipCount < mLevelCount)
+	{
+		const Mip& src = mMips[mMipCount - 1];
+		bool canHalve = mTileable ?
+			src.Rows % 2 == 0 && src.Cols % 2 == 0 && src.Rows >= 2 && src.Cols >= 2 :
+			src.Rows >= 3 && src.Cols >= 3;
+		if(!canHalve)
+			break;
+
+		BuildMip(src, mMips[mMipCount]);
+		++mMipCount;
+	}
+}
+
+void WaterClipmap::BuildMip(const Mip& src, Mip& dst) const
+{
+	dst.Rows = mTileable ? src.Rows / 2 : (src.Rows - 1) / 2 + 1;
+	dst.Cols = mTileable ? src.Cols / 2 : (src.Cols - 1) / 2 + 1;
+	dst.Heights.resize(dst.Rows*dst.Cols);
+
+	// 1-2-1 tent filter centred on every second source point.
+	static const float Weights[3] = { 0.25f, 0.5f, 0.25f };
+
+	mScheduler->ParallelFor(0, dst.Rows, 0, [&](int r)
+	{
+		for(int c = 0; c < dst.Cols; ++c)
+		{
+			float sum = 0.0f;
+			for(int dr = -1; dr <= 1; ++dr)
+				for(int dc = -1; dc <= 1; ++dc)
+					sum += Weights[dr + 1]*Weights[dc + 1]*SampleHeight(src, 2*r + dr, 2*c + dc);
+
+			dst.Heights[r*dst.Cols + c] = sum;
+		}
+	});
+}
+
+float WaterClipmap::SampleHeight(const Mip& mip, int r, int c) const
+{
+	if(mTileable)
+	{
+		r = Wrap(r, mip.Rows);
+		c = Wrap(c, mip.Cols);
+	}
+	else if(r < 0 || r >= mip.Rows || c < 0 || c >= mip.Cols)
+	{
+		return 0.0f;
+	}
+
+	return mip.Heights[r*mip.Cols + c];
+}
+
+void WaterClipmap::Recenter(float eyeX, float eyeZ)
+{
+	// Eye position in source grid coordinates, kept well inside int range.
+	const float Limit = 1.0e7f;
+	float eyeCol = ((eyeX + 0.5f*(mSourceCols - 1)*mSpacing) / mSpacing);
+	float eyeRow = ((0.5f*(mSourceRows - 1)*mSpacing - eyeZ) / mSpacing);
+	eyeCol = std::min(std::max(eyeCol, -Limit), Limit);
+	eyeRow = std::min(std::max(eyeRow, -Limit), Limit);
+
+	// Each level's centre snaps to twice its spacing, which keeps every level's
+	// vertices on the grid of the level outside it.
+	for(int l = 0; l < mLevelCount; ++l)
+	{
+		int step = 1 << l;
+		mLevelRow[l] = FloorToMultiple(eyeRow, 2*step) - 2*mRingSize*step;
+		mLevelCol[l] = FloorToMultiple(eyeCol, 2*step) - 2*mRingSize*step;
+	}
+}
+
+WaterClipmap::LevelDrawArgs WaterClipmap::DrawArgs(int level) const
+{
+	LevelDrawArgs args;
+	if(level == 0)
+	{
+		args.IndexCount = mGridIndexCount;
+		return args;
+	}
+
+	// Where the finer level sits inside this one, in this level's cells.
+	int step = 1 << level;
+	int holeRow = (mLevelRow[level - 1] - mLevelRow[level]) / step;
+	int holeCol = (mLevelCol[level - 1] - mLevelCol[level]) / step;
+	int v = (holeRow - mRingSize)*2 + (holeCol - mRingSize);
+	assert(v >= 0 && v < 4);
+
+	args.IndexCount = mRingIndexCount[v];
+	args.StartIndexLocation = mRingIndexStart[v];
+	args.BaseVertexLocation = (level - 1)*LevelVertexCount();
+	return args;
+}
+
+void WaterClipmap::WriteVertices(void* dst, const Waves::VertexLayout& layout) const
+{
+	std::uint8_t* base = static_cast<std::uint8_t*>(dst);
+
+	mScheduler->ParallelFor(0, mLevelCount*mLevelSize, 0, [&](int row)
+	{
+		WriteLevelRow(base, layout, row / mLevelSize, row % mLevelSize);
+	});
+}
+
+void WaterClipmap::WriteLevelRow(std::uint8_t* base, const Waves::VertexLayout& layout, int level, int a) const
+{
+	const int n = mLevelSize;
+	const int step = 1 << level;
+
+	// Level vertices are multiples of 2^level source points apart, so they fall
+	// exactly on texels of the matching mip.
+	const int mipLevel = std::min(level, mMipCount - 1);
+	const Mip& mip = mMips[mipLevel];
+	const int mipScale = 1 << mipLevel;
+	const float texelSize = mSpacing*mipScale;
+
+	const float originX = -0.5f*(mSourceCols - 1)*mSpacing;
+	const float originZ = 0.5f*(mSourceRows - 1)*mSpacing;
+	const float width = mSourceCols*mSpacing;
+	const float depth = mSourceRows*mSpacing;
+
+	int row = mLevelRow[level] + a*step;
+	int mr = row / mipScale;
+	float z = originZ - row*mSpacing;
+
+	std::uint8_t* v = base + static_cast<size_t>(level*n*n + a*n)*layout.Stride;
+	for(int b = 0; b < n; ++b, v += layout.Stride)
+	{
+		int col = mLevelCol[level] + b*step;
+		int mc = col / mipScale;
+		float x = originX + col*mSpacing;
+
+		if(layout.PositionOffset >= 0)
+		{
+			XMFLOAT3 p(x, SampleHeight(mip, mr, mc), z);
+			std::memcpy(v + layout.PositionOffset, &p, sizeof(p));
+		}
+		if(layout.NormalOffset >= 0)
+		{
+			// Same finite differences as Waves, one texel of the mip apart.
+			float l = SampleHeight(mip, mr, mc - 1);
+			float r = SampleHeight(mip, mr, mc + 1);
+			float t = SampleHeight(mip, mr - 1, mc);
+			float d = SampleHeight(mip, mr + 1, mc);
+
+			XMFLOAT3 normal;
+			XMStoreFloat3(&normal, XMVector3Normalize(XMVectorSet(l - r, 2.0f*texelSize, d - t, 0.0f)));
+			std::memcpy(v + layout.NormalOffset, &normal, sizeof(normal));
+		}
+		if(layout.TexCOffset >= 0)
+		{
+			// Same mapping as Waves, continued past the source.
+			XMFLOAT2 uv(0.5f + x / width, 0.5f - z / depth);
+			std::memcpy(v + layout.TexCOffset, &uv, sizeof(uv));
+		}
+	}
+}
@@ -0,0 +1,123 @@
+//***************************************************************************************
+// WaterClipmap.h
+//
+// Renders a water height field as nested square levels centred on the eye.  Level 0
+// samples the source at full resolution; every further level has twice the spacing of
+// the one inside it and samples a correspondingly downsampled copy of the source, so
+// the vertex count stays fixed no matter how far out the water reaches.
+//
+// Every level is a (4k+1)x(4k+1) vertex grid.  Level 0 is drawn whole; the others are
+// drawn as rings around the hole covered by the next finer level.  The ring triangles
+// along the hole use the finer level's edge vertices, so there are no T-junctions or
+// cracks between levels.  Levels snap to multiples of twice their own spacing, which
+// leaves the hole at one of four offsets; the index buffer holds a ring for each.
+//
+// The source is any row-major height grid laid out like Waves: row i at
+// z = (rows-1)*dx/2 - i*dx, column j at x = -(cols-1)*dx/2 + j*dx.  Outside the
+// grid the water is flat, unless the source is tileable.
+//***************************************************************************************
+
+#ifndef WATER_CLIPMAP_H
+#define WATER_CLIPMAP_H
+
+#include "Waves.h"
+#include <cstdint>
+#include <vector>
+
+class TaskScheduler;
+
+class WaterClipmap
+{
+public:
+	// Index range to draw one level with.
+	struct LevelDrawArgs
+	{
+		int IndexCount = 0;
+		int StartIndexLocation = 0;
+		int BaseVertexLocation = 0;
+	};
+
+	// levelCount levels of (4*ringSize + 1)^2 vertices each.
+	WaterClipmap(int levelCount, int ringSize);
+	WaterClipmap(const WaterClipmap& rhs) = delete;
+	WaterClipmap& operator=(const WaterClipmap& rhs) = delete;
+	~WaterClipmap();
+
+	int LevelCount() const { return mLevelCount; }
+	int LevelVertexCount() const { return mLevelSize*mLevelSize; }
+	int VertexCount() const { return mLevelCount*LevelVertexCount(); }
+
+	// Static index buffer shared by all levels; see LevelDrawArgs for the
+	// ranges to draw.
+	const std::vector<std::uint32_t>& Indices() const { return mIndices; }
+
+	void SetScheduler(TaskScheduler* scheduler);
+
+	// Copies the heights of a Waves (or OceanWaves) and rebuilds the downsampled
+	// copies.  A tileable source repeats its first row and column as its last.
+	template <typename Surface>
+	void SetSource(const Surface& surface, bool tileable)
+	{
+		mSourceCopy.resize(surface.VertexCount());
+		for(int i = 0; i < surface.VertexCount(); ++i)
+			mSourceCopy[i] = surface.Height(i);
+
+		SetSource(&mSourceCopy[0], surface.RowCount(), surface.ColumnCount(),
+			surface.SpatialStep(), tileable);
+	}
+
+	void SetSource(const float* heights, int rows, int cols, float spacing, bool tileable);
+
+	// Centres the levels on the eye position (world x/z).
+	void Recenter(float eyeX, float eyeZ);
+
+	// Draw arguments of the given level for the current centre.
+	LevelDrawArgs DrawArgs(int level) const;
+
+	// Writes all VertexCount() vertices, level after level, in the given layout
+	// (tangents are not written).
+	void WriteVertices(void* dst, const Waves::VertexLayout& layout) const;
+
+private:
+	// One downsampled copy of the source.  Texel (r, c) of mip m lies on source
+	// grid point (r*2^m, c*2^m).
+	struct Mip
+	{
+		int Rows = 0;
+		int Cols = 0;
+		std::vector<float> Heights;
+	};
+
+	void BuildIndices();
+	void BuildMip(const Mip& src, Mip& dst) const;
+	float SampleHeight(const Mip& mip, int r, int c) const;
+	void WriteLevelRow(std::uint8_t* dst, const Waves::VertexLayout& layout, int level, int a) const;
+
+private:
+	int mLevelCount = 0;
+	int mRingSize = 0;
+	int mLevelSize = 0;
+
+	TaskScheduler* mScheduler = nullptr;
+
+	std::vector<std::uint32_t> mIndices;
+	int mGridIndexCount = 0;
+	int mRingIndexStart[4];
+	int mRingIndexCount[4];
+
+	// Source grid, as rows x cols points dx apart.  A tileable source repeats
+	// every rows-1 by cols-1 points.
+	std::vector<float> mSourceCopy;
+	std::vector<Mip> mMips;
+	int mMipCount = 0;
+	float mSpacing = 1.0f;
+	int mSourceRows = 0;
+	int mSourceCols = 0;
+	bool mTileable = false;
+
+	// Source grid coordinates of the first vertex of each level.
+	std::vector<int> mLevelRow;
+	std::vector<int> mLevelCol;
+};
+
+#endif // WATER_CLIPMAP_H
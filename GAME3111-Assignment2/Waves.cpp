@@ -3,13 +3,386 @@
 //***************************************************************************************
 
 #include "Waves.h"
-#include <ppl.h>
+#include "../Common/TaskScheduler.h"
 #include <algorithm>
+#include <chrono>
 #include <vector>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 
 using namespace DirectX;
 
+namespace
+{
+	// Number of consecutive quiet steps before a tile is put to sleep.
+	const int SleepDelaySteps = 8;
+
+	// Batched splats are binned into tiles of this many grid points on a side
+	// (outside sparse mode, which bins by its own tiles), and cut off at
+	// SplatCutoff standard deviations.  Radii below MinSplatRadius grid steps
+	// are raised to it, so even a point impulse reaches the nearest grid point.
+	const int SplatTileSize = 32;
+	const float SplatCutoff = 3.0f;
+	const float MinSplatRadius = 0.25f;
+
+	// Surface queries are handed out in chunks of this many points, so small
+	// batches run on the calling thread.
+	const int SampleGrainSize = 1024;
+
+	// Most steps Update takes to catch up with the clock; any further backlog
+	// is dropped.
+	const int MaxCatchUpSteps = 4;
+
+	// Adds its own lifetime to a nanosecond counter.
+	class ScopedTimer
+	{
+	public:
+		explicit ScopedTimer(std::int64_t& total)
+			: mTotal(total), mStart(std::chrono::steady_clock::now())
+		{
+		}
+
+		~ScopedTimer()
+		{
+			mTotal += std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - mStart).count();
+		}
+
+	private:
+		std::int64_t& mTotal;
+		std::chrono::steady_clock::time_point mStart;
+	};
+
+	inline XMVECTOR LoadFloats(const float* p)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+	}
+
+	inline void StoreFloats(float* p, FXMVECTOR v)
+	{
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p), v);
+	}
+
+	// Widens the range [first, last) to cover [f, l); empty ranges (first >= last)
+	// are ignored on either side.
+	inline void GrowRange(int& first, int& last, int f, int l)
+	{
+		if(f >= l)
+			return;
+
+		if(first >= last)
+		{
+			first = f;
+			last = l;
+		}
+		else
+		{
+			first = std::min(first, f);
+			last = std::max(last, l);
+		}
+	}
+
+	// Loads p[index[k] + offset] into lane k.
+	inline XMVECTOR GatherFloats(const float* p, const uint32_t index[4], int offset)
+	{
+		return XMVectorSet(p[index[0] + offset], p[index[1] + offset],
+			p[index[2] + offset], p[index[3] + offset]);
+	}
+
+	// Bilinear blend of the four corners gathered around each lane's cell.
+	inline XMVECTOR GatherBilinear(const float* p, const uint32_t index[4], int rowPitch,
+		FXMVECTOR fx, FXMVECTOR fz)
+	{
+		XMVECTOR top = XMVectorLerpV(GatherFloats(p, index, 0), GatherFloats(p, index, 1), fx);
+		XMVECTOR bottom = XMVectorLerpV(GatherFloats(p, index, rowPitch), GatherFloats(p, index, rowPitch + 1), fx);
+		return XMVectorLerpV(top, bottom, fz);
+	}
+
+	// Applies the stencil to count consecutive points of one row, four at a time.
+	// prev is overwritten in place with the new solution; curr, up and down are
+	// the current solution on this row and the rows above and below.  All
+	// pointers are offset to the first point to update.  [changedFirst,
+	// changedLast) is set to cover the points whose height changed, rounded out
+	// to groups of four.
+	void UpdateRow(float* prev, const float* curr, const float* up, const float* down,
+		int count, float k1, float k2, float k3, int& changedFirst, int& changedLast)
+	{
+		changedFirst = changedLast = 0;
+
+		const XMVECTOR K1 = XMVectorReplicate(k1);
+		const XMVECTOR K2 = XMVectorReplicate(k2);
+		const XMVECTOR K3 = XMVectorReplicate(k3);
+
+		int j = 0;
+		for(; j + 4 <= count; j += 4)
+		{
+			XMVECTOR p = LoadFloats(prev + j);
+			XMVECTOR c = LoadFloats(curr + j);
+			XMVECTOR d = LoadFloats(down + j);
+			XMVECTOR u = LoadFloats(up + j);
+			XMVECTOR r = LoadFloats(curr + j + 1);
+			XMVECTOR l = LoadFloats(curr + j - 1);
+
+			XMVECTOR h = K1*p + K2*c + K3*(d + u + r + l);
+			StoreFloats(prev + j, h);
+
+			if(XMVector4NotEqual(h, c))
+				GrowRange(changedFirst, changedLast, j, j + 4);
+		}
+
+		for(; j < count; ++j)
+		{
+			float h = k1*prev[j] + k2*curr[j] + k3*(down[j] + up[j] + curr[j+1] + curr[j-1]);
+			if(h != curr[j])
+				GrowRange(changedFirst, changedLast, j, j + 1);
+			prev[j] = h;
+		}
+	}
+
+	// Same as UpdateRow, but also returns the largest new |height| and the largest
+	// |new - current| (the velocity times dt) over the points updated.
+	void UpdateRowTracked(float* prev, const float* curr, const float* up, const float* down,
+		int count, float k1, float k2, float k3, int& changedFirst, int& changedLast,
+		float& maxHeight, float& maxVelocity)
+	{
+		changedFirst = changedLast = 0;
+
+		const XMVECTOR K1 = XMVectorReplicate(k1);
+		const XMVECTOR K2 = XMVectorReplicate(k2);
+		const XMVECTOR K3 = XMVectorReplicate(k3);
+
+		XMVECTOR maxH = XMVectorZero();
+		XMVECTOR maxV = XMVectorZero();
+
+		int j = 0;
+		for(; j + 4 <= count; j += 4)
+		{
+			XMVECTOR p = LoadFloats(prev + j);
+			XMVECTOR c = LoadFloats(curr + j);
+			XMVECTOR d = LoadFloats(down + j);
+			XMVECTOR u = LoadFloats(up + j);
+			XMVECTOR r = LoadFloats(curr + j + 1);
+			XMVECTOR l = LoadFloats(curr + j - 1);
+
+			XMVECTOR h = K1*p + K2*c + K3*(d + u + r + l);
+			StoreFloats(prev + j, h);
+
+			maxH = XMVectorMax(maxH, XMVectorAbs(h));
+			maxV = XMVectorMax(maxV, XMVectorAbs(h - c));
+
+			if(XMVector4NotEqual(h, c))
+				GrowRange(changedFirst, changedLast, j, j + 4);
+		}
+
+		XMFLOAT4 lanesH, lanesV;
+		XMStoreFloat4(&lanesH, maxH);
+		XMStoreFloat4(&lanesV, maxV);
+		float mh = std::max(std::max(lanesH.x, lanesH.y), std::max(lanesH.z, lanesH.w));
+		float mv = std::max(std::max(lanesV.x, lanesV.y), std::max(lanesV.z, lanesV.w));
+
+		for(; j < count; ++j)
+		{
+			float h = k1*prev[j] + k2*curr[j] + k3*(down[j] + up[j] + curr[j+1] + curr[j-1]);
+			mh = std::max(mh, fabsf(h));
+			mv = std::max(mv, fabsf(h - curr[j]));
+			if(h != curr[j])
+				GrowRange(changedFirst, changedLast, j, j + 1);
+			prev[j] = h;
+		}
+
+		maxHeight = std::max(maxHeight, mh);
+		maxVelocity = std::max(maxVelocity, mv);
+	}
+
+	// Writes count packed {Position, Normal, TexC} vertices of one grid row.  Four
+	// vertices at a time, the per-attribute arrays are transposed into per-vertex
+	// halves [x y z nx] [ny nz u v].  Upload heaps are write-combined memory that
+	// the CPU never reads back, so when the destination is 16-byte aligned the
+	// halves are written with non-temporal stores.
+	void WritePackedRow(float* out, int count, const float* x, const float* u, float z, float v,
+		const float* h, const float* nx, const float* ny, const float* nz)
+	{
+		const XMVECTOR Z = XMVectorReplicate(z);
+		const XMVECTOR V = XMVectorReplicate(v);
+
+#if defined(_XM_SSE_INTRINSICS_)
+		bool stream = (reinterpret_cast<std::uintptr_t>(out) & 15) == 0;
+#endif
+
+		int j = 0;
+		for(; j + 4 <= count; j += 4, out += 32)
+		{
+			XMMATRIX lo = XMMatrixTranspose(XMMATRIX(
+				LoadFloats(x + j), LoadFloats(h + j), Z, LoadFloats(nx + j)));
+			XMMATRIX hi = XMMatrixTranspose(XMMATRIX(
+				LoadFloats(ny + j), LoadFloats(nz + j), LoadFloats(u + j), V));
+
+#if defined(_XM_SSE_INTRINSICS_)
+			if(stream)
+			{
+				for(int k = 0; k < 4; ++k)
+				{
+					_mm_stream_ps(out + 8*k, lo.r[k]);
+					_mm_stream_ps(out + 8*k + 4, hi.r[k]);
+				}
+				continue;
+			}
+#endif
+			for(int k = 0; k < 4; ++k)
+			{
+				StoreFloats(out + 8*k, lo.r[k]);
+				StoreFloats(out + 8*k + 4, hi.r[k]);
+			}
+		}
+
+		for(; j < count; ++j, out += 8)
+		{
+			StoreFloats(out, XMVectorSet(x[j], h[j], z, nx[j]));
+			StoreFloats(out + 4, XMVectorSet(ny[j], nz[j], u[j], v));
+		}
+
+#if defined(_XM_SSE_INTRINSICS_)
+		// Non-temporal stores are weakly ordered; make them visible before the
+		// caller hands the buffer to the GPU.
+		_mm_sfence();
+#endif
+	}
+
+	// Octahedral-encodes count unit normals of one row into the NormalOct of the
+	// compact vertices, four at a time: project onto |x|+|y|+|z| = 1, fold the
+	// lower hemisphere over the diagonals and quantize x/z to snorm16.  Each step
+	// is the lane-wise equivalent of Waves::EncodeCompact.
+	void EncodeNormalRow(Waves::CompactVertex* out, int count,
+		const float* nx, const float* ny, const float* nz)
+	{
+		const XMVECTOR One = XMVectorSplatOne();
+		const XMVECTOR NegOne = XMVectorNegate(One);
+		const XMVECTOR ShortMax = XMVectorReplicate(32767.0f);
+		const XMVECTOR SignMask = XMVectorSplatSignMask();
+
+		int j = 0;
+		for(; j + 4 <= count; j += 4)
+		{
+			XMVECTOR x = LoadFloats(nx + j);
+			XMVECTOR y = LoadFloats(ny + j);
+			XMVECTOR z = LoadFloats(nz + j);
+
+			XMVECTOR sum = XMVectorAbs(x) + XMVectorAbs(y) + XMVectorAbs(z);
+			XMVECTOR u = x / sum;
+			XMVECTOR v = z / sum;
+
+			XMVECTOR foldU = XMVectorOrInt(XMVectorAndInt(u, SignMask), One - XMVectorAbs(v));
+			XMVECTOR foldV = XMVectorOrInt(XMVectorAndInt(v, SignMask), One - XMVectorAbs(u));
+			XMVECTOR lower = XMVectorLess(y, XMVectorZero());
+			u = XMVectorSelect(u, foldU, lower);
+			v = XMVectorSelect(v, foldV, lower);
+
+			XMVECTOR qu = XMVectorRound(XMVectorClamp(u, NegOne, One)*ShortMax);
+			XMVECTOR qv = XMVectorRound(XMVectorClamp(v, NegOne, One)*ShortMax);
+
+			std::uint32_t iu[4];
+			std::uint32_t iv[4];
+			XMStoreInt4(iu, XMConvertVectorFloatToInt(qu, 0));
+			XMStoreInt4(iv, XMConvertVectorFloatToInt(qv, 0));
+
+			for(int k = 0; k < 4; ++k)
+			{
+				out[j + k].NormalOct.x = static_cast<std::int16_t>(iu[k]);
+				out[j + k].NormalOct.y = static_cast<std::int16_t>(iv[k]);
+			}
+		}
+
+		for(; j < count; ++j)
+		{
+			out[j].NormalOct = Waves::EncodeCompact(0.0f, XMFLOAT3(nx[j], ny[j], nz[j])).NormalOct;
+		}
+	}
+
+	// Adds scale*weights[j] to the count heights of one row, four at a time.
+	void AddScaledRow(float* heights, const float* weights, float scale, int count)
+	{
+		const XMVECTOR Scale = XMVectorReplicate(scale);
+
+		int j = 0;
+		for(; j + 4 <= count; j += 4)
+		{
+			StoreFloats(heights + j, XMVectorMultiplyAdd(Scale, LoadFloats(weights + j), LoadFloats(heights + j)));
+		}
+
+		for(; j < count; ++j)
+		{
+			heights[j] += scale*weights[j];
+		}
+	}
+
+	// Rounds f up/down and clamps it to [lo, hi] before converting, so positions
+	// far outside the grid cannot overflow the int.
+	inline int CeilIndex(float f, int lo, int hi)
+	{
+		return static_cast<int>(std::min(std::max(ceilf(f), static_cast<float>(lo)), static_cast<float>(hi)));
+	}
+
+	inline int FloorIndex(float f, int lo, int hi)
+	{
+		return static_cast<int>(std::min(std::max(floorf(f), static_cast<float>(lo)), static_cast<float>(hi)));
+	}
+
+	// Maps an interior row/column index to the tile row/column containing it.
+	inline int TileIndexOf(int index, int tileSize, int tileCount)
+	{
+		return std::min(std::max((index - 1) / tileSize, 0), tileCount - 1);
+	}
+
+	// Computes the finite difference normals and x-tangents for count consecutive
+	// points of one row, four at a time.  Pointers are offset as in UpdateRow.
+	void ComputeNormalRow(const float* curr, const float* up, const float* down, int count,
+		float twoDx, float* nx, float* ny, float* nz, float* tx, float* ty)
+	{
+		const XMVECTOR TwoDx = XMVectorReplicate(twoDx);
+		const XMVECTOR TwoDxSq = XMVectorReplicate(twoDx*twoDx);
+
+		int j = 0;
+		for(; j + 4 <= count; j += 4)
+		{
+			XMVECTOR l = LoadFloats(curr + j - 1);
+			XMVECTOR r = LoadFloats(curr + j + 1);
+			XMVECTOR t = LoadFloats(up + j);
+			XMVECTOR b = LoadFloats(down + j);
+
+			// n = (l-r, 2dx, b-t) and T = (2dx, r-l, 0), both normalized.
+			XMVECTOR x = l - r;
+			XMVECTOR z = b - t;
+			XMVECTOR xSq = x*x;
+
+			XMVECTOR invLenN = XMVectorReciprocalSqrt(xSq + TwoDxSq + z*z);
+			XMVECTOR invLenT = XMVectorReciprocalSqrt(TwoDxSq + xSq);
+
+			StoreFloats(nx + j, x*invLenN);
+			StoreFloats(ny + j, TwoDx*invLenN);
+			StoreFloats(nz + j, z*invLenN);
+			StoreFloats(tx + j, TwoDx*invLenT);
+			StoreFloats(ty + j, -x*invLenT);
+		}
+
+		for(; j < count; ++j)
+		{
+			float x = curr[j-1] - curr[j+1];
+			float z = down[j] - up[j];
+
+			float invLenN = 1.0f / sqrtf(x*x + twoDx*twoDx + z*z);
+			float invLenT = 1.0f / sqrtf(twoDx*twoDx + x*x);
+
+			nx[j] = x*invLenN;
+			ny[j] = twoDx*invLenN;
+			nz[j] = z*invLenN;
+			tx[j] = twoDx*invLenT;
+			ty[j] = -x*invLenT;
+		}
+	}
+}
+
 Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 {
     mNumRows = m;
@@ -27,34 +400,55 @@ Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
     mK2 = (4.0f - 8.0f*e) / d;
     mK3 = (2.0f*e) / d;
 
-    mPrevSolution.resize(m*n);
-    mCurrSolution.resize(m*n);
-    mNormals.resize(m*n);
-    mTangentX.resize(m*n);
+    mHalfWidth = (n - 1)*dx*0.5f;
+    mHalfDepth = (m - 1)*dx*0.5f;
 
-    // Generate grid vertices in system memory.
+    // The x- and z-coordinates of the grid vertices (and the tex-coords derived
+    // from them by mapping [-w/2,w/2] --> [0,1]) only depend on the column and
+    // row, so they are stored once per column/row rather than per vertex.
+    mColumnX.resize(n);
+    mColumnU.resize(n);
+    for(int j = 0; j < n; ++j)
+    {
+        mColumnX[j] = -mHalfWidth + j*dx;
+        mColumnU[j] = 0.5f + mColumnX[j] / Width();
+    }
 
-    float halfWidth = (n - 1)*dx*0.5f;
-    float halfDepth = (m - 1)*dx*0.5f;
+    mRowZ.resize(m);
+    mRowV.resize(m);
     for(int i = 0; i < m; ++i)
     {
-        float z = halfDepth - i*dx;
-        for(int j = 0; j < n; ++j)
-        {
-            float x = -halfWidth + j*dx;
-
-            mPrevSolution[i*n + j] = XMFLOAT3(x, 0.0f, z);
-            mCurrSolution[i*n + j] = XMFLOAT3(x, 0.0f, z);
-            mNormals[i*n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
-            mTangentX[i*n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
-        }
+        mRowZ[i] = mHalfDepth - i*dx;
+        mRowV[i] = 0.5f - mRowZ[i] / Depth();
     }
+
+    // Heights start out flat.
+    mPrevSolution.assign(m*n, 0.0f);
+    mCurrSolution.assign(m*n, 0.0f);
+    mNormalsX.assign(m*n, 0.0f);
+    mNormalsY.assign(m*n, 1.0f);
+    mNormalsZ.assign(m*n, 0.0f);
+    mTangentsX.assign(m*n, 1.0f);
+    mTangentsY.assign(m*n, 0.0f);
+
+    mHeightChangedFirst.assign(m, 0);
+    mHeightChangedLast.assign(m, 0);
+    mPendingHeights.Reset(m);
+    mChanged.Reset(m);
+
+    mScheduler = &TaskScheduler::Default();
 }
 
 Waves::~Waves()
 {
 }
 
+void Waves::SetScheduler(TaskScheduler* scheduler, int rowGrainSize)
+{
+	mScheduler = scheduler != nullptr ? scheduler : &TaskScheduler::Default();
+	mRowGrainSize = rowGrainSize;
+}
+
 int Waves::RowCount()const
 {
 	return mNumRows;
@@ -85,73 +479,456 @@ float Waves::Depth()const
 	return mNumRows*mSpatialStep;
 }
 
-void Waves::Update(float dt)
+float Waves::SpatialStep()const
 {
-	static float t = 0;
+	return mSpatialStep;
+}
 
-	// Accumulate time.
-	t += dt;
+float Waves::TimeStep()const
+{
+	return mTimeStep;
+}
+
+void Waves::SetSparseSimulation(bool enabled, int tileSize, float threshold)
+{
+	mSparse = enabled;
+	mTileSize = std::max(tileSize, 4);
+	mSleepThreshold = threshold;
+
+	mTileRows = (mNumRows - 2 + mTileSize - 1) / mTileSize;
+	mTileCols = (mNumCols - 2 + mTileSize - 1) / mTileSize;
+
+	// Start with everything awake; calm tiles fall asleep on their own.
+	mTiles.assign(enabled ? mTileRows*mTileCols : 0, TileState());
+}
+
+int Waves::TileCount()const
+{
+	return mSparse ? mTileRows*mTileCols : 1;
+}
 
+void Waves::Update(float dt)
+{
 	// Only update the simulation at the specified time step.
-	if( t >= mTimeStep )
+	int steps = AdvanceClock(dt);
+	for(int k = 0; k < steps; ++k)
+		Step();
+}
+
+void Waves::Step()
+{
+	int bandCount = BeginStep();
+
 	{
-		// Only update interior points; we use zero boundary conditions.
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-		//for(int i = 1; i < mNumRows-1; ++i)
+		ScopedTimer timer(mTimings.StencilNanoseconds);
+		mScheduler->ParallelFor(0, bandCount, 1, [this](int band)
 		{
-			for(int j = 1; j < mNumCols-1; ++j)
-			{
-				// After this update we will be discarding the old previous
-				// buffer, so overwrite that buffer with the new update.
-				// Note how we can do this inplace (read/write to same element) 
-				// because we won't need prev_ij again and the assignment happens last.
-
-				// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-				// Moreover, our +z axis goes "down"; this is just to 
-				// keep consistent with our row indices going down.
-
-				mPrevSolution[i*mNumCols+j].y = 
-					mK1*mPrevSolution[i*mNumCols+j].y +
-					mK2*mCurrSolution[i*mNumCols+j].y +
-					mK3*(mCurrSolution[(i+1)*mNumCols+j].y + 
-					     mCurrSolution[(i-1)*mNumCols+j].y + 
-					     mCurrSolution[i*mNumCols+j+1].y + 
-						 mCurrSolution[i*mNumCols+j-1].y);
-			}
+			StepBand(band);
+		});
+	}
+
+	{
+		ScopedTimer timer(mTimings.SeamNanoseconds);
+		mScheduler->ParallelFor(1, bandCount, 1, [this](int band)
+		{
+			FinishSeam(band);
 		});
+	}
+
+	{
+		ScopedTimer timer(mTimings.TileNanoseconds);
+		EndStep();
+	}
+
+	++mTimings.Steps;
+	mTimings.CellsStepped += mStepCellCount;
+}
+
+void Waves::ResetStageTimings()
+{
+	mTimings = StageTimings();
+}
+
+void Waves::ClearChangedRegion()
+{
+	mChanged.Reset(mNumRows);
+}
+
+void Waves::DirtyRegion::Reset(int rows)
+{
+	First.assign(rows, 0);
+	Last.assign(rows, 0);
+}
+
+void Waves::DirtyRegion::MarkAll(int rows, int cols)
+{
+	First.assign(rows, 0);
+	Last.assign(rows, cols);
+}
+
+void Waves::DirtyRegion::Add(int row, int first, int last)
+{
+	GrowRange(First[row], Last[row], first, last);
+}
+
+void Waves::DirtyRegion::Merge(const DirtyRegion& other)
+{
+	if(First.size() != other.First.size())
+		Reset(static_cast<int>(other.First.size()));
+
+	for(size_t i = 0; i < First.size(); ++i)
+		GrowRange(First[i], Last[i], other.First[i], other.Last[i]);
+}
+
+bool Waves::DirtyRegion::IsEmpty()const
+{
+	for(size_t i = 0; i < First.size(); ++i)
+	{
+		if(First[i] < Last[i])
+			return false;
+	}
+	return true;
+}
+
+int Waves::DirtyRegion::VertexCount()const
+{
+	int count = 0;
+	for(size_t i = 0; i < First.size(); ++i)
+		count += std::max(Last[i] - First[i], 0);
+	return count;
+}
+
+int Waves::AdvanceClock(float dt)
+{
+	// Accumulate time.
+	mTimeAccumulator += dt;
+
+	int steps = 0;
+	while(mTimeAccumulator >= mTimeStep && steps < MaxCatchUpSteps)
+	{
+		mTimeAccumulator -= mTimeStep;
+		++steps;
+	}
+
+	// After a long stall, drop the backlog rather than stepping it all at once
+	// (and falling further behind).
+	if(mTimeAccumulator >= mTimeStep)
+		mTimeAccumulator = fmodf(mTimeAccumulator, mTimeStep);
+
+	return steps;
+}
+
+int Waves::BeginStep()
+{
+	// Only update interior points; we use zero boundary conditions.
+	// The interior rows are split into bands, and each band is stepped and
+	// has its normals computed in one pass while its rows are still in cache.
+	// In sparse mode a band is one row of tiles and only awake tiles are stepped.
+	mBandRows = mSparse ? mTileSize : BandRowCount();
+	mBandCount = (mNumRows - 2 + mBandRows - 1) / mBandRows;
+
+	BuildSpans(mBandCount);
+
+	mStepCellCount = 0;
+	for(int band = 0; band < mBandCount; ++band)
+	{
+		int rows = std::min(mBandRows, mNumRows - 1 - (1 + band*mBandRows));
+		for(int s = mBandSpanStart[band]; s < mBandSpanStart[band + 1]; ++s)
+			mStepCellCount += static_cast<std::int64_t>(rows)*(mSpans[s].Last - mSpans[s].First);
+	}
+
+	return mBandCount;
+}
+
+void Waves::FinishSeam(int band)
+{
+	// The two rows either side of a seam between bands need heights from
+	// both bands, so they are finished once every band is done.
+	int seam = 1 + band*mBandRows;
+	UpdateNormals(seam - 1);
+	UpdateNormals(seam);
+}
+
+void Waves::EndStep()
+{
+	// We just overwrote the previous buffer with the new data, so
+	// this data needs to become the current solution and the old
+	// current solution becomes the new previous solution.
+	std::swap(mPrevSolution, mCurrSolution);
+
+	if(mSparse)
+		UpdateTileStates();
+}
+
+int Waves::BandRowCount()const
+{
+	if(mRowGrainSize > 0)
+		return std::max(mRowGrainSize, 2);
+
+	// A few bands per thread, but not so thin that the seams dominate.
+	return std::max((mNumRows - 2) / (mScheduler->ThreadCount()*4), 16);
+}
+
+void Waves::BuildSpans(int bandCount)
+{
+	mSpans.clear();
+	mBandSpanStart.resize(bandCount + 1);
+
+	if(!mSparse)
+	{
+		ColumnSpan span;
+		span.First = 1;
+		span.Last = mNumCols - 1;
 
-		// We just overwrote the previous buffer with the new data, so
-		// this data needs to become the current solution and the old
-		// current solution becomes the new previous solution.
-		std::swap(mPrevSolution, mCurrSolution);
+		for(int band = 0; band < bandCount; ++band)
+		{
+			mBandSpanStart[band] = band;
+			mSpans.push_back(span);
+		}
+		mBandSpanStart[bandCount] = bandCount;
+		mActiveTileCount = 1;
+		return;
+	}
+
+	mActiveTileCount = 0;
+	for(int band = 0; band < bandCount; ++band)
+	{
+		mBandSpanStart[band] = static_cast<int>(mSpans.size());
+		for(int tc = 0; tc < mTileCols; ++tc)
+		{
+			int tile = band*mTileCols + tc;
+			if(!mTiles[tile].Awake)
+				continue;
+
+			ColumnSpan span;
+			span.First = 1 + tc*mTileSize;
+			span.Last = std::min(span.First + mTileSize, mNumCols - 1);
+			span.Tile = tile;
+			mSpans.push_back(span);
+			++mActiveTileCount;
+		}
+	}
+	mBandSpanStart[bandCount] = static_cast<int>(mSpans.size());
+}
+
+void Waves::StepBand(int band)
+{
+	int first = 1 + band*mBandRows;
+	int last = std::min(first + mBandRows, mNumRows - 1);
 
-		t = 0.0f; // reset time
+	int spanFirst = mBandSpanStart[band];
+	int spanLast = mBandSpanStart[band + 1];
 
-		//
-		// Compute normals using finite difference scheme.
-		//
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-		//for(int i = 1; i < mNumRows - 1; ++i)
+	for(int s = spanFirst; s < spanLast; ++s)
+	{
+		if(mSpans[s].Tile >= 0)
 		{
-			for(int j = 1; j < mNumCols-1; ++j)
+			TileState& tile = mTiles[mSpans[s].Tile];
+			tile.MaxHeight = tile.MaxVelocity = 0.0f;
+			tile.EdgeLeft = tile.EdgeRight = 0.0f;
+		}
+	}
+
+	// Normals of a row need the new heights of the rows above and below it, so
+	// they trail the stencil by one row.  The first and last row of the band
+	// border another band (unless they border the grid boundary, which never
+	// changes) and are left for the seam pass.
+	int normalFirst = (first == 1) ? first : first + 1;
+	int normalLast = (last == mNumRows - 1) ? last : last - 1;
+
+	for(int i = first; i < last; ++i)
+	{
+		// Heights changed since the last step by Disturb or by a tile falling
+		// asleep count as changed by this one.
+		int changedFirst = mPendingHeights.First[i];
+		int changedLast = mPendingHeights.Last[i];
+		mPendingHeights.First[i] = mPendingHeights.Last[i] = 0;
+
+		for(int s = spanFirst; s < spanLast; ++s)
+		{
+			float rowHeight = StepSpanRow(i, mSpans[s], changedFirst, changedLast);
+
+			if(mSpans[s].Tile >= 0)
 			{
-				float l = mCurrSolution[i*mNumCols+j-1].y;
-				float r = mCurrSolution[i*mNumCols+j+1].y;
-				float t = mCurrSolution[(i-1)*mNumCols+j].y;
-				float b = mCurrSolution[(i+1)*mNumCols+j].y;
-				mNormals[i*mNumCols+j].x = -r+l;
-				mNormals[i*mNumCols+j].y = 2.0f*mSpatialStep;
-				mNormals[i*mNumCols+j].z = b-t;
-
-				XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i*mNumCols+j]));
-				XMStoreFloat3(&mNormals[i*mNumCols+j], n);
-
-				mTangentX[i*mNumCols+j] = XMFLOAT3(2.0f*mSpatialStep, r-l, 0.0f);
-				XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i*mNumCols+j]));
-				XMStoreFloat3(&mTangentX[i*mNumCols+j], T);
+				TileState& tile = mTiles[mSpans[s].Tile];
+				if(i == first)
+					tile.EdgeTop = rowHeight;
+				if(i == last - 1)
+					tile.EdgeBottom = rowHeight;
 			}
-		});
+		}
+
+		mHeightChangedFirst[i] = changedFirst;
+		mHeightChangedLast[i] = changedLast;
+
+		if(i - 1 >= normalFirst && i - 1 < normalLast)
+			UpdateNormals(i - 1);
 	}
+
+	if(last - 1 >= normalFirst && last - 1 < normalLast)
+		UpdateNormals(last - 1);
+}
+
+float Waves::StepSpanRow(int i, const ColumnSpan& span, int& changedFirst, int& changedLast)
+{
+	// After this update we will be discarding the old previous
+	// buffer, so overwrite that buffer with the new update.
+	// Note how we can do this inplace (read/write to same element) 
+	// because we won't need prev_ij again and the assignment happens last.
+
+	// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+	// Moreover, our +z axis goes "down"; this is just to 
+	// keep consistent with our row indices going down.
+	int row = i*mNumCols + span.First;
+	int count = span.Last - span.First;
+	int first = 0;
+	int last = 0;
+
+	if(span.Tile < 0)
+	{
+		UpdateRow(&mPrevSolution[row], &mCurrSolution[row],
+			&mCurrSolution[row - mNumCols], &mCurrSolution[row + mNumCols],
+			count, mK1, mK2, mK3, first, last);
+		GrowRange(changedFirst, changedLast, span.First + first, span.First + last);
+		return 0.0f;
+	}
+
+	// Track the tile's activity for the sleep/wake decisions.
+	TileState& tile = mTiles[span.Tile];
+	float rowHeight = 0.0f;
+	UpdateRowTracked(&mPrevSolution[row], &mCurrSolution[row],
+		&mCurrSolution[row - mNumCols], &mCurrSolution[row + mNumCols],
+		count, mK1, mK2, mK3, first, last, rowHeight, tile.MaxVelocity);
+	GrowRange(changedFirst, changedLast, span.First + first, span.First + last);
+
+	tile.MaxHeight = std::max(tile.MaxHeight, rowHeight);
+	tile.EdgeLeft = std::max(tile.EdgeLeft, fabsf(mPrevSolution[row]));
+	tile.EdgeRight = std::max(tile.EdgeRight, fabsf(mPrevSolution[row + count - 1]));
+
+	return rowHeight;
+}
+
+void Waves::UpdateNormals(int i)
+{
+	// A normal only depends on the heights of its four neighbours, so it can
+	// only have changed next to a height that did.
+	int first = 0;
+	int last = 0;
+	if(mHeightChangedFirst[i] < mHeightChangedLast[i])
+		GrowRange(first, last, mHeightChangedFirst[i] - 1, mHeightChangedLast[i] + 1);
+	GrowRange(first, last, mHeightChangedFirst[i - 1], mHeightChangedLast[i - 1]);
+	GrowRange(first, last, mHeightChangedFirst[i + 1], mHeightChangedLast[i + 1]);
+
+	first = std::max(first, 1);
+	last = std::min(last, mNumCols - 1);
+	if(first >= last)
+		return;
+
+	ComputeNormals(mPrevSolution, i, first, last);
+
+	// Covers the changed heights of the row as well.
+	mChanged.Add(i, first, last);
+}
+
+void Waves::ComputeNormals(const std::vector<float>& heights, int i, int first, int last)
+{
+	// Compute normals using finite difference scheme.
+	int row = i*mNumCols + first;
+	ComputeNormalRow(&heights[row],
+		&heights[row - mNumCols], &heights[row + mNumCols],
+		last - first, 2.0f*mSpatialStep,
+		&mNormalsX[row], &mNormalsY[row], &mNormalsZ[row],
+		&mTangentsX[row], &mTangentsY[row]);
+}
+
+void Waves::UpdateTileStates()
+{
+	// Waves that reach the edge of an awake tile spill into the neighbour.
+	for(int tr = 0; tr < mTileRows; ++tr)
+	{
+		for(int tc = 0; tc < mTileCols; ++tc)
+		{
+			const TileState& tile = mTiles[tr*mTileCols + tc];
+			if(!tile.Awake)
+				continue;
+
+			if(tr > 0 && tile.EdgeTop > mSleepThreshold)
+				mTiles[(tr - 1)*mTileCols + tc].WakeRequested = true;
+			if(tr + 1 < mTileRows && tile.EdgeBottom > mSleepThreshold)
+				mTiles[(tr + 1)*mTileCols + tc].WakeRequested = true;
+			if(tc > 0 && tile.EdgeLeft > mSleepThreshold)
+				mTiles[tr*mTileCols + tc - 1].WakeRequested = true;
+			if(tc + 1 < mTileCols && tile.EdgeRight > mSleepThreshold)
+				mTiles[tr*mTileCols + tc + 1].WakeRequested = true;
+		}
+	}
+
+	for(int k = 0; k < static_cast<int>(mTiles.size()); ++k)
+	{
+		TileState& tile = mTiles[k];
+
+		if(!tile.Awake)
+		{
+			tile.Awake = tile.WakeRequested;
+			tile.QuietSteps = 0;
+		}
+		else if(tile.WakeRequested ||
+			tile.MaxHeight >= mSleepThreshold || tile.MaxVelocity >= mSleepThreshold)
+		{
+			tile.QuietSteps = 0;
+		}
+		else if(++tile.QuietSteps >= SleepDelaySteps)
+		{
+			SleepTile(k);
+		}
+
+		tile.WakeRequested = false;
+	}
+}
+
+void Waves::SleepTile(int tile)
+{
+	int tr = tile / mTileCols;
+	int tc = tile % mTileCols;
+
+	int rowFirst = 1 + tr*mTileSize;
+	int rowLast = std::min(rowFirst + mTileSize, mNumRows - 1);
+	int colFirst = 1 + tc*mTileSize;
+	int colLast = std::min(colFirst + mTileSize, mNumCols - 1);
+
+	// Flatten what little is left so the tile is at rest in both time levels.
+	for(int i = rowFirst; i < rowLast; ++i)
+	{
+		int row = i*mNumCols;
+		std::fill(&mPrevSolution[row + colFirst], &mPrevSolution[row + colLast], 0.0f);
+		std::fill(&mCurrSolution[row + colFirst], &mCurrSolution[row + colLast], 0.0f);
+		std::fill(&mNormalsX[row + colFirst], &mNormalsX[row + colLast], 0.0f);
+		std::fill(&mNormalsY[row + colFirst], &mNormalsY[row + colLast], 1.0f);
+		std::fill(&mNormalsZ[row + colFirst], &mNormalsZ[row + colLast], 0.0f);
+		std::fill(&mTangentsX[row + colFirst], &mTangentsX[row + colLast], 1.0f);
+		std::fill(&mTangentsY[row + colFirst], &mTangentsY[row + colLast], 0.0f);
+	}
+
+	for(int i = rowFirst; i < rowLast; ++i)
+	{
+		mPendingHeights.Add(i, colFirst, colLast);
+		mChanged.Add(i, colFirst, colLast);
+	}
+
+	mTiles[tile].Awake = false;
+	mTiles[tile].QuietSteps = 0;
+}
+
+void Waves::WakeTileAt(int i, int j)
+{
+	if(!mSparse)
+		return;
+
+	int tr = TileIndexOf(i, mTileSize, mTileRows);
+	int tc = TileIndexOf(j, mTileSize, mTileCols);
+	TileState& tile = mTiles[tr*mTileCols + tc];
+	tile.Awake = true;
+	tile.QuietSteps = 0;
 }
 
 void Waves::Disturb(int i, int j, float magnitude)
@@ -163,10 +940,415 @@ void Waves::Disturb(int i, int j, float magnitude)
 	float halfMag = 0.5f*magnitude;
 
 	// Disturb the ijth vertex height and its neighbors.
-	mCurrSolution[i*mNumCols+j].y     += magnitude;
-	mCurrSolution[i*mNumCols+j+1].y   += halfMag;
-	mCurrSolution[i*mNumCols+j-1].y   += halfMag;
-	mCurrSolution[(i+1)*mNumCols+j].y += halfMag;
-	mCurrSolution[(i-1)*mNumCols+j].y += halfMag;
+	mCurrSolution[i*mNumCols+j]     += magnitude;
+	mCurrSolution[i*mNumCols+j+1]   += halfMag;
+	mCurrSolution[i*mNumCols+j-1]   += halfMag;
+	mCurrSolution[(i+1)*mNumCols+j] += halfMag;
+	mCurrSolution[(i-1)*mNumCols+j] += halfMag;
+
+	for(int r = i - 1; r <= i + 1; ++r)
+	{
+		mPendingHeights.Add(r, j - 1, j + 2);
+		mChanged.Add(r, j - 1, j + 2);
+	}
+
+	WakeTileAt(i, j);
+	WakeTileAt(i - 1, j);
+	WakeTileAt(i + 1, j);
+	WakeTileAt(i, j - 1);
+	WakeTileAt(i, j + 1);
+}
+
+void Waves::Disturb(const Impulse* impulses, int count)
+{
+	if(count <= 0)
+		return;
+
+	// In sparse mode bin by the simulation tiles, so that each tile's wake state
+	// is only touched by the task that owns the tile.
+	int tileSize = mSparse ? mTileSize : SplatTileSize;
+	int tileRows = (mNumRows - 2 + tileSize - 1) / tileSize;
+	int tileCols = (mNumCols - 2 + tileSize - 1) / tileSize;
+	int tileCount = tileRows*tileCols;
+
+	// Find the interior grid points each splat covers; an empty rect means the
+	// splat misses the interior entirely.
+	mSplatRects.resize(count);
+	for(int k = 0; k < count; ++k)
+	{
+		const Impulse& p = impulses[k];
+
+		float col = (p.X + mHalfWidth) / mSpatialStep;
+		float row = (mHalfDepth - p.Z) / mSpatialStep;
+		float reach = SplatCutoff*std::max(p.Radius / mSpatialStep, MinSplatRadius);
+
+		SplatRect& r = mSplatRects[k];
+		r.Row0 = CeilIndex(row - reach, 1, mNumRows - 1);
+		r.Row1 = FloorIndex(row + reach, 0, mNumRows - 2);
+		r.Col0 = CeilIndex(col - reach, 1, mNumCols - 1);
+		r.Col1 = FloorIndex(col + reach, 0, mNumCols - 2);
+	}
+
+	// Counting sort of the splats into every tile they overlap, keeping the
+	// input order within a tile.  First count into mSplatBinStart[t+1] ...
+	mSplatBinStart.assign(tileCount + 1, 0);
+	for(int k = 0; k < count; ++k)
+	{
+		const SplatRect& r = mSplatRects[k];
+		if(r.Row0 > r.Row1 || r.Col0 > r.Col1)
+			continue;
+
+		for(int tr = TileIndexOf(r.Row0, tileSize, tileRows); tr <= TileIndexOf(r.Row1, tileSize, tileRows); ++tr)
+			for(int tc = TileIndexOf(r.Col0, tileSize, tileCols); tc <= TileIndexOf(r.Col1, tileSize, tileCols); ++tc)
+				++mSplatBinStart[tr*tileCols + tc + 1];
+	}
+
+	for(int t = 0; t < tileCount; ++t)
+		mSplatBinStart[t + 1] += mSplatBinStart[t];
+
+	// ... then fill, advancing mSplatBinStart[t] to the end of bin t as we go,
+	// and shift the starts back into place.
+	mSplatBins.resize(mSplatBinStart[tileCount]);
+	for(int k = 0; k < count; ++k)
+	{
+		const SplatRect& r = mSplatRects[k];
+		if(r.Row0 > r.Row1 || r.Col0 > r.Col1)
+			continue;
+
+		for(int tr = TileIndexOf(r.Row0, tileSize, tileRows); tr <= TileIndexOf(r.Row1, tileSize, tileRows); ++tr)
+			for(int tc = TileIndexOf(r.Col0, tileSize, tileCols); tc <= TileIndexOf(r.Col1, tileSize, tileCols); ++tc)
+				mSplatBins[mSplatBinStart[tr*tileCols + tc]++] = k;
+	}
+
+	for(int t = tileCount; t > 0; --t)
+		mSplatBinStart[t] = mSplatBinStart[t - 1];
+	mSplatBinStart[0] = 0;
+
+	// Tiles are disjoint, so they can be splatted in parallel.
+	mScheduler->ParallelFor(0, tileCount, 1, [&](int tile)
+	{
+		if(mSplatBinStart[tile] != mSplatBinStart[tile + 1])
+			ApplySplats(impulses, tile, tileSize, tileCols);
+	});
+
+	for(int k = 0; k < count; ++k)
+	{
+		const SplatRect& r = mSplatRects[k];
+		for(int i = r.Row0; i <= r.Row1 && r.Col0 <= r.Col1; ++i)
+		{
+			mPendingHeights.Add(i, r.Col0, r.Col1 + 1);
+			mChanged.Add(i, r.Col0, r.Col1 + 1);
+		}
+	}
+}
+
+void Waves::ApplySplats(const Impulse* impulses, int tile, int tileSize, int tileCols)
+{
+	int rowFirst = 1 + (tile / tileCols)*tileSize;
+	int rowLast = std::min(rowFirst + tileSize, mNumRows - 1);
+	int colFirst = 1 + (tile % tileCols)*tileSize;
+	int colLast = std::min(colFirst + tileSize, mNumCols - 1);
+
+	// Column weights of one splat; per thread, since tiles are splatted in parallel,
+	// and only ever grown, so splatting stops allocating once it has seen the widest
+	// tile.
+	static thread_local std::vector<float> colWeights;
+	if(colWeights.size() < static_cast<size_t>(colLast - colFirst))
+		colWeights.resize(colLast - colFirst);
+
+	for(int b = mSplatBinStart[tile]; b < mSplatBinStart[tile + 1]; ++b)
+	{
+		int k = mSplatBins[b];
+		const Impulse& p = impulses[k];
+		const SplatRect& r = mSplatRects[k];
+
+		// Part of the splat inside this tile; binning guarantees it is not empty.
+		int i0 = std::max(r.Row0, rowFirst);
+		int i1 = std::min(r.Row1, rowLast - 1);
+		int j0 = std::max(r.Col0, colFirst);
+		int j1 = std::min(r.Col1, colLast - 1);
+
+		float sigma = std::max(p.Radius, MinSplatRadius*mSpatialStep);
+		float falloff = 1.0f / (2.0f*sigma*sigma);
+
+		// The Gaussian is separable, so weight(i, j) = weight(row i)*weight(column j).
+		int cols = j1 - j0 + 1;
+		for(int j = 0; j < cols; ++j)
+		{
+			float d = mColumnX[j0 + j] - p.X;
+			colWeights[j] = expf(-d*d*falloff);
+		}
+
+		for(int i = i0; i <= i1; ++i)
+		{
+			float d = mRowZ[i] - p.Z;
+			AddScaledRow(&mCurrSolution[i*mNumCols + j0], &colWeights[0],
+				p.Magnitude*expf(-d*d*falloff), cols);
+		}
+	}
+
+	if(mSparse)
+	{
+		mTiles[tile].Awake = true;
+		mTiles[tile].QuietSteps = 0;
+	}
+}
+
+void Waves::SampleHeights(const XMFLOAT2* points, int count, float* heights) const
+{
+	mScheduler->ParallelForRange(0, count, SampleGrainSize, [&](int first, int last)
+	{
+		SampleRange(points, first, last, heights, nullptr);
+	});
+}
+
+void Waves::SampleNormals(const XMFLOAT2* points, int count, XMFLOAT3* normals) const
+{
+	mScheduler->ParallelForRange(0, count, SampleGrainSize, [&](int first, int last)
+	{
+		SampleRange(points, first, last, nullptr, normals);
+	});
+}
+
+void Waves::SampleRange(const XMFLOAT2* points, int first, int last, float* heights, XMFLOAT3* normals) const
+{
+	const XMVECTOR invDx = XMVectorReplicate(1.0f / mSpatialStep);
+	const XMVECTOR halfWidth = XMVectorReplicate(mHalfWidth);
+	const XMVECTOR halfDepth = XMVectorReplicate(mHalfDepth);
+	const XMVECTOR lastCol = XMVectorReplicate(static_cast<float>(mNumCols - 1));
+	const XMVECTOR lastRow = XMVectorReplicate(static_cast<float>(mNumRows - 1));
+	const XMVECTOR lastCellCol = XMVectorReplicate(static_cast<float>(mNumCols - 2));
+	const XMVECTOR lastCellRow = XMVectorReplicate(static_cast<float>(mNumRows - 2));
+
+	for(int k = first; k < last; k += 4)
+	{
+		int n = std::min(last - k, 4);
+
+		// The tail repeats its last point.
+		XMFLOAT4 xs, zs;
+		float* px = &xs.x;
+		float* pz = &zs.x;
+		for(int q = 0; q < 4; ++q)
+		{
+			const XMFLOAT2& point = points[k + std::min(q, n - 1)];
+			px[q] = point.x;
+			pz[q] = point.y;
+		}
+
+		// Grid coordinates, clamped to the grid, split into the cell (the index
+		// of its top-left corner) and the position inside it.
+		XMVECTOR c = XMVectorClamp((XMLoadFloat4(&xs) + halfWidth)*invDx, XMVectorZero(), lastCol);
+		XMVECTOR r = XMVectorClamp((halfDepth - XMLoadFloat4(&zs))*invDx, XMVectorZero(), lastRow);
+		XMVECTOR c0 = XMVectorMin(XMVectorFloor(c), lastCellCol);
+		XMVECTOR r0 = XMVectorMin(XMVectorFloor(r), lastCellRow);
+		XMVECTOR fx = c - c0;
+		XMVECTOR fz = r - r0;
+
+		// Row and column go to integers before they are combined; the index itself
+		// can exceed the 2^24 that a float holds exactly on large grids.
+		uint32_t row[4], col[4], cell[4];
+		XMStoreInt4(row, XMConvertVectorFloatToInt(r0, 0));
+		XMStoreInt4(col, XMConvertVectorFloatToInt(c0, 0));
+		for(int q = 0; q < 4; ++q)
+			cell[q] = row[q]*mNumCols + col[q];
+
+		if(heights != nullptr)
+		{
+			XMFLOAT4 h;
+			XMStoreFloat4(&h, GatherBilinear(mCurrSolution.data(), cell, mNumCols, fx, fz));
+			std::memcpy(heights + k, &h, n*sizeof(float));
+		}
+
+		if(normals != nullptr)
+		{
+			XMVECTOR nx = GatherBilinear(mNormalsX.data(), cell, mNumCols, fx, fz);
+			XMVECTOR ny = GatherBilinear(mNormalsY.data(), cell, mNumCols, fx, fz);
+			XMVECTOR nz = GatherBilinear(mNormalsZ.data(), cell, mNumCols, fx, fz);
+
+			// Normalize the four blended normals at once.
+			XMVECTOR invLength = XMVectorReciprocalSqrt(nx*nx + ny*ny + nz*nz);
+
+			XMFLOAT4 x, y, z;
+			XMStoreFloat4(&x, nx*invLength);
+			XMStoreFloat4(&y, ny*invLength);
+			XMStoreFloat4(&z, nz*invLength);
+			const float* sx = &x.x;
+			const float* sy = &y.x;
+			const float* sz = &z.x;
+			for(int q = 0; q < n; ++q)
+				normals[k + q] = XMFLOAT3(sx[q], sy[q], sz[q]);
+		}
+	}
+}
+
+void Waves::WriteVertices(void* dst, const VertexLayout& layout) const
+{
+	ScopedTimer timer(mTimings.EmitNanoseconds);
+	mTimings.VerticesWritten += mVertexCount;
+
+	std::uint8_t* base = static_cast<std::uint8_t*>(dst);
+	bool packed = IsPackedLayout(layout);
+
+	mScheduler->ParallelFor(0, mNumRows, BandRowCount(), [&](int i)
+	{
+		WriteVertexRow(base, layout, packed, i, 0, mNumCols);
+	});
+}
+
+void Waves::WriteVertices(void* dst, const VertexLayout& layout, const DirtyRegion& region) const
+{
+	assert(static_cast<int>(region.First.size()) == mNumRows);
+
+	ScopedTimer timer(mTimings.EmitNanoseconds);
+	mTimings.VerticesWritten += region.VertexCount();
+
+	std::uint8_t* base = static_cast<std::uint8_t*>(dst);
+	bool packed = IsPackedLayout(layout);
+
+	mScheduler->ParallelFor(0, mNumRows, BandRowCount(), [&](int i)
+	{
+		if(region.First[i] < region.Last[i])
+			WriteVertexRow(base, layout, packed, i, region.First[i], region.Last[i]);
+	});
+}
+
+bool Waves::IsPackedLayout(const VertexLayout& layout)
+{
+	return layout.Stride == 8*sizeof(float) &&
+		layout.PositionOffset == 0 &&
+		layout.NormalOffset == 3*sizeof(float) &&
+		layout.TexCOffset == 6*sizeof(float) &&
+		layout.TangentOffset < 0;
+}
+
+void Waves::WriteVertexRow(std::uint8_t* base, const VertexLayout& layout, bool packed, int i, int first, int last) const
+{
+	int row = i*mNumCols;
+	std::uint8_t* rowDst = base + static_cast<size_t>(row + first)*layout.Stride;
+
+	if(packed)
+	{
+		WritePackedRow(reinterpret_cast<float*>(rowDst), last - first,
+			&mColumnX[first], &mColumnU[first], mRowZ[i], mRowV[i], &mCurrSolution[row + first],
+			&mNormalsX[row + first], &mNormalsY[row + first], &mNormalsZ[row + first]);
+		return;
+	}
+
+	for(int j = first; j < last; ++j)
+	{
+		std::uint8_t* v = rowDst + (j - first)*layout.Stride;
+
+		if(layout.PositionOffset >= 0)
+		{
+			XMFLOAT3 p(mColumnX[j], mCurrSolution[row + j], mRowZ[i]);
+			std::memcpy(v + layout.PositionOffset, &p, sizeof(p));
+		}
+		if(layout.NormalOffset >= 0)
+		{
+			XMFLOAT3 n(mNormalsX[row + j], mNormalsY[row + j], mNormalsZ[row + j]);
+			std::memcpy(v + layout.NormalOffset, &n, sizeof(n));
+		}
+		if(layout.TexCOffset >= 0)
+		{
+			XMFLOAT2 uv(mColumnU[j], mRowV[i]);
+			std::memcpy(v + layout.TexCOffset, &uv, sizeof(uv));
+		}
+		if(layout.TangentOffset >= 0)
+		{
+			XMFLOAT3 t(mTangentsX[row + j], mTangentsY[row + j], 0.0f);
+			std::memcpy(v + layout.TangentOffset, &t, sizeof(t));
+		}
+	}
+}
+
+void Waves::WriteStaticVertices(StaticVertex* dst) const
+{
+	for(int i = 0; i < mNumRows; ++i)
+	{
+		for(int j = 0; j < mNumCols; ++j)
+		{
+			StaticVertex& v = dst[i*mNumCols + j];
+			v.PosXZ = XMFLOAT2(mColumnX[j], mRowZ[i]);
+			v.TexC = XMFLOAT2(mColumnU[j], mRowV[i]);
+		}
+	}
+}
+
+void Waves::WriteCompactVertices(CompactVertex* dst) const
+{
+	ScopedTimer timer(mTimings.EmitNanoseconds);
+	mTimings.VerticesWritten += mVertexCount;
+
+	mScheduler->ParallelFor(0, mNumRows, BandRowCount(), [&](int i)
+	{
+		WriteCompactRow(dst, i, 0, mNumCols);
+	});
+}
+
+void Waves::WriteCompactVertices(CompactVertex* dst, const DirtyRegion& region) const
+{
+	assert(static_cast<int>(region.First.size()) == mNumRows);
+
+	ScopedTimer timer(mTimings.EmitNanoseconds);
+	mTimings.VerticesWritten += region.VertexCount();
+
+	mScheduler->ParallelFor(0, mNumRows, BandRowCount(), [&](int i)
+	{
+		if(region.First[i] < region.Last[i])
+			WriteCompactRow(dst, i, region.First[i], region.Last[i]);
+	});
+}
+
+void Waves::WriteCompactRow(CompactVertex* dst, int i, int first, int last) const
+{
+	int start = i*mNumCols + first;
+	int count = last - first;
+
+	PackedVector::XMConvertFloatToHalfStream(&dst[start].Height, sizeof(CompactVertex),
+		&mCurrSolution[start], sizeof(float), count);
+
+	for(int j = 0; j < count; ++j)
+		dst[start + j].Pad = 0;
+
+	EncodeNormalRow(dst + start, count,
+		&mNormalsX[start], &mNormalsY[start], &mNormalsZ[start]);
+}
+
+Waves::CompactVertex Waves::EncodeCompact(float height, const XMFLOAT3& normal)
+{
+	float sum = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+	float u = normal.x / sum;
+	float v = normal.z / sum;
+
+	if(normal.y < 0.0f)
+	{
+		float foldU = copysignf(1.0f - fabsf(v), u);
+		float foldV = copysignf(1.0f - fabsf(u), v);
+		u = foldU;
+		v = foldV;
+	}
+
+	CompactVertex result;
+	result.Height = PackedVector::XMConvertFloatToHalf(height);
+	result.Pad = 0;
+	PackedVector::XMStoreShortN2(&result.NormalOct, XMVectorSet(u, v, 0.0f, 0.0f));
+
+	return result;
+}
+
+void Waves::DecodeCompact(const CompactVertex& v, float& height, XMFLOAT3& normal)
+{
+	height = PackedVector::XMConvertHalfToFloat(v.Height);
+
+	XMFLOAT2 e;
+	XMStoreFloat2(&e, PackedVector::XMLoadShortN2(&v.NormalOct));
+
+	XMFLOAT3 n(e.x, 1.0f - fabsf(e.x) - fabsf(e.y), e.y);
+	if(n.y < 0.0f)
+	{
+		n.x = (1.0f - fabsf(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f);
+		n.z = (1.0f - fabsf(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f);
+	}
+
+	XMStoreFloat3(&normal, XMVector3Normalize(XMLoadFloat3(&n)));
 }
-	
@@ -9,12 +9,96 @@
 #ifndef WAVES_H
 #define WAVES_H
 
+#include <cstdint>
 #include <vector>
 #include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+class TaskScheduler;
 
 class Waves
 {
 public:
+	// Describes where each vertex attribute lives inside a vertex buffer, so the
+	// solution can be written straight into mapped memory.  Offsets are in bytes
+	// from the start of a vertex; a negative offset skips that attribute.  The
+	// defaults match a tightly packed {Position, Normal, TexC} vertex.
+	struct VertexLayout
+	{
+		int Stride = 32;
+		int PositionOffset = 0;
+		int NormalOffset = 12;
+		int TexCOffset = 24;
+		int TangentOffset = -1;
+	};
+
+	// Compact per-frame vertex holding only what the simulation changes: the
+	// height as a half float and the unit normal octahedral-encoded (folded
+	// about the y-axis) into two snorm16s.  8 bytes instead of 32; bind as
+	// DXGI_FORMAT_R16_FLOAT at offset 0 and DXGI_FORMAT_R16G16_SNORM at offset 4.
+	struct CompactVertex
+	{
+		DirectX::PackedVector::HALF Height;
+		std::uint16_t Pad;
+		DirectX::PackedVector::XMSHORTN2 NormalOct;
+	};
+
+	// A Gaussian bump added by the batched Disturb: Magnitude is the peak height,
+	// (X, Z) the centre and Radius the standard deviation, all in world units.
+	struct Impulse
+	{
+		float X = 0.0f;
+		float Z = 0.0f;
+		float Magnitude = 0.0f;
+		float Radius = 1.0f;
+	};
+
+	// The part of a grid vertex that never changes, uploaded once alongside a
+	// stream of CompactVertex.
+	struct StaticVertex
+	{
+		DirectX::XMFLOAT2 PosXZ;
+		DirectX::XMFLOAT2 TexC;
+	};
+
+	// Vertices that changed, as one column range [First[i], Last[i]) per grid row;
+	// row i is unchanged when First[i] >= Last[i].
+	struct DirtyRegion
+	{
+		std::vector<int> First;
+		std::vector<int> Last;
+
+		// Makes every row clean / fully dirty.
+		void Reset(int rows);
+		void MarkAll(int rows, int cols);
+
+		void Add(int row, int first, int last);
+		void Merge(const DirtyRegion& other);
+
+		bool IsEmpty() const;
+		int VertexCount() const;
+	};
+
+	// Time spent in each stage of Step and of the vertex writers since the last
+	// ResetStageTimings.  The stencil stage includes the normals of the rows
+	// inside each band, which are computed in the same pass; the seam stage is
+	// the normals of the rows between bands.  Steps taken by a WavesWorld are
+	// not counted.
+	struct StageTimings
+	{
+		std::int64_t Steps = 0;
+		std::int64_t CellsStepped = 0;
+		std::int64_t StencilNanoseconds = 0;
+		std::int64_t SeamNanoseconds = 0;
+		std::int64_t TileNanoseconds = 0;
+
+		std::int64_t VerticesWritten = 0;
+		std::int64_t EmitNanoseconds = 0;
+
+		double StencilNsPerCell() const { return CellsStepped > 0 ? double(StencilNanoseconds) / CellsStepped : 0.0; }
+		double EmitNsPerVertex() const { return VerticesWritten > 0 ? double(EmitNanoseconds) / VerticesWritten : 0.0; }
+	};
+
 	Waves(int m, int n, float dx, float dt, float speed, float damping);
 	Waves(const Waves& rhs) = delete;
 	Waves& operator=(const Waves& rhs) = delete;
@@ -26,19 +110,178 @@ public:
 	int TriangleCount() const;
 	float Width() const;
 	float Depth() const;
+	float SpatialStep() const;
+	float TimeStep() const;
+
+	// Returns the solution at the ith grid point.  Only the heights are stored; the
+	// x- and z-coordinates are reconstructed from the grid.
+	DirectX::XMFLOAT3 Position(int i) const
+	{
+		return DirectX::XMFLOAT3(mColumnX[i % mNumCols], mCurrSolution[i], mRowZ[i / mNumCols]);
+	}
 
-	// Returns the solution at the ith grid point.
-	const DirectX::XMFLOAT3& Position(int i) const { return mCurrSolution[i]; }
+	// Returns the texture coordinates at the ith grid point, which map the grid
+	// onto [0,1] and never change.
+	DirectX::XMFLOAT2 TexC(int i) const
+	{
+		return DirectX::XMFLOAT2(mColumnU[i % mNumCols], mRowV[i / mNumCols]);
+	}
+
+	// Returns the solution height at the ith grid point.
+	float Height(int i) const { return mCurrSolution[i]; }
 
 	// Returns the solution normal at the ith grid point.
-	const DirectX::XMFLOAT3& Normal(int i) const { return mNormals[i]; }
+	DirectX::XMFLOAT3 Normal(int i) const
+	{
+		return DirectX::XMFLOAT3(mNormalsX[i], mNormalsY[i], mNormalsZ[i]);
+	}
 
 	// Returns the unit tangent vector at the ith grid point in the local x-axis direction.
-	const DirectX::XMFLOAT3& TangentX(int i) const { return mTangentX[i]; }
+	DirectX::XMFLOAT3 TangentX(int i) const
+	{
+		return DirectX::XMFLOAT3(mTangentsX[i], mTangentsY[i], 0.0f);
+	}
+
+	// Runs the simulation on the given scheduler (the process-wide default if null).
+	// rowGrainSize is the height of the row bands handed out per task; <= 0 picks
+	// a size from the grid and thread count.
+	void SetScheduler(TaskScheduler* scheduler, int rowGrainSize = 0);
+
+	// In sparse mode the interior is divided into tileSize x tileSize tiles.  A tile
+	// whose heights and velocities have stayed below threshold for a few steps is
+	// flattened and put to sleep, and is skipped by Update until Disturb touches it
+	// or an awake neighbour's waves reach its edge.
+	void SetSparseSimulation(bool enabled, int tileSize = 32, float threshold = 1.0e-4f);
+	bool IsSparseSimulation() const { return mSparse; }
+
+	// Number of tiles, and how many of them were stepped by the last update.
+	// Outside sparse mode the whole grid counts as one tile.
+	int TileCount() const;
+	int ActiveTileCount() const { return mActiveTileCount; }
 
+	// Vertices changed by steps, Disturb and tiles falling asleep since the last
+	// ClearChangedRegion.  A step only recomputes normals next to heights that
+	// changed, so a calm surface costs little more than the stencil.
+	const DirtyRegion& ChangedRegion() const { return mChanged; }
+	void ClearChangedRegion();
+
+	const StageTimings& GetStageTimings() const { return mTimings; }
+	void ResetStageTimings();
+
+	// Advances the simulation clock by dt and takes every fixed step that is due,
+	// up to a few per call; a larger backlog is dropped.  Each Waves keeps its own
+	// clock.
 	void Update(float dt);
+
+	// Takes one fixed step regardless of the clock.
+	void Step();
+
 	void Disturb(int i, int j, float magnitude);
 
+	// Adds count impulses to the current solution in one pass.  The impulses are
+	// binned by the tiles their splats overlap and the tiles are processed in
+	// parallel.  Splats are cut off at three radii and clipped to the interior of
+	// the grid, so impulses near or beyond the boundary are fine.
+	void Disturb(const Impulse* impulses, int count);
+
+	// Bilinearly interpolated surface height / unit normal at count world (x, z)
+	// points of the current solution, four points at a time.  Points outside the
+	// grid are clamped to its edge, where the water is at rest.
+	void SampleHeights(const DirectX::XMFLOAT2* points, int count, float* heights) const;
+	void SampleNormals(const DirectX::XMFLOAT2* points, int count, DirectX::XMFLOAT3* normals) const;
+
+	// Writes all VertexCount() vertices of the current solution to dst in one pass.
+	// dst is typically the mapped memory of an upload buffer, but any buffer of
+	// VertexCount()*layout.Stride bytes will do.
+	void WriteVertices(void* dst, const VertexLayout& layout) const;
+
+	// Same, but only writes the vertices in region, e.g. the changes since a
+	// buffer was last written.
+	void WriteVertices(void* dst, const VertexLayout& layout, const DirtyRegion& region) const;
+
+	// Writes the VertexCount() static x/z/texture coordinates of the grid.
+	void WriteStaticVertices(StaticVertex* dst) const;
+
+	// Encodes the current solution into VertexCount() compact vertices, four
+	// vertices at a time.  The result is bit-identical to EncodeCompact.
+	void WriteCompactVertices(CompactVertex* dst) const;
+	void WriteCompactVertices(CompactVertex* dst, const DirtyRegion& region) const;
+
+	// Scalar reference encoder/decoder for CompactVertex.  DecodeCompact mirrors
+	// what the vertex shader does with the stream.
+	static CompactVertex EncodeCompact(float height, const DirectX::XMFLOAT3& normal);
+	static void DecodeCompact(const CompactVertex& v, float& height, DirectX::XMFLOAT3& normal);
+
+private:
+	// WavesWorld interleaves the phases of Step across many patches.
+	friend class WavesWorld;
+
+	// Columns [First, Last) of a band to step; Tile is -1 outside sparse mode.
+	struct ColumnSpan
+	{
+		int First = 0;
+		int Last = 0;
+		int Tile = -1;
+	};
+
+	// Interior grid points [Row0, Row1] x [Col0, Col1] covered by a splat.
+	struct SplatRect
+	{
+		int Row0 = 0;
+		int Row1 = -1;
+		int Col0 = 0;
+		int Col1 = -1;
+	};
+
+	struct TileState
+	{
+		bool Awake = true;
+		bool WakeRequested = false;
+		int QuietSteps = 0;
+
+		// Activity measured over the last step.
+		float MaxHeight = 0.0f;
+		float MaxVelocity = 0.0f;
+		float EdgeTop = 0.0f;
+		float EdgeBottom = 0.0f;
+		float EdgeLeft = 0.0f;
+		float EdgeRight = 0.0f;
+	};
+
+	// Adds dt to the clock and returns the number of steps due now.
+	int AdvanceClock(float dt);
+
+	// Step is BeginStep (which returns the band count), StepBand for every band,
+	// FinishSeam for bands [1, count) once all bands are done, then EndStep.
+	int BeginStep();
+	void FinishSeam(int band);
+	void EndStep();
+
+	int BandRowCount()const;
+	void BuildSpans(int bandCount);
+	void StepBand(int band);
+	// Steps one row of a span and grows [changedFirst, changedLast) over the
+	// heights that changed; returns the largest new |height| on it (tracked only
+	// in sparse mode).
+	float StepSpanRow(int i, const ColumnSpan& span, int& changedFirst, int& changedLast);
+	// Recomputes the normals of row i around the heights changed by this step.
+	void UpdateNormals(int i);
+	void ComputeNormals(const std::vector<float>& heights, int i, int first, int last);
+
+	void ApplySplats(const Impulse* impulses, int tile, int tileSize, int tileCols);
+
+	static bool IsPackedLayout(const VertexLayout& layout);
+	void WriteVertexRow(std::uint8_t* base, const VertexLayout& layout, bool packed, int i, int first, int last) const;
+	void WriteCompactRow(CompactVertex* dst, int i, int first, int last) const;
+
+	// Samples points [first, last); either output may be null.
+	void SampleRange(const DirectX::XMFLOAT2* points, int first, int last,
+		float* heights, DirectX::XMFLOAT3* normals) const;
+
+	void UpdateTileStates();
+	void SleepTile(int tile);
+	void WakeTileAt(int i, int j);
+
 private:
 	int mNumRows = 0;
 	int mNumCols = 0;
@@ -54,10 +297,67 @@ private:
 	float mTimeStep = 0.0f;
 	float mSpatialStep = 0.0f;
 
-	std::vector<DirectX::XMFLOAT3> mPrevSolution;
-	std::vector<DirectX::XMFLOAT3> mCurrSolution;
-	std::vector<DirectX::XMFLOAT3> mNormals;
-	std::vector<DirectX::XMFLOAT3> mTangentX;
+	// Time accumulated towards the next step.
+	float mTimeAccumulator = 0.0f;
+
+	TaskScheduler* mScheduler = nullptr;
+	int mRowGrainSize = 0;
+
+	// Work list for the current step: mBandCount bands of mBandRows rows, and
+	// the spans of band b are mSpans[mBandSpanStart[b], mBandSpanStart[b+1]).
+	int mBandRows = 0;
+	int mBandCount = 0;
+	std::vector<ColumnSpan> mSpans;
+	std::vector<int> mBandSpanStart;
+
+	bool mSparse = false;
+	int mTileSize = 0;
+	int mTileRows = 0;
+	int mTileCols = 0;
+	float mSleepThreshold = 0.0f;
+	std::vector<TileState> mTiles;
+	int mActiveTileCount = 0;
+
+	// Scratch space of the batched Disturb: the footprint of every impulse, and
+	// the impulses overlapping tile t in mSplatBins[mSplatBinStart[t], mSplatBinStart[t+1]).
+	std::vector<SplatRect> mSplatRects;
+	std::vector<int> mSplatBinStart;
+	std::vector<int> mSplatBins;
+
+	// Columns of each row whose height the current step changed.
+	std::vector<int> mHeightChangedFirst;
+	std::vector<int> mHeightChangedLast;
+
+	// Heights changed outside a step, which the next step treats as changed by
+	// it; and the vertices changed since ClearChangedRegion.
+	DirtyRegion mPendingHeights;
+	DirtyRegion mChanged;
+
+	// Interior cells covered by the current step's spans.
+	std::int64_t mStepCellCount = 0;
+
+	// Updated by the (const) vertex writers too.
+	mutable StageTimings mTimings;
+
+	float mHalfWidth = 0.0f;
+	float mHalfDepth = 0.0f;
+
+	// Static per-column x/u and per-row z/v of the grid vertices.
+	std::vector<float> mColumnX;
+	std::vector<float> mColumnU;
+	std::vector<float> mRowZ;
+	std::vector<float> mRowV;
+
+	// The simulation only ever touches the heights, so the grid is stored as a
+	// structure of arrays: one float per grid point for the solutions, and the
+	// normal/tangent components in separate arrays (the tangent z is always 0).
+	std::vector<float> mPrevSolution;
+	std::vector<float> mCurrSolution;
+	std::vector<float> mNormalsX;
+	std::vector<float> mNormalsY;
+	std::vector<float> mNormalsZ;
+	std::vector<float> mTangentsX;
+	std::vector<float> mTangentsY;
 };
 
 #endif // WAVES_H
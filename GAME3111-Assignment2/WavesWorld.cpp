@@ -0,0 +1,106 @@
+//***************************************************************************************
+// WavesWorld.cpp
+//***************************************************************************************
+
+#include "WavesWorld.h"
+#include "../Common/TaskScheduler.h"
+#include <algorithm>
+
+WavesWorld::WavesWorld(TaskScheduler* scheduler)
+{
+	SetScheduler(scheduler);
+}
+
+WavesWorld::~WavesWorld()
+{
+}
+
+Waves* WavesWorld::AddPatch(int m, int n, float dx, float dt, float speed, float damping)
+{
+	mPatches.push_back(std::make_unique<Waves>(m, n, dx, dt, speed, damping));
+	mPatches.back()->SetScheduler(mScheduler);
+	return mPatches.back().get();
+}
+
+void WavesWorld::RemovePatch(Waves* patch)
+{
+	mPatches.erase(std::remove_if(mPatches.begin(), mPatches.end(),
+		[patch](const std::unique_ptr<Waves>& p) { return p.get() == patch; }), mPatches.end());
+}
+
+int WavesWorld::PatchCount()const
+{
+	return static_cast<int>(mPatches.size());
+}
+
+Waves* WavesWorld::Patch(int i)const
+{
+	return mPatches[i].get();
+}
+
+void WavesWorld::SetScheduler(TaskScheduler* scheduler)
+{
+	mScheduler = scheduler != nullptr ? scheduler : &TaskScheduler::Default();
+
+	for(auto& patch : mPatches)
+		patch->SetScheduler(mScheduler);
+}
+
+void WavesWorld::Update(float dt)
+{
+	// Patches with different time steps fall due at different times, and one
+	// that is behind may take several steps; step k of every patch that is due
+	// at least k+1 steps is taken in batch k.
+	mDueSteps.resize(mPatches.size());
+
+	int rounds = 0;
+	for(size_t p = 0; p < mPatches.size(); ++p)
+	{
+		mDueSteps[p] = mPatches[p]->AdvanceClock(dt);
+		rounds = std::max(rounds, mDueSteps[p]);
+	}
+
+	mStepCount = 0;
+	for(int round = 0; round < rounds; ++round)
+		StepBatch(round);
+}
+
+void WavesWorld::StepBatch(int round)
+{
+	mStepping.clear();
+	mBands.clear();
+	mSeams.clear();
+
+	for(size_t p = 0; p < mPatches.size(); ++p)
+	{
+		if(mDueSteps[p] <= round)
+			continue;
+
+		Waves* patch = mPatches[p].get();
+		int bandCount = patch->BeginStep();
+
+		mStepping.push_back(patch);
+		for(int band = 0; band < bandCount; ++band)
+			mBands.push_back({ patch, band });
+		for(int band = 1; band < bandCount; ++band)
+			mSeams.push_back({ patch, band });
+	}
+
+	// Same phases as Waves::Step, each one a single job over all patches.
+	mScheduler->ParallelFor(0, static_cast<int>(mBands.size()), 1, [this](int k)
+	{
+		mBands[k].Patch->StepBand(mBands[k].Band);
+	});
+
+	mScheduler->ParallelFor(0, static_cast<int>(mSeams.size()), 1, [this](int k)
+	{
+		mSeams[k].Patch->FinishSeam(mSeams[k].Band);
+	});
+
+	mScheduler->ParallelFor(0, static_cast<int>(mStepping.size()), 1, [this](int k)
+	{
+		mStepping[k]->EndStep();
+	});
+
+	mStepCount += static_cast<int>(mStepping.size());
+}
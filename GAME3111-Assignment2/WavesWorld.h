@@ -0,0 +1,74 @@
+//***************************************************************************************
+// WavesWorld.h
+//
+// Owns any number of independent wave patches (ponds, moats, ...) and steps them
+// together.  Every patch keeps its own fixed-step clock, but the patches that are due
+// a step are stepped as one batch: the bands of all of them go into a single parallel
+// job, then all their seams, so many small patches cost a few dispatches per step
+// instead of a few each.
+//
+// Patches are plain Waves and can be disturbed and written out as usual between
+// updates, but must not be stepped on their own (or handed to AsyncWaves) as well.
+//***************************************************************************************
+
+#ifndef WAVES_WORLD_H
+#define WAVES_WORLD_H
+
+#include "Waves.h"
+#include <memory>
+#include <vector>
+
+class TaskScheduler;
+
+class WavesWorld
+{
+public:
+	// Steps the patches on the given scheduler (the process-wide default if null).
+	explicit WavesWorld(TaskScheduler* scheduler = nullptr);
+	WavesWorld(const WavesWorld& rhs) = delete;
+	WavesWorld& operator=(const WavesWorld& rhs) = delete;
+	~WavesWorld();
+
+	// Adds a patch with the same parameters as the Waves constructor.  The patch
+	// lives until it is removed or the world is destroyed.
+	Waves* AddPatch(int m, int n, float dx, float dt, float speed, float damping);
+	void RemovePatch(Waves* patch);
+
+	int PatchCount() const;
+	Waves* Patch(int i) const;
+
+	void SetScheduler(TaskScheduler* scheduler);
+
+	// Advances the clock of every patch by dt and takes the steps that are due.
+	void Update(float dt);
+
+	// Patch steps taken by the last Update, over all patches.
+	int StepCount() const { return mStepCount; }
+
+private:
+	// One band or seam of one patch.
+	struct WorkItem
+	{
+		Waves* Patch = nullptr;
+		int Band = 0;
+	};
+
+	void StepBatch(int round);
+
+private:
+	TaskScheduler* mScheduler = nullptr;
+
+	std::vector<std::unique_ptr<Waves>> mPatches;
+
+	// Steps each patch is due in the current Update.
+	std::vector<int> mDueSteps;
+
+	// Scratch space of one batched step.
+	std::vector<Waves*> mStepping;
+	std::vector<WorkItem> mBands;
+	std::vector<WorkItem> mSeams;
+
+	int mStepCount = 0;
+};
+
+#endif // WAVES_WORLD_H
@@ -13,8 +13,14 @@
 #include "../Common/MathHelper.h"
 #include "../Common/UploadBuffer.h"
 #include "../Common/GeometryGenerator.h"
+#include "../Common/MeshOptimizer.h"
+#include "../Common/MeshSimplifier.h"
+#include "../Common/MeshWelder.h"
+#include "../Common/MeshCache.h"
 #include "FrameResource.h"
 #include "Waves.h"
+#include "AsyncWaves.h"
+#include "WaterClipmap.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -25,6 +31,125 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// Meshes of boxGeo that also get simplified levels, stored as "<name>_lod<level>",
+// and the fraction of the triangles each level keeps.
+const char* const gLodMeshNames[] = { "cylinder", "cone", "sphere", "torus" };
+const std::vector<float> gLodTriangleRatios = { 0.5f, 0.25f };
+
+// A render item switches to a coarser level once that level's simplification
+// error covers fewer pixels than this.
+const float gLodPixelError = 1.0f;
+
+// Where Waves::WriteVertices puts each attribute of a full wave Vertex.  The
+// tex-coords are derived from position by mapping [-w/2,w/2] --> [0,1] inside Waves.
+Waves::VertexLayout WavesVertexLayout()
+{
+	Waves::VertexLayout layout;
+	layout.Stride = sizeof(Vertex);
+	layout.PositionOffset = offsetof(Vertex, Pos);
+	layout.NormalOffset = offsetof(Vertex, Normal);
+	layout.TexCOffset = offsetof(Vertex, TexC);
+	return layout;
+}
+
+// The mesh cache file sits next to the executable, not in whatever directory the
+// app happens to be started from.
+std::wstring MeshCacheFileName()
+{
+	wchar_t path[MAX_PATH];
+	DWORD length = GetModuleFileNameW(nullptr, path, MAX_PATH);
+	if(length == 0 || length == MAX_PATH)
+		return L"MeshCache.bin";
+
+	std::wstring exePath(path, length);
+	return exePath.substr(0, exePath.find_last_of(L"\\/") + 1) + L"MeshCache.bin";
+}
+
+// Index buffer contents for indices that are relative to their submesh's
+// BaseVertexLocation: 16-bit when every index fits, 32-bit otherwise.  Returns
+// the format to draw them with.
+DXGI_FORMAT PackIndices(const std::vector<std::uint32_t>& indices, std::vector<std::uint8_t>& bytes)
+{
+	bool fits16 = std::all_of(indices.begin(), indices.end(), [](std::uint32_t i) { return i <= 0xffff; });
+	if(!fits16)
+	{
+		bytes.resize(indices.size()*sizeof(std::uint32_t));
+		memcpy(bytes.data(), indices.data(), bytes.size());
+		return DXGI_FORMAT_R32_UINT;
+	}
+
+	bytes.resize(indices.size()*sizeof(std::uint16_t));
+	std::uint16_t* dst = reinterpret_cast<std::uint16_t*>(bytes.data());
+	for(size_t i = 0; i < indices.size(); ++i)
+		dst[i] = static_cast<std::uint16_t>(indices[i]);
+	return DXGI_FORMAT_R16_UINT;
+}
+
+// gLodTriangleRatios for the meshes named in gLodMeshNames, no levels for the rest.
+const std::vector<float>& LodTriangleRatios(const char* name)
+{
+	static const std::vector<float> none;
+	for(const char* lodName : gLodMeshNames)
+	{
+		if(strcmp(name, lodName) == 0)
+			return gLodTriangleRatios;
+	}
+	return none;
+}
+
+// A mesh of boxGeo as it is uploaded, out of the cache: (gen.*create)(args...)
+// welded and reordered for the vertex cache, then a simplified level for each
+// of lodRatios, reordered too.  Each key covers the generator call and every
+// setting after it, so changing any of them makes a new entry.  Only the levels
+// the cache does not have yet are stored.
+template <typename... Params, typename... Args>
+std::vector<MeshCache::MeshView> ProcessedMesh(MeshCache& cache, const std::vector<float>& lodRatios, const char* generator,
+	GeometryGenerator& gen, GeometryGenerator::MeshData (GeometryGenerator::*create)(Params...), Args... args)
+{
+	// Vertex has no tangent, so vertices that differ only in TangentU can be shared.
+	MeshWelder::WeldOptions weldOptions;
+	weldOptions.CompareTangents = false;
+	const std::uint32_t cacheSize = MeshOptimizer::DefaultCacheSize;
+
+	// WeldOptions goes in field by field, as it has padding after CompareTangents.
+	MeshCache::Key source = MeshCache::MakeKey(generator, Params(args)...);
+	std::vector<MeshCache::Key> keys;
+	for(size_t level = 0; level <= lodRatios.size(); ++level)
+	{
+		float ratio = level == 0 ? 1.0f : lodRatios[level - 1];
+		keys.push_back(MeshCache::MakeKey("ProcessedMesh", source.Name, source.Parameters, weldOptions.PositionEpsilon,
+			weldOptions.NormalEpsilon, weldOptions.TexCEpsilon, weldOptions.CompareTangents, cacheSize, ratio));
+	}
+
+	std::vector<MeshCache::MeshView> levels(keys.size());
+	std::vector<bool> found(keys.size());
+	for(size_t level = 0; level < keys.size(); ++level)
+		found[level] = cache.Find(keys[level], levels[level]);
+	if(std::all_of(found.begin(), found.end(), [](bool f) { return f; }))
+		return levels;
+
+	GeometryGenerator::MeshData mesh = (gen.*create)(Params(args)...);
+	MeshWelder::Weld(mesh, weldOptions);
+
+	// The levels are simplified before the full mesh is reordered, so they do not
+	// depend on that order.
+	std::vector<MeshSimplifier::Lod> lods = MeshSimplifier::BuildLodChain(mesh, lodRatios);
+	MeshOptimizer::OptimizeMesh(mesh, cacheSize);
+	if(!found[0])
+		levels[0] = cache.Store(keys[0], mesh);
+
+	for(size_t level = 1; level < keys.size(); ++level)
+	{
+		if(found[level])
+			continue;
+		MeshSimplifier::Lod& lod = lods[level - 1];
+		MeshOptimizer::OptimizeMesh(lod.Mesh, cacheSize);
+		levels[level] = cache.Store(keys[level], lod.Mesh, lod.Error);
+	}
+
+	return levels;
+}
+
 // Lightweight structure stores parameters to draw a shape.  This will
 // vary from app-to-app.
 struct RenderItem
@@ -57,6 +182,19 @@ struct RenderItem
     UINT IndexCount = 0;
     UINT StartIndexLocation = 0;
     int BaseVertexLocation = 0;
+
+	// Name of the Geo->DrawArgs entry the parameters above were taken from.
+	std::string Submesh;
+
+	// Levels of detail of the mesh, full detail first, with their object-space
+	// error.  UpdateLods copies the chosen level into the draw parameters above.
+	// Empty for items without levels.
+	std::vector<SubmeshGeometry> Lods;
+	std::vector<float> LodErrors;
+
+	// Further ranges drawn with the same constants after the one above, for
+	// meshes split into pieces addressable with 16-bit indices.
+	std::vector<SubmeshGeometry> Chunks;
 };
 
 enum class RenderLayer : int
@@ -89,11 +227,13 @@ private:
 
     void OnKeyboardInput(const GameTimer& gt);
 	void UpdateCamera(const GameTimer& gt);
+	void UpdateLods(const GameTimer& gt);
 	void AnimateMaterials(const GameTimer& gt);
 	void UpdateObjectCBs(const GameTimer& gt);
 	void UpdateMaterialCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 	void UpdateWaves(const GameTimer& gt); 
+	void UpdateWaterClipmap(BYTE* wavesVertices);
 
 	void LoadTextures();
     void BuildRootSignature();
@@ -101,12 +241,14 @@ private:
     void BuildShadersAndInputLayouts();
     void BuildLandGeometry();
     void BuildWavesGeometry();
+	void BuildWaterClipmapGeometry();
 	void BuildBoxGeometry();
 	void BuildTreeSpritesGeometry();
     void BuildPSOs();
     void BuildFrameResources();
     void BuildMaterials();
     void BuildRenderItems();
+	void AttachLods(RenderItem* ritem);
     void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
 
 	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();
@@ -127,6 +269,7 @@ private:
 	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
+	std::unordered_map<std::string, float> mLodErrors;
 	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
@@ -134,6 +277,7 @@ private:
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> mStdInputLayout;
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mTreeSpriteInputLayout;
+	std::vector<D3D12_INPUT_ELEMENT_DESC> mCompactWavesInputLayout;
 
     RenderItem* mWavesRitem = nullptr;
 
@@ -145,12 +289,36 @@ private:
 
 	std::unique_ptr<Waves> mWaves;
 
+	// Generated meshes from earlier runs; only open while the geometry is built.
+	std::unique_ptr<MeshCache> mMeshCache;
+
+	// When set, the waves upload 8-byte Waves::CompactVertex per frame and the
+	// static grid x/z and tex-coords live in an immutable buffer bound to slot 1.
+	bool mCompactWaves = true;
+	ComPtr<ID3D12Resource> mWavesStaticVB = nullptr;
+	ComPtr<ID3D12Resource> mWavesStaticVBUploader = nullptr;
+	D3D12_VERTEX_BUFFER_VIEW mWavesStaticVBView = {};
+
+	// Steps mWaves on a background thread; when null the waves are stepped in
+	// UpdateWaves.  Declared after mWaves so it is stopped first.
+	std::unique_ptr<AsyncWaves> mAsyncWaves;
+
+	// When set, the water is drawn as clipmap levels centred on the eye, one
+	// render item per level, instead of as the simulation grid.  The levels
+	// read the simulated heights, so the waves are stepped in UpdateWaves.
+	bool mClipmapWaves = false;
+	std::unique_ptr<WaterClipmap> mWaterClipmap;
+	std::vector<RenderItem*> mWaterClipmapRitems;
+
     PassConstants mMainPassCB;
 
 	XMFLOAT3 mEyePos = { 0.0f, 0.0f, 0.0f };
 	XMFLOAT4X4 mView = MathHelper::Identity4x4();
 	XMFLOAT4X4 mProj = MathHelper::Identity4x4();
 
+	// Vertical field of view of mProj, which UpdateLods also needs.
+	float mFovY = 0.25f*MathHelper::Pi;
+
     float mTheta = 1.5f*XM_PI;
     float mPhi = XM_PIDIV2 - 0.1f;
     float mRadius = 50.0f;
@@ -205,14 +373,31 @@ bool TreeBillboardsApp::Initialize()
     mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
     mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+	mWaves->SetSparseSimulation(true);
+
+	if(mClipmapWaves)
+	{
+		mCompactWaves = false;
+		mWaterClipmap = std::make_unique<WaterClipmap>(5, 16);
+	}
+	else if(mCompactWaves)
+		mAsyncWaves = std::make_unique<AsyncWaves>(mWaves.get());
+	else
+		mAsyncWaves = std::make_unique<AsyncWaves>(mWaves.get(), WavesVertexLayout());
  
 	LoadTextures();
     BuildRootSignature();
 	BuildDescriptorHeaps();
     BuildShadersAndInputLayouts();
+	mMeshCache = std::make_unique<MeshCache>(MeshCacheFileName());
     BuildLandGeometry();
-    BuildWavesGeometry();
+	if(mWaterClipmap)
+		BuildWaterClipmapGeometry();
+	else
+		BuildWavesGeometry();
 	BuildBoxGeometry();
+	mMeshCache->Save();
+	mMeshCache.reset();
 	BuildTreeSpritesGeometry();
 	BuildMaterials();
     BuildRenderItems();
@@ -227,6 +412,9 @@ bool TreeBillboardsApp::Initialize()
     // Wait until initialization is complete.
     FlushCommandQueue();
 
+	if(mAsyncWaves)
+		mAsyncWaves->Start();
+
     return true;
 }
  
@@ -235,7 +423,7 @@ void TreeBillboardsApp::OnResize()
     D3DApp::OnResize();
 
     // The window resized, so update the aspect ratio and recompute the projection matrix.
-    XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
+    XMMATRIX P = XMMatrixPerspectiveFovLH(mFovY, AspectRatio(), 1.0f, 1000.0f);
     XMStoreFloat4x4(&mProj, P);
 }
 
@@ -243,6 +431,7 @@ void TreeBillboardsApp::Update(const GameTimer& gt)
 {
     OnKeyboardInput(gt);
 	UpdateCamera(gt);
+	UpdateLods(gt);
 
     // Cycle through the circular frame resource array.
     mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
@@ -307,7 +496,15 @@ void TreeBillboardsApp::Draw(const GameTimer& gt)
 	mCommandList->SetPipelineState(mPSOs["treeSprites"].Get());
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::AlphaTestedTreeSprites]);
 
-	mCommandList->SetPipelineState(mPSOs["transparent"].Get());
+	if(mCompactWaves)
+	{
+		mCommandList->SetPipelineState(mPSOs["compactWaves"].Get());
+		mCommandList->IASetVertexBuffers(1, 1, &mWavesStaticVBView);
+	}
+	else
+	{
+		mCommandList->SetPipelineState(mPSOs["transparent"].Get());
+	}
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Transparent]);
 
     // Indicate a state transition on the resource usage.
@@ -399,6 +596,35 @@ void TreeBillboardsApp::UpdateCamera(const GameTimer& gt)
 	XMStoreFloat4x4(&mView, view);
 }
 
+void TreeBillboardsApp::UpdateLods(const GameTimer& gt)
+{
+	// Pixels covered by one world unit at distance 1, for the projection built in
+	// OnResize.
+	float pixelsPerUnit = mClientHeight / (2.0f*tanf(0.5f*mFovY));
+
+	for(auto& ritem : mAllRitems)
+	{
+		if(ritem->Lods.empty())
+			continue;
+
+		// The errors are in object space, so scale them by the largest axis scale
+		// of the world matrix.
+		XMMATRIX world = XMLoadFloat4x4(&ritem->World);
+		float scale = MathHelper::Max(XMVectorGetX(XMVector3Length(world.r[0])),
+			MathHelper::Max(XMVectorGetX(XMVector3Length(world.r[1])), XMVectorGetX(XMVector3Length(world.r[2]))));
+		float distance = XMVectorGetX(XMVector3Length(world.r[3] - XMVectorSetW(XMLoadFloat3(&mEyePos), 1.0f)));
+
+		size_t level = 0;
+		while(level + 1 < ritem->Lods.size() &&
+			ritem->LodErrors[level + 1]*scale*pixelsPerUnit < gLodPixelError*distance)
+			++level;
+
+		ritem->IndexCount = ritem->Lods[level].IndexCount;
+		ritem->StartIndexLocation = ritem->Lods[level].StartIndexLocation;
+		ritem->BaseVertexLocation = ritem->Lods[level].BaseVertexLocation;
+	}
+}
+
 void TreeBillboardsApp::AnimateMaterials(const GameTimer& gt)
 {
 	// Scroll the water material texture coordinates.
@@ -535,31 +761,83 @@ void TreeBillboardsApp::UpdateWaves(const GameTimer& gt)
 
 		float r = MathHelper::RandF(0.2f, 0.5f);
 
-		mWaves->Disturb(i, j, r);
+		if(mAsyncWaves)
+			mAsyncWaves->Disturb(i, j, r);
+		else
+			mWaves->Disturb(i, j, r);
 	}
 
-	// Update the wave simulation.
-	mWaves->Update(gt.DeltaTime());
-
-	// Update the wave vertex buffer with the new solution.
-	auto currWavesVB = mCurrFrameResource->WavesVB.get();
-	for(int i = 0; i < mWaves->VertexCount(); ++i)
+	// Pick the dynamic vertex buffer of the current frame.
+	ID3D12Resource* currWavesVB = nullptr;
+	BYTE* wavesVertices = nullptr;
+	if(mCompactWaves)
+	{
+		currWavesVB = mCurrFrameResource->WavesCompactVB->Resource();
+		wavesVertices = mCurrFrameResource->WavesCompactVB->MappedData();
+	}
+	else
 	{
-		Vertex v;
+		currWavesVB = mCurrFrameResource->WavesVB->Resource();
+		wavesVertices = mCurrFrameResource->WavesVB->MappedData();
+	}
 
-		v.Pos = mWaves->Position(i);
-		v.Normal = mWaves->Normal(i);
-		
-		// Derive tex-coords from position by 
-		// mapping [-w/2,w/2] --> [0,1]
-		v.TexC.x = 0.5f + v.Pos.x / mWaves->Width();
-		v.TexC.y = 0.5f - v.Pos.z / mWaves->Depth();
+	if(mAsyncWaves)
+	{
+		// The simulation steps on its own thread; copy the latest finished frame,
+		// unless this frame's buffer already holds it.
+		const void* latest = mAsyncWaves->AcquireLatest();
+		if(mCurrFrameResource->WavesAsyncFrame != mAsyncWaves->AcquiredFrame())
+		{
+			std::memcpy(wavesVertices, latest, (size_t)mWaves->VertexCount()*mAsyncWaves->VertexStride());
+			mCurrFrameResource->WavesAsyncFrame = mAsyncWaves->AcquiredFrame();
+		}
+	}
+	else
+	{
+		// Update the wave simulation and write the new solution straight into
+		// the vertex buffer.
+		mWaves->Update(gt.DeltaTime());
 
-		currWavesVB->CopyData(i, v);
+		if(mWaterClipmap)
+		{
+			UpdateWaterClipmap(wavesVertices);
+		}
+		else
+		{
+			// Every frame's buffer is missing the changes made since it was last
+			// written; rewrite only those vertices of this frame's.
+			for(auto& frameResource : mFrameResources)
+				frameResource->WavesDirty.Merge(mWaves->ChangedRegion());
+			mWaves->ClearChangedRegion();
+
+			Waves::DirtyRegion& dirty = mCurrFrameResource->WavesDirty;
+			if(mCompactWaves)
+				mWaves->WriteCompactVertices(reinterpret_cast<Waves::CompactVertex*>(wavesVertices), dirty);
+			else
+				mWaves->WriteVertices(wavesVertices, WavesVertexLayout(), dirty);
+			dirty.Reset(mWaves->RowCount());
+		}
 	}
 
 	// Set the dynamic VB of the wave renderitem to the current frame VB.
-	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
+	mWavesRitem->Geo->VertexBufferGPU = currWavesVB;
+}
+
+void TreeBillboardsApp::UpdateWaterClipmap(BYTE* wavesVertices)
+{
+	// Resample the new solution into the levels around the eye.
+	mWaterClipmap->SetSource(*mWaves, false);
+	mWaterClipmap->Recenter(mEyePos.x, mEyePos.z);
+	mWaterClipmap->WriteVertices(wavesVertices, WavesVertexLayout());
+
+	for(int level = 0; level < mWaterClipmap->LevelCount(); ++level)
+	{
+		WaterClipmap::LevelDrawArgs args = mWaterClipmap->DrawArgs(level);
+		RenderItem* ri = mWaterClipmapRitems[level];
+		ri->IndexCount = args.IndexCount;
+		ri->StartIndexLocation = args.StartIndexLocation;
+		ri->BaseVertexLocation = args.BaseVertexLocation;
+	}
 }
 
 void TreeBillboardsApp::LoadTextures()
@@ -767,7 +1045,14 @@ void TreeBillboardsApp::BuildShadersAndInputLayouts()
 		NULL, NULL
 	};
 
+	const D3D_SHADER_MACRO compactWavesDefines[] =
+	{
+		"COMPACT_WAVES", "1",
+		NULL, NULL
+	};
+
 	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_1");
+	mShaders["compactWavesVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", compactWavesDefines, "VS", "vs_5_1");
 	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", defines, "PS", "ps_5_1");
 	mShaders["alphaTestedPS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", alphaTestDefines, "PS", "ps_5_1");
 	
@@ -787,12 +1072,24 @@ void TreeBillboardsApp::BuildShadersAndInputLayouts()
 		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 		{ "SIZE", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 	};
+
+	mCompactWavesInputLayout =
+	{
+		{ "HEIGHT", 0, DXGI_FORMAT_R16_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 4, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 1, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
 }
 
 void TreeBillboardsApp::BuildLandGeometry()
 {
     GeometryGenerator geoGen;
-    GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.0f, 160.0f, 50, 50);
+    GeometryGenerator::MeshData grid = mMeshCache->Generate("CreateGrid", geoGen, &GeometryGenerator::CreateGrid, 160.0f, 160.0f, 50, 50).ToMeshData();
+
+	// 16-bit indices however fine the grid is; may add vertices, so done first.
+	std::vector<std::uint16_t> indices;
+	std::vector<GeometryGenerator::MeshData::Chunk16> chunks = grid.SplitIndices16(indices);
 
     //
     // Extract the vertex elements we are interested and apply the height function to
@@ -811,8 +1108,6 @@ void TreeBillboardsApp::BuildLandGeometry()
     }
 
     const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-
-    std::vector<std::uint16_t> indices = grid.GetIndices16();
     const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
@@ -835,20 +1130,23 @@ void TreeBillboardsApp::BuildLandGeometry()
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
-	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
-	submesh.StartIndexLocation = 0;
-	submesh.BaseVertexLocation = 0;
+	// The first chunk is "grid", the others "grid_chunk1", "grid_chunk2", ...
+	for(size_t i = 0; i < chunks.size(); ++i)
+	{
+		SubmeshGeometry submesh;
+		submesh.IndexCount = chunks[i].IndexCount;
+		submesh.StartIndexLocation = chunks[i].StartIndexLocation;
+		submesh.BaseVertexLocation = chunks[i].BaseVertexLocation;
 
-	geo->DrawArgs["grid"] = submesh;
+		geo->DrawArgs[i == 0 ? std::string("grid") : "grid_chunk" + std::to_string(i)] = submesh;
+	}
 
 	mGeometries["landGeo"] = std::move(geo);
 }
 
 void TreeBillboardsApp::BuildWavesGeometry()
 {
-    std::vector<std::uint16_t> indices(3 * mWaves->TriangleCount()); // 3 indices per face
-	assert(mWaves->VertexCount() < 0x0000ffff);
+    std::vector<std::uint32_t> indices(3 * mWaves->TriangleCount()); // 3 indices per face
 
     // Iterate over each quad.
     int m = mWaves->RowCount();
@@ -870,8 +1168,26 @@ void TreeBillboardsApp::BuildWavesGeometry()
         }
     }
 
-	UINT vbByteSize = mWaves->VertexCount()*sizeof(Vertex);
-	UINT ibByteSize = (UINT)indices.size()*sizeof(std::uint16_t);
+	std::vector<std::uint8_t> indexBytes;
+	DXGI_FORMAT indexFormat = PackIndices(indices, indexBytes);
+
+	UINT vertexByteStride = mCompactWaves ? sizeof(Waves::CompactVertex) : sizeof(Vertex);
+	UINT vbByteSize = mWaves->VertexCount()*vertexByteStride;
+	UINT ibByteSize = (UINT)indexBytes.size();
+
+	if(mCompactWaves)
+	{
+		std::vector<Waves::StaticVertex> staticVertices(mWaves->VertexCount());
+		mWaves->WriteStaticVertices(staticVertices.data());
+
+		UINT staticByteSize = (UINT)staticVertices.size()*sizeof(Waves::StaticVertex);
+		mWavesStaticVB = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+			mCommandList.Get(), staticVertices.data(), staticByteSize, mWavesStaticVBUploader);
+
+		mWavesStaticVBView.BufferLocation = mWavesStaticVB->GetGPUVirtualAddress();
+		mWavesStaticVBView.StrideInBytes = sizeof(Waves::StaticVertex);
+		mWavesStaticVBView.SizeInBytes = staticByteSize;
+	}
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "waterGeo";
@@ -881,14 +1197,14 @@ void TreeBillboardsApp::BuildWavesGeometry()
 	geo->VertexBufferGPU = nullptr;
 
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indexBytes.data(), ibByteSize);
 
 	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+		mCommandList.Get(), indexBytes.data(), ibByteSize, geo->IndexBufferUploader);
 
-	geo->VertexByteStride = sizeof(Vertex);
+	geo->VertexByteStride = vertexByteStride;
 	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+	geo->IndexFormat = indexFormat;
 	geo->IndexBufferByteSize = ibByteSize;
 
 	SubmeshGeometry submesh;
@@ -901,144 +1217,117 @@ void TreeBillboardsApp::BuildWavesGeometry()
 	mGeometries["waterGeo"] = std::move(geo);
 }
 
+void TreeBillboardsApp::BuildWaterClipmapGeometry()
+{
+	const std::vector<std::uint32_t>& indices = mWaterClipmap->Indices();
+
+	UINT vbByteSize = mWaterClipmap->VertexCount()*sizeof(Vertex);
+	UINT ibByteSize = (UINT)indices.size()*sizeof(std::uint32_t);
+
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = "waterGeo";
+
+	// Set dynamically.
+	geo->VertexBufferCPU = nullptr;
+	geo->VertexBufferGPU = nullptr;
+
+	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+
+	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+
+	geo->VertexByteStride = sizeof(Vertex);
+	geo->VertexBufferByteSize = vbByteSize;
+	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
+	geo->IndexBufferByteSize = ibByteSize;
+
+	// The draw arguments change with the eye; level 0 is the whole grid.
+	WaterClipmap::LevelDrawArgs args = mWaterClipmap->DrawArgs(0);
+
+	SubmeshGeometry submesh;
+	submesh.IndexCount = (UINT)args.IndexCount;
+	submesh.StartIndexLocation = (UINT)args.StartIndexLocation;
+	submesh.BaseVertexLocation = args.BaseVertexLocation;
+
+	geo->DrawArgs["grid"] = submesh;
+
+	mGeometries["waterGeo"] = std::move(geo);
+}
+
 void TreeBillboardsApp::BuildBoxGeometry()
 {
 	GeometryGenerator geoGen;
+	MeshCache& cache = *mMeshCache;
 
-	GeometryGenerator::MeshData grid = geoGen.CreateGrid(30.0f, 30.0f, 15, 15);
-	GeometryGenerator::MeshData box = geoGen.CreateBox(8.0f, 8.0f, 8.0f, 2);
-	GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(1.5f, 1.0f, 8.0f, 10, 5);
-	GeometryGenerator::MeshData pyramid = geoGen.CreateSquarePyramid(5.0f, 7.0f, 7.0f, 2);
-	GeometryGenerator::MeshData cone = geoGen.CreateCone(1.5f, 1.5f, 6.0f, 3.0f);
-	GeometryGenerator::MeshData torus = geoGen.CreateTorus(1.5f, 0.3f, 8, 6);
-	GeometryGenerator::MeshData diamond = geoGen.CreateDiamond(2.0f, 2.0f, 1.0f, 1);
-	GeometryGenerator::MeshData sphere = geoGen.CreateSphere(1.0f, 6.0f, 6.0f);
-
-	UINT gridVertexOffset = 0;
-	UINT boxVertexOffset = grid.Vertices.size();
-	UINT cylinderVertexOffset = boxVertexOffset + box.Vertices.size();
-	UINT pyramidVertexOffset = cylinderVertexOffset + cylinder.Vertices.size();
-	UINT coneVertexOffset = pyramidVertexOffset + pyramid.Vertices.size();
-	UINT torusVertexOffset = coneVertexOffset + cone.Vertices.size();
-	UINT diamondVertexOffset = torusVertexOffset + torus.Vertices.size();
-	UINT sphereVertexOffset = diamondVertexOffset + diamond.Vertices.size();
-
-	UINT gridIndexOffset = 0;
-	UINT boxIndexOffset = grid.Indices32.size();
-	UINT cylinderIndexOffset = boxIndexOffset + box.Indices32.size();
-	UINT pyramidIndexOffset = cylinderIndexOffset + cylinder.Indices32.size();
-	UINT coneIndexOffset = pyramidIndexOffset + pyramid.Indices32.size();
-	UINT torusIndexOffset = coneIndexOffset + cone.Indices32.size();
-	UINT diamondIndexOffset = torusIndexOffset + torus.Indices32.size();
-	UINT sphereIndexOffset = diamondIndexOffset + diamond.Indices32.size();
-
-
-	SubmeshGeometry gridSubmesh;
-	gridSubmesh.IndexCount = grid.Indices32.size();
-	gridSubmesh.StartIndexLocation = gridIndexOffset;
-	gridSubmesh.BaseVertexLocation = gridVertexOffset;
-
-	SubmeshGeometry boxSubmesh;
-	boxSubmesh.IndexCount = (UINT)box.Indices32.size();
-	boxSubmesh.StartIndexLocation = boxIndexOffset;
-	boxSubmesh.BaseVertexLocation = boxVertexOffset;
-
-	SubmeshGeometry cylinderSubmesh;
-	cylinderSubmesh.IndexCount = (UINT)cylinder.Indices32.size();
-	cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
-	cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
-
-	SubmeshGeometry pyramidSubmesh;
-	pyramidSubmesh.IndexCount = (UINT)pyramid.Indices32.size();
-	pyramidSubmesh.StartIndexLocation = pyramidIndexOffset;
-	pyramidSubmesh.BaseVertexLocation = pyramidVertexOffset;
-
-	SubmeshGeometry coneSubmesh;
-	coneSubmesh.IndexCount = (UINT)cone.Indices32.size();
-	coneSubmesh.StartIndexLocation = coneIndexOffset;
-	coneSubmesh.BaseVertexLocation = coneVertexOffset;
-
-	SubmeshGeometry torusSubmesh;
-	torusSubmesh.IndexCount = (UINT)torus.Indices32.size();
-	torusSubmesh.StartIndexLocation = torusIndexOffset;
-	torusSubmesh.BaseVertexLocation = torusVertexOffset;
-
-	SubmeshGeometry diamondSubmesh;
-	diamondSubmesh.IndexCount = (UINT)diamond.Indices32.size();
-	diamondSubmesh.StartIndexLocation = diamondIndexOffset;
-	diamondSubmesh.BaseVertexLocation = diamondVertexOffset;
-
-	SubmeshGeometry sphereSubmesh;
-	sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
-	sphereSubmesh.StartIndexLocation = sphereIndexOffset;
-	sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
-
-	auto totalVertexCount = grid.Vertices.size() + box.Vertices.size() + cylinder.Vertices.size() + pyramid.Vertices.size() + cone.Vertices.size() + torus.Vertices.size() + diamond.Vertices.size() + sphere.Vertices.size();
-
-	std::vector<Vertex> vertices(totalVertexCount);
-
-	UINT k = 0;
-	for (size_t i = 0; i < grid.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = grid.Vertices[i].Position;
-		vertices[k].Normal = grid.Vertices[i].Normal;
-		vertices[k].TexC = grid.Vertices[i].TexC;
-	}
-	for (size_t i = 0; i < box.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = box.Vertices[i].Position;
-		vertices[k].Normal = box.Vertices[i].Normal;
-		vertices[k].TexC = box.Vertices[i].TexC;
-	}
-	for (size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
+	struct NamedMesh
 	{
-		vertices[k].Pos = cylinder.Vertices[i].Position;
-		vertices[k].Normal = cylinder.Vertices[i].Normal;
-		vertices[k].TexC = cylinder.Vertices[i].TexC;
-	}
-	for (size_t i = 0; i < pyramid.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = pyramid.Vertices[i].Position;
-		vertices[k].Normal = pyramid.Vertices[i].Normal;
-		vertices[k].TexC = pyramid.Vertices[i].TexC;
-	}
-	for (size_t i = 0; i < cone.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = cone.Vertices[i].Position;
-		vertices[k].Normal = cone.Vertices[i].Normal;
-		vertices[k].TexC = cone.Vertices[i].TexC;
-	}
-	for (size_t i = 0; i < torus.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = torus.Vertices[i].Position;
-		vertices[k].Normal = torus.Vertices[i].Normal;
-		vertices[k].TexC = torus.Vertices[i].TexC;
-	}
-	for (size_t i = 0; i < diamond.Vertices.size(); ++i, ++k)
+		const char* Name;
+
+		// The full mesh, then its simplified levels.
+		std::vector<MeshCache::MeshView> Levels;
+	};
+
+	std::vector<NamedMesh> meshes;
+	meshes.push_back({ "grid", ProcessedMesh(cache, LodTriangleRatios("grid"), "CreateGrid", geoGen, &GeometryGenerator::CreateGrid, 30.0f, 30.0f, 15, 15) });
+	meshes.push_back({ "box", ProcessedMesh(cache, LodTriangleRatios("box"), "CreateBox", geoGen, &GeometryGenerator::CreateBox, 8.0f, 8.0f, 8.0f, 2) });
+	meshes.push_back({ "cylinder", ProcessedMesh(cache, LodTriangleRatios("cylinder"), "CreateCylinder", geoGen, &GeometryGenerator::CreateCylinder, 1.5f, 1.0f, 8.0f, 10, 5) });
+	meshes.push_back({ "pyramid", ProcessedMesh(cache, LodTriangleRatios("pyramid"), "CreateSquarePyramid", geoGen, &GeometryGenerator::CreateSquarePyramid, 5.0f, 7.0f, 7.0f, 2) });
+	meshes.push_back({ "cone", ProcessedMesh(cache, LodTriangleRatios("cone"), "CreateCone", geoGen, &GeometryGenerator::CreateCone, 1.5f, 1.5f, 6.0f, 3.0f) });
+	meshes.push_back({ "torus", ProcessedMesh(cache, LodTriangleRatios("torus"), "CreateTorus", geoGen, &GeometryGenerator::CreateTorus, 1.5f, 0.3f, 8, 6) });
+	meshes.push_back({ "diamond", ProcessedMesh(cache, LodTriangleRatios("diamond"), "CreateDiamond", geoGen, &GeometryGenerator::CreateDiamond, 2.0f, 2.0f, 1.0f, 1) });
+	meshes.push_back({ "sphere", ProcessedMesh(cache, LodTriangleRatios("sphere"), "CreateSphere", geoGen, &GeometryGenerator::CreateSphere, 1.0f, 6.0f, 6.0f) });
+
+	size_t totalVertexCount = 0;
+	size_t totalIndexCount = 0;
+	for(const NamedMesh& mesh : meshes)
 	{
-		vertices[k].Pos = diamond.Vertices[i].Position;
-		vertices[k].Normal = diamond.Vertices[i].Normal;
-		vertices[k].TexC = diamond.Vertices[i].TexC;
+		for(const MeshCache::MeshView& view : mesh.Levels)
+		{
+			totalVertexCount += view.VertexCount;
+			totalIndexCount += view.IndexCount;
+		}
 	}
-	for (size_t i = 0; i < sphere.Vertices.size(); ++i, ++k)
+
+	// Every mesh and level is read straight out of its view.  Each one's indices
+	// stay relative to its BaseVertexLocation, so the buffer only needs 32-bit
+	// indices if a single mesh has more than 65536 vertices.
+	std::vector<Vertex> vertices;
+	std::vector<std::uint32_t> indices;
+	vertices.reserve(totalVertexCount);
+	indices.reserve(totalIndexCount);
+
+	std::unordered_map<std::string, SubmeshGeometry> submeshes;
+	for(const NamedMesh& mesh : meshes)
 	{
-		vertices[k].Pos = sphere.Vertices[i].Position;
-		vertices[k].Normal = sphere.Vertices[i].Normal;
-		vertices[k].TexC = sphere.Vertices[i].TexC;
+		for(size_t level = 0; level < mesh.Levels.size(); ++level)
+		{
+			const MeshCache::MeshView& view = mesh.Levels[level];
+
+			std::string name = mesh.Name;
+			if(level > 0)
+			{
+				name += "_lod" + std::to_string(level);
+				mLodErrors[name] = view.Error;
+			}
+
+			SubmeshGeometry submesh;
+			submesh.IndexCount = view.IndexCount;
+			submesh.StartIndexLocation = (UINT)indices.size();
+			submesh.BaseVertexLocation = (INT)vertices.size();
+			submeshes[name] = submesh;
+
+			for(std::uint32_t i = 0; i < view.VertexCount; ++i)
+				vertices.push_back({ view.Vertices[i].Position, view.Vertices[i].Normal, view.Vertices[i].TexC });
+			indices.insert(indices.end(), view.Indices, view.Indices + view.IndexCount);
+		}
 	}
 
-	std::vector<std::uint16_t> indices;
-	indices.insert(indices.end(), std::begin(grid.GetIndices16()), std::end(grid.GetIndices16()));
-	indices.insert(indices.end(), std::begin(box.GetIndices16()), std::end(box.GetIndices16()));
-	indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
-	indices.insert(indices.end(), std::begin(pyramid.GetIndices16()), std::end(pyramid.GetIndices16()));
-	indices.insert(indices.end(), std::begin(cone.GetIndices16()), std::end(cone.GetIndices16()));
-	indices.insert(indices.end(), std::begin(torus.GetIndices16()), std::end(torus.GetIndices16()));
-	indices.insert(indices.end(), std::begin(diamond.GetIndices16()), std::end(diamond.GetIndices16()));
-	indices.insert(indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
+	std::vector<std::uint8_t> indexBytes;
+	DXGI_FORMAT indexFormat = PackIndices(indices, indexBytes);
 
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+	const UINT ibByteSize = (UINT)indexBytes.size();
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "boxGeo";
@@ -1047,27 +1336,21 @@ void TreeBillboardsApp::BuildBoxGeometry()
 	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
 
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indexBytes.data(), ibByteSize);
 
 	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
 		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
 	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+		mCommandList.Get(), indexBytes.data(), ibByteSize, geo->IndexBufferUploader);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+	geo->IndexFormat = indexFormat;
 	geo->IndexBufferByteSize = ibByteSize;
 
-	geo->DrawArgs["grid"] = gridSubmesh;
-	geo->DrawArgs["box"] = boxSubmesh;
-	geo->DrawArgs["cylinder"] = cylinderSubmesh;
-	geo->DrawArgs["pyramid"] = pyramidSubmesh;
-	geo->DrawArgs["cone"] = coneSubmesh;
-	geo->DrawArgs["torus"] = torusSubmesh;
-	geo->DrawArgs["diamond"] = diamondSubmesh;
-	geo->DrawArgs["sphere"] = sphereSubmesh;
+	for(const auto& submesh : submeshes)
+		geo->DrawArgs[submesh.first] = submesh.second;
 
 	mGeometries["boxGeo"] = std::move(geo);
 }
@@ -1195,6 +1478,19 @@ void TreeBillboardsApp::BuildPSOs()
 	transparentPsoDesc.BlendState.RenderTarget[0] = transparencyBlendDesc;
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&transparentPsoDesc, IID_PPV_ARGS(&mPSOs["transparent"])));
 
+	//
+	// PSO for the waves drawn from the compact two-stream layout
+	//
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC compactWavesPsoDesc = transparentPsoDesc;
+	compactWavesPsoDesc.InputLayout = { mCompactWavesInputLayout.data(), (UINT)mCompactWavesInputLayout.size() };
+	compactWavesPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["compactWavesVS"]->GetBufferPointer()),
+		mShaders["compactWavesVS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&compactWavesPsoDesc, IID_PPV_ARGS(&mPSOs["compactWaves"])));
+
 	//
 	// PSO for alpha tested objects
 	//
@@ -1237,10 +1533,14 @@ void TreeBillboardsApp::BuildPSOs()
 
 void TreeBillboardsApp::BuildFrameResources()
 {
+	UINT wavesVertexCount = mWaterClipmap ? mWaterClipmap->VertexCount() : mWaves->VertexCount();
     for(int i = 0; i < gNumFrameResources; ++i)
     {
         mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-            1, (UINT)mAllRitems.size(), (UINT)mMaterials.size(), mWaves->VertexCount()));
+            1, (UINT)mAllRitems.size(), (UINT)mMaterials.size(), wavesVertexCount, mCompactWaves));
+
+		// Nothing has been written to the new buffer yet.
+		mFrameResources.back()->WavesDirty.MarkAll(mWaves->RowCount(), mWaves->ColumnCount());
     }
 }
 
@@ -1331,6 +1631,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	wavesRitem->Mat = mMaterials["water"].get();
 	wavesRitem->Geo = mGeometries["waterGeo"].get();
 	wavesRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	wavesRitem->Submesh = "grid";
 	wavesRitem->IndexCount = wavesRitem->Geo->DrawArgs["grid"].IndexCount;
 	wavesRitem->StartIndexLocation = wavesRitem->Geo->DrawArgs["grid"].StartIndexLocation;
 	wavesRitem->BaseVertexLocation = wavesRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
@@ -1338,6 +1639,19 @@ void TreeBillboardsApp::BuildRenderItems()
 	mRitemLayer[(int)RenderLayer::Transparent].push_back(wavesRitem.get());
 	mAllRitems.push_back(std::move(wavesRitem));
 
+	if(mWaterClipmap)
+	{
+		// The waves item draws level 0; the coarser levels share its constants.
+		mWaterClipmapRitems.push_back(mWavesRitem);
+		for(int level = 1; level < mWaterClipmap->LevelCount(); ++level)
+		{
+			auto levelRitem = std::make_unique<RenderItem>(*mWavesRitem);
+			mWaterClipmapRitems.push_back(levelRitem.get());
+			mRitemLayer[(int)RenderLayer::Transparent].push_back(levelRitem.get());
+			mAllRitems.push_back(std::move(levelRitem));
+		}
+	}
+
 	/*auto gridRitem = std::make_unique<RenderItem>();
 	XMStoreFloat4x4(&gridRitem->World, XMMatrixScaling(4.0f, 4.0f, 4.0f) * XMMatrixTranslation(1.0f, -1.0f, 1.0f));
 	XMStoreFloat4x4(&gridRitem->TexTransform, XMMatrixScaling(8.0f, 8.0f, 1.0f));
@@ -1345,6 +1659,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	gridRitem->Mat = mMaterials["grass"].get();
 	gridRitem->Geo = mGeometries["boxGeo"].get();
 	gridRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	gridRitem->Submesh = "grid";
 	gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
 	gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
 	gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
@@ -1358,9 +1673,12 @@ void TreeBillboardsApp::BuildRenderItems()
 	gridRitem->Mat = mMaterials["grass"].get();
 	gridRitem->Geo = mGeometries["landGeo"].get();
 	gridRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+    gridRitem->Submesh = "grid";
     gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
     gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
     gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+	for(size_t i = 1; gridRitem->Geo->DrawArgs.count("grid_chunk" + std::to_string(i)); ++i)
+		gridRitem->Chunks.push_back(gridRitem->Geo->DrawArgs["grid_chunk" + std::to_string(i)]);
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(gridRitem.get());
 	mAllRitems.push_back(std::move(gridRitem));
 
@@ -1372,6 +1690,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	gridRitem->Mat = mMaterials["grass"].get();
 	gridRitem->Geo = mGeometries["boxGeo"].get();
 	gridRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	gridRitem->Submesh = "grid";
 	gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
 	gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
 	gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
@@ -1386,6 +1705,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	boxRitem->Mat = mMaterials["stone"].get();
 	boxRitem->Geo = mGeometries["boxGeo"].get();
 	boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	boxRitem->Submesh = "box";
 	boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
 	boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
 	boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1400,6 +1720,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	CylRitem->Mat = mMaterials["stone"].get();
 	CylRitem->Geo = mGeometries["boxGeo"].get();
 	CylRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	CylRitem->Submesh = "cylinder";
 	CylRitem->IndexCount = CylRitem->Geo->DrawArgs["cylinder"].IndexCount;
 	CylRitem->StartIndexLocation = CylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
 	CylRitem->BaseVertexLocation = CylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
@@ -1414,6 +1735,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	CylRitem1->Mat = mMaterials["stone"].get();
 	CylRitem1->Geo = mGeometries["boxGeo"].get();
 	CylRitem1->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	CylRitem1->Submesh = "cylinder";
 	CylRitem1->IndexCount = CylRitem1->Geo->DrawArgs["cylinder"].IndexCount;
 	CylRitem1->StartIndexLocation = CylRitem1->Geo->DrawArgs["cylinder"].StartIndexLocation;
 	CylRitem1->BaseVertexLocation = CylRitem1->Geo->DrawArgs["cylinder"].BaseVertexLocation;
@@ -1428,6 +1750,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	CylRitem2->Mat = mMaterials["stone"].get();
 	CylRitem2->Geo = mGeometries["boxGeo"].get();
 	CylRitem2->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	CylRitem2->Submesh = "cylinder";
 	CylRitem2->IndexCount = CylRitem2->Geo->DrawArgs["cylinder"].IndexCount;
 	CylRitem2->StartIndexLocation = CylRitem2->Geo->DrawArgs["cylinder"].StartIndexLocation;
 	CylRitem2->BaseVertexLocation = CylRitem2->Geo->DrawArgs["cylinder"].BaseVertexLocation;
@@ -1442,6 +1765,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	CylRitem3->Mat = mMaterials["stone"].get();
 	CylRitem3->Geo = mGeometries["boxGeo"].get();
 	CylRitem3->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	CylRitem3->Submesh = "cylinder";
 	CylRitem3->IndexCount = CylRitem3->Geo->DrawArgs["cylinder"].IndexCount;
 	CylRitem3->StartIndexLocation = CylRitem3->Geo->DrawArgs["cylinder"].StartIndexLocation;
 	CylRitem3->BaseVertexLocation = CylRitem3->Geo->DrawArgs["cylinder"].BaseVertexLocation;
@@ -1456,6 +1780,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	pyramidRitem->Mat = mMaterials["marble"].get();
 	pyramidRitem->Geo = mGeometries["boxGeo"].get();
 	pyramidRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	pyramidRitem->Submesh = "pyramid";
 	pyramidRitem->IndexCount = pyramidRitem->Geo->DrawArgs["pyramid"].IndexCount;
 	pyramidRitem->StartIndexLocation = pyramidRitem->Geo->DrawArgs["pyramid"].StartIndexLocation;
 	pyramidRitem->BaseVertexLocation = pyramidRitem->Geo->DrawArgs["pyramid"].BaseVertexLocation;
@@ -1470,6 +1795,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	coneRitem->Mat = mMaterials["marble2"].get();
 	coneRitem->Geo = mGeometries["boxGeo"].get();
 	coneRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	coneRitem->Submesh = "cone";
 	coneRitem->IndexCount = coneRitem->Geo->DrawArgs["cone"].IndexCount;
 	coneRitem->StartIndexLocation = coneRitem->Geo->DrawArgs["cone"].StartIndexLocation;
 	coneRitem->BaseVertexLocation = coneRitem->Geo->DrawArgs["cone"].BaseVertexLocation;
@@ -1484,6 +1810,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	coneRitem2->Mat = mMaterials["marble2"].get();
 	coneRitem2->Geo = mGeometries["boxGeo"].get();
 	coneRitem2->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	coneRitem2->Submesh = "cone";
 	coneRitem2->IndexCount = coneRitem2->Geo->DrawArgs["cone"].IndexCount;
 	coneRitem2->StartIndexLocation = coneRitem2->Geo->DrawArgs["cone"].StartIndexLocation;
 	coneRitem2->BaseVertexLocation = coneRitem2->Geo->DrawArgs["cone"].BaseVertexLocation;
@@ -1498,6 +1825,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	coneRitem3->Mat = mMaterials["marble2"].get();
 	coneRitem3->Geo = mGeometries["boxGeo"].get();
 	coneRitem3->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	coneRitem3->Submesh = "cone";
 	coneRitem3->IndexCount = coneRitem3->Geo->DrawArgs["cone"].IndexCount;
 	coneRitem3->StartIndexLocation = coneRitem3->Geo->DrawArgs["cone"].StartIndexLocation;
 	coneRitem3->BaseVertexLocation = coneRitem3->Geo->DrawArgs["cone"].BaseVertexLocation;
@@ -1512,6 +1840,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	coneRitem4->Mat = mMaterials["marble2"].get();
 	coneRitem4->Geo = mGeometries["boxGeo"].get();
 	coneRitem4->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	coneRitem4->Submesh = "cone";
 	coneRitem4->IndexCount = coneRitem4->Geo->DrawArgs["cone"].IndexCount;
 	coneRitem4->StartIndexLocation = coneRitem4->Geo->DrawArgs["cone"].StartIndexLocation;
 	coneRitem4->BaseVertexLocation = coneRitem4->Geo->DrawArgs["cone"].BaseVertexLocation;
@@ -1526,6 +1855,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	torusRitem4->Mat = mMaterials["marble2"].get();
 	torusRitem4->Geo = mGeometries["boxGeo"].get();
 	torusRitem4->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	torusRitem4->Submesh = "torus";
 	torusRitem4->IndexCount = torusRitem4->Geo->DrawArgs["torus"].IndexCount;
 	torusRitem4->StartIndexLocation = torusRitem4->Geo->DrawArgs["torus"].StartIndexLocation;
 	torusRitem4->BaseVertexLocation = torusRitem4->Geo->DrawArgs["torus"].BaseVertexLocation;
@@ -1540,6 +1870,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	diamondRitem4->Mat = mMaterials["gold"].get();
 	diamondRitem4->Geo = mGeometries["boxGeo"].get();
 	diamondRitem4->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	diamondRitem4->Submesh = "diamond";
 	diamondRitem4->IndexCount = diamondRitem4->Geo->DrawArgs["diamond"].IndexCount;
 	diamondRitem4->StartIndexLocation = diamondRitem4->Geo->DrawArgs["diamond"].StartIndexLocation;
 	diamondRitem4->BaseVertexLocation = diamondRitem4->Geo->DrawArgs["diamond"].BaseVertexLocation;
@@ -1554,6 +1885,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	boxRitem1->Mat = mMaterials["bricks"].get();
 	boxRitem1->Geo = mGeometries["boxGeo"].get();
 	boxRitem1->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	boxRitem1->Submesh = "box";
 	boxRitem1->IndexCount = boxRitem1->Geo->DrawArgs["box"].IndexCount;
 	boxRitem1->StartIndexLocation = boxRitem1->Geo->DrawArgs["box"].StartIndexLocation;
 	boxRitem1->BaseVertexLocation = boxRitem1->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1568,6 +1900,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	boxRitem2->Mat = mMaterials["bricks"].get();
 	boxRitem2->Geo = mGeometries["boxGeo"].get();
 	boxRitem2->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	boxRitem2->Submesh = "box";
 	boxRitem2->IndexCount = boxRitem2->Geo->DrawArgs["box"].IndexCount;
 	boxRitem2->StartIndexLocation = boxRitem2->Geo->DrawArgs["box"].StartIndexLocation;
 	boxRitem2->BaseVertexLocation = boxRitem2->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1582,6 +1915,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	boxRitem3->Mat = mMaterials["bricks"].get();
 	boxRitem3->Geo = mGeometries["boxGeo"].get();
 	boxRitem3->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	boxRitem3->Submesh = "box";
 	boxRitem3->IndexCount = boxRitem3->Geo->DrawArgs["box"].IndexCount;
 	boxRitem3->StartIndexLocation = boxRitem3->Geo->DrawArgs["box"].StartIndexLocation;
 	boxRitem3->BaseVertexLocation = boxRitem3->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1596,6 +1930,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	boxRitem4->Mat = mMaterials["bricks"].get();
 	boxRitem4->Geo = mGeometries["boxGeo"].get();
 	boxRitem4->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	boxRitem4->Submesh = "box";
 	boxRitem4->IndexCount = boxRitem4->Geo->DrawArgs["box"].IndexCount;
 	boxRitem4->StartIndexLocation = boxRitem4->Geo->DrawArgs["box"].StartIndexLocation;
 	boxRitem4->BaseVertexLocation = boxRitem4->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1610,6 +1945,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	boxRitem5->Mat = mMaterials["bricks"].get();
 	boxRitem5->Geo = mGeometries["boxGeo"].get();
 	boxRitem5->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	boxRitem5->Submesh = "box";
 	boxRitem5->IndexCount = boxRitem5->Geo->DrawArgs["box"].IndexCount;
 	boxRitem5->StartIndexLocation = boxRitem5->Geo->DrawArgs["box"].StartIndexLocation;
 	boxRitem5->BaseVertexLocation = boxRitem5->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1624,6 +1960,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	CylRitem4->Mat = mMaterials["stone"].get();
 	CylRitem4->Geo = mGeometries["boxGeo"].get();
 	CylRitem4->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	CylRitem4->Submesh = "cylinder";
 	CylRitem4->IndexCount = CylRitem4->Geo->DrawArgs["cylinder"].IndexCount;
 	CylRitem4->StartIndexLocation = CylRitem4->Geo->DrawArgs["cylinder"].StartIndexLocation;
 	CylRitem4->BaseVertexLocation = CylRitem4->Geo->DrawArgs["cylinder"].BaseVertexLocation;
@@ -1638,6 +1975,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	CylRitem5->Mat = mMaterials["stone"].get();
 	CylRitem5->Geo = mGeometries["boxGeo"].get();
 	CylRitem5->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	CylRitem5->Submesh = "cylinder";
 	CylRitem5->IndexCount = CylRitem5->Geo->DrawArgs["cylinder"].IndexCount;
 	CylRitem5->StartIndexLocation = CylRitem5->Geo->DrawArgs["cylinder"].StartIndexLocation;
 	CylRitem5->BaseVertexLocation = CylRitem5->Geo->DrawArgs["cylinder"].BaseVertexLocation;
@@ -1652,6 +1990,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	CylRitem6->Mat = mMaterials["stone"].get();
 	CylRitem6->Geo = mGeometries["boxGeo"].get();
 	CylRitem6->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	CylRitem6->Submesh = "cylinder";
 	CylRitem6->IndexCount = CylRitem6->Geo->DrawArgs["cylinder"].IndexCount;
 	CylRitem6->StartIndexLocation = CylRitem6->Geo->DrawArgs["cylinder"].StartIndexLocation;
 	CylRitem6->BaseVertexLocation = CylRitem6->Geo->DrawArgs["cylinder"].BaseVertexLocation;
@@ -1667,6 +2006,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	CylRitem7->Mat = mMaterials["stone"].get();
 	CylRitem7->Geo = mGeometries["boxGeo"].get();
 	CylRitem7->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	CylRitem7->Submesh = "cylinder";
 	CylRitem7->IndexCount = CylRitem7->Geo->DrawArgs["cylinder"].IndexCount;
 	CylRitem7->StartIndexLocation = CylRitem7->Geo->DrawArgs["cylinder"].StartIndexLocation;
 	CylRitem7->BaseVertexLocation = CylRitem7->Geo->DrawArgs["cylinder"].BaseVertexLocation;
@@ -1681,6 +2021,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	sphereRitem->Mat = mMaterials["gold"].get();
 	sphereRitem->Geo = mGeometries["boxGeo"].get();
 	sphereRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	sphereRitem->Submesh = "sphere";
 	sphereRitem->IndexCount = sphereRitem->Geo->DrawArgs["sphere"].IndexCount;
 	sphereRitem->StartIndexLocation = sphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 	sphereRitem->BaseVertexLocation = sphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
@@ -1695,6 +2036,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	sphereRitem1->Mat = mMaterials["gold"].get();
 	sphereRitem1->Geo = mGeometries["boxGeo"].get();
 	sphereRitem1->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	sphereRitem1->Submesh = "sphere";
 	sphereRitem1->IndexCount = sphereRitem1->Geo->DrawArgs["sphere"].IndexCount;
 	sphereRitem1->StartIndexLocation = sphereRitem1->Geo->DrawArgs["sphere"].StartIndexLocation;
 	sphereRitem1->BaseVertexLocation = sphereRitem1->Geo->DrawArgs["sphere"].BaseVertexLocation;
@@ -1709,6 +2051,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	coneRitem5->Mat = mMaterials["marble2"].get();
 	coneRitem5->Geo = mGeometries["boxGeo"].get();
 	coneRitem5->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	coneRitem5->Submesh = "cone";
 	coneRitem5->IndexCount = coneRitem5->Geo->DrawArgs["cone"].IndexCount;
 	coneRitem5->StartIndexLocation = coneRitem5->Geo->DrawArgs["cone"].StartIndexLocation;
 	coneRitem5->BaseVertexLocation = coneRitem5->Geo->DrawArgs["cone"].BaseVertexLocation;
@@ -1723,6 +2066,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	coneRitem6->Mat = mMaterials["marble2"].get();
 	coneRitem6->Geo = mGeometries["boxGeo"].get();
 	coneRitem6->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	coneRitem6->Submesh = "cone";
 	coneRitem6->IndexCount = coneRitem6->Geo->DrawArgs["cone"].IndexCount;
 	coneRitem6->StartIndexLocation = coneRitem6->Geo->DrawArgs["cone"].StartIndexLocation;
 	coneRitem6->BaseVertexLocation = coneRitem6->Geo->DrawArgs["cone"].BaseVertexLocation;
@@ -1736,6 +2080,7 @@ void TreeBillboardsApp::BuildRenderItems()
 	treeSpritesRitem->Geo = mGeometries["treeSpritesGeo"].get();
 	//step2
 	treeSpritesRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_POINTLIST;
+	treeSpritesRitem->Submesh = "points";
 	treeSpritesRitem->IndexCount = treeSpritesRitem->Geo->DrawArgs["points"].IndexCount;
 	treeSpritesRitem->StartIndexLocation = treeSpritesRitem->Geo->DrawArgs["points"].StartIndexLocation;
 	treeSpritesRitem->BaseVertexLocation = treeSpritesRitem->Geo->DrawArgs["points"].BaseVertexLocation;
@@ -1743,6 +2088,25 @@ void TreeBillboardsApp::BuildRenderItems()
 	mRitemLayer[(int)RenderLayer::AlphaTestedTreeSprites].push_back(treeSpritesRitem.get());
 	mAllRitems.push_back(std::move(treeSpritesRitem));
 
+	for(auto& ritem : mAllRitems)
+		AttachLods(ritem.get());
+}
+
+void TreeBillboardsApp::AttachLods(RenderItem* ritem)
+{
+	MeshGeometry* geo = mGeometries["boxGeo"].get();
+	if(ritem->Geo != geo || geo->DrawArgs.count(ritem->Submesh + "_lod1") == 0)
+		return;
+
+	ritem->Lods.push_back(geo->DrawArgs[ritem->Submesh]);
+	ritem->LodErrors.push_back(0.0f);
+
+	for(size_t level = 1; level <= gLodTriangleRatios.size(); ++level)
+	{
+		std::string lodName = ritem->Submesh + "_lod" + std::to_string(level);
+		ritem->Lods.push_back(geo->DrawArgs[lodName]);
+		ritem->LodErrors.push_back(mLodErrors[lodName]);
+	}
 }
 
 void TreeBillboardsApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
@@ -1774,6 +2138,8 @@ void TreeBillboardsApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, cons
         cmdList->SetGraphicsRootConstantBufferView(3, matCBAddress);
 
         cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		for(const SubmeshGeometry& chunk : ri->Chunks)
+			cmdList->DrawIndexedInstanced(chunk.IndexCount, 1, chunk.StartIndexLocation, chunk.BaseVertexLocation, 0);
     }
 }
 
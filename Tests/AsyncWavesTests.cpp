@@ -0,0 +1,161 @@
+//***************************************************************************************
+// AsyncWavesTests.cpp
+//
+// The AsyncWaves triple buffer with the render thread polling faster and slower than
+// the simulation steps: acquired frames only move forward, a frame never changes
+// while the render thread holds it, and every published frame is either acquired,
+// dropped or still waiting.  Disturbances queued on the render thread reach the
+// simulation while it runs and when it is stopped.
+//***************************************************************************************
+
+#include "AsyncWaves.h"
+#include "Check.h"
+#include "TaskScheduler.h"
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const int Rows = 33;
+	const int Cols = 35;
+
+	// 500 steps a second.
+	const float TimeStep = 0.002f;
+
+	typedef std::chrono::steady_clock Clock;
+
+	// Disturbances below are a good deal higher than this, and the ripples of the
+	// others never get this high where they are checked.
+	const float SeenHeight = 0.1f;
+
+	float HeightAt(const void* frame, const Waves::VertexLayout& layout, int i, int j)
+	{
+		float h;
+		std::memcpy(&h, static_cast<const std::uint8_t*>(frame) + (i*Cols + j)*layout.Stride + layout.PositionOffset + 4, sizeof(h));
+		return h;
+	}
+
+	// Polls AcquireLatest every renderPeriod for 300 ms.
+	void TestExchange(std::chrono::microseconds renderPeriod, bool expectDrops)
+	{
+		TaskScheduler scheduler(0);
+		Waves waves(Rows, Cols, 1.0f, TimeStep, 4.0f, 0.2f);
+		waves.SetScheduler(&scheduler);
+		waves.Disturb(Rows/2, Cols/2, 1.0f);
+
+		AsyncWaves async(&waves);
+		async.Start();
+
+		const size_t frameBytes = static_cast<size_t>(waves.VertexCount())*async.VertexStride();
+		std::vector<std::uint8_t> held(frameBytes);
+
+		std::int64_t lastFrame = -1;
+		int newFrames = 0;
+		int backwards = 0;
+		int changedWhileHeld = 0;
+
+		Clock::time_point end = Clock::now() + std::chrono::milliseconds(300);
+		while(Clock::now() < end)
+		{
+			const void* frame = async.AcquireLatest();
+			std::int64_t number = async.AcquiredFrame();
+
+			backwards += number < lastFrame;
+			if(number != lastFrame)
+				++newFrames;
+			lastFrame = number;
+
+			// The simulation keeps stepping meanwhile; the held frame must not change.
+			std::memcpy(held.data(), frame, frameBytes);
+			std::this_thread::sleep_for(renderPeriod);
+			changedWhileHeld += std::memcmp(held.data(), frame, frameBytes) != 0;
+		}
+
+		async.Stop();
+
+		// With the thread stopped nothing new arrives.
+		const void* frame = async.AcquireLatest();
+		std::int64_t number = async.AcquiredFrame();
+		CHECK(async.AcquireLatest() == frame);
+		CHECK(async.AcquiredFrame() == number);
+
+		AsyncWaves::Stats stats = async.GetStats();
+		CHECK(backwards == 0);
+		CHECK(changedWhileHeld == 0);
+		CHECK(newFrames > 1);
+		CHECK(stats.StepsSimulated > 0);
+		CHECK(stats.FramesPublished == stats.StepsSimulated + 1);
+		CHECK(number == stats.FramesPublished - 1);
+
+		// Each published frame was picked up, overwritten or is the last one.
+		std::int64_t accounted = stats.FramesAcquired + stats.FramesDropped;
+		CHECK(accounted == stats.FramesPublished || accounted == stats.FramesPublished - 1);
+		if(expectDrops)
+			CHECK(stats.FramesDropped > 0);
+
+		std::printf("render every %d us: %lld steps, %lld acquired, %lld dropped\n",
+			static_cast<int>(renderPeriod.count()), static_cast<long long>(stats.StepsSimulated),
+			static_cast<long long>(stats.FramesAcquired), static_cast<long long>(stats.FramesDropped));
+	}
+
+	// Queues disturbances while the simulation runs and just before it stops.
+	void TestDisturb(std::chrono::microseconds renderPeriod)
+	{
+		TaskScheduler scheduler(0);
+		Waves waves(Rows, Cols, 1.0f, TimeStep, 4.0f, 0.2f);
+		waves.SetScheduler(&scheduler);
+
+		Waves::VertexLayout layout;
+		AsyncWaves async(&waves, layout);
+		async.Start();
+
+		// A point disturbance shows up in a published frame.
+		async.Disturb(8, 9, 0.5f);
+		bool seen = false;
+		Clock::time_point end = Clock::now() + std::chrono::seconds(2);
+		while(!seen && Clock::now() < end)
+		{
+			seen = HeightAt(async.AcquireLatest(), layout, 8, 9) > SeenHeight;
+			std::this_thread::sleep_for(renderPeriod);
+		}
+		CHECK(seen);
+
+		// So does a batch of impulses, here centred on grid point (i, j).
+		const int i = 20;
+		const int j = 24;
+		Waves::Impulse impulse;
+		impulse.X = waves.Position(i*Cols + j).x;
+		impulse.Z = waves.Position(i*Cols + j).z;
+		impulse.Magnitude = 0.4f;
+		impulse.Radius = 1.5f;
+		async.Disturb(&impulse, 1);
+
+		seen = false;
+		end = Clock::now() + std::chrono::seconds(2);
+		while(!seen && Clock::now() < end)
+		{
+			seen = HeightAt(async.AcquireLatest(), layout, i, j) > SeenHeight;
+			std::this_thread::sleep_for(renderPeriod);
+		}
+		CHECK(seen);
+
+		// Queued right before Stop: applied by the last step or by Stop itself.
+		async.Disturb(Rows - 6, 5, 0.75f);
+		async.Stop();
+		CHECK(waves.Height((Rows - 6)*Cols + 5) > SeenHeight);
+	}
+}
+
+int main()
+{
+	// Render faster than the simulation steps, then much slower.
+	TestExchange(std::chrono::microseconds(200), false);
+	TestExchange(std::chrono::microseconds(20000), true);
+
+	TestDisturb(std::chrono::microseconds(200));
+	TestDisturb(std::chrono::microseconds(20000));
+
+	return CheckResult("AsyncWavesTests");
+}
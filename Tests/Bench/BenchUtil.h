@@ -0,0 +1,143 @@
+//***************************************************************************************
+// BenchUtil.h
+//
+// Timing and JSON output shared by the headless benchmarks.  Every benchmark prints
+// one JSON object, {"benchmark": name, "results": [...]}, to stdout and, with
+// --out <file>, to that file as well.  --quick shrinks the problem sizes and timing
+// windows so ctest can run each benchmark as a smoke test.
+//***************************************************************************************
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Bench
+{
+	struct Options
+	{
+		bool Quick = false;
+		const char* OutFile = nullptr;
+
+		// Minimum time spent measuring each result.
+		double MinSeconds = 0.25;
+	};
+
+	inline Options ParseOptions(int argc, char** argv)
+	{
+		Options options;
+		for(int i = 1; i < argc; ++i)
+		{
+			if(std::strcmp(argv[i], "--quick") == 0)
+			{
+				options.Quick = true;
+				options.MinSeconds = 0.01;
+			}
+			else if(std::strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+			{
+				options.OutFile = argv[++i];
+			}
+		}
+		return options;
+	}
+
+	inline double Now()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Calls f once to warm up, then in batches of doubling size until a batch takes
+	// at least minSeconds, and returns the seconds per call of that batch.
+	template <typename Func>
+	double SecondsPerCall(double minSeconds, Func&& f)
+	{
+		f();
+
+		for(long long calls = 1; ; calls *= 2)
+		{
+			double start = Now();
+			for(long long k = 0; k < calls; ++k)
+				f();
+			double elapsed = Now() - start;
+
+			if(elapsed >= minSeconds || calls >= (1ll << 30))
+				return elapsed / calls;
+		}
+	}
+
+	class JsonReport
+	{
+	public:
+		explicit JsonReport(const char* benchmark) : mBenchmark(benchmark) {}
+
+		// Starts a new object in "results"; the Adds that follow go into it.
+		void BeginResult(const char* name)
+		{
+			mResults.emplace_back();
+			Add("name", name);
+		}
+
+		void Add(const char* key, const char* value)
+		{
+			mResults.back().emplace_back(key, "\"" + std::string(value) + "\"");
+		}
+
+		void Add(const char* key, double value)
+		{
+			char text[64];
+			std::snprintf(text, sizeof(text), "%.6g", value);
+			mResults.back().emplace_back(key, text);
+		}
+
+		void Add(const char* key, long long value)
+		{
+			mResults.back().emplace_back(key, std::to_string(value));
+		}
+
+		void Add(const char* key, int value) { Add(key, static_cast<long long>(value)); }
+
+		void Write(std::FILE* file) const
+		{
+			std::fprintf(file, "{\n  \"benchmark\": \"%s\",\n  \"results\": [", mBenchmark.c_str());
+			for(size_t r = 0; r < mResults.size(); ++r)
+			{
+				std::fprintf(file, "%s\n    {", r == 0 ? "" : ",");
+				for(size_t f = 0; f < mResults[r].size(); ++f)
+				{
+					std::fprintf(file, "%s\"%s\": %s", f == 0 ? "" : ", ",
+						mResults[r][f].first.c_str(), mResults[r][f].second.c_str());
+				}
+				std::fprintf(file, "}");
+			}
+			std::fprintf(file, "\n  ]\n}\n");
+		}
+
+		// Writes to stdout and to options.OutFile if given; returns the exit code.
+		int Finish(const Options& options) const
+		{
+			Write(stdout);
+			if(options.OutFile == nullptr)
+				return 0;
+
+			std::FILE* file = std::fopen(options.OutFile, "w");
+			if(file == nullptr)
+			{
+				std::fprintf(stderr, "cannot write %s\n", options.OutFile);
+				return 1;
+			}
+			Write(file);
+			std::fclose(file);
+			return 0;
+		}
+
+	private:
+		typedef std::vector<std::pair<std::string, std::string>> Fields;
+
+		std::string mBenchmark;
+		std::vector<Fields> mResults;
+	};
+}
@@ -0,0 +1,93 @@
+//***************************************************************************************
+// CodecBench.cpp
+//
+// Compression ratio and encode/decode throughput of MeshCodec on generated meshes in
+// the order the app draws them (welded and optimized).  Throughput is in raw bytes,
+// i.e. the size of the index or vertex buffer, per second.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "GeometryGenerator.h"
+#include "MeshCodec.h"
+#include "MeshOptimizer.h"
+#include "MeshWelder.h"
+#include <vector>
+
+namespace
+{
+	typedef GeometryGenerator::MeshData MeshData;
+	typedef GeometryGenerator::Vertex Vertex;
+
+	struct Named
+	{
+		const char* Name;
+		MeshData Mesh;
+	};
+
+	void BenchCodec(const Bench::Options& options, Bench::JsonReport& report)
+	{
+		GeometryGenerator::uint32 n = options.Quick ? 32 : 256;
+
+		GeometryGenerator geoGen;
+		std::vector<Named> meshes;
+		meshes.push_back({ "grid", geoGen.CreateGrid(160.0f, 160.0f, n, n) });
+		meshes.push_back({ "sphere", geoGen.CreateSphere(1.0f, 2*n, n) });
+		meshes.push_back({ "geosphere", geoGen.CreateGeosphere(1.0f, options.Quick ? 3 : 6) });
+		meshes.push_back({ "torus", geoGen.CreateTorus(1.5f, 0.3f, 2*n, n) });
+
+		MeshWelder::WeldOptions weldOptions;
+		weldOptions.CompareTangents = false;
+		for(Named& named : meshes)
+		{
+			MeshWelder::Weld(named.Mesh, weldOptions);
+			MeshOptimizer::OptimizeMesh(named.Mesh);
+
+			const MeshData& mesh = named.Mesh;
+			double indexBytes = double(mesh.Indices32.size())*sizeof(GeometryGenerator::uint32);
+			double vertexBytes = double(mesh.Vertices.size())*sizeof(Vertex);
+
+			std::vector<std::uint8_t> indexData;
+			double encodeIndices = Bench::SecondsPerCall(options.MinSeconds, [&]()
+			{
+				indexData = MeshCodec::EncodeIndices(mesh.Indices32.data(), mesh.Indices32.size());
+			});
+			std::vector<GeometryGenerator::uint32> indices(mesh.Indices32.size());
+			double decodeIndices = Bench::SecondsPerCall(options.MinSeconds, [&]()
+			{
+				MeshCodec::DecodeIndices(indices.data(), indices.size(), indexData.data(), indexData.size());
+			});
+
+			std::vector<std::uint8_t> vertexData;
+			double encodeVertices = Bench::SecondsPerCall(options.MinSeconds, [&]()
+			{
+				vertexData = MeshCodec::EncodeVertices(mesh.Vertices.data(), mesh.Vertices.size(), sizeof(Vertex));
+			});
+			std::vector<Vertex> vertices(mesh.Vertices.size());
+			double decodeVertices = Bench::SecondsPerCall(options.MinSeconds, [&]()
+			{
+				MeshCodec::DecodeVertices(vertices.data(), vertices.size(), sizeof(Vertex), vertexData.data(), vertexData.size());
+			});
+
+			report.BeginResult(named.Name);
+			report.Add("triangles", static_cast<long long>(mesh.Indices32.size() / 3));
+			report.Add("vertices", static_cast<long long>(mesh.Vertices.size()));
+			report.Add("index_ratio", indexBytes / indexData.size());
+			report.Add("bytes_per_triangle", indexData.size() / (mesh.Indices32.size() / 3.0));
+			report.Add("vertex_ratio", vertexBytes / vertexData.size());
+			report.Add("index_encode_mb_s", indexBytes / encodeIndices * 1e-6);
+			report.Add("index_decode_mb_s", indexBytes / decodeIndices * 1e-6);
+			report.Add("vertex_encode_mb_s", vertexBytes / encodeVertices * 1e-6);
+			report.Add("vertex_decode_mb_s", vertexBytes / decodeVertices * 1e-6);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Bench::Options options = Bench::ParseOptions(argc, argv);
+	Bench::JsonReport report("CodecBench");
+
+	BenchCodec(options, report);
+
+	return report.Finish(options);
+}
@@ -0,0 +1,170 @@
+//***************************************************************************************
+// GeneratorBench.cpp
+//
+// Times the large GeometryGenerator meshes on one thread and on 2, 4, ... threads
+// up to the hardware count, and the sphere against the push_back version it
+// replaced (kept here as PushBackSphere).
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "GeometryGenerator.h"
+#include "TaskScheduler.h"
+#include <functional>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef GeometryGenerator::MeshData MeshData;
+	typedef GeometryGenerator::Vertex Vertex;
+	typedef GeometryGenerator::uint32 uint32;
+
+	// CreateSphere before the buffers were sized up front: every vertex and index
+	// is appended with push_back.
+	MeshData PushBackSphere(float radius, uint32 sliceCount, uint32 stackCount)
+	{
+		MeshData meshData;
+
+		meshData.Vertices.push_back(Vertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f));
+
+		float phiStep = XM_PI / stackCount;
+		float thetaStep = 2.0f * XM_PI / sliceCount;
+
+		for(uint32 i = 1; i <= stackCount - 1; ++i)
+		{
+			float phi = i * phiStep;
+			for(uint32 j = 0; j <= sliceCount; ++j)
+			{
+				float theta = j * thetaStep;
+
+				Vertex v;
+				v.Position.x = radius * sinf(phi) * cosf(theta);
+				v.Position.y = radius * cosf(phi);
+				v.Position.z = radius * sinf(phi) * sinf(theta);
+
+				v.TangentU.x = -radius * sinf(phi) * sinf(theta);
+				v.TangentU.y = 0.0f;
+				v.TangentU.z = +radius * sinf(phi) * cosf(theta);
+				XMStoreFloat3(&v.TangentU, XMVector3Normalize(XMLoadFloat3(&v.TangentU)));
+				XMStoreFloat3(&v.Normal, XMVector3Normalize(XMLoadFloat3(&v.Position)));
+
+				v.TexC.x = theta / XM_2PI;
+				v.TexC.y = phi / XM_PI;
+
+				meshData.Vertices.push_back(v);
+			}
+		}
+
+		meshData.Vertices.push_back(Vertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f));
+
+		for(uint32 i = 1; i <= sliceCount; ++i)
+		{
+			meshData.Indices32.push_back(0);
+			meshData.Indices32.push_back(i + 1);
+			meshData.Indices32.push_back(i);
+		}
+
+		uint32 baseIndex = 1;
+		uint32 ringVertexCount = sliceCount + 1;
+		for(uint32 i = 0; i < stackCount - 2; ++i)
+		{
+			for(uint32 j = 0; j < sliceCount; ++j)
+			{
+				meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j);
+				meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j + 1);
+				meshData.Indices32.push_back(baseIndex + (i + 1) * ringVertexCount + j);
+
+				meshData.Indices32.push_back(baseIndex + (i + 1) * ringVertexCount + j);
+				meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j + 1);
+				meshData.Indices32.push_back(baseIndex + (i + 1) * ringVertexCount + j + 1);
+			}
+		}
+
+		uint32 southPoleIndex = static_cast<uint32>(meshData.Vertices.size()) - 1;
+		baseIndex = southPoleIndex - ringVertexCount;
+		for(uint32 i = 0; i < sliceCount; ++i)
+		{
+			meshData.Indices32.push_back(southPoleIndex);
+			meshData.Indices32.push_back(baseIndex + i);
+			meshData.Indices32.push_back(baseIndex + i + 1);
+		}
+
+		return meshData;
+	}
+
+	struct Generator
+	{
+		const char* Name;
+		std::function<MeshData(GeometryGenerator&)> Create;
+	};
+
+	void BenchGenerators(const Bench::Options& options, Bench::JsonReport& report)
+	{
+		// Rings or rows of the meshes; all well above the size generated in parallel.
+		uint32 n = options.Quick ? 256 : 1024;
+
+		std::vector<Generator> generators = {
+			{ "grid", [n](GeometryGenerator& g) { return g.CreateGrid(100.0f, 100.0f, n, n); } },
+			{ "sphere", [n](GeometryGenerator& g) { return g.CreateSphere(1.0f, 2*n, n); } },
+			{ "cylinder", [n](GeometryGenerator& g) { return g.CreateCylinder(1.5f, 1.0f, 8.0f, 2*n, n); } },
+			{ "torus", [n](GeometryGenerator& g) { return g.CreateTorus(1.5f, 0.3f, 2*n, n); } },
+		};
+
+		std::vector<int> threadCounts = { 1 };
+		int hardware = static_cast<int>(std::thread::hardware_concurrency());
+		for(int threads = 2; threads <= hardware; threads *= 2)
+			threadCounts.push_back(threads);
+		if(hardware > 1 && threadCounts.back() != hardware)
+			threadCounts.push_back(hardware);
+
+		for(const Generator& generator : generators)
+		{
+			double serial = 0.0;
+			for(int threads : threadCounts)
+			{
+				TaskScheduler scheduler(threads - 1);
+				GeometryGenerator geoGen;
+				geoGen.SetScheduler(&scheduler);
+
+				size_t vertices = 0;
+				double seconds = Bench::SecondsPerCall(options.MinSeconds, [&]()
+				{
+					vertices = generator.Create(geoGen).Vertices.size();
+				});
+				if(threads == 1)
+					serial = seconds;
+
+				report.BeginResult(generator.Name);
+				report.Add("threads", threads);
+				report.Add("vertices", static_cast<long long>(vertices));
+				report.Add("ms", seconds*1e3);
+				report.Add("ns_per_vertex", seconds*1e9 / vertices);
+				report.Add("speedup", serial / seconds);
+			}
+		}
+
+		double pushBack = Bench::SecondsPerCall(options.MinSeconds, [n]() { PushBackSphere(1.0f, 2*n, n); });
+		TaskScheduler single(0);
+		GeometryGenerator geoGen;
+		geoGen.SetScheduler(&single);
+		double presized = Bench::SecondsPerCall(options.MinSeconds, [&geoGen, n]() { geoGen.CreateSphere(1.0f, 2*n, n); });
+
+		report.BeginResult("sphere_push_back");
+		report.Add("threads", 1);
+		report.Add("push_back_ms", pushBack*1e3);
+		report.Add("presized_ms", presized*1e3);
+		report.Add("speedup", pushBack / presized);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Bench::Options options = Bench::ParseOptions(argc, argv);
+	Bench::JsonReport report("GeneratorBench");
+
+	BenchGenerators(options, report);
+
+	return report.Finish(options);
+}
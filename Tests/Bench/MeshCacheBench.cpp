@@ -0,0 +1,101 @@
+//***************************************************************************************
+// MeshCacheBench.cpp
+//
+// Times getting a mesh from a MeshCache file, as a view into the mapping and as a
+// MeshData copy, against calling the generator, for the scene meshes of the app and
+// for larger ones.  Opening the cache (mapping the file) is timed separately.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "GeometryGenerator.h"
+#include "MeshCache.h"
+#include "TaskScheduler.h"
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const char* const CacheFile = "MeshCacheBench.bin";
+
+	typedef GeometryGenerator::MeshData MeshData;
+
+	struct Mesh
+	{
+		const char* Name;
+		std::function<MeshCache::MeshView(MeshCache&, GeometryGenerator&)> Generate;
+	};
+
+	void BenchCache(const Bench::Options& options, Bench::JsonReport& report)
+	{
+		unsigned n = options.Quick ? 64 : 512;
+
+		std::vector<Mesh> meshes = {
+			{ "grid", [](MeshCache& c, GeometryGenerator& g) { return c.Generate("CreateGrid", g, &GeometryGenerator::CreateGrid, 30.0f, 30.0f, 15, 15); } },
+			{ "cylinder", [](MeshCache& c, GeometryGenerator& g) { return c.Generate("CreateCylinder", g, &GeometryGenerator::CreateCylinder, 1.5f, 1.0f, 8.0f, 10, 5); } },
+			{ "torus", [](MeshCache& c, GeometryGenerator& g) { return c.Generate("CreateTorus", g, &GeometryGenerator::CreateTorus, 1.5f, 0.3f, 8, 6); } },
+			{ "sphere", [](MeshCache& c, GeometryGenerator& g) { return c.Generate("CreateSphere", g, &GeometryGenerator::CreateSphere, 1.0f, 6.0f, 6.0f); } },
+			{ "large_grid", [n](MeshCache& c, GeometryGenerator& g) { return c.Generate("CreateGrid", g, &GeometryGenerator::CreateGrid, 160.0f, 160.0f, n, n); } },
+			{ "large_sphere", [n](MeshCache& c, GeometryGenerator& g) { return c.Generate("CreateSphere", g, &GeometryGenerator::CreateSphere, 1.0f, 2*n, n); } },
+		};
+
+		// Generated on one thread, as the app's small meshes are.
+		TaskScheduler serial(0);
+		GeometryGenerator geoGen;
+		geoGen.SetScheduler(&serial);
+
+		std::remove(CacheFile);
+		{
+			MeshCache cache(std::wstring(CacheFile, CacheFile + std::strlen(CacheFile)));
+			for(const Mesh& mesh : meshes)
+				mesh.Generate(cache, geoGen);
+			if(!cache.Save())
+			{
+				std::fprintf(stderr, "cannot write %s\n", CacheFile);
+				return;
+			}
+		}
+
+		std::wstring fileName(CacheFile, CacheFile + std::strlen(CacheFile));
+		double open = Bench::SecondsPerCall(options.MinSeconds, [&fileName]() { MeshCache cache(fileName); });
+		report.BeginResult("open");
+		report.Add("ms", open*1e3);
+
+		MeshCache cache(fileName);
+		for(const Mesh& mesh : meshes)
+		{
+			// Without a cache to hit, Generate calls the generator; the copy into
+			// the cache's store is the small part of that.
+			double generate = Bench::SecondsPerCall(options.MinSeconds, [&mesh, &geoGen, &fileName]()
+			{
+				MeshCache empty(fileName + L".none");
+				mesh.Generate(empty, geoGen);
+			});
+
+			MeshCache::MeshView view;
+			double hit = Bench::SecondsPerCall(options.MinSeconds, [&]() { view = mesh.Generate(cache, geoGen); });
+			double copy = Bench::SecondsPerCall(options.MinSeconds, [&]() { MeshData data = mesh.Generate(cache, geoGen).ToMeshData(); });
+
+			report.BeginResult(mesh.Name);
+			report.Add("vertices", static_cast<long long>(view.VertexCount));
+			report.Add("generate_us", generate*1e6);
+			report.Add("cached_view_us", hit*1e6);
+			report.Add("cached_copy_us", copy*1e6);
+			report.Add("copy_speedup", generate / copy);
+		}
+
+		std::remove(CacheFile);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Bench::Options options = Bench::ParseOptions(argc, argv);
+	Bench::JsonReport report("MeshCacheBench");
+
+	BenchCache(options, report);
+
+	return report.Finish(options);
+}
@@ -0,0 +1,113 @@
+//***************************************************************************************
+// MeshletBench.cpp
+//
+// MeshletBuilder::Build and MeshletCuller::Cull on dense generator meshes: the build
+// time per triangle, and for a camera orbiting each mesh the time per Cull call and
+// per meshlet, and the fraction of meshlets and triangles drawn against drawing the
+// whole mesh.  Each orbit is also run looking past the mesh, so the frustum takes
+// part as well as the backface cones.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "GeometryGenerator.h"
+#include "MeshletBuilder.h"
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef GeometryGenerator::MeshData MeshData;
+
+	struct Named
+	{
+		const char* Name;
+		MeshData Mesh;
+
+		// Distance of the orbiting eye from the origin.
+		float Orbit;
+	};
+
+	void BenchMeshlets(const Bench::Options& options, Bench::JsonReport& report)
+	{
+		unsigned n = options.Quick ? 32 : 256;
+
+		GeometryGenerator geoGen;
+		std::vector<Named> meshes;
+		meshes.push_back({ "sphere", geoGen.CreateSphere(1.0f, 2*n, n), 4.0f });
+		meshes.push_back({ "torus", geoGen.CreateTorus(1.5f, 0.3f, 2*n, n/2), 6.0f });
+		meshes.push_back({ "grid", geoGen.CreateGrid(160.0f, 160.0f, n, n), 150.0f });
+
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*XM_PI, 16.0f/9.0f, 0.1f, 1000.0f);
+		const int viewCount = 16;
+
+		for(const Named& named : meshes)
+		{
+			const MeshData& mesh = named.Mesh;
+			double triangles = double(mesh.Indices32.size() / 3);
+
+			MeshletBuilder::MeshletMesh meshlets;
+			double build = Bench::SecondsPerCall(options.MinSeconds, [&]()
+			{
+				meshlets = MeshletBuilder::Build(mesh);
+			});
+
+			MeshletCuller culler(meshlets);
+			std::vector<std::uint32_t> indices;
+
+			for(bool past : { false, true })
+			{
+				// Half way up, round the mesh, looking at the middle or beside it.
+				std::vector<XMMATRIX> viewProjs;
+				std::vector<XMFLOAT3> eyes;
+				for(int k = 0; k < viewCount; ++k)
+				{
+					float theta = XM_2PI*k/viewCount;
+					XMVECTOR eye = XMVectorSet(named.Orbit*cosf(theta), 0.5f*named.Orbit, named.Orbit*sinf(theta), 1.0f);
+					XMVECTOR target = past ? XMVectorSet(-0.8f*named.Orbit*sinf(theta), 0.0f, 0.8f*named.Orbit*cosf(theta), 1.0f) : XMVectorZero();
+					viewProjs.push_back(XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f))*proj);
+
+					XMFLOAT3 eyePos;
+					XMStoreFloat3(&eyePos, eye);
+					eyes.push_back(eyePos);
+				}
+
+				double drawnMeshlets = 0.0;
+				double drawnTriangles = 0.0;
+				for(int k = 0; k < viewCount; ++k)
+				{
+					drawnMeshlets += culler.Cull(XMMatrixIdentity(), viewProjs[k], eyes[k], indices);
+					drawnTriangles += double(indices.size() / 3);
+				}
+
+				int view = 0;
+				double cull = Bench::SecondsPerCall(options.MinSeconds, [&]()
+				{
+					culler.Cull(XMMatrixIdentity(), viewProjs[view], eyes[view], indices);
+					view = (view + 1) % viewCount;
+				});
+
+				report.BeginResult(named.Name);
+				report.Add("view", past ? "past" : "middle");
+				report.Add("triangles", static_cast<long long>(triangles));
+				report.Add("meshlets", static_cast<long long>(culler.MeshletCount()));
+				report.Add("build_ns_per_triangle", build*1e9 / triangles);
+				report.Add("cull_us", cull*1e6);
+				report.Add("cull_ns_per_meshlet", cull*1e9 / culler.MeshletCount());
+				report.Add("meshlets_drawn", drawnMeshlets / (double(viewCount)*culler.MeshletCount()));
+				report.Add("triangles_drawn", drawnTriangles / (viewCount*triangles));
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Bench::Options options = Bench::ParseOptions(argc, argv);
+	Bench::JsonReport report("MeshletBench");
+
+	BenchMeshlets(options, report);
+
+	return report.Finish(options);
+}
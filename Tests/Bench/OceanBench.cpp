@@ -0,0 +1,93 @@
+//***************************************************************************************
+// OceanBench.cpp
+//
+// Times one evaluation of the FFT ocean for several FFT sizes, next to a step of the
+// finite-difference Waves on a grid with the same number of vertices, both on one
+// thread and on all of them.  Writing the vertices is timed separately since both
+// share the same layout.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "OceanWaves.h"
+#include "TaskScheduler.h"
+#include "Waves.h"
+#include <cstdint>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const float PatchSize = 256.0f;
+	const float WindSpeed = 20.0f;
+
+	// Waves on the same grid; undamped so the swell does not decay into denormals.
+	const float Dt = 0.03f;
+	const float Speed = 4.0f;
+	const float Damping = 0.0f;
+
+	void BenchOcean(const Bench::Options& options, Bench::JsonReport& report)
+	{
+		std::vector<int> sizes = { 64, 128, 256, 512 };
+		if(options.Quick)
+			sizes = { 64 };
+
+		TaskScheduler serial(0);
+		TaskScheduler* schedulers[] = { &serial, &TaskScheduler::Default() };
+
+		for(int n : sizes)
+		{
+			for(TaskScheduler* scheduler : schedulers)
+			{
+				if(scheduler != &serial && scheduler->ThreadCount() == 1)
+					continue;
+
+				OceanWaves ocean(n, PatchSize, WindSpeed, XMFLOAT2(1.0f, 0.3f));
+				ocean.SetScheduler(scheduler);
+				double vertices = ocean.VertexCount();
+
+				float time = 0.0f;
+				double evaluate = Bench::SecondsPerCall(options.MinSeconds, [&ocean, &time]()
+				{
+					time += Dt;
+					ocean.Evaluate(time);
+				});
+
+				Waves::VertexLayout layout;
+				std::vector<std::uint8_t> buffer(ocean.VertexCount()*layout.Stride);
+				double oceanWrite = Bench::SecondsPerCall(options.MinSeconds, [&ocean, &buffer, &layout]()
+				{
+					ocean.WriteVertices(buffer.data(), layout);
+				});
+
+				Waves waves(ocean.RowCount(), ocean.ColumnCount(), ocean.SpatialStep(), Dt, Speed, Damping);
+				waves.SetScheduler(scheduler);
+				for(int i = 1; i < waves.RowCount() - 1; i += 7)
+				{
+					for(int j = 1; j < waves.ColumnCount() - 1; j += 5)
+						waves.Disturb(i, j, 0.5f);
+				}
+				double step = Bench::SecondsPerCall(options.MinSeconds, [&waves]() { waves.Step(); });
+
+				report.BeginResult("ocean");
+				report.Add("fft_size", n);
+				report.Add("threads", scheduler->ThreadCount());
+				report.Add("evaluate_ms", evaluate*1e3);
+				report.Add("evaluate_ns_per_vertex", evaluate*1e9 / vertices);
+				report.Add("write_ns_per_vertex", oceanWrite*1e9 / vertices);
+				report.Add("waves_step_ms", step*1e3);
+				report.Add("waves_step_ns_per_vertex", step*1e9 / vertices);
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Bench::Options options = Bench::ParseOptions(argc, argv);
+	Bench::JsonReport report("OceanBench");
+
+	BenchOcean(options, report);
+
+	return report.Finish(options);
+}
@@ -0,0 +1,105 @@
+//***************************************************************************************
+// QuantizerBench.cpp
+//
+// MeshQuantizer's report for the app's scene meshes in each PositionFormat, with and
+// without tangents: bytes before and after, the fraction saved, the worst position,
+// normal, tangent and texture coordinate error, and the encode and decode time per
+// vertex.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "GeometryGenerator.h"
+#include "MeshQuantizer.h"
+#include <vector>
+
+namespace
+{
+	typedef GeometryGenerator::MeshData MeshData;
+	typedef MeshQuantizer::PositionFormat PositionFormat;
+
+	struct Named
+	{
+		const char* Name;
+		MeshData Mesh;
+	};
+
+	const char* FormatName(PositionFormat format)
+	{
+		switch(format)
+		{
+		case PositionFormat::Float3: return "float3";
+		case PositionFormat::Half4: return "half4";
+		default: return "snorm16x4";
+		}
+	}
+
+	void BenchQuantizer(const Bench::Options& options, Bench::JsonReport& report)
+	{
+		// The meshes BuildBoxGeometry and BuildLandGeometry make.
+		GeometryGenerator geoGen;
+		std::vector<Named> meshes;
+		meshes.push_back({ "land", geoGen.CreateGrid(160.0f, 160.0f, 50, 50) });
+		meshes.push_back({ "grid", geoGen.CreateGrid(30.0f, 30.0f, 15, 15) });
+		meshes.push_back({ "box", geoGen.CreateBox(8.0f, 8.0f, 8.0f, 2) });
+		meshes.push_back({ "cylinder", geoGen.CreateCylinder(1.5f, 1.0f, 8.0f, 10, 5) });
+		meshes.push_back({ "pyramid", geoGen.CreateSquarePyramid(5.0f, 7.0f, 7.0f, 2) });
+		meshes.push_back({ "cone", geoGen.CreateCone(1.5f, 1.5f, 6, 3) });
+		meshes.push_back({ "torus", geoGen.CreateTorus(1.5f, 0.3f, 8, 6) });
+		meshes.push_back({ "diamond", geoGen.CreateDiamond(2.0f, 2.0f, 1.0f, 1) });
+		meshes.push_back({ "sphere", geoGen.CreateSphere(1.0f, 6, 6) });
+		if(options.Quick)
+			meshes.resize(2);
+
+		for(const Named& named : meshes)
+		{
+			for(PositionFormat format : { PositionFormat::Float3, PositionFormat::Half4, PositionFormat::SNorm16x4 })
+			{
+				for(bool tangent : { false, true })
+				{
+					MeshQuantizer::Layout layout;
+					layout.Position = format;
+					layout.Tangent = tangent;
+
+					MeshQuantizer::EncodedMesh encoded;
+					double encode = Bench::SecondsPerCall(options.MinSeconds, [&]()
+					{
+						encoded = MeshQuantizer::Encode(named.Mesh, layout);
+					});
+					std::vector<GeometryGenerator::Vertex> decoded;
+					double decode = Bench::SecondsPerCall(options.MinSeconds, [&]()
+					{
+						decoded = MeshQuantizer::Decode(encoded);
+					});
+
+					MeshQuantizer::EncodeReport measured = MeshQuantizer::Measure(named.Mesh, encoded);
+					double vertices = double(named.Mesh.Vertices.size());
+
+					report.BeginResult(named.Name);
+					report.Add("position", FormatName(format));
+					report.Add("tangent", tangent ? "yes" : "no");
+					report.Add("vertices", static_cast<long long>(named.Mesh.Vertices.size()));
+					report.Add("stride", encoded.Stride);
+					report.Add("source_bytes", static_cast<long long>(measured.SourceBytes));
+					report.Add("encoded_bytes", static_cast<long long>(measured.EncodedBytes));
+					report.Add("saved", measured.SavedFraction());
+					report.Add("max_position_error", measured.MaxPositionError);
+					report.Add("max_normal_error_deg", measured.MaxNormalErrorDegrees);
+					report.Add("max_tangent_error_deg", measured.MaxTangentErrorDegrees);
+					report.Add("max_texc_error", measured.MaxTexCError);
+					report.Add("encode_ns_per_vertex", encode*1e9 / vertices);
+					report.Add("decode_ns_per_vertex", decode*1e9 / vertices);
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Bench::Options options = Bench::ParseOptions(argc, argv);
+	Bench::JsonReport report("QuantizerBench");
+
+	BenchQuantizer(options, report);
+
+	return report.Finish(options);
+}
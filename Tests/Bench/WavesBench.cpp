@@ -0,0 +1,330 @@
+//***************************************************************************************
+// WavesBench.cpp
+//
+// Times Waves::Step, which computes the stencil and the normals of each row band in
+// one sweep, against the separate full-grid stencil and normal passes it replaced
+// (kept here as TwoPassGrid), for grids from 129 to 4097 points a side on one thread
+// and on all of them, and Waves::Step with each band height.  Then reports the
+// Waves::StageTimings of dense and sparse stepping with full and compact vertex
+// writes, over grid sizes and thread counts.
+//***************************************************************************************
+
+#include "BenchUtil.h"
+#include "TaskScheduler.h"
+#include "Waves.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const float Dx = 1.0f;
+	const float Dt = 0.03f;
+	const float Speed = 4.0f;
+
+	// Undamped, so the swell does not decay into denormals however long the timing
+	// runs.
+	const float Damping = 0.0f;
+
+	inline XMVECTOR LoadFloats(const float* p)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+	}
+
+	inline void StoreFloats(float* p, FXMVECTOR v)
+	{
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p), v);
+	}
+
+	// The simulation before the fused sweep: one parallel pass of the stencil over
+	// every interior row, then one pass computing every interior normal.
+	class TwoPassGrid
+	{
+	public:
+		TwoPassGrid(int rows, int cols, TaskScheduler& scheduler)
+			: mRows(rows), mCols(cols), mScheduler(scheduler),
+			mPrev(rows*cols, 0.0f), mCurr(rows*cols, 0.0f),
+			mNx(rows*cols, 0.0f), mNy(rows*cols, 1.0f), mNz(rows*cols, 0.0f),
+			mTx(rows*cols, 1.0f), mTy(rows*cols, 0.0f)
+		{
+			float d = Damping*Dt + 2.0f;
+			float e = (Speed*Speed)*(Dt*Dt) / (Dx*Dx);
+			mK1 = (Damping*Dt - 2.0f) / d;
+			mK2 = (4.0f - 8.0f*e) / d;
+			mK3 = (2.0f*e) / d;
+		}
+
+		std::vector<float>& Heights() { return mCurr; }
+
+		void Step(int rowGrainSize)
+		{
+			mScheduler.ParallelFor(1, mRows - 1, rowGrainSize, [this](int i)
+			{
+				int row = i*mCols + 1;
+				UpdateRow(&mPrev[row], &mCurr[row], &mCurr[row - mCols], &mCurr[row + mCols], mCols - 2);
+			});
+
+			std::swap(mPrev, mCurr);
+
+			mScheduler.ParallelFor(1, mRows - 1, rowGrainSize, [this](int i)
+			{
+				int row = i*mCols + 1;
+				ComputeNormalRow(&mCurr[row], &mCurr[row - mCols], &mCurr[row + mCols], mCols - 2, row);
+			});
+		}
+
+	private:
+		void UpdateRow(float* prev, const float* curr, const float* up, const float* down, int count)
+		{
+			const XMVECTOR K1 = XMVectorReplicate(mK1);
+			const XMVECTOR K2 = XMVectorReplicate(mK2);
+			const XMVECTOR K3 = XMVectorReplicate(mK3);
+
+			int j = 0;
+			for(; j + 4 <= count; j += 4)
+			{
+				XMVECTOR p = LoadFloats(prev + j);
+				XMVECTOR c = LoadFloats(curr + j);
+				XMVECTOR d = LoadFloats(down + j);
+				XMVECTOR u = LoadFloats(up + j);
+				XMVECTOR r = LoadFloats(curr + j + 1);
+				XMVECTOR l = LoadFloats(curr + j - 1);
+
+				StoreFloats(prev + j, K1*p + K2*c + K3*(d + u + r + l));
+			}
+
+			for(; j < count; ++j)
+				prev[j] = mK1*prev[j] + mK2*curr[j] + mK3*(down[j] + up[j] + curr[j+1] + curr[j-1]);
+		}
+
+		void ComputeNormalRow(const float* curr, const float* up, const float* down, int count, int row)
+		{
+			const float twoDx = 2.0f*Dx;
+			const XMVECTOR TwoDx = XMVectorReplicate(twoDx);
+			const XMVECTOR TwoDxSq = XMVectorReplicate(twoDx*twoDx);
+
+			float* nx = &mNx[row];
+			float* ny = &mNy[row];
+			float* nz = &mNz[row];
+			float* tx = &mTx[row];
+			float* ty = &mTy[row];
+
+			int j = 0;
+			for(; j + 4 <= count; j += 4)
+			{
+				XMVECTOR x = LoadFloats(curr + j - 1) - LoadFloats(curr + j + 1);
+				XMVECTOR z = LoadFloats(down + j) - LoadFloats(up + j);
+				XMVECTOR xSq = x*x;
+
+				XMVECTOR invLenN = XMVectorReciprocalSqrt(xSq + TwoDxSq + z*z);
+				XMVECTOR invLenT = XMVectorReciprocalSqrt(TwoDxSq + xSq);
+
+				StoreFloats(nx + j, x*invLenN);
+				StoreFloats(ny + j, TwoDx*invLenN);
+				StoreFloats(nz + j, z*invLenN);
+				StoreFloats(tx + j, TwoDx*invLenT);
+				StoreFloats(ty + j, -x*invLenT);
+			}
+
+			for(; j < count; ++j)
+			{
+				float x = curr[j-1] - curr[j+1];
+				float z = down[j] - up[j];
+
+				float invLenN = 1.0f / sqrtf(x*x + twoDx*twoDx + z*z);
+				float invLenT = 1.0f / sqrtf(twoDx*twoDx + x*x);
+
+				nx[j] = x*invLenN;
+				ny[j] = twoDx*invLenN;
+				nz[j] = z*invLenN;
+				tx[j] = twoDx*invLenT;
+				ty[j] = -x*invLenT;
+			}
+		}
+
+		int mRows;
+		int mCols;
+		TaskScheduler& mScheduler;
+		float mK1 = 0.0f;
+		float mK2 = 0.0f;
+		float mK3 = 0.0f;
+
+		std::vector<float> mPrev;
+		std::vector<float> mCurr;
+		std::vector<float> mNx;
+		std::vector<float> mNy;
+		std::vector<float> mNz;
+		std::vector<float> mTx;
+		std::vector<float> mTy;
+	};
+
+	// Rough swell over the whole interior, so every row has something to do.
+	template <typename SetHeight>
+	void Roughen(int rows, int cols, const SetHeight& setHeight)
+	{
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> height(-0.5f, 0.5f);
+		for(int i = 1; i < rows - 1; ++i)
+		{
+			for(int j = 1; j < cols - 1; ++j)
+				setHeight(i, j, height(random));
+		}
+	}
+
+	void BenchSweep(const Bench::Options& options, Bench::JsonReport& report)
+	{
+		std::vector<int> sizes = { 129, 257, 513, 1025, 2049, 4097 };
+		if(options.Quick)
+			sizes = { 129 };
+
+		TaskScheduler serial(0);
+		TaskScheduler* schedulers[] = { &serial, &TaskScheduler::Default() };
+
+		for(int size : sizes)
+		{
+			for(TaskScheduler* scheduler : schedulers)
+			{
+				if(scheduler != &serial && scheduler->ThreadCount() == 1)
+					continue;
+
+				double cells = double(size - 2)*(size - 2);
+
+				Waves waves(size, size, Dx, Dt, Speed, Damping);
+				waves.SetScheduler(scheduler);
+				Roughen(size, size, [&waves](int i, int j, float h) { waves.Disturb(i, j, h); });
+				double fused = Bench::SecondsPerCall(options.MinSeconds, [&waves]() { waves.Step(); });
+
+				TwoPassGrid grid(size, size, *scheduler);
+				Roughen(size, size, [&grid, size](int i, int j, float h) { grid.Heights()[i*size + j] = h; });
+				int grain = std::max(1, (size - 2) / (scheduler->ThreadCount()*4));
+				double twoPass = Bench::SecondsPerCall(options.MinSeconds, [&grid, grain]() { grid.Step(grain); });
+
+				report.BeginResult("sweep");
+				report.Add("grid", size);
+				report.Add("threads", scheduler->ThreadCount());
+				report.Add("fused_ns_per_cell", fused*1e9 / cells);
+				report.Add("two_pass_ns_per_cell", twoPass*1e9 / cells);
+				report.Add("speedup", twoPass / fused);
+			}
+		}
+	}
+
+	// Waves::Step on one thread with each band height, 0 being the one BandRowCount
+	// picks.  Each band costs a seam, two rows of normals computed apart from the
+	// sweep; taller bands have fewer seams.
+	void BenchBands(const Bench::Options& options, Bench::JsonReport& report)
+	{
+		std::vector<int> sizes = { 129, 257, 513, 1025, 2049, 4097 };
+		std::vector<int> bandRows = { 0, 4, 8, 16, 32, 64, 128, 256 };
+		if(options.Quick)
+		{
+			sizes = { 129 };
+			bandRows = { 0, 16 };
+		}
+
+		TaskScheduler serial(0);
+		for(int size : sizes)
+		{
+			double cells = double(size - 2)*(size - 2);
+
+			Waves waves(size, size, Dx, Dt, Speed, Damping);
+			Roughen(size, size, [&waves](int i, int j, float h) { waves.Disturb(i, j, h); });
+			for(int rows : bandRows)
+			{
+				waves.SetScheduler(&serial, rows);
+				double seconds = Bench::SecondsPerCall(options.MinSeconds, [&waves]() { waves.Step(); });
+
+				report.BeginResult("bands");
+				report.Add("grid", size);
+				report.Add("band_rows", rows);
+				report.Add("ns_per_cell", seconds*1e9 / cells);
+			}
+		}
+	}
+
+	// Steps a rough swell, with a few disturbances along the way so sparse tiles
+	// wake and sleep, writing the vertices after every step as the app does.
+	void BenchStages(const Bench::Options& options, Bench::JsonReport& report)
+	{
+		std::vector<int> sizes = { 129, 257, 513, 1025 };
+		std::vector<int> threadCounts = { 1 };
+		int steps = 200;
+		if(options.Quick)
+		{
+			sizes = { 129 };
+			steps = 10;
+		}
+		int hardware = static_cast<int>(std::thread::hardware_concurrency());
+		for(int threads = 2; threads <= hardware; threads *= 2)
+			threadCounts.push_back(threads);
+		if(hardware > 1 && threadCounts.back() != hardware)
+			threadCounts.push_back(hardware);
+
+		for(int size : sizes)
+		{
+			for(int threads : threadCounts)
+			{
+				TaskScheduler scheduler(threads - 1);
+				for(int sparse = 0; sparse <= 1; ++sparse)
+				{
+					for(int compact = 0; compact <= 1; ++compact)
+					{
+						Waves waves(size, size, Dx, Dt, Speed, Damping);
+						waves.SetScheduler(&scheduler);
+						waves.SetSparseSimulation(sparse != 0);
+						waves.Disturb(size/2, size/2, 1.0f);
+
+						Waves::VertexLayout layout;
+						std::vector<std::uint8_t> vertices(static_cast<size_t>(waves.VertexCount())*layout.Stride);
+						std::vector<Waves::CompactVertex> compactVertices(waves.VertexCount());
+
+						waves.ResetStageTimings();
+						for(int k = 0; k < steps; ++k)
+						{
+							if(k % 50 == 0)
+								waves.Disturb(1 + (k*7) % (size - 2), 1 + (k*13) % (size - 2), 0.5f);
+							waves.Step();
+
+							if(compact)
+								waves.WriteCompactVertices(compactVertices.data());
+							else
+								waves.WriteVertices(vertices.data(), layout);
+						}
+
+						const Waves::StageTimings& t = waves.GetStageTimings();
+						report.BeginResult("stages");
+						report.Add("grid", size);
+						report.Add("threads", scheduler.ThreadCount());
+						report.Add("mode", sparse ? "sparse" : "dense");
+						report.Add("vertices", compact ? "compact" : "full");
+						report.Add("steps", static_cast<long long>(t.Steps));
+						report.Add("cells_stepped", static_cast<long long>(t.CellsStepped));
+						report.Add("stencil_ns", static_cast<long long>(t.StencilNanoseconds));
+						report.Add("seam_ns", static_cast<long long>(t.SeamNanoseconds));
+						report.Add("tile_ns", static_cast<long long>(t.TileNanoseconds));
+						report.Add("emit_ns", static_cast<long long>(t.EmitNanoseconds));
+						report.Add("stencil_ns_per_cell", t.StencilNsPerCell());
+						report.Add("emit_ns_per_vertex", t.EmitNsPerVertex());
+					}
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Bench::Options options = Bench::ParseOptions(argc, argv);
+	Bench::JsonReport report("WavesBench");
+
+	BenchSweep(options, report);
+	BenchBands(options, report);
+	BenchStages(options, report);
+
+	return report.Finish(options);
+}
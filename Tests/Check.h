@@ -0,0 +1,46 @@
+//***************************************************************************************
+// Check.h
+//
+// Minimal checks for the headless tests.  A failed CHECK prints where it failed and
+// the test carries on; main returns CheckResult() so ctest sees any failure.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+
+namespace Check
+{
+	// CHECK may run on TaskScheduler worker threads.
+	inline std::atomic<int>& Failures()
+	{
+		static std::atomic<int> failures(0);
+		return failures;
+	}
+
+	inline bool Record(bool passed, const char* expr, const char* file, int line)
+	{
+		if(!passed)
+		{
+			std::printf("%s(%d): check failed: %s\n", file, line, expr);
+			++Failures();
+		}
+		return passed;
+	}
+}
+
+#define CHECK(expr) Check::Record((expr), #expr, __FILE__, __LINE__)
+#define CHECK_NEAR(a, b, tolerance) Check::Record(std::fabs(double(a) - double(b)) <= double(tolerance), \
+	#a " == " #b " within " #tolerance, __FILE__, __LINE__)
+
+// Prints a summary and returns the process exit code.
+inline int CheckResult(const char* testName)
+{
+	if(Check::Failures() == 0)
+		std::printf("%s: all checks passed\n", testName);
+	else
+		std::printf("%s: %d check(s) failed\n", testName, Check::Failures().load());
+	return Check::Failures() == 0 ? 0 : 1;
+}
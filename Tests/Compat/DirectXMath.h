@@ -0,0 +1,484 @@
+//***************************************************************************************
+// DirectXMath.h (headless build)
+//
+// The part of DirectXMath that the simulation and mesh code use, so the tests and
+// benchmarks build with GCC or Clang where the Windows SDK is not installed.  MSVC
+// builds use the real header; CMake only puts this directory on the include path for
+// other compilers.
+//
+// XMVECTOR is the SSE register type on x86 (so the _XM_SSE_INTRINSICS_ paths are the
+// ones under test) and a GCC vector of four floats elsewhere.  Both have the built-in
+// arithmetic operators, so only the named functions are defined here; each one follows
+// the DirectXMath reference implementation lane by lane.
+//***************************************************************************************
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(__x86_64__)
+#include <emmintrin.h>
+#define _XM_SSE_INTRINSICS_
+#else
+#define _XM_NO_INTRINSICS_
+#endif
+
+#define XM_CALLCONV
+
+namespace DirectX
+{
+
+const float XM_PI = 3.141592654f;
+const float XM_2PI = 6.283185307f;
+const float XM_1DIVPI = 0.318309886f;
+const float XM_1DIV2PI = 0.159154943f;
+const float XM_PIDIV2 = 1.570796327f;
+const float XM_PIDIV4 = 0.785398163f;
+
+#if defined(_XM_SSE_INTRINSICS_)
+typedef __m128 XMVECTOR;
+#else
+typedef float XMVECTOR __attribute__((vector_size(16), aligned(16)));
+#endif
+
+typedef const XMVECTOR FXMVECTOR;
+typedef const XMVECTOR GXMVECTOR;
+typedef const XMVECTOR HXMVECTOR;
+typedef const XMVECTOR& CXMVECTOR;
+
+namespace Internal
+{
+	typedef std::uint32_t XMVECTORU __attribute__((vector_size(16)));
+
+	inline XMVECTORU AsBits(FXMVECTOR v) { return (XMVECTORU)v; }
+	inline XMVECTOR AsFloats(XMVECTORU u) { return (XMVECTOR)u; }
+}
+
+struct XMFLOAT2
+{
+	float x;
+	float y;
+
+	XMFLOAT2() = default;
+	constexpr XMFLOAT2(float _x, float _y) : x(_x), y(_y) {}
+};
+
+struct XMFLOAT3
+{
+	float x;
+	float y;
+	float z;
+
+	XMFLOAT3() = default;
+	constexpr XMFLOAT3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+};
+
+struct XMFLOAT4
+{
+	float x;
+	float y;
+	float z;
+	float w;
+
+	XMFLOAT4() = default;
+	constexpr XMFLOAT4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+};
+
+struct alignas(16) XMFLOAT4A : public XMFLOAT4
+{
+	XMFLOAT4A() = default;
+	constexpr XMFLOAT4A(float _x, float _y, float _z, float _w) : XMFLOAT4(_x, _y, _z, _w) {}
+};
+
+struct XMMATRIX;
+typedef const XMMATRIX& FXMMATRIX;
+typedef const XMMATRIX& CXMMATRIX;
+
+struct alignas(16) XMMATRIX
+{
+	XMVECTOR r[4];
+
+	XMMATRIX() = default;
+	XMMATRIX(FXMVECTOR r0, FXMVECTOR r1, FXMVECTOR r2, CXMVECTOR r3) { r[0] = r0; r[1] = r1; r[2] = r2; r[3] = r3; }
+
+	XMMATRIX operator*(CXMMATRIX m) const;
+};
+
+//
+// Construction and access.
+//
+
+inline XMVECTOR XMVectorSet(float x, float y, float z, float w) { XMVECTOR v = { x, y, z, w }; return v; }
+inline XMVECTOR XMVectorReplicate(float value) { return XMVectorSet(value, value, value, value); }
+inline XMVECTOR XMVectorReplicatePtr(const float* value) { return XMVectorReplicate(*value); }
+inline XMVECTOR XMVectorZero() { return XMVectorReplicate(0.0f); }
+inline XMVECTOR XMVectorSplatOne() { return XMVectorReplicate(1.0f); }
+inline XMVECTOR XMVectorSplatX(FXMVECTOR v) { return XMVectorReplicate(v[0]); }
+inline XMVECTOR XMVectorSplatY(FXMVECTOR v) { return XMVectorReplicate(v[1]); }
+inline XMVECTOR XMVectorSplatZ(FXMVECTOR v) { return XMVectorReplicate(v[2]); }
+inline XMVECTOR XMVectorSplatW(FXMVECTOR v) { return XMVectorReplicate(v[3]); }
+
+inline XMVECTOR XMVectorSetInt(std::uint32_t x, std::uint32_t y, std::uint32_t z, std::uint32_t w)
+{
+	Internal::XMVECTORU u = { x, y, z, w };
+	return Internal::AsFloats(u);
+}
+
+inline XMVECTOR XMVectorReplicateInt(std::uint32_t value) { return XMVectorSetInt(value, value, value, value); }
+inline XMVECTOR XMVectorTrueInt() { return XMVectorReplicateInt(0xFFFFFFFFu); }
+inline XMVECTOR XMVectorSplatSignMask() { return XMVectorReplicateInt(0x80000000u); }
+
+inline float XMVectorGetByIndex(FXMVECTOR v, size_t i) { return v[i]; }
+inline float XMVectorGetX(FXMVECTOR v) { return v[0]; }
+inline float XMVectorGetY(FXMVECTOR v) { return v[1]; }
+inline float XMVectorGetZ(FXMVECTOR v) { return v[2]; }
+inline float XMVectorGetW(FXMVECTOR v) { return v[3]; }
+inline XMVECTOR XMVectorSetX(FXMVECTOR v, float x) { XMVECTOR r = v; r[0] = x; return r; }
+inline XMVECTOR XMVectorSetY(FXMVECTOR v, float y) { XMVECTOR r = v; r[1] = y; return r; }
+inline XMVECTOR XMVectorSetZ(FXMVECTOR v, float z) { XMVECTOR r = v; r[2] = z; return r; }
+inline XMVECTOR XMVectorSetW(FXMVECTOR v, float w) { XMVECTOR r = v; r[3] = w; return r; }
+
+//
+// Loads and stores.
+//
+
+inline XMVECTOR XMLoadFloat(const float* p) { return XMVectorSet(*p, 0.0f, 0.0f, 0.0f); }
+inline XMVECTOR XMLoadFloat2(const XMFLOAT2* p) { return XMVectorSet(p->x, p->y, 0.0f, 0.0f); }
+inline XMVECTOR XMLoadFloat3(const XMFLOAT3* p) { return XMVectorSet(p->x, p->y, p->z, 0.0f); }
+inline XMVECTOR XMLoadFloat4(const XMFLOAT4* p) { return XMVectorSet(p->x, p->y, p->z, p->w); }
+inline XMVECTOR XMLoadFloat4A(const XMFLOAT4A* p) { return XMVectorSet(p->x, p->y, p->z, p->w); }
+inline XMVECTOR XMLoadInt4(const std::uint32_t* p) { return XMVectorSetInt(p[0], p[1], p[2], p[3]); }
+
+inline void XMStoreFloat(float* p, FXMVECTOR v) { *p = v[0]; }
+inline void XMStoreFloat2(XMFLOAT2* p, FXMVECTOR v) { p->x = v[0]; p->y = v[1]; }
+inline void XMStoreFloat3(XMFLOAT3* p, FXMVECTOR v) { p->x = v[0]; p->y = v[1]; p->z = v[2]; }
+inline void XMStoreFloat4(XMFLOAT4* p, FXMVECTOR v) { p->x = v[0]; p->y = v[1]; p->z = v[2]; p->w = v[3]; }
+inline void XMStoreFloat4A(XMFLOAT4A* p, FXMVECTOR v) { XMStoreFloat4(p, v); }
+
+inline void XMStoreInt4(std::uint32_t* p, FXMVECTOR v)
+{
+	Internal::XMVECTORU u = Internal::AsBits(v);
+	p[0] = u[0]; p[1] = u[1]; p[2] = u[2]; p[3] = u[3];
+}
+
+//
+// Arithmetic.
+//
+
+inline XMVECTOR XMVectorAdd(FXMVECTOR a, FXMVECTOR b) { return a + b; }
+inline XMVECTOR XMVectorSubtract(FXMVECTOR a, FXMVECTOR b) { return a - b; }
+inline XMVECTOR XMVectorMultiply(FXMVECTOR a, FXMVECTOR b) { return a*b; }
+inline XMVECTOR XMVectorDivide(FXMVECTOR a, FXMVECTOR b) { return a/b; }
+inline XMVECTOR XMVectorMultiplyAdd(FXMVECTOR a, FXMVECTOR b, FXMVECTOR c) { return a*b + c; }
+inline XMVECTOR XMVectorNegativeMultiplySubtract(FXMVECTOR a, FXMVECTOR b, FXMVECTOR c) { return c - a*b; }
+inline XMVECTOR XMVectorScale(FXMVECTOR v, float s) { return v*s; }
+inline XMVECTOR XMVectorNegate(FXMVECTOR v) { return -v; }
+
+inline XMVECTOR XMVectorAbs(FXMVECTOR v)
+{
+	return Internal::AsFloats(Internal::AsBits(v) & 0x7FFFFFFFu);
+}
+
+// Like minps/maxps, b is returned where either lane is a NaN.
+inline XMVECTOR XMVectorMin(FXMVECTOR a, FXMVECTOR b) { return a < b ? a : b; }
+inline XMVECTOR XMVectorMax(FXMVECTOR a, FXMVECTOR b) { return a > b ? a : b; }
+
+inline XMVECTOR XMVectorClamp(FXMVECTOR v, FXMVECTOR lo, FXMVECTOR hi) { return XMVectorMin(XMVectorMax(v, lo), hi); }
+inline XMVECTOR XMVectorSaturate(FXMVECTOR v) { return XMVectorClamp(v, XMVectorZero(), XMVectorSplatOne()); }
+
+inline XMVECTOR XMVectorSqrt(FXMVECTOR v)
+{
+#if defined(_XM_SSE_INTRINSICS_)
+	return _mm_sqrt_ps(v);
+#else
+	return XMVectorSet(std::sqrt(v[0]), std::sqrt(v[1]), std::sqrt(v[2]), std::sqrt(v[3]));
+#endif
+}
+
+inline XMVECTOR XMVectorReciprocal(FXMVECTOR v) { return XMVectorSplatOne()/v; }
+inline XMVECTOR XMVectorReciprocalSqrt(FXMVECTOR v) { return XMVectorSplatOne()/XMVectorSqrt(v); }
+
+// Round to nearest, ties to even, like the reference implementation: adding and
+// taking away 2^23 (with the sign of v) leaves no fraction bits.  Lanes of 2^23 and
+// more are integers already.
+inline XMVECTOR XMVectorRound(FXMVECTOR v)
+{
+	Internal::XMVECTORU sign = Internal::AsBits(v) & 0x80000000u;
+	XMVECTOR magic = Internal::AsFloats(sign | 0x4B000000u);
+	XMVECTOR rounded = (v + magic) - magic;
+	return XMVectorAbs(v) < XMVectorReplicate(8388608.0f) ? rounded : v;
+}
+
+inline XMVECTOR XMVectorFloor(FXMVECTOR v)
+{
+	XMVECTOR rounded = XMVectorRound(v);
+	return rounded > v ? rounded - XMVectorSplatOne() : rounded;
+}
+
+inline XMVECTOR XMVectorTruncate(FXMVECTOR v)
+{
+	return XMVectorSet(std::trunc(v[0]), std::trunc(v[1]), std::trunc(v[2]), std::trunc(v[3]));
+}
+
+inline XMVECTOR XMVectorLerp(FXMVECTOR a, FXMVECTOR b, float t) { return a + (b - a)*t; }
+inline XMVECTOR XMVectorLerpV(FXMVECTOR a, FXMVECTOR b, FXMVECTOR t) { return a + (b - a)*t; }
+
+inline XMVECTOR XMVectorACos(FXMVECTOR v)
+{
+	return XMVectorSet(std::acos(v[0]), std::acos(v[1]), std::acos(v[2]), std::acos(v[3]));
+}
+
+inline void XMVectorSinCos(XMVECTOR* sin, XMVECTOR* cos, FXMVECTOR v)
+{
+	*sin = XMVectorSet(std::sin(v[0]), std::sin(v[1]), std::sin(v[2]), std::sin(v[3]));
+	*cos = XMVectorSet(std::cos(v[0]), std::cos(v[1]), std::cos(v[2]), std::cos(v[3]));
+}
+
+//
+// Comparisons and bitwise operations.  Comparisons give all-ones lanes where true.
+//
+
+inline XMVECTOR XMVectorEqual(FXMVECTOR a, FXMVECTOR b) { return (XMVECTOR)(a == b); }
+inline XMVECTOR XMVectorGreater(FXMVECTOR a, FXMVECTOR b) { return (XMVECTOR)(a > b); }
+inline XMVECTOR XMVectorGreaterOrEqual(FXMVECTOR a, FXMVECTOR b) { return (XMVECTOR)(a >= b); }
+inline XMVECTOR XMVectorLess(FXMVECTOR a, FXMVECTOR b) { return (XMVECTOR)(a < b); }
+inline XMVECTOR XMVectorLessOrEqual(FXMVECTOR a, FXMVECTOR b) { return (XMVECTOR)(a <= b); }
+
+inline XMVECTOR XMVectorAndInt(FXMVECTOR a, FXMVECTOR b) { return Internal::AsFloats(Internal::AsBits(a) & Internal::AsBits(b)); }
+inline XMVECTOR XMVectorAndCInt(FXMVECTOR a, FXMVECTOR b) { return Internal::AsFloats(Internal::AsBits(a) & ~Internal::AsBits(b)); }
+inline XMVECTOR XMVectorOrInt(FXMVECTOR a, FXMVECTOR b) { return Internal::AsFloats(Internal::AsBits(a) | Internal::AsBits(b)); }
+inline XMVECTOR XMVectorXorInt(FXMVECTOR a, FXMVECTOR b) { return Internal::AsFloats(Internal::AsBits(a) ^ Internal::AsBits(b)); }
+
+// Takes the lanes of b where control is set and the lanes of a elsewhere.
+inline XMVECTOR XMVectorSelect(FXMVECTOR a, FXMVECTOR b, FXMVECTOR control)
+{
+	Internal::XMVECTORU c = Internal::AsBits(control);
+	return Internal::AsFloats((Internal::AsBits(a) & ~c) | (Internal::AsBits(b) & c));
+}
+
+//
+// Conversions.
+//
+
+// Scales by 2^mulExponent and truncates to int32 lanes, saturating like the
+// reference implementation.
+inline XMVECTOR XMConvertVectorFloatToInt(FXMVECTOR v, std::uint32_t mulExponent)
+{
+	float scale = static_cast<float>(1u << mulExponent);
+	Internal::XMVECTORU u;
+	for(int i = 0; i < 4; ++i)
+	{
+		float f = v[i]*scale;
+		std::int32_t r;
+		if(f <= -(65536.0f*32768.0f))
+			r = INT32_MIN;
+		else if(f > (65536.0f*32768.0f) - 128.0f)
+			r = INT32_MAX;
+		else
+			r = static_cast<std::int32_t>(f);
+		u[i] = static_cast<std::uint32_t>(r);
+	}
+	return Internal::AsFloats(u);
+}
+
+inline XMVECTOR XMConvertVectorIntToFloat(FXMVECTOR v, std::uint32_t divExponent)
+{
+	float scale = 1.0f/static_cast<float>(1u << divExponent);
+	Internal::XMVECTORU u = Internal::AsBits(v);
+	return XMVectorSet(static_cast<std::int32_t>(u[0])*scale, static_cast<std::int32_t>(u[1])*scale,
+		static_cast<std::int32_t>(u[2])*scale, static_cast<std::int32_t>(u[3])*scale);
+}
+
+inline float XMConvertToRadians(float degrees) { return degrees*(XM_PI/180.0f); }
+inline float XMConvertToDegrees(float radians) { return radians*(180.0f/XM_PI); }
+
+inline void XMScalarSinCos(float* sin, float* cos, float value)
+{
+	*sin = std::sin(value);
+	*cos = std::cos(value);
+}
+
+//
+// 2D, 3D and 4D vector functions.  Dot products are replicated into every lane.
+//
+
+inline XMVECTOR XMVector2Dot(FXMVECTOR a, FXMVECTOR b) { return XMVectorReplicate(a[0]*b[0] + a[1]*b[1]); }
+inline XMVECTOR XMVector2Length(FXMVECTOR v) { return XMVectorSqrt(XMVector2Dot(v, v)); }
+
+inline XMVECTOR XMVector2Normalize(FXMVECTOR v)
+{
+	float length = std::sqrt(v[0]*v[0] + v[1]*v[1]);
+	return v*(length > 0.0f ? 1.0f/length : 0.0f);
+}
+
+inline XMVECTOR XMVector3Dot(FXMVECTOR a, FXMVECTOR b) { return XMVectorReplicate(a[0]*b[0] + a[1]*b[1] + a[2]*b[2]); }
+inline XMVECTOR XMVector3LengthSq(FXMVECTOR v) { return XMVector3Dot(v, v); }
+inline XMVECTOR XMVector3Length(FXMVECTOR v) { return XMVectorSqrt(XMVector3Dot(v, v)); }
+
+inline XMVECTOR XMVector3Normalize(FXMVECTOR v)
+{
+	float length = std::sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+	return v*(length > 0.0f ? 1.0f/length : 0.0f);
+}
+
+inline XMVECTOR XMVector3Cross(FXMVECTOR a, FXMVECTOR b)
+{
+	return XMVectorSet(a[1]*b[2] - a[2]*b[1], a[2]*b[0] - a[0]*b[2], a[0]*b[1] - a[1]*b[0], 0.0f);
+}
+
+inline bool XMVector3Equal(FXMVECTOR a, FXMVECTOR b) { return a[0] == b[0] && a[1] == b[1] && a[2] == b[2]; }
+inline bool XMVector3Less(FXMVECTOR a, FXMVECTOR b) { return a[0] < b[0] && a[1] < b[1] && a[2] < b[2]; }
+
+inline XMVECTOR XMVector4Dot(FXMVECTOR a, FXMVECTOR b) { return XMVectorReplicate(a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3]); }
+inline bool XMVector4Equal(FXMVECTOR a, FXMVECTOR b)
+{
+#if defined(_XM_SSE_INTRINSICS_)
+	return _mm_movemask_ps(_mm_cmpeq_ps(a, b)) == 0xF;
+#else
+	return a[0] == b[0] && a[1] == b[1] && a[2] == b[2] && a[3] == b[3];
+#endif
+}
+
+inline bool XMVector4NotEqual(FXMVECTOR a, FXMVECTOR b) { return !XMVector4Equal(a, b); }
+
+//
+// Matrices (row vectors, as in DirectXMath).
+//
+
+inline XMMATRIX XMMatrixIdentity()
+{
+	return XMMATRIX(XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f),
+		XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+inline XMMATRIX XMMatrixTranspose(FXMMATRIX m)
+{
+	return XMMATRIX(
+		XMVectorSet(m.r[0][0], m.r[1][0], m.r[2][0], m.r[3][0]),
+		XMVectorSet(m.r[0][1], m.r[1][1], m.r[2][1], m.r[3][1]),
+		XMVectorSet(m.r[0][2], m.r[1][2], m.r[2][2], m.r[3][2]),
+		XMVectorSet(m.r[0][3], m.r[1][3], m.r[2][3], m.r[3][3]));
+}
+
+inline XMMATRIX XMMatrixMultiply(FXMMATRIX a, CXMMATRIX b)
+{
+	XMMATRIX r;
+	for(int i = 0; i < 4; ++i)
+		r.r[i] = XMVectorSplatX(a.r[i])*b.r[0] + XMVectorSplatY(a.r[i])*b.r[1] +
+			XMVectorSplatZ(a.r[i])*b.r[2] + XMVectorSplatW(a.r[i])*b.r[3];
+	return r;
+}
+
+inline XMMATRIX XMMATRIX::operator*(CXMMATRIX m) const { return XMMatrixMultiply(*this, m); }
+
+inline XMMATRIX XMMatrixTranslation(float x, float y, float z)
+{
+	XMMATRIX m = XMMatrixIdentity();
+	m.r[3] = XMVectorSet(x, y, z, 1.0f);
+	return m;
+}
+
+inline XMMATRIX XMMatrixScaling(float x, float y, float z)
+{
+	return XMMATRIX(XMVectorSet(x, 0.0f, 0.0f, 0.0f), XMVectorSet(0.0f, y, 0.0f, 0.0f),
+		XMVectorSet(0.0f, 0.0f, z, 0.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+inline XMMATRIX XMMatrixRotationX(float angle)
+{
+	float s = sinf(angle), c = cosf(angle);
+	return XMMATRIX(XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), XMVectorSet(0.0f, c, s, 0.0f),
+		XMVectorSet(0.0f, -s, c, 0.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+inline XMMATRIX XMMatrixRotationY(float angle)
+{
+	float s = sinf(angle), c = cosf(angle);
+	return XMMATRIX(XMVectorSet(c, 0.0f, -s, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f),
+		XMVectorSet(s, 0.0f, c, 0.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+inline XMMATRIX XMMatrixPerspectiveFovLH(float fovAngleY, float aspectRatio, float nearZ, float farZ)
+{
+	float h = cosf(0.5f*fovAngleY)/sinf(0.5f*fovAngleY);
+	float w = h/aspectRatio;
+	float range = farZ/(farZ - nearZ);
+	return XMMATRIX(XMVectorSet(w, 0.0f, 0.0f, 0.0f), XMVectorSet(0.0f, h, 0.0f, 0.0f),
+		XMVectorSet(0.0f, 0.0f, range, 1.0f), XMVectorSet(0.0f, 0.0f, -range*nearZ, 0.0f));
+}
+
+inline XMMATRIX XMMatrixLookAtLH(FXMVECTOR eyePosition, FXMVECTOR focusPosition, FXMVECTOR upDirection)
+{
+	XMVECTOR r2 = XMVector3Normalize(focusPosition - eyePosition);
+	XMVECTOR r0 = XMVector3Normalize(XMVector3Cross(upDirection, r2));
+	XMVECTOR r1 = XMVector3Cross(r2, r0);
+
+	XMVECTOR negEye = XMVectorNegate(eyePosition);
+	float d0 = XMVectorGetX(XMVector3Dot(r0, negEye));
+	float d1 = XMVectorGetX(XMVector3Dot(r1, negEye));
+	float d2 = XMVectorGetX(XMVector3Dot(r2, negEye));
+
+	return XMMatrixTranspose(XMMATRIX(XMVectorSetW(r0, d0), XMVectorSetW(r1, d1), XMVectorSetW(r2, d2),
+		XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+// Inverse by cofactors; the determinant is replicated into *determinant.
+inline XMMATRIX XMMatrixInverse(XMVECTOR* determinant, FXMMATRIX m)
+{
+	float a[16];
+	for(int i = 0; i < 16; ++i)
+		a[i] = m.r[i/4][i%4];
+
+	float c[16];
+	c[0] = a[5]*a[10]*a[15] - a[5]*a[11]*a[14] - a[9]*a[6]*a[15] + a[9]*a[7]*a[14] + a[13]*a[6]*a[11] - a[13]*a[7]*a[10];
+	c[4] = -a[4]*a[10]*a[15] + a[4]*a[11]*a[14] + a[8]*a[6]*a[15] - a[8]*a[7]*a[14] - a[12]*a[6]*a[11] + a[12]*a[7]*a[10];
+	c[8] = a[4]*a[9]*a[15] - a[4]*a[11]*a[13] - a[8]*a[5]*a[15] + a[8]*a[7]*a[13] + a[12]*a[5]*a[11] - a[12]*a[7]*a[9];
+	c[12] = -a[4]*a[9]*a[14] + a[4]*a[10]*a[13] + a[8]*a[5]*a[14] - a[8]*a[6]*a[13] - a[12]*a[5]*a[10] + a[12]*a[6]*a[9];
+	c[1] = -a[1]*a[10]*a[15] + a[1]*a[11]*a[14] + a[9]*a[2]*a[15] - a[9]*a[3]*a[14] - a[13]*a[2]*a[11] + a[13]*a[3]*a[10];
+	c[5] = a[0]*a[10]*a[15] - a[0]*a[11]*a[14] - a[8]*a[2]*a[15] + a[8]*a[3]*a[14] + a[12]*a[2]*a[11] - a[12]*a[3]*a[10];
+	c[9] = -a[0]*a[9]*a[15] + a[0]*a[11]*a[13] + a[8]*a[1]*a[15] - a[8]*a[3]*a[13] - a[12]*a[1]*a[11] + a[12]*a[3]*a[9];
+	c[13] = a[0]*a[9]*a[14] - a[0]*a[10]*a[13] - a[8]*a[1]*a[14] + a[8]*a[2]*a[13] + a[12]*a[1]*a[10] - a[12]*a[2]*a[9];
+	c[2] = a[1]*a[6]*a[15] - a[1]*a[7]*a[14] - a[5]*a[2]*a[15] + a[5]*a[3]*a[14] + a[13]*a[2]*a[7] - a[13]*a[3]*a[6];
+	c[6] = -a[0]*a[6]*a[15] + a[0]*a[7]*a[14] + a[4]*a[2]*a[15] - a[4]*a[3]*a[14] - a[12]*a[2]*a[7] + a[12]*a[3]*a[6];
+	c[10] = a[0]*a[5]*a[15] - a[0]*a[7]*a[13] - a[4]*a[1]*a[15] + a[4]*a[3]*a[13] + a[12]*a[1]*a[7] - a[12]*a[3]*a[5];
+	c[14] = -a[0]*a[5]*a[14] + a[0]*a[6]*a[13] + a[4]*a[1]*a[14] - a[4]*a[2]*a[13] - a[12]*a[1]*a[6] + a[12]*a[2]*a[5];
+	c[3] = -a[1]*a[6]*a[11] + a[1]*a[7]*a[10] + a[5]*a[2]*a[11] - a[5]*a[3]*a[10] - a[9]*a[2]*a[7] + a[9]*a[3]*a[6];
+	c[7] = a[0]*a[6]*a[11] - a[0]*a[7]*a[10] - a[4]*a[2]*a[11] + a[4]*a[3]*a[10] + a[8]*a[2]*a[7] - a[8]*a[3]*a[6];
+	c[11] = -a[0]*a[5]*a[11] + a[0]*a[7]*a[9] + a[4]*a[1]*a[11] - a[4]*a[3]*a[9] - a[8]*a[1]*a[7] + a[8]*a[3]*a[5];
+	c[15] = a[0]*a[5]*a[10] - a[0]*a[6]*a[9] - a[4]*a[1]*a[10] + a[4]*a[2]*a[9] + a[8]*a[1]*a[6] - a[8]*a[2]*a[5];
+
+	float det = a[0]*c[0] + a[1]*c[4] + a[2]*c[8] + a[3]*c[12];
+	if(determinant)
+		*determinant = XMVectorReplicate(det);
+
+	float inv = 1.0f/det;
+	XMMATRIX r;
+	for(int i = 0; i < 4; ++i)
+		r.r[i] = XMVectorSet(c[4*i]*inv, c[4*i + 1]*inv, c[4*i + 2]*inv, c[4*i + 3]*inv);
+	return r;
+}
+
+inline XMVECTOR XMVector3Transform(FXMVECTOR v, FXMMATRIX m)
+{
+	return XMVectorSplatX(v)*m.r[0] + XMVectorSplatY(v)*m.r[1] + XMVectorSplatZ(v)*m.r[2] + m.r[3];
+}
+
+inline XMVECTOR XMVector3TransformCoord(FXMVECTOR v, FXMMATRIX m)
+{
+	XMVECTOR r = XMVector3Transform(v, m);
+	return r/XMVectorSplatW(r);
+}
+
+inline XMVECTOR XMVector4Transform(FXMVECTOR v, FXMMATRIX m)
+{
+	return XMVectorSplatX(v)*m.r[0] + XMVectorSplatY(v)*m.r[1] + XMVectorSplatZ(v)*m.r[2] + XMVectorSplatW(v)*m.r[3];
+}
+
+inline XMVECTOR XMVector3TransformNormal(FXMVECTOR v, FXMMATRIX m)
+{
+	return XMVectorSplatX(v)*m.r[0] + XMVectorSplatY(v)*m.r[1] + XMVectorSplatZ(v)*m.r[2];
+}
+
+} // namespace DirectX
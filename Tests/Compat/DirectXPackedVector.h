@@ -0,0 +1,198 @@
+//***************************************************************************************
+// DirectXPackedVector.h (headless build)
+//
+// The packed formats of DirectXMath that the simulation and mesh code use.  The half
+// conversions are the reference (non-F16C) ones, so results match the MSVC build bit
+// for bit.
+//***************************************************************************************
+
+#pragma once
+
+#include "DirectXMath.h"
+#include <cstring>
+
+namespace DirectX
+{
+namespace PackedVector
+{
+
+typedef std::uint16_t HALF;
+
+inline HALF XMConvertFloatToHalf(float value)
+{
+	std::uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	std::uint32_t sign = (bits & 0x80000000u) >> 16u;
+	bits &= 0x7FFFFFFFu;
+
+	std::uint32_t result;
+	if(bits > 0x477FE000u)
+	{
+		// Too large for a half: infinity, or a NaN that stays a NaN.
+		if((bits & 0x7F800000u) == 0x7F800000u && (bits & 0x7FFFFFu) != 0)
+			result = 0x7FFFu;
+		else
+			result = 0x7C00u;
+	}
+	else if(bits == 0)
+	{
+		result = 0;
+	}
+	else
+	{
+		if(bits < 0x38800000u)
+		{
+			// Denormalized as a half.
+			std::uint32_t shift = 113u - (bits >> 23u);
+			bits = (0x800000u | (bits & 0x7FFFFFu)) >> shift;
+		}
+		else
+		{
+			// Rebias the exponent.
+			bits += 0xC8000000u;
+		}
+
+		// Round to nearest even.
+		result = ((bits + 0x0FFFu + ((bits >> 13u) & 1u)) >> 13u) & 0x7FFFu;
+	}
+
+	return static_cast<HALF>(result | sign);
+}
+
+inline float XMConvertHalfToFloat(HALF value)
+{
+	std::uint32_t mantissa = value & 0x03FFu;
+	std::uint32_t exponent = value & 0x7C00u;
+
+	if(exponent == 0x7C00u)
+	{
+		// Infinity or NaN.
+		exponent = 0x8Fu;
+	}
+	else if(exponent != 0)
+	{
+		exponent = (value >> 10) & 0x1Fu;
+	}
+	else if(mantissa != 0)
+	{
+		// Normalize a denormal.
+		exponent = 1;
+		do
+		{
+			exponent--;
+			mantissa <<= 1;
+		} while((mantissa & 0x0400u) == 0);
+		mantissa &= 0x03FFu;
+	}
+	else
+	{
+		exponent = static_cast<std::uint32_t>(-112);
+	}
+
+	std::uint32_t bits = ((value & 0x8000u) << 16) | ((exponent + 112) << 23) | (mantissa << 13);
+	float result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+inline HALF* XMConvertFloatToHalfStream(HALF* output, size_t outputStride,
+	const float* input, size_t inputStride, size_t count)
+{
+	auto out = reinterpret_cast<std::uint8_t*>(output);
+	auto in = reinterpret_cast<const std::uint8_t*>(input);
+	for(size_t i = 0; i < count; ++i, out += outputStride, in += inputStride)
+	{
+		float f;
+		std::memcpy(&f, in, sizeof(f));
+		HALF h = XMConvertFloatToHalf(f);
+		std::memcpy(out, &h, sizeof(h));
+	}
+	return output;
+}
+
+struct XMHALF4
+{
+	HALF x;
+	HALF y;
+	HALF z;
+	HALF w;
+};
+
+struct XMSHORTN2
+{
+	std::int16_t x;
+	std::int16_t y;
+};
+
+struct XMSHORTN4
+{
+	std::int16_t x;
+	std::int16_t y;
+	std::int16_t z;
+	std::int16_t w;
+};
+
+struct XMUSHORTN2
+{
+	std::uint16_t x;
+	std::uint16_t y;
+};
+
+inline void XMStoreHalf4(XMHALF4* p, FXMVECTOR v)
+{
+	p->x = XMConvertFloatToHalf(v[0]);
+	p->y = XMConvertFloatToHalf(v[1]);
+	p->z = XMConvertFloatToHalf(v[2]);
+	p->w = XMConvertFloatToHalf(v[3]);
+}
+
+inline XMVECTOR XMLoadHalf4(const XMHALF4* p)
+{
+	return XMVectorSet(XMConvertHalfToFloat(p->x), XMConvertHalfToFloat(p->y),
+		XMConvertHalfToFloat(p->z), XMConvertHalfToFloat(p->w));
+}
+
+inline void XMStoreShortN2(XMSHORTN2* p, FXMVECTOR v)
+{
+	XMVECTOR n = XMVectorRound(XMVectorClamp(v, XMVectorReplicate(-1.0f), XMVectorSplatOne())*32767.0f);
+	p->x = static_cast<std::int16_t>(n[0]);
+	p->y = static_cast<std::int16_t>(n[1]);
+}
+
+// -32768 decodes to -1, like -32767.
+inline XMVECTOR XMLoadShortN2(const XMSHORTN2* p)
+{
+	XMVECTOR v = XMVectorSet(p->x, p->y, 0.0f, 0.0f)/32767.0f;
+	return XMVectorMax(v, XMVectorReplicate(-1.0f));
+}
+
+inline void XMStoreShortN4(XMSHORTN4* p, FXMVECTOR v)
+{
+	XMVECTOR n = XMVectorRound(XMVectorClamp(v, XMVectorReplicate(-1.0f), XMVectorSplatOne())*32767.0f);
+	p->x = static_cast<std::int16_t>(n[0]);
+	p->y = static_cast<std::int16_t>(n[1]);
+	p->z = static_cast<std::int16_t>(n[2]);
+	p->w = static_cast<std::int16_t>(n[3]);
+}
+
+inline XMVECTOR XMLoadShortN4(const XMSHORTN4* p)
+{
+	XMVECTOR v = XMVectorSet(p->x, p->y, p->z, p->w)/32767.0f;
+	return XMVectorMax(v, XMVectorReplicate(-1.0f));
+}
+
+inline void XMStoreUShortN2(XMUSHORTN2* p, FXMVECTOR v)
+{
+	XMVECTOR n = XMVectorRound(XMVectorSaturate(v)*65535.0f);
+	p->x = static_cast<std::uint16_t>(n[0]);
+	p->y = static_cast<std::uint16_t>(n[1]);
+}
+
+inline XMVECTOR XMLoadUShortN2(const XMUSHORTN2* p)
+{
+	return XMVectorSet(p->x, p->y, 0.0f, 0.0f)/65535.0f;
+}
+
+} // namespace PackedVector
+} // namespace DirectX
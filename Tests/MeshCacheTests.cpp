@@ -0,0 +1,183 @@
+//***************************************************************************************
+// MeshCacheTests.cpp
+//
+// MeshCache round trips: meshes stored and saved come back from the mapped file bit
+// for bit, with the error they were stored with, files that are damaged or of another layout count as empty, and a Save
+// that cannot write or replace the file keeps the stored meshes and leaves no
+// temporary file behind.
+//***************************************************************************************
+
+#include "Check.h"
+#include "GeometryGenerator.h"
+#include "MeshCache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char* const CacheFile = "MeshCacheTests.bin";
+	const char* const TempFile = "MeshCacheTests.bin.tmp";
+
+	std::wstring Wide(const char* name)
+	{
+		return std::wstring(name, name + std::strlen(name));
+	}
+
+	bool Exists(const char* name)
+	{
+		return std::ifstream(name).good();
+	}
+
+	void MakeDirectory(const char* name)
+	{
+#if defined(_WIN32)
+		_mkdir(name);
+#else
+		mkdir(name, 0755);
+#endif
+	}
+
+	void RemoveEmptyDirectory(const char* name)
+	{
+#if defined(_WIN32)
+		_rmdir(name);
+#else
+		rmdir(name);
+#endif
+	}
+
+	bool SameMesh(const MeshCache::MeshView& view, const GeometryGenerator::MeshData& mesh)
+	{
+		return view.VertexCount == mesh.Vertices.size() && view.IndexCount == mesh.Indices32.size() &&
+			std::memcmp(view.Vertices, mesh.Vertices.data(), mesh.Vertices.size()*sizeof(GeometryGenerator::Vertex)) == 0 &&
+			std::memcmp(view.Indices, mesh.Indices32.data(), mesh.Indices32.size()*sizeof(std::uint32_t)) == 0;
+	}
+
+	void TestRoundTrip()
+	{
+		std::remove(CacheFile);
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData torus = geoGen.CreateTorus(1.5f, 0.3f, 8, 6);
+		GeometryGenerator::MeshData sphere = geoGen.CreateSphere(1.0f, 12, 10);
+
+		{
+			MeshCache cache(Wide(CacheFile));
+			CHECK(SameMesh(cache.Generate("CreateTorus", geoGen, &GeometryGenerator::CreateTorus, 1.5f, 0.3f, 8, 6), torus));
+			CHECK(cache.HitCount() == 0);
+			CHECK(cache.MissCount() == 1);
+			CHECK(cache.Save());
+			CHECK(cache.MissCount() == 0);
+			CHECK(!Exists(TempFile));
+
+			// Served from the new file now.
+			CHECK(SameMesh(cache.Generate("CreateTorus", geoGen, &GeometryGenerator::CreateTorus, 1.5f, 0.3f, 8, 6), torus));
+			CHECK(cache.HitCount() == 1);
+		}
+
+		// A second run finds the torus, adds the sphere and keeps both.
+		{
+			MeshCache cache(Wide(CacheFile));
+			CHECK(SameMesh(cache.Generate("CreateTorus", geoGen, &GeometryGenerator::CreateTorus, 1.5f, 0.3f, 8, 6), torus));
+			CHECK(SameMesh(cache.Generate("CreateSphere", geoGen, &GeometryGenerator::CreateSphere, 1.0f, 12, 10), sphere));
+			CHECK(cache.HitCount() == 1);
+			CHECK(cache.MissCount() == 1);
+
+			// An LOD level keeps its error, before and after Save.
+			MeshCache::MeshView lod = cache.Store(MeshCache::MakeKey("SphereLod", 1.0f, 12u, 10u, 0.5f), sphere, 0.125f);
+			CHECK(SameMesh(lod, sphere) && lod.Error == 0.125f);
+			CHECK(cache.Save());
+		}
+		{
+			MeshCache cache(Wide(CacheFile));
+			MeshCache::MeshView view;
+			CHECK(cache.Find(MeshCache::MakeKey("CreateTorus", 1.5f, 0.3f, 8u, 6u), view) && SameMesh(view, torus));
+			CHECK(view.Error == 0.0f);
+			CHECK(cache.Find(MeshCache::MakeKey("CreateSphere", 1.0f, 12u, 10u), view) && SameMesh(view, sphere));
+			CHECK(!cache.Find(MeshCache::MakeKey("CreateSphere", 1.0f, 12u, 11u), view));
+			CHECK(cache.Find(MeshCache::MakeKey("SphereLod", 1.0f, 12u, 10u, 0.5f), view) && SameMesh(view, sphere));
+			CHECK(view.Error == 0.125f);
+		}
+
+		std::remove(CacheFile);
+	}
+
+	void TestDamagedFile()
+	{
+		// Cut short in the middle of the entries.
+		{
+			std::ofstream file(CacheFile, std::ios::binary);
+			file.write("MSHC\x03\0\0\0\x05\0\0\0", 12);
+		}
+
+		MeshCache cache(Wide(CacheFile));
+		MeshCache::MeshView view;
+		CHECK(!cache.Find(MeshCache::MakeKey("CreateTorus", 1.5f, 0.3f, 8u, 6u), view));
+
+		// Overwritten by the next Save.
+		GeometryGenerator geoGen;
+		cache.Generate("CreateTorus", geoGen, &GeometryGenerator::CreateTorus, 1.5f, 0.3f, 8, 6);
+		CHECK(cache.Save());
+		CHECK(cache.Find(MeshCache::MakeKey("CreateTorus", 1.5f, 0.3f, 8u, 6u), view));
+
+		std::remove(CacheFile);
+	}
+
+	void TestFailedSave()
+	{
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData torus = geoGen.CreateTorus(1.5f, 0.3f, 8, 6);
+
+		// The temporary file cannot be created.
+		{
+			MeshCache cache(L"MeshCacheTestsMissing/MeshCache.bin");
+			cache.Generate("CreateTorus", geoGen, &GeometryGenerator::CreateTorus, 1.5f, 0.3f, 8, 6);
+			CHECK(!cache.Save());
+			CHECK(cache.MissCount() == 1);
+		}
+
+		// The temporary file is written but cannot replace the cache: a directory
+		// is in the way.
+		std::remove(CacheFile);
+		MakeDirectory(CacheFile);
+		{
+			MeshCache cache(Wide(CacheFile));
+			cache.Generate("CreateTorus", geoGen, &GeometryGenerator::CreateTorus, 1.5f, 0.3f, 8, 6);
+			CHECK(!cache.Save());
+			CHECK(!Exists(TempFile));
+			CHECK(cache.MissCount() == 1);
+
+			MeshCache::MeshView view;
+			CHECK(cache.Find(MeshCache::MakeKey("CreateTorus", 1.5f, 0.3f, 8u, 6u), view) && SameMesh(view, torus));
+
+			// With the way clear, the same cache saves what it kept.
+			RemoveEmptyDirectory(CacheFile);
+			CHECK(cache.Save());
+			CHECK(cache.MissCount() == 0);
+		}
+		{
+			MeshCache cache(Wide(CacheFile));
+			MeshCache::MeshView view;
+			CHECK(cache.Find(MeshCache::MakeKey("CreateTorus", 1.5f, 0.3f, 8u, 6u), view) && SameMesh(view, torus));
+		}
+
+		std::remove(CacheFile);
+	}
+}
+
+int main()
+{
+	TestRoundTrip();
+	TestDamagedFile();
+	TestFailedSave();
+
+	return CheckResult("MeshCacheTests");
+}
@@ -0,0 +1,229 @@
+//***************************************************************************************
+// MeshCodecTests.cpp
+//
+// MeshCodec round trips: every generated mesh, as generated and as the app prepares
+// it (welded and optimized), decodes to the same vertices and the same triangles in
+// the same order with the same winding, and the optimized index buffers shrink at
+// least fourfold.  Random indices and vertex bytes of every vertex size round trip
+// too, and cut-short or damaged data is refused or decodes to something without
+// reading out of bounds.  Headers with counts the data cannot hold are refused
+// before anything is allocated for them.
+//***************************************************************************************
+
+#include "Check.h"
+#include "GeometryGenerator.h"
+#include "MeshCodec.h"
+#include "MeshOptimizer.h"
+#include "MeshWelder.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	typedef GeometryGenerator::MeshData MeshData;
+	typedef std::uint32_t uint32;
+
+	// Optimized meshes take one or two bytes per triangle against twelve raw.
+	const float MinOptimizedIndexRatio = 4.0f;
+
+	// Same triangles in the same order; each may start at another corner.
+	bool SameTriangles(const std::vector<uint32>& a, const std::vector<uint32>& b)
+	{
+		if(a.size() != b.size())
+			return false;
+
+		for(size_t t = 0; t + 2 < a.size(); t += 3)
+		{
+			bool same = false;
+			for(int r = 0; r < 3 && !same; ++r)
+				same = a[t] == b[t + r] && a[t + 1] == b[t + (r + 1) % 3] && a[t + 2] == b[t + (r + 2) % 3];
+			if(!same)
+				return false;
+		}
+		return true;
+	}
+
+	void TestMesh(const char* name, const MeshData& mesh, bool optimized)
+	{
+		std::vector<std::uint8_t> data = MeshCodec::Encode(mesh);
+
+		MeshData decoded;
+		CHECK(MeshCodec::Decode(data.data(), data.size(), decoded));
+		CHECK(decoded.Vertices.size() == mesh.Vertices.size());
+		CHECK(std::memcmp(decoded.Vertices.data(), mesh.Vertices.data(), mesh.Vertices.size()*sizeof(GeometryGenerator::Vertex)) == 0);
+		CHECK(SameTriangles(mesh.Indices32, decoded.Indices32));
+
+		MeshCodec::CodecReport report = MeshCodec::Measure(mesh);
+		CHECK(report.RoundTrips);
+		CHECK(report.IndexBytes == mesh.Indices32.size()*sizeof(uint32));
+		CHECK(report.VertexBytes == mesh.Vertices.size()*sizeof(GeometryGenerator::Vertex));
+		if(mesh.Vertices.size() >= 64)
+			CHECK(report.VertexRatio() >= 1.0f);
+		if(optimized)
+			CHECK(report.IndexRatio() >= MinOptimizedIndexRatio);
+
+		// Every way of cutting the data short is refused.
+		int accepted = 0;
+		for(size_t size = 0; size < data.size(); size += std::max<size_t>(1, data.size()/97))
+			accepted += MeshCodec::Decode(data.data(), size, decoded);
+		CHECK(accepted == 0);
+
+		std::printf("%-24s indices %6.2fx, vertices %5.2fx\n", name, report.IndexRatio(), report.VertexRatio());
+	}
+
+	void TestGenerators()
+	{
+		GeometryGenerator geoGen;
+		struct Named
+		{
+			const char* Name;
+			MeshData Mesh;
+		};
+		std::vector<Named> meshes;
+		meshes.push_back({ "box", geoGen.CreateBox(8.0f, 8.0f, 8.0f, 2) });
+		meshes.push_back({ "sphere", geoGen.CreateSphere(1.0f, 20, 20) });
+		meshes.push_back({ "geosphere", geoGen.CreateGeosphere(1.0f, 3) });
+		meshes.push_back({ "cylinder", geoGen.CreateCylinder(1.5f, 1.0f, 8.0f, 20, 10) });
+		meshes.push_back({ "grid", geoGen.CreateGrid(160.0f, 160.0f, 50, 50) });
+		meshes.push_back({ "quad", geoGen.CreateQuad(0.0f, 0.0f, 1.0f, 1.0f, 0.0f) });
+		meshes.push_back({ "square pyramid", geoGen.CreateSquarePyramid(5.0f, 7.0f, 7.0f, 2) });
+		meshes.push_back({ "triangular pyramid", geoGen.CreateTriangularPyramid(5.0f, 7.0f, 7.0f, 2) });
+		meshes.push_back({ "triangular prism", geoGen.CreateTriangularPrism(5.0f, 7.0f, 7.0f, 2) });
+		meshes.push_back({ "cone", geoGen.CreateCone(1.5f, 6.0f, 20, 6) });
+		meshes.push_back({ "torus", geoGen.CreateTorus(1.5f, 0.3f, 24, 16) });
+		meshes.push_back({ "diamond", geoGen.CreateDiamond(2.0f, 2.0f, 1.0f, 1) });
+
+		MeshWelder::WeldOptions weldOptions;
+		weldOptions.CompareTangents = false;
+		for(Named& named : meshes)
+		{
+			TestMesh(named.Name, named.Mesh, false);
+
+			MeshWelder::Weld(named.Mesh, weldOptions);
+			MeshOptimizer::OptimizeMesh(named.Mesh);
+			TestMesh((std::string(named.Name) + " optimized").c_str(), named.Mesh, named.Mesh.Indices32.size() >= 3*64);
+		}
+	}
+
+	void TestRandom()
+	{
+		std::mt19937 random(7);
+
+		// Triangles with no locality at all, and with repeated and degenerate ones.
+		for(uint32 vertexCount : { 3u, 17u, 1000u, 70000u })
+		{
+			std::uniform_int_distribution<uint32> vertex(0, vertexCount - 1);
+			std::vector<uint32> indices(3*2000);
+			for(uint32& index : indices)
+				index = vertex(random);
+			for(size_t t = 0; t + 8 < indices.size(); t += 300)
+			{
+				std::copy(&indices[t], &indices[t] + 3, &indices[t] + 3);
+				indices[t + 7] = indices[t + 6];
+			}
+
+			std::vector<std::uint8_t> data = MeshCodec::EncodeIndices(indices.data(), indices.size());
+			std::vector<uint32> decoded(indices.size());
+			CHECK(MeshCodec::DecodeIndices(decoded.data(), decoded.size(), data.data(), data.size()));
+			CHECK(SameTriangles(indices, decoded));
+		}
+
+		// Every vertex size, with bytes that are random, constant or slowly changing,
+		// over counts that do and do not fill the last block.
+		int wrong = 0;
+		for(size_t vertexSize = 1; vertexSize <= 256; vertexSize += (vertexSize < 20 ? 1 : 27))
+		{
+			for(size_t vertexCount : { size_t(1), size_t(255), size_t(700) })
+			{
+				std::vector<std::uint8_t> vertices(vertexCount*vertexSize);
+				for(size_t k = 0; k < vertices.size(); ++k)
+				{
+					size_t column = k % vertexSize;
+					if(column % 3 == 0)
+						vertices[k] = static_cast<std::uint8_t>(random());
+					else if(column % 3 == 1)
+						vertices[k] = 0x5a;
+					else
+						vertices[k] = static_cast<std::uint8_t>(k / vertexSize / 7);
+				}
+
+				std::vector<std::uint8_t> data = MeshCodec::EncodeVertices(vertices.data(), vertexCount, vertexSize);
+				std::vector<std::uint8_t> decoded(vertices.size());
+				bool ok = MeshCodec::DecodeVertices(decoded.data(), vertexCount, vertexSize, data.data(), data.size());
+				wrong += !ok || decoded != vertices;
+			}
+		}
+		CHECK(wrong == 0);
+	}
+
+	// Flipped bytes may decode to other indices, but never outside the mesh and
+	// never by reading past the data.
+	void TestDamaged()
+	{
+		GeometryGenerator geoGen;
+		MeshData mesh = geoGen.CreateSphere(1.0f, 16, 12);
+		MeshOptimizer::OptimizeMesh(mesh);
+		std::vector<std::uint8_t> data = MeshCodec::Encode(mesh);
+
+		std::mt19937 random(11);
+		int outOfRange = 0;
+		for(int trial = 0; trial < 500; ++trial)
+		{
+			std::vector<std::uint8_t> damaged = data;
+			damaged[random() % damaged.size()] ^= static_cast<std::uint8_t>(1 + random() % 255);
+
+			MeshData decoded;
+			if(MeshCodec::Decode(damaged.data(), damaged.size(), decoded))
+			{
+				for(uint32 index : decoded.Indices32)
+					outOfRange += index >= decoded.Vertices.size();
+			}
+		}
+		CHECK(outOfRange == 0);
+	}
+
+	// Counts of 0xFFFFFFFF (FF FF FF FF 0F) would need gigabytes; the few bytes
+	// after them cannot hold that many vertices or triangles.
+	void TestHostileHeader()
+	{
+		const std::vector<std::vector<std::uint8_t>> headers =
+		{
+			{ 0xFF, 0xFF, 0xFF, 0xFF, 0x0F },
+			{ 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x00, 0x01, 0x01, 0x01 },
+			{ 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x01, 0x01, 0x01 },
+			{ 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x01, 0x01, 0x01 },
+			{ 0x00, 0x04, 0x01, 0x01, 0x01, 0xF0, 0x00, 0x00, 0x00 },
+		};
+
+		for(const std::vector<std::uint8_t>& header : headers)
+		{
+			MeshData decoded;
+			bool accepted = true;
+			try
+			{
+				accepted = MeshCodec::Decode(header.data(), header.size(), decoded);
+			}
+			catch(const std::exception& e)
+			{
+				std::printf("Decode threw %s on a %zu-byte header\n", e.what(), header.size());
+			}
+			CHECK(!accepted);
+			CHECK(decoded.Vertices.capacity() + decoded.Indices32.capacity() < 1024);
+		}
+	}
+}
+
+int main()
+{
+	TestGenerators();
+	TestRandom();
+	TestDamaged();
+	TestHostileHeader();
+
+	return CheckResult("MeshCodecTests");
+}
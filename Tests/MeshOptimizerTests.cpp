@@ -0,0 +1,229 @@
+//***************************************************************************************
+// MeshOptimizerTests.cpp
+//
+// MeshOptimizer on the generated meshes, welded the way the app welds them: the
+// optimized mesh draws the same triangles with the same winding, its ACMR is no
+// worse and clearly better on the large regular meshes, OptimizeOverdraw keeps the
+// ACMR within its threshold, and the overdraw measured by a small rasterizer does
+// not grow.
+//***************************************************************************************
+
+#include "Check.h"
+#include "GeometryGenerator.h"
+#include "MeshOptimizer.h"
+#include "MeshWelder.h"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef GeometryGenerator::MeshData MeshData;
+	typedef std::array<float, 9> Triangle;
+
+	// Resolution of each orthographic view the overdraw is measured in.
+	const int ViewSize = 256;
+
+	// Overdraw differences smaller than this are rasterization noise.
+	const double OverdrawTolerance = 1.0e-3;
+
+	XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+	}
+
+	float Component(const XMFLOAT3& v, int axis)
+	{
+		return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+	}
+
+	// Pixels shaded per pixel covered, averaged over views along +-x, +-y and +-z.
+	// Triangles are drawn in index order with a less-than depth test and back faces
+	// culled, so the result depends on the triangle order as on the GPU.  The
+	// outward side of a triangle is the one its vertex normals point to.
+	double MeasureOverdraw(const MeshData& mesh)
+	{
+		XMFLOAT3 lo(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for(const GeometryGenerator::Vertex& v : mesh.Vertices)
+		{
+			lo = XMFLOAT3(std::min(lo.x, v.Position.x), std::min(lo.y, v.Position.y), std::min(lo.z, v.Position.z));
+			hi = XMFLOAT3(std::max(hi.x, v.Position.x), std::max(hi.y, v.Position.y), std::max(hi.z, v.Position.z));
+		}
+
+		long long shaded = 0;
+		long long covered = 0;
+		std::vector<float> depth(ViewSize*ViewSize);
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			// Screen u and v are the other two axes, scaled to the view.
+			int ua = (axis + 1) % 3;
+			int va = (axis + 2) % 3;
+			float uScale = (ViewSize - 1) / std::max(Component(hi, ua) - Component(lo, ua), 1e-6f);
+			float vScale = (ViewSize - 1) / std::max(Component(hi, va) - Component(lo, va), 1e-6f);
+
+			for(float facing = -1.0f; facing <= 1.0f; facing += 2.0f)
+			{
+				std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::infinity());
+
+				for(size_t t = 0; t + 2 < mesh.Indices32.size(); t += 3)
+				{
+					const GeometryGenerator::Vertex* v[3];
+					for(int k = 0; k < 3; ++k)
+						v[k] = &mesh.Vertices[mesh.Indices32[t + k]];
+
+					// Looking along facing*axis: drop triangles whose outward side
+					// faces away from the viewer.
+					XMFLOAT3 n = Cross(Sub(v[1]->Position, v[0]->Position), Sub(v[2]->Position, v[0]->Position));
+					float outward = 0.0f;
+					for(int k = 0; k < 3; ++k)
+						outward += n.x*v[k]->Normal.x + n.y*v[k]->Normal.y + n.z*v[k]->Normal.z;
+					float normal = outward < 0.0f ? -Component(n, axis) : Component(n, axis);
+					if(normal*facing >= 0.0f)
+						continue;
+
+					float u[3], w[3], z[3];
+					for(int k = 0; k < 3; ++k)
+					{
+						u[k] = (Component(v[k]->Position, ua) - Component(lo, ua))*uScale;
+						w[k] = (Component(v[k]->Position, va) - Component(lo, va))*vScale;
+						z[k] = facing*Component(v[k]->Position, axis);
+					}
+
+					float area = (u[1] - u[0])*(w[2] - w[0]) - (u[2] - u[0])*(w[1] - w[0]);
+					if(area == 0.0f)
+						continue;
+
+					int x0 = std::max(0, static_cast<int>(std::ceil(std::min({ u[0], u[1], u[2] }))));
+					int x1 = std::min(ViewSize - 1, static_cast<int>(std::floor(std::max({ u[0], u[1], u[2] }))));
+					int y0 = std::max(0, static_cast<int>(std::ceil(std::min({ w[0], w[1], w[2] }))));
+					int y1 = std::min(ViewSize - 1, static_cast<int>(std::floor(std::max({ w[0], w[1], w[2] }))));
+
+					for(int y = y0; y <= y1; ++y)
+					{
+						for(int x = x0; x <= x1; ++x)
+						{
+							// Barycentrics of the pixel; inside if all agree with the area.
+							float b0 = ((u[1] - x)*(w[2] - y) - (u[2] - x)*(w[1] - y)) / area;
+							float b1 = ((u[2] - x)*(w[0] - y) - (u[0] - x)*(w[2] - y)) / area;
+							float b2 = 1.0f - b0 - b1;
+							if(b0 < 0.0f || b1 < 0.0f || b2 < 0.0f)
+								continue;
+
+							float d = b0*z[0] + b1*z[1] + b2*z[2];
+							float& stored = depth[y*ViewSize + x];
+							if(d < stored)
+							{
+								covered += stored == std::numeric_limits<float>::infinity();
+								stored = d;
+								++shaded;
+							}
+						}
+					}
+				}
+			}
+		}
+
+		return covered > 0 ? double(shaded) / covered : 1.0;
+	}
+
+	// The triangles as positions, each rotated to start at its smallest vertex so
+	// the winding is kept, in sorted order.
+	std::vector<Triangle> Triangles(const MeshData& mesh)
+	{
+		std::vector<Triangle> triangles;
+		for(size_t t = 0; t + 2 < mesh.Indices32.size(); t += 3)
+		{
+			std::array<std::array<float, 3>, 3> corners;
+			for(int k = 0; k < 3; ++k)
+			{
+				const XMFLOAT3& p = mesh.Vertices[mesh.Indices32[t + k]].Position;
+				corners[k] = { p.x, p.y, p.z };
+			}
+
+			int first = static_cast<int>(std::min_element(corners.begin(), corners.end()) - corners.begin());
+			Triangle triangle;
+			for(int k = 0; k < 3; ++k)
+				std::copy(corners[(first + k) % 3].begin(), corners[(first + k) % 3].end(), triangle.begin() + 3*k);
+			triangles.push_back(triangle);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	// maxAcmr is the ACMR the optimized mesh must reach or beat; the small meshes
+	// pass 3, the worst there is, and only have to be no worse than before.
+	void TestMesh(const char* name, MeshData mesh, float maxAcmr)
+	{
+		MeshWelder::WeldOptions weldOptions;
+		weldOptions.CompareTangents = false;
+		MeshWelder::Weld(mesh, weldOptions);
+
+		size_t vertexCount = mesh.Vertices.size();
+		MeshOptimizer::CacheStats before = MeshOptimizer::AnalyzeVertexCache(mesh.Indices32, vertexCount);
+		double overdrawBefore = MeasureOverdraw(mesh);
+
+		// The stages one at a time, as OptimizeMesh runs them.
+		MeshData cacheOnly = mesh;
+		MeshOptimizer::OptimizeVertexCache(cacheOnly.Indices32, vertexCount);
+		MeshOptimizer::CacheStats afterCache = MeshOptimizer::AnalyzeVertexCache(cacheOnly.Indices32, vertexCount);
+		double overdrawAfterCache = MeasureOverdraw(cacheOnly);
+
+		MeshData optimized = mesh;
+		MeshOptimizer::OptimizeMesh(optimized);
+		MeshOptimizer::CacheStats after = MeshOptimizer::AnalyzeVertexCache(optimized.Indices32, optimized.Vertices.size());
+		double overdrawAfter = MeasureOverdraw(optimized);
+
+		CHECK(optimized.Indices32.size() == mesh.Indices32.size());
+		CHECK(optimized.Vertices.size() <= vertexCount);
+		CHECK(Triangles(optimized) == Triangles(mesh));
+
+		// Vertex fetch order does not change what the cache sees.
+		CHECK(after.Acmr <= before.Acmr + 1e-6f);
+		CHECK(after.Acmr <= std::min(before.Acmr, afterCache.Acmr)*1.05f + 1e-6f);
+		CHECK(after.Acmr <= maxAcmr);
+
+		// Sorting the clusters never adds overdraw to the cache order.  Convex
+		// meshes have none to remove; what the views show of them is only pixels
+		// on the silhouette shaded twice.
+		CHECK(overdrawAfter <= overdrawAfterCache + OverdrawTolerance);
+
+		std::printf("%-12s ACMR %.3f -> %.3f (cache only %.3f), overdraw %.4f -> %.4f (cache only %.4f)\n",
+			name, before.Acmr, after.Acmr, afterCache.Acmr, overdrawBefore, overdrawAfter, overdrawAfterCache);
+	}
+}
+
+int main()
+{
+	GeometryGenerator geoGen;
+
+	// The scene meshes of the app.
+	TestMesh("grid", geoGen.CreateGrid(30.0f, 30.0f, 15, 15), 3.0f);
+	TestMesh("box", geoGen.CreateBox(8.0f, 8.0f, 8.0f, 2), 3.0f);
+	TestMesh("cylinder", geoGen.CreateCylinder(1.5f, 1.0f, 8.0f, 10, 5), 3.0f);
+	TestMesh("pyramid", geoGen.CreateSquarePyramid(5.0f, 7.0f, 7.0f, 2), 3.0f);
+	TestMesh("cone", geoGen.CreateCone(1.5f, 1.5f, 6, 3), 3.0f);
+	TestMesh("torus", geoGen.CreateTorus(1.5f, 0.3f, 8, 6), 3.0f);
+	TestMesh("diamond", geoGen.CreateDiamond(2.0f, 2.0f, 1.0f, 1), 3.0f);
+	TestMesh("sphere", geoGen.CreateSphere(1.0f, 6, 6), 3.0f);
+
+	// Larger regular meshes start near 1 and should end near 0.7 with a 16 entry
+	// cache.
+	TestMesh("grid 50", geoGen.CreateGrid(160.0f, 160.0f, 50, 50), 0.75f);
+	TestMesh("sphere 40", geoGen.CreateSphere(1.0f, 40, 40), 0.75f);
+	TestMesh("cylinder 40", geoGen.CreateCylinder(1.5f, 1.0f, 8.0f, 40, 20), 0.75f);
+	TestMesh("torus 40", geoGen.CreateTorus(1.5f, 0.5f, 40, 24), 0.75f);
+
+	return CheckResult("MeshOptimizerTests");
+}
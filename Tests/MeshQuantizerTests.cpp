@@ -0,0 +1,212 @@
+//***************************************************************************************
+// MeshQuantizerTests.cpp
+//
+// MeshQuantizer on every generator's mesh in each PositionFormat: Measure reports
+// position errors within what the format can hold over the mesh bounds, normal and
+// tangent angles within the snorm16 octahedral error, texture coordinate errors within
+// a unorm16 step of their range, and the saving the stride gives.  Decode agrees with
+// DecodeVertex, and the octahedral encoding round trips the axes, the y < 0 fold
+// diagonals and random directions.
+//***************************************************************************************
+
+#include "Check.h"
+#include "GeometryGenerator.h"
+#include "MeshQuantizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef GeometryGenerator::MeshData MeshData;
+	typedef MeshQuantizer::PositionFormat PositionFormat;
+
+	// Largest angle between a unit vector and its snorm16 octahedral encoding.  The
+	// grid is 1/32767 apart, which gives about 6.4e-5 rad at worst.
+	const float MaxOctahedralDegrees = XMConvertToDegrees(1.0e-4f);
+
+	struct Named
+	{
+		const char* Name;
+		MeshData Mesh;
+	};
+
+	std::vector<Named> AllMeshes()
+	{
+		GeometryGenerator geoGen;
+		std::vector<Named> meshes;
+		meshes.push_back({ "box", geoGen.CreateBox(8.0f, 8.0f, 8.0f, 2) });
+		meshes.push_back({ "sphere", geoGen.CreateSphere(1.0f, 20, 20) });
+		meshes.push_back({ "geosphere", geoGen.CreateGeosphere(1.0f, 3) });
+		meshes.push_back({ "cylinder", geoGen.CreateCylinder(1.5f, 1.0f, 8.0f, 20, 10) });
+		meshes.push_back({ "grid", geoGen.CreateGrid(160.0f, 160.0f, 50, 50) });
+		meshes.push_back({ "quad", geoGen.CreateQuad(0.0f, 0.0f, 1.0f, 1.0f, 0.0f) });
+		meshes.push_back({ "square pyramid", geoGen.CreateSquarePyramid(5.0f, 7.0f, 7.0f, 2) });
+		meshes.push_back({ "triangular pyramid", geoGen.CreateTriangularPyramid(5.0f, 7.0f, 7.0f, 2) });
+		meshes.push_back({ "triangular prism", geoGen.CreateTriangularPrism(5.0f, 7.0f, 7.0f, 2) });
+		meshes.push_back({ "cone", geoGen.CreateCone(1.5f, 6.0f, 20, 6) });
+		meshes.push_back({ "torus", geoGen.CreateTorus(1.5f, 0.3f, 24, 16) });
+		meshes.push_back({ "diamond", geoGen.CreateDiamond(2.0f, 2.0f, 1.0f, 1) });
+		return meshes;
+	}
+
+	float AngleDegrees(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		XMVECTOR u = XMLoadFloat3(&a);
+		XMVECTOR v = XMLoadFloat3(&b);
+		float sinAngle = XMVectorGetX(XMVector3Length(XMVector3Cross(u, v)));
+		return XMConvertToDegrees(std::atan2(sinAngle, XMVectorGetX(XMVector3Dot(u, v))));
+	}
+
+	// Largest error Measure may report for the mesh's positions in the given
+	// format: half a step of the format on each axis, at the largest offset from
+	// the centre of the bounds.
+	float PositionBound(const MeshData& mesh, PositionFormat format)
+	{
+		XMFLOAT3 lo(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for(const GeometryGenerator::Vertex& v : mesh.Vertices)
+		{
+			lo = XMFLOAT3(std::min(lo.x, v.Position.x), std::min(lo.y, v.Position.y), std::min(lo.z, v.Position.z));
+			hi = XMFLOAT3(std::max(hi.x, v.Position.x), std::max(hi.y, v.Position.y), std::max(hi.z, v.Position.z));
+		}
+		float extent = 0.5f*std::max({ hi.x - lo.x, hi.y - lo.y, hi.z - lo.z });
+
+		// A little over half a step, for the float arithmetic around it.
+		const float sqrt3 = 1.7321f;
+		switch(format)
+		{
+		case PositionFormat::Float3:
+			return 0.0f;
+		case PositionFormat::Half4:
+			return sqrt3*extent*(0.5f/1024.0f)*1.01f;
+		default:
+			return sqrt3*extent*(0.5f/32767.0f)*1.01f + 1e-6f*extent;
+		}
+	}
+
+	// Same for texture coordinates, over their range.
+	float TexCBound(const MeshData& mesh)
+	{
+		float uMin = FLT_MAX, uMax = -FLT_MAX, vMin = FLT_MAX, vMax = -FLT_MAX;
+		for(const GeometryGenerator::Vertex& v : mesh.Vertices)
+		{
+			uMin = std::min(uMin, v.TexC.x);
+			uMax = std::max(uMax, v.TexC.x);
+			vMin = std::min(vMin, v.TexC.y);
+			vMax = std::max(vMax, v.TexC.y);
+		}
+		float range = std::max(uMax - uMin, vMax - vMin);
+		return range*(0.5f/65535.0f)*1.01f + 1e-7f;
+	}
+
+	void TestMeshes()
+	{
+		const PositionFormat formats[] = { PositionFormat::Float3, PositionFormat::Half4, PositionFormat::SNorm16x4 };
+		const int positionBytes[] = { 12, 8, 8 };
+
+		for(const Named& named : AllMeshes())
+		{
+			const MeshData& mesh = named.Mesh;
+			for(int f = 0; f < 3; ++f)
+			{
+				MeshQuantizer::Layout layout;
+				layout.Position = formats[f];
+				layout.Tangent = true;
+
+				MeshQuantizer::EncodedMesh encoded = MeshQuantizer::Encode(mesh, layout);
+				CHECK(encoded.VertexCount == mesh.Vertices.size());
+				CHECK(encoded.Stride == positionBytes[f] + 12);
+				CHECK(encoded.Vertices.size() == mesh.Vertices.size()*encoded.Stride);
+
+				MeshQuantizer::EncodeReport report = MeshQuantizer::Measure(mesh, encoded);
+				CHECK(report.SourceBytes == mesh.Vertices.size()*sizeof(GeometryGenerator::Vertex));
+				CHECK(report.EncodedBytes == encoded.Vertices.size());
+				CHECK_NEAR(report.SavedFraction(), 1.0f - float(encoded.Stride)/sizeof(GeometryGenerator::Vertex), 1e-6f);
+
+				CHECK(report.MaxPositionError <= PositionBound(mesh, formats[f]));
+				CHECK(report.MaxNormalErrorDegrees <= MaxOctahedralDegrees);
+				CHECK(report.MaxTangentErrorDegrees <= MaxOctahedralDegrees);
+				CHECK(report.MaxTexCError <= TexCBound(mesh));
+
+				std::vector<GeometryGenerator::Vertex> decoded = MeshQuantizer::Decode(encoded);
+				int different = 0;
+				for(std::uint32_t i = 0; i < encoded.VertexCount; ++i)
+				{
+					GeometryGenerator::Vertex v = MeshQuantizer::DecodeVertex(encoded, i);
+					different += std::memcmp(&v, &decoded[i], sizeof(v)) != 0;
+				}
+				CHECK(different == 0);
+			}
+
+			// The default layout leaves the tangent out, and decodes it as zero.
+			MeshQuantizer::EncodedMesh compact = MeshQuantizer::Encode(mesh);
+			CHECK(compact.Stride == 16);
+			CHECK(compact.TangentOffset == -1);
+			GeometryGenerator::Vertex v = MeshQuantizer::DecodeVertex(compact, 0);
+			CHECK(v.TangentU.x == 0.0f && v.TangentU.y == 0.0f && v.TangentU.z == 0.0f);
+			CHECK(MeshQuantizer::Measure(mesh, compact).SavedFraction() >= 0.63f);
+		}
+	}
+
+	float RoundTripDegrees(const XMFLOAT3& direction)
+	{
+		XMFLOAT3 unit;
+		XMStoreFloat3(&unit, XMVector3Normalize(XMLoadFloat3(&direction)));
+
+		std::int16_t packed[2];
+		MeshQuantizer::EncodeOctahedral(unit, packed);
+		return AngleDegrees(MeshQuantizer::DecodeOctahedral(packed), unit);
+	}
+
+	void TestOctahedral()
+	{
+		// The axes land on corners of the octahedron and come back exactly.
+		const XMFLOAT3 axes[] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+		for(const XMFLOAT3& axis : axes)
+		{
+			std::int16_t packed[2];
+			MeshQuantizer::EncodeOctahedral(axis, packed);
+			XMFLOAT3 decoded = MeshQuantizer::DecodeOctahedral(packed);
+			CHECK(decoded.x == axis.x && decoded.y == axis.y && decoded.z == axis.z);
+		}
+
+		// The lower half is folded over the diagonals |u| + |v| = 1, so directions
+		// with |x| = |z| below the equator, and on the equator itself, are where
+		// the fold can go wrong.
+		int wrong = 0;
+		for(float sx : { -1.0f, 1.0f })
+		{
+			for(float sz : { -1.0f, 1.0f })
+			{
+				for(float y : { 0.0f, -1e-4f, -0.01f, -0.3f, -1.0f, -5.0f, -100.0f })
+				{
+					wrong += RoundTripDegrees(XMFLOAT3(sx, y, sz)) > MaxOctahedralDegrees;
+					wrong += RoundTripDegrees(XMFLOAT3(sx, y, 0.25f*sz)) > MaxOctahedralDegrees;
+					wrong += RoundTripDegrees(XMFLOAT3(0.0f, y, sz)) > MaxOctahedralDegrees;
+				}
+			}
+		}
+
+		// And anywhere else.
+		std::mt19937 random(5);
+		std::normal_distribution<float> gauss;
+		for(int k = 0; k < 100000; ++k)
+			wrong += RoundTripDegrees(XMFLOAT3(gauss(random), gauss(random), gauss(random))) > MaxOctahedralDegrees;
+		CHECK(wrong == 0);
+	}
+}
+
+int main()
+{
+	TestMeshes();
+	TestOctahedral();
+
+	return CheckResult("MeshQuantizerTests");
+}
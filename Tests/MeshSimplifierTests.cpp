@@ -0,0 +1,284 @@
+//***************************************************************************************
+// MeshSimplifierTests.cpp
+//
+// MeshSimplifier on the meshes the app builds LODs for, at the app's sizes and finer:
+// Simplify reaches the target triangle count, leaves no zero-area or repeated
+// triangles, does not turn any triangle against the normals its vertices carry from
+// the source, and keeps the outline (open borders and attribute seams) on the source
+// outline with no new holes.  BuildLodChain's Error does not go down as the ratio
+// does.
+//***************************************************************************************
+
+#include "Check.h"
+#include "GeometryGenerator.h"
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef GeometryGenerator::MeshData MeshData;
+	typedef std::uint32_t uint32;
+
+	struct Named
+	{
+		const char* Name;
+		MeshData Mesh;
+
+		// Smallest ratio of Ratios that Simplify must reach.  The app's meshes
+		// are coarse enough that their seams stop it before a tenth.
+		float MinRatio;
+	};
+
+	// The LOD meshes of BuildBoxGeometry, then finer ones, and a grid for open
+	// borders.
+	std::vector<Named> LodMeshes()
+	{
+		GeometryGenerator geoGen;
+		std::vector<Named> meshes;
+		meshes.push_back({ "cylinder", geoGen.CreateCylinder(1.5f, 1.0f, 8.0f, 10, 5), 0.25f });
+		meshes.push_back({ "cone", geoGen.CreateCone(1.5f, 1.5f, 6, 3), 0.25f });
+		meshes.push_back({ "sphere", geoGen.CreateSphere(1.0f, 6, 6), 0.25f });
+		meshes.push_back({ "torus", geoGen.CreateTorus(1.5f, 0.3f, 8, 6), 0.25f });
+		meshes.push_back({ "fine cylinder", geoGen.CreateCylinder(1.5f, 1.0f, 8.0f, 32, 12), 0.1f });
+		meshes.push_back({ "fine cone", geoGen.CreateCone(1.5f, 6.0f, 32, 8), 0.1f });
+		meshes.push_back({ "fine sphere", geoGen.CreateSphere(1.0f, 24, 24), 0.1f });
+		meshes.push_back({ "fine torus", geoGen.CreateTorus(1.5f, 0.3f, 32, 16), 0.1f });
+		meshes.push_back({ "grid", geoGen.CreateGrid(30.0f, 30.0f, 15, 15), 0.1f });
+		return meshes;
+	}
+
+	const float Ratios[] = { 0.9f, 0.75f, 0.5f, 0.35f, 0.25f, 0.1f };
+
+	uint32 TriangleCount(const MeshData& mesh)
+	{
+		return static_cast<uint32>(mesh.Indices32.size() / 3);
+	}
+
+	// Positions are only ever copied by the simplifier, so they compare exactly.
+	typedef std::tuple<float, float, float> Point;
+	typedef std::pair<Point, Point> Edge;
+
+	Point PointOf(const MeshData& mesh, uint32 i)
+	{
+		const XMFLOAT3& p = mesh.Vertices[i].Position;
+		return Point(p.x, p.y, p.z);
+	}
+
+	// Triangles with three different positions.  The cone's tip and top cap are
+	// made of triangles that are not, and the simplifier drops those first.
+	uint32 LiveTriangleCount(const MeshData& mesh)
+	{
+		uint32 live = 0;
+		for(size_t t = 0; t + 2 < mesh.Indices32.size(); t += 3)
+		{
+			Point a = PointOf(mesh, mesh.Indices32[t]);
+			Point b = PointOf(mesh, mesh.Indices32[t + 1]);
+			Point c = PointOf(mesh, mesh.Indices32[t + 2]);
+			live += a != b && b != c && a != c;
+		}
+		return live;
+	}
+
+	Edge EdgeOf(const Point& a, const Point& b)
+	{
+		return a < b ? Edge(a, b) : Edge(b, a);
+	}
+
+	// Edges, by position, with one triangle or with different vertices on either
+	// side.
+	std::set<Edge> Outline(const MeshData& mesh)
+	{
+		std::map<Edge, std::vector<std::pair<uint32, uint32>>> sides;
+		for(size_t t = 0; t + 2 < mesh.Indices32.size(); t += 3)
+		{
+			for(int k = 0; k < 3; ++k)
+			{
+				uint32 a = mesh.Indices32[t + k];
+				uint32 b = mesh.Indices32[t + (k + 1) % 3];
+				sides[EdgeOf(PointOf(mesh, a), PointOf(mesh, b))].push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+			}
+		}
+
+		std::set<Edge> outline;
+		for(const auto& edge : sides)
+		{
+			const auto& s = edge.second;
+			if(s.size() == 1 || std::any_of(s.begin(), s.end(), [&](const std::pair<uint32, uint32>& e) { return e != s[0]; }))
+				outline.insert(edge.first);
+		}
+		return outline;
+	}
+
+	std::set<Point> OutlinePoints(const MeshData& mesh)
+	{
+		std::set<Point> points;
+		for(const Edge& edge : Outline(mesh))
+		{
+			points.insert(edge.first);
+			points.insert(edge.second);
+		}
+		return points;
+	}
+
+	// Zero-area triangles, triangles over the same three positions as another,
+	// and triangles facing away from the normals of their own vertices.
+	void CheckTriangles(const Named& named, const MeshData& mesh, float ratio)
+	{
+		int degenerate = 0;
+		int flipped = 0;
+		std::set<std::array<Point, 3>> seen;
+		int repeated = 0;
+
+		for(size_t t = 0; t + 2 < mesh.Indices32.size(); t += 3)
+		{
+			const GeometryGenerator::Vertex* v[3];
+			for(int k = 0; k < 3; ++k)
+				v[k] = &mesh.Vertices[mesh.Indices32[t + k]];
+
+			XMVECTOR p0 = XMLoadFloat3(&v[0]->Position);
+			XMVECTOR face = XMVector3Cross(XMLoadFloat3(&v[1]->Position) - p0, XMLoadFloat3(&v[2]->Position) - p0);
+			if(XMVectorGetX(XMVector3LengthSq(face)) <= 0.0f)
+				++degenerate;
+
+			XMVECTOR normal = XMLoadFloat3(&v[0]->Normal) + XMLoadFloat3(&v[1]->Normal) + XMLoadFloat3(&v[2]->Normal);
+			if(XMVectorGetX(XMVector3Dot(face, normal)) <= 0.0f)
+				++flipped;
+
+			std::array<Point, 3> corners = { { PointOf(mesh, mesh.Indices32[t]), PointOf(mesh, mesh.Indices32[t + 1]), PointOf(mesh, mesh.Indices32[t + 2]) } };
+			std::sort(corners.begin(), corners.end());
+			repeated += !seen.insert(corners).second;
+		}
+
+		if(degenerate != 0 || flipped != 0 || repeated != 0)
+			std::printf("%s at %.2f: %d zero-area, %d flipped, %d repeated\n", named.Name, ratio, degenerate, flipped, repeated);
+
+		CHECK(degenerate == 0);
+		CHECK(flipped == 0);
+		CHECK(repeated == 0);
+	}
+
+	void TestSimplify()
+	{
+		for(const Named& named : LodMeshes())
+		{
+			const MeshData& source = named.Mesh;
+			std::set<Point> sourceOutline = OutlinePoints(source);
+			std::set<Point> sourcePoints;
+			for(uint32 i = 0; i < source.Vertices.size(); ++i)
+				sourcePoints.insert(PointOf(source, i));
+
+			for(float ratio : Ratios)
+			{
+				uint32 target = static_cast<uint32>(TriangleCount(source)*ratio);
+				float error = -1.0f;
+				MeshData mesh = MeshSimplifier::Simplify(source, target, &error);
+
+				// A collapse takes one or two triangles, so it lands on the target
+				// or one under.
+				uint32 count = TriangleCount(mesh);
+				uint32 reachable = std::min(target, LiveTriangleCount(source));
+				if(ratio >= named.MinRatio)
+				{
+					if(count > reachable || count + 1 < reachable)
+						std::printf("%s at %.2f: %u triangles for a target of %u\n", named.Name, ratio, count, target);
+					CHECK(count <= reachable);
+					CHECK(count + 1 >= reachable);
+				}
+				CHECK(count <= LiveTriangleCount(source));
+				CHECK(error >= 0.0f);
+
+				CheckTriangles(named, mesh, ratio);
+
+				// Every vertex is one of the source's, and the outline runs only
+				// through source outline points.  Closed meshes with seams keep them
+				// closed, since an open edge would show as an outline edge between
+				// points the seam does not join.
+				int moved = 0;
+				for(uint32 i = 0; i < mesh.Vertices.size(); ++i)
+					moved += sourcePoints.count(PointOf(mesh, i)) == 0;
+				CHECK(moved == 0);
+
+				int offOutline = 0;
+				for(const Point& p : OutlinePoints(mesh))
+					offOutline += sourceOutline.count(p) == 0;
+				if(offOutline != 0)
+					std::printf("%s at %.2f: %d outline points off the source outline\n", named.Name, ratio, offOutline);
+				CHECK(offOutline == 0);
+
+				int unused = 0;
+				std::vector<bool> used(mesh.Vertices.size(), false);
+				for(uint32 i : mesh.Indices32)
+					used[i] = true;
+				unused = static_cast<int>(std::count(used.begin(), used.end(), false));
+				CHECK(unused == 0);
+			}
+		}
+	}
+
+	// The grid's border is four straight lines, so the outline can be checked
+	// exactly: every outline edge lies along one of them.
+	void TestGridBorder()
+	{
+		GeometryGenerator geoGen;
+		MeshData grid = geoGen.CreateGrid(30.0f, 30.0f, 15, 15);
+		auto OnSide = [](float c) { return std::abs(std::abs(c) - 15.0f) < 1e-4f; };
+
+		for(float ratio : Ratios)
+		{
+			MeshData mesh = MeshSimplifier::Simplify(grid, static_cast<uint32>(TriangleCount(grid)*ratio));
+
+			int off = 0;
+			for(const Edge& edge : Outline(mesh))
+			{
+				float x0 = std::get<0>(edge.first), z0 = std::get<2>(edge.first);
+				float x1 = std::get<0>(edge.second), z1 = std::get<2>(edge.second);
+				bool alongX = OnSide(z0) && z0 == z1;
+				bool alongZ = OnSide(x0) && x0 == x1;
+				off += !alongX && !alongZ;
+			}
+			CHECK(off == 0);
+		}
+	}
+
+	void TestLodChain()
+	{
+		std::vector<float> ratios(std::begin(Ratios), std::end(Ratios));
+		for(const Named& named : LodMeshes())
+		{
+			std::vector<MeshSimplifier::Lod> lods = MeshSimplifier::BuildLodChain(named.Mesh, ratios);
+			CHECK(lods.size() == ratios.size());
+
+			int decreasing = 0;
+			for(size_t level = 1; level < lods.size(); ++level)
+			{
+				if(lods[level].Error < lods[level - 1].Error)
+				{
+					std::printf("%s: error %g at %.2f after %g at %.2f\n", named.Name,
+						lods[level].Error, ratios[level], lods[level - 1].Error, ratios[level - 1]);
+					++decreasing;
+				}
+				CHECK(TriangleCount(lods[level].Mesh) <= TriangleCount(lods[level - 1].Mesh));
+			}
+			CHECK(decreasing == 0);
+		}
+	}
+}
+
+int main()
+{
+	TestSimplify();
+	TestGridBorder();
+	TestLodChain();
+
+	return CheckResult("MeshSimplifierTests");
+}
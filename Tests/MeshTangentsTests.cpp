@@ -0,0 +1,169 @@
+//***************************************************************************************
+// MeshTangentsTests.cpp
+//
+// MeshTangents::Validate on every generator's output, the torus included, and on the
+// same meshes after MeshTangents::Generate with and without recomputed normals.
+// Generate gives the same result on any thread count and fills in zero normals, and
+// Validate notices broken normals and tangents.
+//***************************************************************************************
+
+#include "Check.h"
+#include "GeometryGenerator.h"
+#include "MeshTangents.h"
+#include "TaskScheduler.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef GeometryGenerator::MeshData MeshData;
+
+	struct Named
+	{
+		const char* Name;
+		MeshData Mesh;
+	};
+
+	std::vector<Named> AllMeshes()
+	{
+		GeometryGenerator geoGen;
+		std::vector<Named> meshes;
+		meshes.push_back({ "box", geoGen.CreateBox(8.0f, 8.0f, 8.0f, 2) });
+		meshes.push_back({ "sphere", geoGen.CreateSphere(1.0f, 20, 20) });
+		meshes.push_back({ "geosphere", geoGen.CreateGeosphere(1.0f, 3) });
+		meshes.push_back({ "cylinder", geoGen.CreateCylinder(1.5f, 1.0f, 8.0f, 20, 10) });
+		meshes.push_back({ "grid", geoGen.CreateGrid(30.0f, 30.0f, 15, 15) });
+		meshes.push_back({ "quad", geoGen.CreateQuad(0.0f, 0.0f, 1.0f, 1.0f, 0.0f) });
+		meshes.push_back({ "square pyramid", geoGen.CreateSquarePyramid(5.0f, 7.0f, 7.0f, 2) });
+		meshes.push_back({ "triangular pyramid", geoGen.CreateTriangularPyramid(5.0f, 7.0f, 7.0f, 2) });
+		meshes.push_back({ "triangular prism", geoGen.CreateTriangularPrism(5.0f, 7.0f, 7.0f, 2) });
+		meshes.push_back({ "cone", geoGen.CreateCone(1.5f, 6.0f, 20, 6) });
+		meshes.push_back({ "torus", geoGen.CreateTorus(1.5f, 0.3f, 8, 6) });
+		meshes.push_back({ "fine torus", geoGen.CreateTorus(1.5f, 0.5f, 48, 32) });
+		meshes.push_back({ "diamond", geoGen.CreateDiamond(2.0f, 2.0f, 1.0f, 1) });
+		return meshes;
+	}
+
+	bool CheckPassed(const char* name, const char* stage, const MeshData& mesh)
+	{
+		MeshTangents::CheckReport check = MeshTangents::Validate(mesh);
+		if(!check.Passed())
+		{
+			std::printf("%s (%s): %d bad normals, %d bad tangents, %d flipped tangents\n", name, stage,
+				static_cast<int>(check.BadNormals), static_cast<int>(check.BadTangents), static_cast<int>(check.FlippedTangents));
+		}
+		return check.Passed();
+	}
+
+	void TestGenerators()
+	{
+		MeshTangents::TangentOptions keepNormals;
+		MeshTangents::TangentOptions computeNormals;
+		computeNormals.ComputeNormals = true;
+
+		for(const Named& named : AllMeshes())
+		{
+			CHECK(CheckPassed(named.Name, "generated", named.Mesh));
+
+			MeshData regenerated = named.Mesh;
+			MeshTangents::Generate(regenerated, keepNormals);
+			CHECK(CheckPassed(named.Name, "tangents", regenerated));
+
+			// Recomputed normals are only smooth where the generator shares vertices,
+			// so compare against the mesh's own triangles again.
+			MeshData recomputed = named.Mesh;
+			MeshTangents::Generate(recomputed, computeNormals);
+			CHECK(CheckPassed(named.Name, "normals and tangents", recomputed));
+		}
+	}
+
+	// Zero normals are filled in even when the normals are kept.
+	void TestZeroNormals()
+	{
+		GeometryGenerator geoGen;
+		MeshData mesh = geoGen.CreateSphere(1.0f, 16, 12);
+		for(GeometryGenerator::Vertex& v : mesh.Vertices)
+			v.Normal = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+		MeshTangents::TangentReport report = MeshTangents::Generate(mesh, MeshTangents::TangentOptions());
+		CHECK(report.ComputedNormals == mesh.Vertices.size());
+		CHECK(CheckPassed("sphere", "zero normals", mesh));
+	}
+
+	// Large enough to be split over the threads.
+	void TestThreadCounts()
+	{
+		GeometryGenerator geoGen;
+		MeshData reference = geoGen.CreateTorus(1.5f, 0.5f, 512, 256);
+
+		MeshTangents::TangentOptions options;
+		options.ComputeNormals = true;
+
+		TaskScheduler serial(0);
+		options.Scheduler = &serial;
+		MeshData expected = reference;
+		MeshTangents::Generate(expected, options);
+
+		for(int workers : { 1, 3 })
+		{
+			TaskScheduler scheduler(workers);
+			options.Scheduler = &scheduler;
+			MeshData mesh = reference;
+			MeshTangents::Generate(mesh, options);
+			CHECK(std::memcmp(mesh.Vertices.data(), expected.Vertices.data(), mesh.Vertices.size()*sizeof(GeometryGenerator::Vertex)) == 0);
+		}
+	}
+
+	// Each kind of damage shows up in its own count.
+	void TestDetection()
+	{
+		GeometryGenerator geoGen;
+		const MeshData mesh = geoGen.CreateCylinder(1.5f, 1.0f, 8.0f, 20, 10);
+		const size_t Damaged = 7;
+
+		MeshData flippedNormals = mesh;
+		for(size_t i = 0; i < Damaged; ++i)
+		{
+			XMFLOAT3& n = flippedNormals.Vertices[i*13].Normal;
+			n = XMFLOAT3(-n.x, -n.y, -n.z);
+		}
+		CHECK(MeshTangents::Validate(flippedNormals).BadNormals == Damaged);
+
+		MeshData longNormals = mesh;
+		for(size_t i = 0; i < Damaged; ++i)
+			XMStoreFloat3(&longNormals.Vertices[i*13].Normal, 1.5f*XMLoadFloat3(&longNormals.Vertices[i*13].Normal));
+		CHECK(MeshTangents::Validate(longNormals).BadNormals == Damaged);
+
+		// Side vertices, whose tangents are defined: rotated into the normal, or
+		// turned around.
+		MeshData tiltedTangents = mesh;
+		MeshData flippedTangents = mesh;
+		for(size_t i = 0; i < Damaged; ++i)
+		{
+			size_t k = 30 + i*3;
+			XMVECTOR n = XMLoadFloat3(&mesh.Vertices[k].Normal);
+			XMVECTOR t = XMLoadFloat3(&mesh.Vertices[k].TangentU);
+			XMStoreFloat3(&tiltedTangents.Vertices[k].TangentU, XMVector3Normalize(t + 0.5f*n));
+			XMStoreFloat3(&flippedTangents.Vertices[k].TangentU, -t);
+		}
+		MeshTangents::CheckReport tilted = MeshTangents::Validate(tiltedTangents);
+		CHECK(tilted.BadTangents == Damaged);
+		CHECK(tilted.BadNormals == 0);
+		MeshTangents::CheckReport flipped = MeshTangents::Validate(flippedTangents);
+		CHECK(flipped.FlippedTangents == Damaged);
+		CHECK(flipped.BadTangents == 0);
+	}
+}
+
+int main()
+{
+	TestGenerators();
+	TestZeroNormals();
+	TestThreadCounts();
+	TestDetection();
+
+	return CheckResult("MeshTangentsTests");
+}
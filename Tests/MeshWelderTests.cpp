@@ -0,0 +1,306 @@
+//***************************************************************************************
+// MeshWelderTests.cpp
+//
+// MeshWelder::Weld on boxes and pyramids: the generator's own vertices weld to the
+// counts their faces give, with attributes or by position alone, and the same meshes
+// with every corner made its own vertex weld back to those counts, also when the
+// copies are jittered inside the epsilons and not when they are pushed outside.
+// Every index still points at a vertex that matches what it pointed at before, and
+// the vertices that are kept stay in their original order.  Merge concatenates
+// meshes at the right StartIndexLocation, and with shareDuplicates stores vertices
+// shared between meshes once.
+//***************************************************************************************
+
+#include "Check.h"
+#include "GeometryGenerator.h"
+#include "MeshWelder.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	typedef GeometryGenerator::MeshData MeshData;
+	typedef GeometryGenerator::Vertex Vertex;
+	typedef std::uint32_t uint32;
+
+	struct Expected
+	{
+		const char* Name;
+		MeshData Mesh;
+
+		// Vertices after welding with the default options, and by position only.
+		size_t Welded;
+		size_t ByPosition;
+	};
+
+	// k = 2^n edges along each side of a face after n subdivisions.  The box has
+	// a (k+1)^2 grid per face, or 6k^2+2 points on the surface; the pyramids share
+	// their vertices already, 3*4^n+2 and 2*4^n+2 of them.
+	std::vector<Expected> Boxes()
+	{
+		GeometryGenerator geoGen;
+		std::vector<Expected> meshes;
+		for(uint32 n = 0; n < 4; ++n)
+		{
+			size_t k = size_t(1) << n;
+			size_t quarters = size_t(1) << (2*n);
+			meshes.push_back({ "box", geoGen.CreateBox(8.0f, 8.0f, 8.0f, n), 6*(k + 1)*(k + 1), 6*k*k + 2 });
+			meshes.push_back({ "square pyramid", geoGen.CreateSquarePyramid(5.0f, 7.0f, 7.0f, n), 3*quarters + 2, 3*quarters + 2 });
+			meshes.push_back({ "triangular pyramid", geoGen.CreateTriangularPyramid(5.0f, 7.0f, 7.0f, n), 2*quarters + 2, 2*quarters + 2 });
+		}
+		return meshes;
+	}
+
+	MeshWelder::WeldOptions ByPosition()
+	{
+		MeshWelder::WeldOptions options;
+		options.NormalEpsilon = 4.0f;
+		options.TexCEpsilon = 4.0f;
+		options.CompareTangents = false;
+		return options;
+	}
+
+	// Every corner its own vertex, so vertex i is corner i.
+	MeshData Explode(const MeshData& mesh)
+	{
+		MeshData exploded;
+		for(uint32 i = 0; i < mesh.Indices32.size(); ++i)
+		{
+			exploded.Vertices.push_back(mesh.Vertices[mesh.Indices32[i]]);
+			exploded.Indices32.push_back(i);
+		}
+		return exploded;
+	}
+
+	bool Near(const float* a, const float* b, int count, float epsilon)
+	{
+		for(int i = 0; i < count; ++i)
+		{
+			if(!(std::fabs(a[i] - b[i]) <= epsilon))
+				return false;
+		}
+		return true;
+	}
+
+	bool Matches(const Vertex& a, const Vertex& b, const MeshWelder::WeldOptions& options)
+	{
+		return Near(&a.Position.x, &b.Position.x, 3, options.PositionEpsilon) &&
+			Near(&a.Normal.x, &b.Normal.x, 3, options.NormalEpsilon) &&
+			Near(&a.TexC.x, &b.TexC.x, 2, options.TexCEpsilon) &&
+			(!options.CompareTangents || Near(&a.TangentU.x, &b.TangentU.x, 3, options.NormalEpsilon));
+	}
+
+	bool Same(const Vertex& a, const Vertex& b)
+	{
+		return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+	}
+
+	// Welds an exploded mesh and checks it against the mesh before: every index
+	// points at a vertex matching its corner, the vertex kept is the first corner
+	// of its group, and the kept ones come in corner order.
+	size_t WeldAndCheck(const MeshData& exploded, const MeshWelder::WeldOptions& options)
+	{
+		MeshData welded = exploded;
+		MeshWelder::WeldReport report = MeshWelder::Weld(welded, options);
+		CHECK(report.VerticesBefore == exploded.Vertices.size());
+		CHECK(report.VerticesAfter == welded.Vertices.size());
+		CHECK(welded.Indices32.size() == exploded.Indices32.size());
+
+		int mismatched = 0;
+		int notFirst = 0;
+		int outOfOrder = 0;
+		uint32 nextKept = 0;
+		for(uint32 i = 0; i < welded.Indices32.size(); ++i)
+		{
+			uint32 index = welded.Indices32[i];
+			if(index >= welded.Vertices.size())
+			{
+				++mismatched;
+				continue;
+			}
+			mismatched += !Matches(welded.Vertices[index], exploded.Vertices[i], options);
+
+			// A new index must be the next one, and hold this very corner.
+			if(index >= nextKept)
+			{
+				outOfOrder += index != nextKept;
+				notFirst += !Same(welded.Vertices[index], exploded.Vertices[i]);
+				nextKept = index + 1;
+			}
+		}
+		CHECK(mismatched == 0);
+		CHECK(notFirst == 0);
+		CHECK(outOfOrder == 0);
+		CHECK(nextKept == welded.Vertices.size());
+
+		return welded.Vertices.size();
+	}
+
+	void TestWeld()
+	{
+		for(const Expected& expected : Boxes())
+		{
+			MeshData mesh = expected.Mesh;
+			MeshWelder::Weld(mesh);
+			CHECK(mesh.Vertices.size() == expected.Welded);
+
+			mesh = expected.Mesh;
+			MeshWelder::Weld(mesh, ByPosition());
+			CHECK(mesh.Vertices.size() == expected.ByPosition);
+
+			MeshData exploded = Explode(expected.Mesh);
+			size_t welded = WeldAndCheck(exploded, MeshWelder::WeldOptions());
+			size_t byPosition = WeldAndCheck(exploded, ByPosition());
+			if(welded != expected.Welded || byPosition != expected.ByPosition)
+			{
+				std::printf("%s (%zu vertices): welded to %zu and %zu, expected %zu and %zu\n", expected.Name,
+					expected.Mesh.Vertices.size(), welded, byPosition, expected.Welded, expected.ByPosition);
+			}
+			CHECK(welded == expected.Welded);
+			CHECK(byPosition == expected.ByPosition);
+
+			// Copies moved by up to 0.4 epsilon are at most 0.8 epsilon apart, so
+			// they still weld; moved by 2 epsilon each, none of them do.
+			MeshWelder::WeldOptions options;
+			MeshData jittered = exploded;
+			MeshData apart = exploded;
+			for(uint32 i = 0; i < exploded.Vertices.size(); ++i)
+			{
+				float s = (int(i*7 % 5) - 2)/5.0f;
+				jittered.Vertices[i].Position.x += s*options.PositionEpsilon;
+				jittered.Vertices[i].Normal.y += s*options.NormalEpsilon;
+				jittered.Vertices[i].TexC.x -= s*options.TexCEpsilon;
+				apart.Vertices[i].Position.y += 2.0f*i*options.PositionEpsilon;
+			}
+
+			CHECK(WeldAndCheck(jittered, options) == expected.Welded);
+			CHECK(WeldAndCheck(apart, options) == apart.Vertices.size());
+		}
+	}
+
+	// Distinct vertices by value (so -0 and +0 are the same) in the meshes.
+	size_t DistinctVertices(const std::vector<const MeshData*>& meshes)
+	{
+		MeshWelder::WeldOptions exact;
+		exact.PositionEpsilon = 0.0f;
+		exact.NormalEpsilon = 0.0f;
+		exact.TexCEpsilon = 0.0f;
+
+		std::vector<Vertex> distinct;
+		for(const MeshData* mesh : meshes)
+		{
+			for(const Vertex& v : mesh->Vertices)
+			{
+				bool found = false;
+				for(const Vertex& d : distinct)
+				{
+					if(Matches(v, d, exact))
+					{
+						found = true;
+						break;
+					}
+				}
+				if(!found)
+					distinct.push_back(v);
+			}
+		}
+		return distinct.size();
+	}
+
+	void TestMerge()
+	{
+		GeometryGenerator geoGen;
+		MeshData box = geoGen.CreateBox(8.0f, 8.0f, 8.0f, 1);
+		MeshData pyramid = geoGen.CreateSquarePyramid(5.0f, 7.0f, 7.0f, 1);
+		MeshData grid = geoGen.CreateGrid(30.0f, 30.0f, 6, 6);
+
+		// The box's front face as a mesh of its own, whose vertices all appear in
+		// the box.
+		MeshData face;
+		face.Vertices.assign(box.Vertices.begin(), box.Vertices.begin() + 4);
+		face.Indices32 = { 0, 1, 2, 0, 2, 3 };
+
+		std::vector<const MeshData*> meshes = { &box, &pyramid, &face, &grid, &box };
+
+		for(bool share : { false, true })
+		{
+			std::vector<MeshWelder::MergedSubmesh> submeshes;
+			MeshWelder::WeldReport report;
+			MeshData merged = MeshWelder::Merge(meshes, share, submeshes, &report);
+
+			size_t vertexCount = 0;
+			size_t indexCount = 0;
+			for(const MeshData* mesh : meshes)
+			{
+				vertexCount += mesh->Vertices.size();
+				indexCount += mesh->Indices32.size();
+			}
+			CHECK(submeshes.size() == meshes.size());
+			CHECK(merged.Indices32.size() == indexCount);
+			CHECK(report.VerticesBefore == vertexCount);
+			CHECK(report.VerticesAfter == merged.Vertices.size());
+			CHECK(merged.Vertices.size() == (share ? DistinctVertices(meshes) : vertexCount));
+
+			// In order, back to back, each index at a vertex equal to its own.
+			uint32 start = 0;
+			int different = 0;
+			for(size_t m = 0; m < meshes.size(); ++m)
+			{
+				const MeshData& mesh = *meshes[m];
+				CHECK(submeshes[m].StartIndexLocation == start);
+				CHECK(submeshes[m].IndexCount == mesh.Indices32.size());
+
+				for(uint32 i = 0; i < mesh.Indices32.size(); ++i)
+				{
+					uint32 index = merged.Indices32[start + i];
+					different += index >= merged.Vertices.size() ||
+						!Matches(merged.Vertices[index], mesh.Vertices[mesh.Indices32[i]], MeshWelder::WeldOptions());
+				}
+				start += static_cast<uint32>(mesh.Indices32.size());
+			}
+			CHECK(different == 0);
+
+			// Shared, the face and the second box use the first box's vertices.
+			if(share)
+			{
+				int elsewhere = 0;
+				for(size_t m : { size_t(2), size_t(4) })
+				{
+					for(uint32 i = 0; i < submeshes[m].IndexCount; ++i)
+						elsewhere += merged.Indices32[submeshes[m].StartIndexLocation + i] >= box.Vertices.size();
+				}
+				CHECK(elsewhere == 0);
+				CHECK(std::equal(box.Indices32.begin(), box.Indices32.end(), merged.Indices32.begin()));
+			}
+		}
+	}
+
+	// Exact copies are equal values, so -0 and +0 are copies too.
+	void TestSignedZero()
+	{
+		MeshData a;
+		a.Vertices.push_back(Vertex(0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f));
+		a.Indices32 = { 0, 0, 0 };
+
+		MeshData b = a;
+		b.Vertices[0].Position.x = -0.0f;
+		b.Vertices[0].Normal.z = -0.0f;
+
+		std::vector<MeshWelder::MergedSubmesh> submeshes;
+		MeshData merged = MeshWelder::Merge({ &a, &b }, true, submeshes);
+		CHECK(merged.Vertices.size() == 1);
+	}
+}
+
+int main()
+{
+	TestWeld();
+	TestMerge();
+	TestSignedZero();
+
+	return CheckResult("MeshWelderTests");
+}
@@ -0,0 +1,310 @@
+//***************************************************************************************
+// MeshletTests.cpp
+//
+// MeshletBuilder::Build on generator meshes at several meshlet sizes: every triangle
+// lands in exactly one meshlet with its winding, no meshlet holds more vertices or
+// triangles than asked for, and the bounding spheres and boxes hold their vertices.
+// MeshletCuller::Cull, over views from around, inside and beside each mesh and with
+// a world transform, never drops a triangle that faces the eye and has a point in the
+// frustum, draws whole meshlets, and does cull something from outside.
+//***************************************************************************************
+
+#include "Check.h"
+#include "GeometryGenerator.h"
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef GeometryGenerator::MeshData MeshData;
+	typedef std::uint32_t uint32;
+	typedef std::array<uint32, 3> Triangle;
+
+	struct Named
+	{
+		const char* Name;
+		MeshData Mesh;
+	};
+
+	std::vector<Named> AllMeshes()
+	{
+		GeometryGenerator geoGen;
+		std::vector<Named> meshes;
+		meshes.push_back({ "box", geoGen.CreateBox(8.0f, 8.0f, 8.0f, 3) });
+		meshes.push_back({ "sphere", geoGen.CreateSphere(1.0f, 48, 48) });
+		meshes.push_back({ "geosphere", geoGen.CreateGeosphere(1.0f, 4) });
+		meshes.push_back({ "cylinder", geoGen.CreateCylinder(1.5f, 1.0f, 8.0f, 32, 12) });
+		meshes.push_back({ "grid", geoGen.CreateGrid(160.0f, 160.0f, 50, 50) });
+		meshes.push_back({ "cone", geoGen.CreateCone(1.5f, 6.0f, 32, 8) });
+		meshes.push_back({ "torus", geoGen.CreateTorus(1.5f, 0.3f, 48, 24) });
+		meshes.push_back({ "square pyramid", geoGen.CreateSquarePyramid(5.0f, 7.0f, 7.0f, 3) });
+		return meshes;
+	}
+
+	// Triangles of the mesh in index order, sorted so two lists can be compared.
+	std::vector<Triangle> Triangles(const std::vector<uint32>& indices)
+	{
+		std::vector<Triangle> triangles;
+		for(size_t i = 0; i + 2 < indices.size(); i += 3)
+			triangles.push_back({ { indices[i], indices[i + 1], indices[i + 2] } });
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	std::vector<uint32> MeshletIndices(const MeshletBuilder::MeshletMesh& meshlets, size_t m)
+	{
+		const MeshletBuilder::Meshlet& meshlet = meshlets.Meshlets[m];
+		std::vector<uint32> indices;
+		for(uint32 i = 0; i < meshlet.TriangleCount*3; ++i)
+			indices.push_back(meshlets.Vertices[meshlet.VertexOffset + meshlets.Triangles[meshlet.TriangleOffset + i]]);
+		return indices;
+	}
+
+	void TestBuild()
+	{
+		const uint32 limits[][2] = { { 64, 124 }, { 32, 32 }, { 3, 1 }, { 10, 200 }, { 256, 512 } };
+
+		for(const Named& named : AllMeshes())
+		{
+			const MeshData& mesh = named.Mesh;
+			std::vector<Triangle> source = Triangles(mesh.Indices32);
+
+			for(const auto& limit : limits)
+			{
+				MeshletBuilder::MeshletMesh meshlets = MeshletBuilder::Build(mesh, limit[0], limit[1]);
+				CHECK(meshlets.MeshletBounds.size() == meshlets.Meshlets.size());
+
+				int oversized = 0;
+				int badLocal = 0;
+				int outsideSphere = 0;
+				int outsideBox = 0;
+				uint32 vertexEnd = 0;
+				uint32 triangleEnd = 0;
+				std::vector<uint32> all;
+
+				for(size_t m = 0; m < meshlets.Meshlets.size(); ++m)
+				{
+					const MeshletBuilder::Meshlet& meshlet = meshlets.Meshlets[m];
+					const MeshletBuilder::Bounds& bounds = meshlets.MeshletBounds[m];
+
+					oversized += meshlet.VertexCount > limit[0] || meshlet.TriangleCount > limit[1] || meshlet.TriangleCount == 0;
+
+					// Meshlets take consecutive ranges of the shared lists.
+					CHECK(meshlet.VertexOffset == vertexEnd);
+					CHECK(meshlet.TriangleOffset == triangleEnd);
+					vertexEnd += meshlet.VertexCount;
+					triangleEnd += meshlet.TriangleCount*3;
+
+					for(uint32 i = 0; i < meshlet.TriangleCount*3; ++i)
+						badLocal += meshlets.Triangles[meshlet.TriangleOffset + i] >= meshlet.VertexCount;
+
+					XMVECTOR center = XMLoadFloat3(&bounds.Center);
+					for(uint32 i = 0; i < meshlet.VertexCount; ++i)
+					{
+						const XMFLOAT3& p = mesh.Vertices[meshlets.Vertices[meshlet.VertexOffset + i]].Position;
+						outsideSphere += XMVectorGetX(XMVector3Length(XMLoadFloat3(&p) - center)) > bounds.Radius*(1.0f + 1e-5f) + 1e-6f;
+						outsideBox += p.x < bounds.BoxMin.x || p.y < bounds.BoxMin.y || p.z < bounds.BoxMin.z ||
+							p.x > bounds.BoxMax.x || p.y > bounds.BoxMax.y || p.z > bounds.BoxMax.z;
+					}
+
+					std::vector<uint32> indices = MeshletIndices(meshlets, m);
+					all.insert(all.end(), indices.begin(), indices.end());
+				}
+
+				if(oversized != 0 || outsideSphere != 0 || outsideBox != 0)
+				{
+					std::printf("%s at %u/%u: %d oversized, %d outside the sphere, %d outside the box\n",
+						named.Name, limit[0], limit[1], oversized, outsideSphere, outsideBox);
+				}
+				CHECK(oversized == 0);
+				CHECK(badLocal == 0);
+				CHECK(outsideSphere == 0);
+				CHECK(outsideBox == 0);
+				CHECK(vertexEnd == meshlets.Vertices.size());
+				CHECK(triangleEnd == meshlets.Triangles.size());
+
+				// Exactly once each, with the source winding.
+				CHECK(Triangles(all) == source);
+			}
+		}
+	}
+
+	struct View
+	{
+		XMFLOAT3 Eye;
+		XMFLOAT3 Target;
+	};
+
+	// Views at a few distances from around the mesh's bounds, looking at the
+	// middle and past it, from close to the surface, and from inside.
+	std::vector<View> Views(const MeshData& mesh)
+	{
+		XMVECTOR lo = XMVectorReplicate(1e30f);
+		XMVECTOR hi = XMVectorReplicate(-1e30f);
+		for(const GeometryGenerator::Vertex& v : mesh.Vertices)
+		{
+			lo = XMVectorMin(lo, XMLoadFloat3(&v.Position));
+			hi = XMVectorMax(hi, XMLoadFloat3(&v.Position));
+		}
+		XMFLOAT3 middle;
+		XMStoreFloat3(&middle, 0.5f*(lo + hi));
+		float size = XMVectorGetX(XMVector3Length(hi - lo));
+
+		std::vector<View> views;
+		for(float distance : { 0.3f, 0.8f, 2.0f, 6.0f })
+		{
+			for(int k = 0; k < 14; ++k)
+			{
+				float theta = 0.45f*k;
+				float phi = 0.4f + 0.17f*k;
+				XMFLOAT3 eye(middle.x + distance*size*sinf(phi)*cosf(theta),
+					middle.y + distance*size*cosf(phi),
+					middle.z + distance*size*sinf(phi)*sinf(theta));
+
+				views.push_back({ eye, middle });
+
+				// Off to one side, so the frustum cuts the mesh.
+				XMFLOAT3 beside(middle.x + 0.4f*size*cosf(2.0f*theta), middle.y, middle.z + 0.4f*size*sinf(2.0f*theta));
+				views.push_back({ eye, beside });
+			}
+		}
+		// Just off the surface, looking along it, where the backface cone test
+		// has the least room.
+		for(size_t k = 0; k < 24; ++k)
+		{
+			const GeometryGenerator::Vertex& v = mesh.Vertices[(k*mesh.Vertices.size())/24];
+			XMVECTOR eye = XMLoadFloat3(&v.Position) + (0.01f*size)*XMLoadFloat3(&v.Normal);
+			XMVECTOR along = XMVector3Normalize(XMVector3Cross(XMLoadFloat3(&v.Normal), XMVectorSet(0.3f, 1.0f, 0.5f, 0.0f)));
+			View view;
+			XMStoreFloat3(&view.Eye, eye);
+			XMStoreFloat3(&view.Target, eye + along - (k % 2 == 0 ? 0.2f : 0.0f)*XMLoadFloat3(&v.Normal));
+			views.push_back(view);
+		}
+
+		views.push_back({ middle, XMFLOAT3(middle.x + 1.0f, middle.y, middle.z) });
+		views.push_back({ middle, XMFLOAT3(middle.x, middle.y - 1.0f, middle.z + 0.2f) });
+		return views;
+	}
+
+	// Whether the triangle faces the eye (clockwise on screen, D3D's default front
+	// face) and has a corner or its middle in the frustum.
+	bool MustDraw(const MeshData& mesh, const uint32* tri, FXMMATRIX world, CXMMATRIX viewProj, FXMVECTOR eyeW)
+	{
+		XMVECTOR p[3];
+		for(int k = 0; k < 3; ++k)
+			p[k] = XMVector3Transform(XMLoadFloat3(&mesh.Vertices[tri[k]].Position), world);
+
+		XMVECTOR n = XMVector3Cross(p[1] - p[0], p[2] - p[0]);
+		if(XMVectorGetX(XMVector3Dot(n, eyeW - p[0])) <= 1e-6f*XMVectorGetX(XMVector3Length(n)))
+			return false;
+
+		XMVECTOR points[4] = { p[0], p[1], p[2], (p[0] + p[1] + p[2])/3.0f };
+		for(const XMVECTOR& point : points)
+		{
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector4Transform(XMVectorSetW(point, 1.0f), viewProj));
+
+			// A little inside, so a point on a plane does not count.
+			float w = 0.999f*clip.w;
+			if(clip.w > 0.0f && fabsf(clip.x) < w && fabsf(clip.y) < w && clip.z > 0.001f*clip.w && clip.z < w)
+				return true;
+		}
+		return false;
+	}
+
+	void TestCull()
+	{
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*XM_PI, 1.5f, 0.05f, 500.0f);
+		XMMATRIX worlds[] =
+		{
+			XMMatrixIdentity(),
+			XMMatrixScaling(2.0f, 2.0f, 2.0f)*XMMatrixRotationX(0.3f)*XMMatrixRotationY(1.1f)*XMMatrixTranslation(5.0f, -2.0f, 3.0f),
+		};
+
+		for(const Named& named : AllMeshes())
+		{
+			const MeshData& mesh = named.Mesh;
+			MeshletBuilder::MeshletMesh meshlets = MeshletBuilder::Build(mesh);
+			MeshletCuller culler(meshlets);
+			CHECK(culler.MeshletCount() == meshlets.Meshlets.size());
+
+			uint32 meshTriangles = static_cast<uint32>(mesh.Indices32.size() / 3);
+			int dropped = 0;
+			int partial = 0;
+			int culledSome = 0;
+			int viewCount = 0;
+			std::vector<uint32> indices;
+
+			for(const XMMATRIX& world : worlds)
+			{
+				for(const View& view : Views(mesh))
+				{
+					// The views are in object space; the eye and target go through
+					// world like the mesh does.
+					XMVECTOR eyeW = XMVector3Transform(XMLoadFloat3(&view.Eye), world);
+					XMVECTOR targetW = XMVector3Transform(XMLoadFloat3(&view.Target), world);
+					XMVECTOR up = fabsf(XMVectorGetY(XMVector3Normalize(targetW - eyeW))) > 0.99f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0);
+					XMMATRIX viewProj = XMMatrixLookAtLH(eyeW, targetW, up)*proj;
+
+					XMFLOAT3 eyePosW;
+					XMStoreFloat3(&eyePosW, eyeW);
+					uint32 drawn = culler.Cull(world, viewProj, eyePosW, indices);
+
+					// Whole meshlets in order, as many as Cull says it drew.
+					size_t at = 0;
+					uint32 whole = 0;
+					for(size_t m = 0; m < meshlets.Meshlets.size(); ++m)
+					{
+						std::vector<uint32> own = MeshletIndices(meshlets, m);
+						if(at + own.size() <= indices.size() && std::equal(own.begin(), own.end(), indices.begin() + at))
+						{
+							at += own.size();
+							++whole;
+						}
+					}
+					partial += at != indices.size() || whole != drawn;
+					CHECK(drawn <= culler.MeshletCount());
+
+					std::vector<Triangle> drawnList = Triangles(indices);
+					for(size_t t = 0; t < mesh.Indices32.size() / 3; ++t)
+					{
+						const uint32* tri = &mesh.Indices32[t*3];
+						if(!MustDraw(mesh, tri, world, viewProj, eyeW))
+							continue;
+
+						Triangle key = { { tri[0], tri[1], tri[2] } };
+						dropped += !std::binary_search(drawnList.begin(), drawnList.end(), key);
+					}
+
+					culledSome += indices.size() / 3 < meshTriangles;
+					++viewCount;
+				}
+			}
+
+			if(dropped != 0)
+				std::printf("%s: %d visible triangles dropped over %d views\n", named.Name, dropped, viewCount);
+			CHECK(dropped == 0);
+			CHECK(partial == 0);
+
+			// Most views see half the mesh at most, so with enough meshlets the
+			// culler should take something out of most of them.
+			if(culler.MeshletCount() >= 8)
+				CHECK(culledSome > viewCount / 2);
+		}
+	}
+}
+
+int main()
+{
+	TestBuild();
+	TestCull();
+
+	return CheckResult("MeshletTests");
+}
@@ -0,0 +1,150 @@
+//***************************************************************************************
+// SchedulerTests.cpp
+//
+// TaskScheduler covers every index exactly once for 1..N threads, and a Waves
+// simulation gives bit-identical results whatever the thread count.  Prints the step
+// time per thread count as it goes, so the scaling can be read off the test log.
+//***************************************************************************************
+
+#include "Check.h"
+#include "TaskScheduler.h"
+#include "Waves.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// At least four so the multi-threaded paths run on small machines too.
+	int MaxThreadCount()
+	{
+		return std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
+	}
+
+	void TestCoverage(TaskScheduler& scheduler)
+	{
+		const int Count = 100003;
+		const int Grains[] = { 0, 1, 7, 4096, Count*2 };
+
+		// A single thread runs the whole range in one call.
+		const bool splits = scheduler.ThreadCount() > 1;
+
+		for(int grain : Grains)
+		{
+			std::vector<std::atomic<int>> visits(Count);
+			for(auto& v : visits)
+				v = 0;
+
+			scheduler.ParallelForRange(0, Count, grain, [&visits, grain, splits](int first, int last)
+			{
+				CHECK(first < last);
+				CHECK(!splits || grain <= 0 || last - first <= grain);
+				for(int i = first; i < last; ++i)
+					++visits[i];
+			});
+
+			int wrong = 0;
+			for(auto& v : visits)
+				wrong += v != 1;
+			CHECK(wrong == 0);
+		}
+
+		// Empty and reversed ranges do nothing.
+		int calls = 0;
+		scheduler.ParallelFor(5, 5, 1, [&calls](int) { ++calls; });
+		scheduler.ParallelFor(5, 2, 1, [&calls](int) { ++calls; });
+		CHECK(calls == 0);
+	}
+
+	void TestNested(TaskScheduler& scheduler)
+	{
+		const int Outer = 64;
+		const int Inner = 1000;
+		std::atomic<long long> sum{0};
+
+		scheduler.ParallelFor(0, Outer, 1, [&scheduler, &sum](int i)
+		{
+			scheduler.ParallelFor(0, Inner, 16, [&sum, i](int j)
+			{
+				sum += i*Inner + j;
+			});
+		});
+
+		long long n = static_cast<long long>(Outer)*Inner;
+		CHECK(sum == n*(n - 1)/2);
+	}
+
+	// Steps a disturbed grid and returns the heights and normals.
+	std::vector<float> RunWaves(TaskScheduler& scheduler, bool sparse, double& msPerStep)
+	{
+		const int Size = 257;
+		Waves waves(Size, Size, 1.0f, 0.03f, 4.0f, 0.2f);
+		waves.SetScheduler(&scheduler);
+		if(sparse)
+			waves.SetSparseSimulation(true);
+
+		for(int k = 0; k < 16; ++k)
+			waves.Disturb(5 + (k*37) % (Size - 10), 5 + (k*61) % (Size - 10), 0.5f);
+
+		Waves::Impulse impulses[8];
+		for(int k = 0; k < 8; ++k)
+		{
+			impulses[k].X = -100.0f + 25.0f*k;
+			impulses[k].Z = 60.0f - 15.0f*k;
+			impulses[k].Magnitude = 0.3f;
+			impulses[k].Radius = 2.0f;
+		}
+		waves.Disturb(impulses, 8);
+
+		const int Steps = 60;
+		auto start = std::chrono::steady_clock::now();
+		for(int k = 0; k < Steps; ++k)
+			waves.Step();
+		msPerStep = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()/Steps;
+
+		std::vector<float> result;
+		result.reserve(waves.VertexCount()*4);
+		for(int i = 0; i < waves.VertexCount(); ++i)
+		{
+			DirectX::XMFLOAT3 n = waves.Normal(i);
+			result.push_back(waves.Height(i));
+			result.push_back(n.x);
+			result.push_back(n.y);
+			result.push_back(n.z);
+		}
+		return result;
+	}
+}
+
+int main()
+{
+	const int maxThreads = MaxThreadCount();
+
+	std::vector<float> reference[2];
+	for(int threads = 1; threads <= maxThreads; ++threads)
+	{
+		TaskScheduler scheduler(threads - 1);
+		CHECK(scheduler.ThreadCount() == threads);
+
+		TestCoverage(scheduler);
+		TestNested(scheduler);
+
+		for(int sparse = 0; sparse < 2; ++sparse)
+		{
+			double msPerStep = 0.0;
+			std::vector<float> result = RunWaves(scheduler, sparse != 0, msPerStep);
+			std::printf("%d thread(s), %s: %.3f ms per step\n", threads, sparse ? "sparse" : "dense", msPerStep);
+
+			if(threads == 1)
+				reference[sparse] = result;
+			else
+				CHECK(std::memcmp(result.data(), reference[sparse].data(), result.size()*sizeof(float)) == 0);
+		}
+	}
+
+	return CheckResult("SchedulerTests");
+}
@@ -0,0 +1,253 @@
+//***************************************************************************************
+// WaterClipmapTests.cpp
+//
+// WaterClipmap's index buffer and vertices: the grid and all four ring variants stay
+// inside their vertices, each ring together with the finer level it surrounds is
+// closed (every inner edge is shared by exactly two triangles with opposite winding,
+// so the stitching fans leave no T-junctions or cracks), and for any eye position the
+// levels drawn with DrawArgs tile the clipmap's square without gaps or overlaps.
+// The 1-2-1 mips of a constant height field stay constant.
+//***************************************************************************************
+
+#include "Check.h"
+#include "TaskScheduler.h"
+#include "WaterClipmap.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <utility>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef std::uint32_t uint32;
+
+	const int LevelCount = 5;
+	const int RingSize = 4;
+	const int LevelSize = 4*RingSize + 1;
+	const int Cells = LevelSize - 1;
+
+	// The four ring variants, as (start, count) in Indices(), in the order they are
+	// built: the grid comes first, then the rings one after another.
+	std::vector<std::pair<int, int>> RingRanges(const WaterClipmap& clipmap)
+	{
+		const int gridCount = 6*Cells*Cells;
+		const int ringCount = (static_cast<int>(clipmap.Indices().size()) - gridCount) / 4;
+
+		std::vector<std::pair<int, int>> ranges;
+		for(int v = 0; v < 4; ++v)
+			ranges.push_back(std::make_pair(gridCount + v*ringCount, ringCount));
+		return ranges;
+	}
+
+	void TestIndexRanges(const WaterClipmap& clipmap)
+	{
+		const std::vector<uint32>& indices = clipmap.Indices();
+		const uint32 n2 = LevelSize*LevelSize;
+
+		WaterClipmap::LevelDrawArgs grid = clipmap.DrawArgs(0);
+		CHECK(grid.StartIndexLocation == 0);
+		CHECK(grid.IndexCount == 6*Cells*Cells);
+
+		int outOfRange = 0;
+		for(int k = 0; k < grid.IndexCount; ++k)
+			outOfRange += indices[k] >= n2;
+
+		// Ring indices are relative to the finer level: its vertices, then the
+		// ring's own.
+		int total = grid.IndexCount;
+		for(const std::pair<int, int>& range : RingRanges(clipmap))
+		{
+			CHECK(range.second % 3 == 0);
+			for(int k = range.first; k < range.first + range.second; ++k)
+				outOfRange += indices[k] >= 2*n2;
+			total += range.second;
+		}
+		CHECK(outOfRange == 0);
+		CHECK(total == static_cast<int>(indices.size()));
+	}
+
+	// Every directed edge occurs once, and every edge but those on the outside of
+	// the ring has its reverse in another triangle.
+	void TestClosedRings(const WaterClipmap& clipmap)
+	{
+		const std::vector<uint32>& indices = clipmap.Indices();
+		const uint32 n2 = LevelSize*LevelSize;
+		const int gridCount = clipmap.DrawArgs(0).IndexCount;
+
+		auto onOutside = [n2](uint32 id)
+		{
+			if(id < n2)
+				return false;
+			int a = (id - n2) / LevelSize;
+			int b = (id - n2) % LevelSize;
+			return a == 0 || b == 0 || a == Cells || b == Cells;
+		};
+
+		for(const std::pair<int, int>& range : RingRanges(clipmap))
+		{
+			std::map<std::pair<uint32, uint32>, int> edges;
+			auto addTriangles = [&](int first, int count)
+			{
+				for(int t = first; t + 2 < first + count; t += 3)
+				{
+					for(int k = 0; k < 3; ++k)
+						++edges[std::make_pair(indices[t + k], indices[t + (k + 1) % 3])];
+				}
+			};
+
+			// The finer level is drawn with the grid indices at the same base.
+			addTriangles(0, gridCount);
+			addTriangles(range.first, range.second);
+
+			int repeated = 0;
+			int open = 0;
+			int outside = 0;
+			for(const auto& edge : edges)
+			{
+				repeated += edge.second != 1;
+				if(edges.count(std::make_pair(edge.first.second, edge.first.first)) == 0)
+				{
+					uint32 p = edge.first.first;
+					uint32 q = edge.first.second;
+					int pa = (p - n2) / LevelSize, pb = (p - n2) % LevelSize;
+					int qa = (q - n2) / LevelSize, qb = (q - n2) % LevelSize;
+					bool sameSide = (pa == qa && (pa == 0 || pa == Cells)) || (pb == qb && (pb == 0 || pb == Cells));
+					if(onOutside(p) && onOutside(q) && sameSide)
+						++outside;
+					else
+						++open;
+				}
+			}
+			CHECK(repeated == 0);
+			CHECK(open == 0);
+			CHECK(outside == 4*Cells);
+		}
+	}
+
+	// Draws every level with its DrawArgs for the given eye, in world x/z: all
+	// triangles wind the same way, and together they cover the coarsest level's
+	// square exactly once.
+	void TestCoverage(const WaterClipmap& clipmap)
+	{
+		const std::vector<uint32>& indices = clipmap.Indices();
+
+		Waves::VertexLayout layout;
+		layout.Stride = 12;
+		layout.NormalOffset = -1;
+		layout.TexCOffset = -1;
+		std::vector<XMFLOAT3> vertices(clipmap.VertexCount());
+		clipmap.WriteVertices(vertices.data(), layout);
+
+		double area = 0.0;
+		int wrongWinding = 0;
+		int outOfRange = 0;
+		for(int level = 0; level < clipmap.LevelCount(); ++level)
+		{
+			WaterClipmap::LevelDrawArgs args = clipmap.DrawArgs(level);
+			bool known = level == 0;
+			for(const std::pair<int, int>& range : RingRanges(clipmap))
+				known |= args.StartIndexLocation == range.first && args.IndexCount == range.second;
+			CHECK(known);
+			if(!known)
+				continue;
+
+			for(int t = args.StartIndexLocation; t + 2 < args.StartIndexLocation + args.IndexCount; t += 3)
+			{
+				const XMFLOAT3* p[3];
+				bool inRange = true;
+				for(int k = 0; k < 3; ++k)
+				{
+					size_t v = args.BaseVertexLocation + indices[t + k];
+					inRange &= v < vertices.size();
+					p[k] = inRange ? &vertices[v] : &vertices[0];
+				}
+				outOfRange += !inRange;
+
+				// Clockwise seen from above, like the Waves grid: x right and z up the page.
+				double cross = double(p[1]->x - p[0]->x)*(p[2]->z - p[0]->z) - double(p[1]->z - p[0]->z)*(p[2]->x - p[0]->x);
+				wrongWinding += cross >= 0.0;
+				area += 0.5*std::fabs(cross);
+			}
+		}
+		CHECK(outOfRange == 0);
+		CHECK(wrongWinding == 0);
+
+		// The coarsest level spans Cells cells of 2^(LevelCount-1) source points.
+		double side = Cells*double(1 << (clipmap.LevelCount() - 1));
+		CHECK_NEAR(area, side*side, 1e-6*side*side);
+	}
+
+	// Heights and normals of every vertex for a tileable source.  Outside a
+	// non-tileable source the water is flat at zero and the filter blends that in,
+	// so there only texels whose neighbours are a texel inside the source count.
+	void TestConstantMips(bool tileable)
+	{
+		// 2^6 + 1 points a side, so the mips come out 33, 17, 9 and 5 wide.
+		const int Size = 65;
+		const float Height = 0.7f;
+		std::vector<float> heights(Size*Size, Height);
+
+		TaskScheduler scheduler(2);
+		WaterClipmap clipmap(LevelCount, RingSize);
+		clipmap.SetScheduler(&scheduler);
+		clipmap.SetSource(heights.data(), Size, Size, 1.0f, tileable);
+		clipmap.Recenter(3.0f, -5.0f);
+
+		Waves::VertexLayout layout;
+		std::vector<std::uint8_t> vertices(static_cast<size_t>(clipmap.VertexCount())*layout.Stride);
+		clipmap.WriteVertices(vertices.data(), layout);
+
+		int wrong = 0;
+		int checked = 0;
+		for(int level = 0; level < clipmap.LevelCount(); ++level)
+		{
+			const int step = 1 << level;
+			const int mipSize = (Size - 1) / step + 1;
+			for(int k = 0; k < clipmap.LevelVertexCount(); ++k)
+			{
+				XMFLOAT3 p, n;
+				const std::uint8_t* v = &vertices[(static_cast<size_t>(level)*clipmap.LevelVertexCount() + k)*layout.Stride];
+				std::memcpy(&p, v + layout.PositionOffset, sizeof(p));
+				std::memcpy(&n, v + layout.NormalOffset, sizeof(n));
+
+				// Mip texel of the vertex; its neighbours are read for the normal.
+				int col = static_cast<int>(std::lround(p.x + 0.5f*(Size - 1))) / step;
+				int row = static_cast<int>(std::lround(0.5f*(Size - 1) - p.z)) / step;
+				bool inside = row >= 2 && row <= mipSize - 3 && col >= 2 && col <= mipSize - 3;
+				if(!tileable && !inside)
+					continue;
+
+				++checked;
+				wrong += std::fabs(p.y - Height) > 1e-5f;
+				wrong += std::fabs(n.x) > 1e-5f || std::fabs(n.y - 1.0f) > 1e-5f || std::fabs(n.z) > 1e-5f;
+			}
+		}
+		CHECK(checked > 0);
+		CHECK(wrong == 0);
+	}
+}
+
+int main()
+{
+	WaterClipmap clipmap(LevelCount, RingSize);
+	TestIndexRanges(clipmap);
+	TestClosedRings(clipmap);
+
+	// Eye positions that leave the holes at all four offsets, and far away.
+	const float eyes[][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, -1.0f }, { 3.0f, 5.0f },
+		{ -7.5f, 2.25f }, { 13.0f, -29.0f }, { 1.0e4f, -3.0e4f } };
+	for(const float* eye : eyes)
+	{
+		clipmap.Recenter(eye[0], eye[1]);
+		TestCoverage(clipmap);
+	}
+
+	TestConstantMips(true);
+	TestConstantMips(false);
+
+	return CheckResult("WaterClipmapTests");
+}
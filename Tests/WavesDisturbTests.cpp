@@ -0,0 +1,185 @@
+//***************************************************************************************
+// WavesDisturbTests.cpp
+//
+// The batched Waves::Disturb with splats centred on, just outside, straddling and far
+// beyond each edge and corner of the grid, and across the tile borders they are
+// binned by: the batch gives the same heights as the splats added one at a time and
+// as a plain Gaussian clipped to the interior, and the boundary stays at rest.  Dense
+// and sparse binning, on one thread and on several.
+//***************************************************************************************
+
+#include "Check.h"
+#include "TaskScheduler.h"
+#include "Waves.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	// Neither a multiple of the 32 point splat tiles nor of the sparse tiles below.
+	const int Rows = 75;
+	const int Cols = 70;
+	const float Dx = 1.0f;
+	const int SparseTileSize = 16;
+
+	// Must match Waves.cpp.
+	const float SplatCutoff = 3.0f;
+	const float MinSplatRadius = 0.25f;
+
+	// World x of column j and z of row i, which may be fractional or off the grid.
+	float ColumnX(float j) { return -(Cols - 1)*Dx*0.5f + j*Dx; }
+	float RowZ(float i) { return (Rows - 1)*Dx*0.5f - i*Dx; }
+
+	Waves::Impulse MakeImpulse(float i, float j, float radius, float magnitude)
+	{
+		Waves::Impulse impulse;
+		impulse.X = ColumnX(j);
+		impulse.Z = RowZ(i);
+		impulse.Radius = radius;
+		impulse.Magnitude = magnitude;
+		return impulse;
+	}
+
+	// Splats around every edge and corner, at grid rows/columns i and j that may lie
+	// outside the grid, and some across the tile borders.
+	std::vector<Waves::Impulse> MakeImpulses()
+	{
+		// On the boundary, just outside, outside but still reaching in, straddling
+		// from inside, and too far out to reach the interior.
+		const float offsets[] = { 0.0f, -0.5f, -2.0f, 1.0f, -20.0f };
+		const float radii[] = { 0.7f, 2.0f, 0.05f };
+
+		std::vector<Waves::Impulse> impulses;
+		float magnitude = 0.1f;
+		for(float radius : radii)
+		{
+			for(float offset : offsets)
+			{
+				float top = offset;
+				float bottom = Rows - 1 - offset;
+				float left = offset;
+				float right = Cols - 1 - offset;
+
+				// Edges, away from the corners.
+				impulses.push_back(MakeImpulse(top, Cols*0.4f, radius, magnitude));
+				impulses.push_back(MakeImpulse(bottom, Cols*0.6f, radius, magnitude));
+				impulses.push_back(MakeImpulse(Rows*0.3f, left, radius, magnitude));
+				impulses.push_back(MakeImpulse(Rows*0.7f, right, radius, magnitude));
+
+				// Corners.
+				impulses.push_back(MakeImpulse(top, left, radius, magnitude));
+				impulses.push_back(MakeImpulse(top, right, radius, magnitude));
+				impulses.push_back(MakeImpulse(bottom, left, radius, magnitude));
+				impulses.push_back(MakeImpulse(bottom, right, radius, magnitude));
+
+				magnitude += 0.01f;
+			}
+		}
+
+		// Across the tile borders, where a splat is split between up to four tiles,
+		// and on top of one another.
+		for(int border : { SparseTileSize, 32, 2*32 })
+		{
+			impulses.push_back(MakeImpulse(border + 0.5f, border + 0.5f, 1.5f, 0.3f));
+			impulses.push_back(MakeImpulse(border + 0.5f, border + 0.5f, 0.6f, -0.2f));
+			impulses.push_back(MakeImpulse(border, Cols*0.5f, 3.0f, 0.25f));
+		}
+		return impulses;
+	}
+
+	// Each splat added on its own to the interior points within its cutoff.
+	std::vector<float> ReferenceHeights(const std::vector<Waves::Impulse>& impulses)
+	{
+		std::vector<float> heights(Rows*Cols, 0.0f);
+		for(const Waves::Impulse& p : impulses)
+		{
+			float col = (p.X - ColumnX(0.0f)) / Dx;
+			float row = (RowZ(0.0f) - p.Z) / Dx;
+			float reach = SplatCutoff*std::max(p.Radius / Dx, MinSplatRadius);
+			float sigma = std::max(p.Radius, MinSplatRadius*Dx);
+			float falloff = 1.0f / (2.0f*sigma*sigma);
+
+			for(int i = 1; i < Rows - 1; ++i)
+			{
+				if(i < std::ceil(row - reach) || i > std::floor(row + reach))
+					continue;
+
+				float dz = RowZ(i) - p.Z;
+				float scale = p.Magnitude*std::exp(-dz*dz*falloff);
+				for(int j = 1; j < Cols - 1; ++j)
+				{
+					if(j < std::ceil(col - reach) || j > std::floor(col + reach))
+						continue;
+
+					float dx = ColumnX(j) - p.X;
+					heights[i*Cols + j] += scale*std::exp(-dx*dx*falloff);
+				}
+			}
+		}
+		return heights;
+	}
+
+	void TestSplats(bool sparse, int workerThreads)
+	{
+		TaskScheduler scheduler(workerThreads);
+		std::vector<Waves::Impulse> impulses = MakeImpulses();
+		std::vector<float> expected = ReferenceHeights(impulses);
+
+		Waves batched(Rows, Cols, Dx, 0.03f, 4.0f, 0.2f);
+		Waves oneByOne(Rows, Cols, Dx, 0.03f, 4.0f, 0.2f);
+		for(Waves* waves : { &batched, &oneByOne })
+		{
+			waves->SetScheduler(&scheduler);
+			waves->SetSparseSimulation(sparse, SparseTileSize);
+		}
+
+		batched.Disturb(impulses.data(), static_cast<int>(impulses.size()));
+		for(const Waves::Impulse& impulse : impulses)
+			oneByOne.Disturb(&impulse, 1);
+
+		int different = 0;
+		int wrong = 0;
+		int boundary = 0;
+		for(int i = 0; i < Rows; ++i)
+		{
+			for(int j = 0; j < Cols; ++j)
+			{
+				int k = i*Cols + j;
+				different += batched.Height(k) != oneByOne.Height(k);
+				wrong += std::fabs(batched.Height(k) - expected[k]) > 1e-6f;
+
+				if(i == 0 || j == 0 || i == Rows - 1 || j == Cols - 1)
+					boundary += batched.Height(k) != 0.0f;
+			}
+		}
+		CHECK(different == 0);
+		CHECK(wrong == 0);
+		CHECK(boundary == 0);
+
+		// The splats reach every edge of the interior.
+		CHECK(batched.Height(1*Cols + 1) != 0.0f);
+		CHECK(batched.Height((Rows - 2)*Cols + Cols - 2) != 0.0f);
+
+		// The boundary stays at rest while the splats spread.
+		for(int k = 0; k < 10; ++k)
+			batched.Step();
+		boundary = 0;
+		for(int i = 0; i < Rows; ++i)
+			boundary += batched.Height(i*Cols) != 0.0f || batched.Height(i*Cols + Cols - 1) != 0.0f;
+		for(int j = 0; j < Cols; ++j)
+			boundary += batched.Height(j) != 0.0f || batched.Height((Rows - 1)*Cols + j) != 0.0f;
+		CHECK(boundary == 0);
+	}
+}
+
+int main()
+{
+	for(int workers : { 0, 3 })
+	{
+		TestSplats(false, workers);
+		TestSplats(true, workers);
+	}
+
+	return CheckResult("WavesDisturbTests");
+}
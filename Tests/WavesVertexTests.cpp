@@ -0,0 +1,337 @@
+//***************************************************************************************
+// WavesVertexTests.cpp
+//
+// The vertex writers of Waves against the solution accessors: the packed (SIMD) and
+// general layouts write the same vertices, aligned and unaligned destinations agree,
+// and writing only the changed region gives the same buffer as a full write while
+// leaving every other vertex alone.  The compact writer matches EncodeCompact bit for
+// bit, and EncodeCompact/DecodeCompact stay within the error of half heights and
+// snorm16 octahedral normals.  Sampling at grid points gives the grid heights.
+//***************************************************************************************
+
+#include "Check.h"
+#include "TaskScheduler.h"
+#include "Waves.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// Column count not a multiple of four, so the scalar tails run too.
+	const int Rows = 61;
+	const int Cols = 67;
+
+	const std::uint8_t Sentinel = 0xCD;
+
+	// Largest angle between a unit normal and its decoded octahedral encoding.  The
+	// snorm16 grid is 1/32767 apart, which gives about 6.4e-5 rad at worst.
+	const double MaxNormalAngle = 1.0e-4;
+
+	void MakeWaves(Waves& waves)
+	{
+		for(int k = 0; k < 6; ++k)
+			waves.Disturb(4 + 9*k, 5 + 10*k, 0.4f);
+		for(int k = 0; k < 5; ++k)
+			waves.Step();
+	}
+
+	bool SameFloats(const std::uint8_t* p, const float* expected, int count)
+	{
+		return std::memcmp(p, expected, count*sizeof(float)) == 0;
+	}
+
+	bool AllSentinel(const std::uint8_t* p, int count)
+	{
+		for(int k = 0; k < count; ++k)
+		{
+			if(p[k] != Sentinel)
+				return false;
+		}
+		return true;
+	}
+
+	// Checks every vertex of buffer against the accessors.  Bytes no attribute
+	// covers must still hold the sentinel.
+	void CheckVertices(const Waves& waves, const std::uint8_t* buffer, const Waves::VertexLayout& layout)
+	{
+		std::vector<bool> covered(layout.Stride, false);
+		auto cover = [&covered](int offset, int bytes)
+		{
+			for(int k = 0; offset >= 0 && k < bytes; ++k)
+				covered[offset + k] = true;
+		};
+		cover(layout.PositionOffset, 12);
+		cover(layout.NormalOffset, 12);
+		cover(layout.TexCOffset, 8);
+		cover(layout.TangentOffset, 12);
+
+		int wrong = 0;
+		for(int i = 0; i < waves.VertexCount(); ++i)
+		{
+			const std::uint8_t* v = buffer + static_cast<size_t>(i)*layout.Stride;
+
+			XMFLOAT3 p = waves.Position(i);
+			XMFLOAT3 n = waves.Normal(i);
+			XMFLOAT2 uv = waves.TexC(i);
+			XMFLOAT3 t = waves.TangentX(i);
+
+			bool ok = true;
+			if(layout.PositionOffset >= 0)
+				ok &= SameFloats(v + layout.PositionOffset, &p.x, 3);
+			if(layout.NormalOffset >= 0)
+				ok &= SameFloats(v + layout.NormalOffset, &n.x, 3);
+			if(layout.TexCOffset >= 0)
+				ok &= SameFloats(v + layout.TexCOffset, &uv.x, 2);
+			if(layout.TangentOffset >= 0)
+				ok &= SameFloats(v + layout.TangentOffset, &t.x, 3);
+
+			for(int k = 0; k < layout.Stride; ++k)
+				ok &= covered[k] || v[k] == Sentinel;
+
+			wrong += !ok;
+		}
+		CHECK(wrong == 0);
+	}
+
+	void TestLayouts(const Waves& waves)
+	{
+		Waves::VertexLayout packed;
+
+		Waves::VertexLayout tangents;
+		tangents.Stride = 48;
+		tangents.PositionOffset = 0;
+		tangents.NormalOffset = 12;
+		tangents.TangentOffset = 24;
+		tangents.TexCOffset = 36;
+
+		Waves::VertexLayout sparse;
+		sparse.Stride = 40;
+		sparse.PositionOffset = 4;
+		sparse.NormalOffset = -1;
+		sparse.TexCOffset = 24;
+
+		for(const Waves::VertexLayout& layout : { packed, tangents, sparse })
+		{
+			// Offsets 0 and 4 from a 16-byte boundary: streaming and plain stores.
+			for(int misalign = 0; misalign <= 4; misalign += 4)
+			{
+				std::vector<std::uint8_t> storage(waves.VertexCount()*layout.Stride + 16 + misalign, Sentinel);
+				std::uint8_t* buffer = storage.data();
+				buffer += (16 - reinterpret_cast<std::uintptr_t>(buffer) % 16) % 16 + misalign;
+
+				waves.WriteVertices(buffer, layout);
+				CheckVertices(waves, buffer, layout);
+			}
+		}
+	}
+
+	void TestDirtyRegion(Waves& waves)
+	{
+		const Waves::VertexLayout layouts[2] = { Waves::VertexLayout(), { 48, 0, 12, 36, 24 } };
+
+		for(const Waves::VertexLayout& layout : layouts)
+		{
+			size_t bytes = static_cast<size_t>(waves.VertexCount())*layout.Stride;
+
+			std::vector<std::uint8_t> incremental(bytes, Sentinel);
+			waves.WriteVertices(incremental.data(), layout);
+			waves.ClearChangedRegion();
+
+			// A disturbance somewhere, then a few steps for it to spread.
+			waves.Disturb(Rows/2, Cols/3, 0.25f);
+			for(int k = 0; k < 3; ++k)
+				waves.Step();
+
+			const Waves::DirtyRegion& region = waves.ChangedRegion();
+			CHECK(!region.IsEmpty());
+			CHECK(region.VertexCount() < waves.VertexCount());
+
+			// Only the region, into a buffer of sentinels.
+			std::vector<std::uint8_t> partial(bytes, Sentinel);
+			waves.WriteVertices(partial.data(), layout, region);
+
+			int outside = 0;
+			int inside = 0;
+			for(int i = 0; i < Rows; ++i)
+			{
+				for(int j = 0; j < Cols; ++j)
+				{
+					const std::uint8_t* v = &partial[static_cast<size_t>(i*Cols + j)*layout.Stride];
+					bool dirty = j >= region.First[i] && j < region.Last[i];
+					if(dirty)
+						inside += AllSentinel(v, layout.Stride);
+					else
+						outside += !AllSentinel(v, layout.Stride);
+				}
+			}
+			CHECK(inside == 0);
+			CHECK(outside == 0);
+
+			// Region on top of the old full write is the new full write.
+			waves.WriteVertices(incremental.data(), layout, region);
+			std::vector<std::uint8_t> full(bytes, Sentinel);
+			waves.WriteVertices(full.data(), layout);
+			CHECK(incremental == full);
+
+			waves.ClearChangedRegion();
+		}
+	}
+
+	// Sampling exactly at grid points gives the heights there, including the last
+	// row and column, which clamp to the last cell.
+	void TestSampling(const Waves& waves)
+	{
+		std::vector<XMFLOAT2> points;
+		std::vector<int> indices;
+		auto add = [&](int i, int j)
+		{
+			XMFLOAT3 p = waves.Position(i*Cols + j);
+			points.push_back(XMFLOAT2(p.x, p.z));
+			indices.push_back(i*Cols + j);
+		};
+		for(int i = 0; i < Rows; i += 3)
+		{
+			for(int j = 0; j < Cols; j += 5)
+				add(i, j);
+			add(i, Cols - 1);
+		}
+		for(int j = 0; j < Cols; ++j)
+			add(Rows - 1, j);
+
+		std::vector<float> heights(points.size());
+		waves.SampleHeights(points.data(), static_cast<int>(points.size()), heights.data());
+
+		int wrong = 0;
+		for(size_t k = 0; k < points.size(); ++k)
+			wrong += std::fabs(heights[k] - waves.Height(indices[k])) > 1.0e-5f;
+		CHECK(wrong == 0);
+	}
+
+	// Angle between two unit vectors, accurate for small angles.
+	double Angle(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		double cx = double(a.y)*b.z - double(a.z)*b.y;
+		double cy = double(a.z)*b.x - double(a.x)*b.z;
+		double cz = double(a.x)*b.y - double(a.y)*b.x;
+		double dot = double(a.x)*b.x + double(a.y)*b.y + double(a.z)*b.z;
+		return std::atan2(std::sqrt(cx*cx + cy*cy + cz*cz), dot);
+	}
+
+	bool SameCompact(const Waves::CompactVertex& a, const Waves::CompactVertex& b)
+	{
+		return a.Height == b.Height && a.NormalOct.x == b.NormalOct.x && a.NormalOct.y == b.NormalOct.y;
+	}
+
+	void TestCompactWriter(Waves& waves)
+	{
+		std::vector<Waves::CompactVertex> compact(waves.VertexCount());
+		waves.WriteCompactVertices(compact.data());
+
+		int wrong = 0;
+		for(int i = 0; i < waves.VertexCount(); ++i)
+			wrong += !SameCompact(compact[i], Waves::EncodeCompact(waves.Height(i), waves.Normal(i)));
+		CHECK(wrong == 0);
+
+		// The region on top of the old frame is the new frame.
+		waves.ClearChangedRegion();
+		waves.Disturb(Rows/3, Cols/2, -0.3f);
+		waves.Step();
+		waves.WriteCompactVertices(compact.data(), waves.ChangedRegion());
+
+		wrong = 0;
+		for(int i = 0; i < waves.VertexCount(); ++i)
+			wrong += !SameCompact(compact[i], Waves::EncodeCompact(waves.Height(i), waves.Normal(i)));
+		CHECK(wrong == 0);
+		waves.ClearChangedRegion();
+	}
+
+	void TestCompactError()
+	{
+		std::mt19937 random(99);
+		std::uniform_real_distribution<float> height(-8.0f, 8.0f);
+
+		// Directions spread evenly over the sphere, both sides of the fold, plus
+		// the axes and the octahedron's edges.
+		std::vector<XMFLOAT3> normals;
+		const int Count = 50000;
+		for(int k = 0; k < Count; ++k)
+		{
+			float y = 1.0f - 2.0f*(k + 0.5f)/Count;
+			float r = std::sqrt(1.0f - y*y);
+			float phi = 2.39996323f*k;
+			normals.push_back(XMFLOAT3(r*std::cos(phi), y, r*std::sin(phi)));
+		}
+		for(float y = -1.0f; y <= 1.0f; y += 1.0f)
+		{
+			for(float x = -1.0f; x <= 1.0f; x += 1.0f)
+			{
+				for(float z = -1.0f; z <= 1.0f; z += 1.0f)
+				{
+					if(x != 0.0f || y != 0.0f || z != 0.0f)
+					{
+						XMFLOAT3 n;
+						XMStoreFloat3(&n, XMVector3Normalize(XMVectorSet(x, y, z, 0.0f)));
+						normals.push_back(n);
+					}
+				}
+			}
+		}
+
+		double worstAngle = 0.0;
+		double worstLength = 0.0;
+		int badHeights = 0;
+		for(size_t k = 0; k < normals.size(); ++k)
+		{
+			const XMFLOAT3& n = normals[k];
+
+			// Some heights small enough to be half denormals.
+			float h = height(random);
+			if(k % 7 == 0)
+				h *= 1.0e-5f;
+
+			float decodedHeight;
+			XMFLOAT3 decoded;
+			Waves::DecodeCompact(Waves::EncodeCompact(h, n), decodedHeight, decoded);
+
+			// Half floats keep 11 significant bits: relative error 2^-11 after
+			// rounding, and absolute 2^-25 below the normal range.
+			double heightError = std::fabs(double(decodedHeight) - h);
+			badHeights += heightError > std::max(std::fabs(h)*std::ldexp(1.0, -11), std::ldexp(1.0, -25));
+
+			worstAngle = std::max(worstAngle, Angle(n, decoded));
+			double length = std::sqrt(double(decoded.x)*decoded.x + double(decoded.y)*decoded.y + double(decoded.z)*decoded.z);
+			worstLength = std::max(worstLength, std::fabs(length - 1.0));
+		}
+
+		CHECK(badHeights == 0);
+		CHECK(worstAngle <= MaxNormalAngle);
+		CHECK(worstLength <= 1.0e-6);
+		std::printf("compact normals: worst error %.3g rad over %d directions\n", worstAngle, static_cast<int>(normals.size()));
+	}
+}
+
+int main()
+{
+	TaskScheduler scheduler(3);
+
+	Waves waves(Rows, Cols, 1.0f, 0.03f, 4.0f, 0.2f);
+	waves.SetScheduler(&scheduler);
+	MakeWaves(waves);
+
+	TestLayouts(waves);
+	TestSampling(waves);
+	TestDirtyRegion(waves);
+	TestCompactWriter(waves);
+	TestCompactError();
+
+	waves.SetSparseSimulation(true, 16);
+	TestDirtyRegion(waves);
+
+	return CheckResult("WavesVertexTests");
+}
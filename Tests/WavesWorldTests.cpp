@@ -0,0 +1,190 @@
+//***************************************************************************************
+// WavesWorldTests.cpp
+//
+// WavesWorld against the same patches stepped on their own: patches of different
+// sizes, time steps and disturbances, dense and sparse, updated through the batched
+// StepBatch give bit-identical heights, normals and tangents to standalone Waves
+// updated with Waves::Update, and take the same number of steps.  Frame times include
+// stalls long enough for the catch-up limit, and the results are the same on any
+// thread count.
+//***************************************************************************************
+
+#include "Check.h"
+#include "TaskScheduler.h"
+#include "Waves.h"
+#include "WavesWorld.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	struct PatchDesc
+	{
+		int Rows;
+		int Cols;
+		float Dx;
+		float Dt;
+		float Speed;
+		float Damping;
+		bool Sparse;
+	};
+
+	// Sizes that do and do not fill the last band and tile, clocks that fall due
+	// at different frames, and sparse patches among the dense ones.
+	const PatchDesc Patches[] =
+	{
+		{ 33, 35, 1.0f, 0.030f, 4.0f, 0.2f, false },
+		{ 64, 17, 0.5f, 0.010f, 2.0f, 0.1f, false },
+		{ 129, 129, 1.0f, 0.020f, 4.0f, 0.3f, true },
+		{ 20, 90, 0.8f, 0.017f, 3.0f, 0.0f, false },
+		{ 97, 61, 1.0f, 0.045f, 5.0f, 0.2f, true },
+		{ 5, 5, 1.0f, 0.030f, 4.0f, 0.2f, false },
+	};
+	const int PatchCount = sizeof(Patches) / sizeof(Patches[0]);
+
+	// At least four so the multi-threaded paths run on small machines too.
+	int MaxThreadCount()
+	{
+		return std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
+	}
+
+	// Frame times of about 60 Hz with jitter, and two stalls.
+	float FrameTime(int frame)
+	{
+		if(frame == 40)
+			return 0.5f;
+		if(frame == 90)
+			return 0.2f;
+		return 0.016f + 0.004f*((frame*7) % 5 - 2)/2.0f;
+	}
+
+	// The same disturbances for patch p at the given frame, wherever it lives.
+	void Disturb(Waves& waves, int p, int frame)
+	{
+		int rows = waves.RowCount();
+		int cols = waves.ColumnCount();
+
+		if(frame % 17 == p % 3)
+			waves.Disturb(1 + (frame*5 + p) % (rows - 2), 1 + (frame*11 + 3*p) % (cols - 2), 0.3f + 0.05f*p);
+
+		if(frame % 29 == 3)
+		{
+			Waves::Impulse impulses[3];
+			for(int k = 0; k < 3; ++k)
+			{
+				DirectX::XMFLOAT3 at = waves.Position(((rows/4)*(k + 1))*cols + (cols/5)*(k + 1));
+				impulses[k].X = at.x + 0.3f*k;
+				impulses[k].Z = at.z - 0.2f*k;
+				impulses[k].Magnitude = 0.2f - 0.05f*k;
+				impulses[k].Radius = 1.5f*waves.SpatialStep();
+			}
+			waves.Disturb(impulses, 3);
+		}
+	}
+
+	// Heights, normals and tangents of every vertex.
+	std::vector<float> State(const Waves& waves)
+	{
+		std::vector<float> state;
+		state.reserve(waves.VertexCount()*7);
+		for(int i = 0; i < waves.VertexCount(); ++i)
+		{
+			DirectX::XMFLOAT3 n = waves.Normal(i);
+			DirectX::XMFLOAT3 t = waves.TangentX(i);
+			state.insert(state.end(), { waves.Height(i), n.x, n.y, n.z, t.x, t.y, t.z });
+		}
+		return state;
+	}
+
+	bool Same(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()*sizeof(float)) == 0;
+	}
+
+	// Runs the world and the standalone patches side by side and returns the final
+	// state of every patch.
+	std::vector<std::vector<float>> Run(TaskScheduler& scheduler)
+	{
+		WavesWorld world(&scheduler);
+		std::vector<std::unique_ptr<Waves>> alone;
+		for(const PatchDesc& d : Patches)
+		{
+			Waves* patch = world.AddPatch(d.Rows, d.Cols, d.Dx, d.Dt, d.Speed, d.Damping);
+			alone.push_back(std::make_unique<Waves>(d.Rows, d.Cols, d.Dx, d.Dt, d.Speed, d.Damping));
+			alone.back()->SetScheduler(&scheduler);
+
+			patch->SetSparseSimulation(d.Sparse, 16);
+			alone.back()->SetSparseSimulation(d.Sparse, 16);
+		}
+
+		int wrongSteps = 0;
+		int different = 0;
+		int stepped = 0;
+		for(int frame = 0; frame < 150; ++frame)
+		{
+			for(int p = 0; p < PatchCount; ++p)
+			{
+				Disturb(*world.Patch(p), p, frame);
+				Disturb(*alone[p], p, frame);
+			}
+
+			std::int64_t stepsBefore = 0;
+			for(const auto& waves : alone)
+				stepsBefore += waves->GetStageTimings().Steps;
+
+			world.Update(FrameTime(frame));
+			for(const auto& waves : alone)
+				waves->Update(FrameTime(frame));
+
+			std::int64_t steps = -stepsBefore;
+			for(const auto& waves : alone)
+				steps += waves->GetStageTimings().Steps;
+			wrongSteps += world.StepCount() != steps;
+			stepped += world.StepCount();
+
+			// Compared every few frames, so a difference is caught near where it
+			// starts.
+			if(frame % 10 == 9)
+			{
+				for(int p = 0; p < PatchCount; ++p)
+					different += !Same(State(*world.Patch(p)), State(*alone[p]));
+			}
+		}
+		CHECK(wrongSteps == 0);
+		CHECK(different == 0);
+		CHECK(stepped > 0);
+
+		std::vector<std::vector<float>> states;
+		for(int p = 0; p < PatchCount; ++p)
+			states.push_back(State(*world.Patch(p)));
+		return states;
+	}
+}
+
+int main()
+{
+	std::vector<std::vector<float>> reference;
+	for(int threads = 1; threads <= MaxThreadCount(); ++threads)
+	{
+		TaskScheduler scheduler(threads - 1);
+		std::vector<std::vector<float>> states = Run(scheduler);
+
+		if(threads == 1)
+		{
+			reference = states;
+		}
+		else
+		{
+			int different = 0;
+			for(int p = 0; p < PatchCount; ++p)
+				different += !Same(states[p], reference[p]);
+			CHECK(different == 0);
+		}
+	}
+
+	return CheckResult("WavesWorldTests");
+}